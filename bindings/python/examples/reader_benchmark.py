@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+# reader_benchmark.py
+#
+# Babeltrace example script measuring the event reading throughput
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+# This example reads a whole trace with each of the ways of accessing
+# event fields offered by the babeltrace python module, and prints
+# the number of events read per second:
+#
+#   iterate   events only, no field access
+#   getitem   every field, one event[name] access at a time
+#   as_dict   every field, converted with Event.as_dict()
+#   as_tuple  every field, converted with Event.as_tuple()
+
+import sys
+import time
+import babeltrace.reader
+
+
+def read_none(event):
+    pass
+
+
+def read_getitem(event):
+    for name in event.keys():
+        event[name]
+
+
+def read_as_dict(event):
+    event.as_dict()
+
+
+def read_as_tuple(event):
+    event.as_tuple()
+
+
+methods = [
+    ("iterate", read_none),
+    ("getitem", read_getitem),
+    ("as_dict", read_as_dict),
+    ("as_tuple", read_as_tuple),
+]
+
+
+# Check for path arg:
+if len(sys.argv) < 2:
+    raise TypeError("Usage: reader_benchmark.py path/to/trace")
+
+# Create TraceCollection and add trace:
+traces = babeltrace.reader.TraceCollection()
+trace_handle = traces.add_trace(sys.argv[1], "ctf")
+if trace_handle is None:
+    raise IOError("Error adding trace")
+
+for name, read in methods:
+    count = 0
+    begin = time.perf_counter()
+
+    for event in traces.events:
+        read(event)
+        count += 1
+
+    duration = time.perf_counter() - begin
+    rate = count / duration if duration > 0 else 0
+    print("{:<9} {} events in {:.3f} s: {:.0f} events/s".format(
+        name, count, duration, rate))
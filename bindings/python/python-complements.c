@@ -386,3 +386,474 @@ int _bt_python_ctf_clock_set_uuid_index(struct bt_ctf_clock *clock,
 end:
 	return ret;
 }
+
+/* Native event iterator and field values
+   ----------------------------------------------------
+*/
+
+/* Priority of the scopes when searching for event fields */
+static const enum bt_ctf_scope field_scopes[] = {
+	BT_EVENT_FIELDS,
+	BT_EVENT_CONTEXT,
+	BT_STREAM_EVENT_CONTEXT,
+	BT_STREAM_EVENT_HEADER,
+	BT_STREAM_PACKET_CONTEXT,
+	BT_TRACE_PACKET_HEADER,
+};
+
+/*
+ * Fields of the events of an event class in a stream: the field
+ * definitions are reused by every event, so they are looked up once.
+ */
+struct event_fields {
+	PyObject *names;	/* tuple of unique field names */
+	GPtrArray *fields;	/* winning struct bt_definition *, per name */
+};
+
+struct _bt_python_event_iter {
+	struct bt_ctf_iter *iter;
+	GHashTable *event_fields;	/* struct ctf_event_definition * to struct event_fields */
+	int started;
+};
+
+static
+void event_fields_destroy(gpointer data)
+{
+	struct event_fields *event_fields = data;
+
+	Py_XDECREF(event_fields->names);
+	if (event_fields->fields) {
+		g_ptr_array_free(event_fields->fields, TRUE);
+	}
+	g_free(event_fields);
+}
+
+static
+PyObject *string_value(const char *str)
+{
+	if (!str) {
+		Py_RETURN_NONE;
+	}
+	return PyUnicode_DecodeUTF8(str, strlen(str), "surrogateescape");
+}
+
+/* True if the array or sequence elements "elem" form a string. */
+static
+int is_string_element(const struct bt_declaration *elem)
+{
+	enum ctf_string_encoding encoding;
+
+	if (bt_ctf_field_type(elem) != CTF_TYPE_INTEGER ||
+		bt_ctf_get_int_len(elem) != CHAR_BIT) {
+		return 0;
+	}
+	encoding = bt_ctf_get_encoding(elem);
+	return encoding == CTF_STRING_UTF8 || encoding == CTF_STRING_ASCII;
+}
+
+static
+PyObject *field_value(const struct bt_definition *field);
+
+static
+PyObject *list_value(struct bt_definition *(*index)(void *, uint64_t),
+		void *container, uint64_t len)
+{
+	PyObject *list;
+	uint64_t i;
+
+	list = PyList_New(len);
+	if (!list) {
+		goto end;
+	}
+	for (i = 0; i < len; i++) {
+		PyObject *value = field_value(index(container, i));
+
+		if (!value) {
+			Py_DECREF(list);
+			list = NULL;
+			goto end;
+		}
+		PyList_SET_ITEM(list, i, value);
+	}
+end:
+	return list;
+}
+
+static
+struct bt_definition *array_index(void *array, uint64_t i)
+{
+	return bt_array_index(array, i);
+}
+
+static
+struct bt_definition *sequence_index(void *sequence, uint64_t i)
+{
+	return bt_sequence_index(sequence, i);
+}
+
+static
+PyObject *struct_value(const struct bt_definition *field)
+{
+	PyObject *dict;
+	uint64_t i, count;
+
+	dict = PyDict_New();
+	if (!dict) {
+		goto end;
+	}
+	count = bt_ctf_get_struct_field_count(field);
+	for (i = 0; i < count; i++) {
+		const struct bt_definition *member;
+		PyObject *value;
+		int ret;
+
+		member = bt_ctf_get_struct_field_index(field, i);
+		value = field_value(member);
+		if (!value) {
+			goto error;
+		}
+		ret = PyDict_SetItemString(dict, bt_ctf_field_name(member),
+			value);
+		Py_DECREF(value);
+		if (ret) {
+			goto error;
+		}
+	}
+end:
+	return dict;
+error:
+	Py_DECREF(dict);
+	return NULL;
+}
+
+/*
+ * Value of a field as a native Python object, as _Definition.value in
+ * reader.py, built without going back and forth between Python and C.
+ */
+static
+PyObject *field_value(const struct bt_definition *field)
+{
+	const struct bt_declaration *decl;
+	enum ctf_type_id type_id;
+	PyObject *value = NULL;
+
+	if (!field) {
+		PyErr_SetString(PyExc_RuntimeError, "Invalid field");
+		goto end;
+	}
+	decl = bt_ctf_get_decl_from_def(field);
+	type_id = bt_ctf_field_type(decl);
+	switch (type_id) {
+	case CTF_TYPE_INTEGER:
+		if (bt_ctf_get_int_signedness(decl)) {
+			value = PyLong_FromLongLong(bt_ctf_get_int64(field));
+		} else {
+			value = PyLong_FromUnsignedLongLong(
+				bt_ctf_get_uint64(field));
+		}
+		break;
+	case CTF_TYPE_FLOAT:
+		value = PyFloat_FromDouble(bt_ctf_get_float(field));
+		break;
+	case CTF_TYPE_ENUM:
+		value = string_value(bt_ctf_get_enum_str(field));
+		break;
+	case CTF_TYPE_STRING:
+		value = string_value(bt_ctf_get_string(field));
+		break;
+	case CTF_TYPE_ARRAY:
+	{
+		struct definition_array *array =
+			container_of(field, struct definition_array, p);
+
+		if (is_string_element(array->declaration->elem)) {
+			value = string_value(array->string->str);
+		} else {
+			value = list_value(array_index, array,
+				bt_ctf_get_array_len(decl));
+		}
+		break;
+	}
+	case CTF_TYPE_SEQUENCE:
+	{
+		struct definition_sequence *sequence =
+			container_of(field, struct definition_sequence, p);
+
+		if (is_string_element(sequence->declaration->elem)) {
+			value = string_value(sequence->string->str);
+		} else {
+			value = list_value(sequence_index, sequence,
+				bt_sequence_len(sequence));
+		}
+		break;
+	}
+	case CTF_TYPE_VARIANT:
+		value = field_value(bt_ctf_get_variant(field));
+		break;
+	case CTF_TYPE_STRUCT:
+		value = struct_value(field);
+		break;
+	default:
+		Py_INCREF(Py_None);
+		value = Py_None;
+		break;
+	}
+	if (value && bt_ctf_field_get_error()) {
+		Py_DECREF(value);
+		value = NULL;
+		PyErr_Format(PyExc_RuntimeError,
+			"Error occurred while accessing field %s",
+			bt_ctf_field_name(field));
+	}
+end:
+	return value;
+}
+
+/* Look the fields of an event up, by scope priority. */
+static
+struct event_fields *event_fields_create(const struct bt_ctf_event *event)
+{
+	struct event_fields *event_fields;
+	GHashTable *seen;
+	PyObject *names;
+	int i;
+
+	event_fields = g_new0(struct event_fields, 1);
+	event_fields->fields = g_ptr_array_new();
+	names = PyList_New(0);
+	seen = g_hash_table_new(g_direct_hash, g_direct_equal);
+	if (!names) {
+		goto error;
+	}
+	for (i = 0; i < sizeof(field_scopes) / sizeof(field_scopes[0]); i++) {
+		const struct bt_definition *scope;
+		struct bt_definition const * const *list;
+		unsigned int j, count;
+
+		scope = bt_ctf_get_top_level_scope(event, field_scopes[i]);
+		if (!scope || bt_ctf_get_field_list(event, scope, &list,
+			&count) < 0) {
+			continue;
+		}
+		for (j = 0; j < count; j++) {
+			GQuark name = list[j]->name;
+			PyObject *py_name;
+			int ret;
+
+			if (g_hash_table_lookup_extended(seen,
+				GUINT_TO_POINTER(name), NULL, NULL)) {
+				continue;
+			}
+			g_hash_table_insert(seen, GUINT_TO_POINTER(name), NULL);
+			py_name = PyUnicode_InternFromString(
+				g_quark_to_string(name));
+			if (!py_name) {
+				goto error;
+			}
+			ret = PyList_Append(names, py_name);
+			Py_DECREF(py_name);
+			if (ret) {
+				goto error;
+			}
+			g_ptr_array_add(event_fields->fields,
+				(gpointer) list[j]);
+		}
+	}
+	event_fields->names = PyList_AsTuple(names);
+	if (!event_fields->names) {
+		goto error;
+	}
+	Py_DECREF(names);
+	g_hash_table_destroy(seen);
+	return event_fields;
+
+error:
+	Py_XDECREF(names);
+	g_hash_table_destroy(seen);
+	event_fields_destroy(event_fields);
+	return NULL;
+}
+
+/*
+ * Fields of an event, cached in the iterator per event class and
+ * stream. Without iterator, the caller owns the returned fields.
+ */
+static
+struct event_fields *get_event_fields(struct _bt_python_event_iter *iter,
+		const struct bt_ctf_event *event)
+{
+	struct event_fields *event_fields;
+
+	if (!iter) {
+		return event_fields_create(event);
+	}
+	event_fields = g_hash_table_lookup(iter->event_fields, event->parent);
+	if (!event_fields) {
+		event_fields = event_fields_create(event);
+		if (event_fields) {
+			g_hash_table_insert(iter->event_fields, event->parent,
+				event_fields);
+		}
+	}
+	return event_fields;
+}
+
+static
+void put_event_fields(struct _bt_python_event_iter *iter,
+		struct event_fields *event_fields)
+{
+	if (!iter && event_fields) {
+		event_fields_destroy(event_fields);
+	}
+}
+
+struct _bt_python_event_iter *_bt_python_event_iter_create(
+		struct bt_context *ctx, const struct bt_iter_pos *begin_pos,
+		const struct bt_iter_pos *end_pos)
+{
+	struct _bt_python_event_iter *iter;
+
+	iter = g_new0(struct _bt_python_event_iter, 1);
+	iter->iter = bt_ctf_iter_create(ctx, begin_pos, end_pos);
+	if (!iter->iter) {
+		g_free(iter);
+		return NULL;
+	}
+	iter->event_fields = g_hash_table_new_full(g_direct_hash,
+		g_direct_equal, NULL, event_fields_destroy);
+	return iter;
+}
+
+void _bt_python_event_iter_destroy(struct _bt_python_event_iter *iter)
+{
+	if (!iter) {
+		return;
+	}
+	g_hash_table_destroy(iter->event_fields);
+	bt_ctf_iter_destroy(iter->iter);
+	g_free(iter);
+}
+
+/*
+ * Move to the next event and read it, in a single call. Returns NULL at
+ * the end of the trace collection or on error.
+ */
+struct bt_ctf_event *_bt_python_event_iter_next(
+		struct _bt_python_event_iter *iter)
+{
+	if (!iter) {
+		return NULL;
+	}
+	if (iter->started &&
+		bt_iter_next(bt_ctf_get_iter(iter->iter)) != 0) {
+		return NULL;
+	}
+	iter->started = 1;
+	return bt_ctf_iter_read_event(iter->iter);
+}
+
+PyObject *_bt_python_event_field_names(struct _bt_python_event_iter *iter,
+		const struct bt_ctf_event *event)
+{
+	struct event_fields *event_fields;
+	PyObject *names;
+
+	event_fields = get_event_fields(iter, event);
+	if (!event_fields) {
+		return NULL;
+	}
+	names = event_fields->names;
+	Py_INCREF(names);
+	put_event_fields(iter, event_fields);
+	return names;
+}
+
+PyObject *_bt_python_event_field_value(const struct bt_ctf_event *event,
+		const char *name)
+{
+	int i;
+
+	for (i = 0; i < sizeof(field_scopes) / sizeof(field_scopes[0]); i++) {
+		const struct bt_definition *scope, *field;
+
+		scope = bt_ctf_get_top_level_scope(event, field_scopes[i]);
+		if (!scope) {
+			continue;
+		}
+		field = bt_ctf_get_field(event, scope, name);
+		if (field) {
+			return field_value(field);
+		}
+	}
+	PyErr_SetString(PyExc_KeyError, name);
+	return NULL;
+}
+
+PyObject *_bt_python_event_to_dict(struct _bt_python_event_iter *iter,
+		const struct bt_ctf_event *event)
+{
+	struct event_fields *event_fields;
+	PyObject *dict = NULL;
+	Py_ssize_t i;
+
+	event_fields = get_event_fields(iter, event);
+	if (!event_fields) {
+		goto end;
+	}
+	dict = PyDict_New();
+	if (!dict) {
+		goto end;
+	}
+	for (i = 0; i < PyTuple_GET_SIZE(event_fields->names); i++) {
+		PyObject *value;
+		int ret;
+
+		value = field_value(g_ptr_array_index(event_fields->fields, i));
+		if (!value) {
+			goto error;
+		}
+		ret = PyDict_SetItem(dict,
+			PyTuple_GET_ITEM(event_fields->names, i), value);
+		Py_DECREF(value);
+		if (ret) {
+			goto error;
+		}
+	}
+end:
+	put_event_fields(iter, event_fields);
+	return dict;
+error:
+	Py_CLEAR(dict);
+	goto end;
+}
+
+PyObject *_bt_python_event_to_tuple(struct _bt_python_event_iter *iter,
+		const struct bt_ctf_event *event)
+{
+	struct event_fields *event_fields;
+	PyObject *tuple = NULL;
+	Py_ssize_t i, len;
+
+	event_fields = get_event_fields(iter, event);
+	if (!event_fields) {
+		goto end;
+	}
+	len = PyTuple_GET_SIZE(event_fields->names);
+	tuple = PyTuple_New(len);
+	if (!tuple) {
+		goto end;
+	}
+	for (i = 0; i < len; i++) {
+		PyObject *value;
+
+		value = field_value(g_ptr_array_index(event_fields->fields, i));
+		if (!value) {
+			Py_CLEAR(tuple);
+			goto end;
+		}
+		PyTuple_SET_ITEM(tuple, i, value);
+	}
+end:
+	put_event_fields(iter, event_fields);
+	return tuple;
+}
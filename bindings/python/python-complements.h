@@ -25,12 +25,14 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
  */
 
+#include <Python.h>
 #include <stdio.h>
 #include <glib.h>
 #include <babeltrace/babeltrace.h>
 #include <babeltrace/format.h>
 #include <babeltrace/ctf-ir/metadata.h>
 #include <babeltrace/ctf/events.h>
+#include <babeltrace/ctf/iterator.h>
 #include <babeltrace/iterator-internal.h>
 #include <babeltrace/ctf/events-internal.h>
 #include <babeltrace/ctf-writer/event-fields.h>
@@ -97,3 +99,20 @@ int _bt_python_ctf_clock_get_uuid_index(struct bt_ctf_clock *clock,
 		size_t index, unsigned char *value);
 int _bt_python_ctf_clock_set_uuid_index(struct bt_ctf_clock *clock,
 		size_t index, unsigned char value);
+
+/* native event iterator and field values */
+struct _bt_python_event_iter;
+struct _bt_python_event_iter *_bt_python_event_iter_create(
+		struct bt_context *ctx, const struct bt_iter_pos *begin_pos,
+		const struct bt_iter_pos *end_pos);
+void _bt_python_event_iter_destroy(struct _bt_python_event_iter *iter);
+struct bt_ctf_event *_bt_python_event_iter_next(
+		struct _bt_python_event_iter *iter);
+PyObject *_bt_python_event_field_names(struct _bt_python_event_iter *iter,
+		const struct bt_ctf_event *event);
+PyObject *_bt_python_event_field_value(const struct bt_ctf_event *event,
+		const char *name);
+PyObject *_bt_python_event_to_dict(struct _bt_python_event_iter *iter,
+		const struct bt_ctf_event *event);
+PyObject *_bt_python_event_to_tuple(struct _bt_python_event_iter *iter,
+		const struct bt_ctf_event *event);
@@ -202,7 +202,7 @@ class TraceCollection:
         ctf_it_ptr = nbt._bt_ctf_iter_create(self._tc, pos_ptr, pos_ptr)
 
         if ctf_it_ptr is None:
-            raise NotImplementedError("Creation of multiple iterators is unsupported.")
+            raise NotImplementedError("Creation of multiple iterators is unsupported on memory-mapped traces.")
 
         ev_ptr = nbt._bt_ctf_iter_read_event(ctf_it_ptr)
         nbt._bt_ctf_iter_destroy(ctf_it_ptr)
@@ -213,31 +213,31 @@ class TraceCollection:
         return ev.timestamp
 
     def _events(self, begin_pos_ptr, end_pos_ptr):
-        ctf_it_ptr = nbt._bt_ctf_iter_create(self._tc, begin_pos_ptr, end_pos_ptr)
+        # The native iterator moves to and reads the next event in a
+        # single call, and caches the field definitions of each event
+        # class for the events it yields.
+        it_ptr = nbt._bt_python_event_iter_create(self._tc, begin_pos_ptr,
+                                                  end_pos_ptr)
 
-        if ctf_it_ptr is None:
-            raise NotImplementedError("Creation of multiple iterators is unsupported.")
+        if it_ptr is None:
+            raise NotImplementedError("Creation of multiple iterators is unsupported on memory-mapped traces.")
 
         while True:
-            ev_ptr = nbt._bt_ctf_iter_read_event(ctf_it_ptr)
+            ev_ptr = nbt._bt_python_event_iter_next(it_ptr)
 
             if ev_ptr is None:
                 break
 
             ev = Event.__new__(Event)
             ev._e = ev_ptr
+            ev._it = it_ptr
 
             try:
                 yield ev
             except GeneratorExit:
                 break
 
-            ret = nbt._bt_iter_next(nbt._bt_ctf_get_iter(ctf_it_ptr))
-
-            if ret != 0:
-                break
-
-        nbt._bt_ctf_iter_destroy(ctf_it_ptr)
+        nbt._bt_python_event_iter_destroy(it_ptr)
 
 
 # Based on enum bt_clock_type in clock-type.h
@@ -389,8 +389,14 @@ class Event(collections.Mapping):
     .. code-block:: python
 
        print(event['my_field']['my_struct']['seq'][2])
+
+    Field values are converted in native code. Use :meth:`as_dict` or
+    :meth:`as_tuple` to convert all the fields of an event at once.
     """
 
+    # Native iterator yielding this event, caching its field names
+    _it = None
+
     def __init__(self):
         raise NotImplementedError("Event cannot be instantiated")
 
@@ -495,31 +501,20 @@ class Event(collections.Mapping):
             return trace_collection
 
     def __getitem__(self, field_name):
-        field = self._field(field_name)
-
-        if field is not None:
-            return field.value
-
-        raise KeyError(field_name)
+        try:
+            return nbt._bt_python_event_field_value(self._e, field_name)
+        except RuntimeError as e:
+            raise FieldError(str(e))
 
     def __iter__(self):
         for key in self.keys():
             yield key
 
     def __len__(self):
-        count = 0
-
-        for scope in _scopes:
-            scope_ptr = nbt._bt_ctf_get_top_level_scope(self._e, scope)
-            ret = nbt._bt_python_field_listcaller(self._e, scope_ptr)
-
-            if isinstance(ret, list):
-                count += ret[1]
-
-        return count
+        return len(self._field_names())
 
     def __contains__(self, field_name):
-        return self._field(field_name) is not None
+        return field_name in self._field_names()
 
     def keys(self):
         """
@@ -531,13 +526,7 @@ class Event(collections.Mapping):
         of a given scope.
         """
 
-        field_names = set()
-
-        for scope in _scopes:
-            for name in self.field_list_with_scope(scope):
-                field_names.add(name)
-
-        return list(field_names)
+        return list(self._field_names())
 
     def get(self, field_name, default=None):
         """
@@ -549,13 +538,11 @@ class Event(collections.Mapping):
         scopes.
         """
 
-        field = self._field(field_name)
-
-        if field is None:
+        try:
+            return self[field_name]
+        except KeyError:
             return default
 
-        return field.value
-
     def items(self):
         """
         Generates pairs of (field name, field value).
@@ -568,6 +555,31 @@ class Event(collections.Mapping):
         for field in self.keys():
             yield (field, self[field])
 
+    def as_dict(self):
+        """
+        Returns a :class:`dict` mapping the field names of :meth:`keys`
+        to their values, converted in a single native call.
+        """
+
+        try:
+            return nbt._bt_python_event_to_dict(self._it, self._e)
+        except RuntimeError as e:
+            raise FieldError(str(e))
+
+    def as_tuple(self):
+        """
+        Returns a :class:`tuple` of the field values, in the order of
+        :meth:`keys`, converted in a single native call.
+        """
+
+        try:
+            return nbt._bt_python_event_to_tuple(self._it, self._e)
+        except RuntimeError as e:
+            raise FieldError(str(e))
+
+    def _field_names(self):
+        return nbt._bt_python_event_field_names(self._it, self._e)
+
     def _field_with_scope(self, field_name, scope):
         scope_ptr = nbt._bt_ctf_get_top_level_scope(self._e, scope)
 
@@ -33,10 +33,12 @@
 #include <babeltrace/context.h>
 #include <babeltrace/context-internal.h>
 #include <babeltrace/ctf/types.h>
+#include <babeltrace/ctf/metadata.h>
 #include <babeltrace/ctf/events.h>
 /* TODO: fix object model for format-agnostic callbacks */
 #include <babeltrace/ctf/events-internal.h>
 #include <babeltrace/ctf/iterator.h>
+#include <babeltrace/ctf/stats.h>
 #include <babeltrace/ctf-text/types.h>
 #include <babeltrace/iterator.h>
 #include <popt.h>
@@ -45,6 +47,8 @@
 #include <ctype.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <inttypes.h>
@@ -57,6 +61,8 @@
 
 #define DEFAULT_FILE_ARRAY_SIZE	1
 
+#define NSEC_PER_SEC 1000000000ULL
+
 #define NET_URL_PREFIX	"net://"
 #define NET4_URL_PREFIX	"net4://"
 #define NET6_URL_PREFIX	"net6://"
@@ -72,6 +78,11 @@ static char *opt_input_format, *opt_output_format;
  */
 static GPtrArray *opt_input_paths;
 static char *opt_output_path;
+static unsigned long opt_parallel;
+static uint64_t opt_begin, opt_end = -1ULL;
+static int opt_stats;
+static unsigned long opt_stats_events;
+static unsigned long opt_max_open_files, opt_max_mapped_mb;
 
 static struct bt_format *fmt_read;
 
@@ -103,6 +114,13 @@ enum {
 	OPT_CLOCK_DATE,
 	OPT_CLOCK_GMT,
 	OPT_CLOCK_FORCE_CORRELATE,
+	OPT_PARALLEL,
+	OPT_BEGIN,
+	OPT_END,
+	OPT_STATS,
+	OPT_STATS_EVENTS,
+	OPT_MAX_OPEN_FILES,
+	OPT_MAX_MAPPED_MB,
 };
 
 /*
@@ -132,6 +150,13 @@ static struct poptOption long_options[] = {
 	{ "clock-date", 0, POPT_ARG_NONE, NULL, OPT_CLOCK_DATE, NULL, NULL },
 	{ "clock-gmt", 0, POPT_ARG_NONE, NULL, OPT_CLOCK_GMT, NULL, NULL },
 	{ "clock-force-correlate", 0, POPT_ARG_NONE, NULL, OPT_CLOCK_FORCE_CORRELATE, NULL, NULL },
+	{ "parallel", 0, POPT_ARG_STRING, NULL, OPT_PARALLEL, NULL, NULL },
+	{ "begin", 0, POPT_ARG_STRING, NULL, OPT_BEGIN, NULL, NULL },
+	{ "end", 0, POPT_ARG_STRING, NULL, OPT_END, NULL, NULL },
+	{ "stats", 0, POPT_ARG_NONE, NULL, OPT_STATS, NULL, NULL },
+	{ "stats-events", 0, POPT_ARG_STRING, NULL, OPT_STATS_EVENTS, NULL, NULL },
+	{ "max-open-files", 0, POPT_ARG_STRING, NULL, OPT_MAX_OPEN_FILES, NULL, NULL },
+	{ "max-mapped-mb", 0, POPT_ARG_STRING, NULL, OPT_MAX_MAPPED_MB, NULL, NULL },
 	{ NULL, 0, 0, NULL, 0, NULL, NULL },
 };
 
@@ -177,6 +202,18 @@ static void usage(FILE *fp)
 	fprintf(fp, "      --clock-gmt                Print clock in GMT time zone (default: local time zone)\n");
 	fprintf(fp, "      --clock-force-correlate    Assume that clocks are inherently correlated\n");
 	fprintf(fp, "                                 across traces.\n");
+	fprintf(fp, "      --parallel N               Convert N time slices of the traces concurrently\n");
+	fprintf(fp, "                                 (ctf input to text output only, at most\n");
+	fprintf(fp, "                                 one slice per CPU)\n");
+	fprintf(fp, "      --begin ns                 Only convert events at or after this timestamp\n");
+	fprintf(fp, "      --end ns                   Only convert events at or before this timestamp\n");
+	fprintf(fp, "                                 (timestamps in nanoseconds since Epoch)\n");
+	fprintf(fp, "      --stats                    Print trace statistics from the packet index\n");
+	fprintf(fp, "                                 instead of converting (ctf input only)\n");
+	fprintf(fp, "      --stats-events N           With --stats, also count events per event class,\n");
+	fprintf(fp, "                                 decoding one packet out of N (1: all packets)\n");
+	fprintf(fp, "      --max-open-files N         Keep at most N stream files open (ctf input only)\n");
+	fprintf(fp, "      --max-mapped-mb N          Keep at most N MiB of packets mapped (ctf input only)\n");
 	list_formats(fp);
 	fprintf(fp, "\n");
 }
@@ -396,6 +433,143 @@ static int parse_options(int argc, char **argv)
 		case OPT_CLOCK_FORCE_CORRELATE:
 			opt_clock_force_correlate = 1;
 			break;
+		case OPT_BEGIN:
+		{
+			char *str;
+			char *endptr;
+
+			str = (char *) poptGetOptArg(pc);
+			if (!str) {
+				fprintf(stderr, "[error] Missing --begin argument\n");
+				ret = -EINVAL;
+				goto end;
+			}
+			errno = 0;
+			opt_begin = strtoull(str, &endptr, 0);
+			if (*endptr != '\0' || str == endptr || errno != 0) {
+				fprintf(stderr, "[error] Incorrect --begin argument: %s\n", str);
+				ret = -EINVAL;
+				free(str);
+				goto end;
+			}
+			free(str);
+			break;
+		}
+		case OPT_END:
+		{
+			char *str;
+			char *endptr;
+
+			str = (char *) poptGetOptArg(pc);
+			if (!str) {
+				fprintf(stderr, "[error] Missing --end argument\n");
+				ret = -EINVAL;
+				goto end;
+			}
+			errno = 0;
+			opt_end = strtoull(str, &endptr, 0);
+			if (*endptr != '\0' || str == endptr || errno != 0) {
+				fprintf(stderr, "[error] Incorrect --end argument: %s\n", str);
+				ret = -EINVAL;
+				free(str);
+				goto end;
+			}
+			free(str);
+			break;
+		}
+		case OPT_PARALLEL:
+		{
+			char *str;
+			char *endptr;
+			long nr_cpus;
+
+			str = (char *) poptGetOptArg(pc);
+			if (!str) {
+				fprintf(stderr, "[error] Missing --parallel argument\n");
+				ret = -EINVAL;
+				goto end;
+			}
+			errno = 0;
+			/* strtoul() would accept "-1" as ULONG_MAX */
+			opt_parallel = isdigit((unsigned char) str[0]) ?
+				strtoul(str, &endptr, 0) : 0;
+			if (opt_parallel == 0 || *endptr != '\0'
+					|| errno != 0) {
+				fprintf(stderr, "[error] Incorrect --parallel argument: %s\n", str);
+				ret = -EINVAL;
+				free(str);
+				goto end;
+			}
+			free(str);
+			/* One slice per CPU at most */
+			nr_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+			if (nr_cpus < 1)
+				nr_cpus = 1;
+			if (opt_parallel > (unsigned long) nr_cpus) {
+				printf_verbose("Limiting --parallel to %ld, the number of CPUs.\n",
+					nr_cpus);
+				opt_parallel = nr_cpus;
+			}
+			break;
+		}
+		case OPT_STATS:
+			opt_stats = 1;
+			break;
+		case OPT_STATS_EVENTS:
+		{
+			char *str;
+			char *endptr;
+
+			str = (char *) poptGetOptArg(pc);
+			if (!str) {
+				fprintf(stderr, "[error] Missing --stats-events argument\n");
+				ret = -EINVAL;
+				goto end;
+			}
+			errno = 0;
+			opt_stats_events = strtoul(str, &endptr, 0);
+			if (*endptr != '\0' || str == endptr || errno != 0
+					|| opt_stats_events == 0) {
+				fprintf(stderr, "[error] Incorrect --stats-events argument: %s\n", str);
+				ret = -EINVAL;
+				free(str);
+				goto end;
+			}
+			opt_stats = 1;
+			free(str);
+			break;
+		}
+		case OPT_MAX_OPEN_FILES:
+		case OPT_MAX_MAPPED_MB:
+		{
+			const char *name = opt == OPT_MAX_OPEN_FILES ?
+				"--max-open-files" : "--max-mapped-mb";
+			unsigned long value;
+			char *str;
+			char *endptr;
+
+			str = (char *) poptGetOptArg(pc);
+			if (!str) {
+				fprintf(stderr, "[error] Missing %s argument\n", name);
+				ret = -EINVAL;
+				goto end;
+			}
+			errno = 0;
+			value = strtoul(str, &endptr, 0);
+			if (*endptr != '\0' || str == endptr || errno != 0
+					|| value == 0) {
+				fprintf(stderr, "[error] Incorrect %s argument: %s\n", name, str);
+				ret = -EINVAL;
+				free(str);
+				goto end;
+			}
+			if (opt == OPT_MAX_OPEN_FILES)
+				opt_max_open_files = value;
+			else
+				opt_max_mapped_mb = value;
+			free(str);
+			break;
+		}
 
 		default:
 			ret = -EINVAL;
@@ -617,30 +791,54 @@ end:
 	return ret;
 }
 
+/*
+ * State of a time slice converted by --parallel. The array of slices is
+ * shared between the parent and the child processes: each child fills
+ * in the results of its own slice.
+ */
+struct parallel_slice {
+	uint64_t begin;			/* first real timestamp of the slice */
+	FILE *fp;			/* temporary output file */
+	pid_t pid;
+	int ret;
+	/*
+	 * Offset, within fp, of the unknown delta printed for the first
+	 * timestamped event, or -1 if there is none. It cannot be computed
+	 * by the child, because the previous event belongs to another slice.
+	 */
+	long delta_offset;
+	uint64_t first_real_timestamp;	/* -1ULL if no timestamped event */
+	uint64_t last_real_timestamp;	/* -1ULL if no timestamped event */
+};
+
+struct packet_extent {
+	uint64_t begin;			/* real timestamp begin */
+	uint64_t size;			/* content size, in bits */
+};
+
 static
-int convert_trace(struct bt_trace_descriptor *td_write,
-		  struct bt_context *ctx)
+int convert_trace_range(struct ctf_text_stream_pos *sout,
+		struct bt_context *ctx,
+		const struct bt_iter_pos *begin_pos,
+		const struct bt_iter_pos *end_pos,
+		struct parallel_slice *slice)
 {
 	struct bt_ctf_iter *iter;
-	struct ctf_text_stream_pos *sout;
-	struct bt_iter_pos begin_pos;
 	struct bt_ctf_event *ctf_event;
 	int ret;
 
-	sout = container_of(td_write, struct ctf_text_stream_pos,
-			trace_descriptor);
-
-	if (!sout->parent.event_cb)
-		return 0;
-
-	begin_pos.type = BT_SEEK_BEGIN;
-	iter = bt_ctf_iter_create(ctx, &begin_pos, NULL);
+	iter = bt_ctf_iter_create(ctx, begin_pos, end_pos);
 	if (!iter) {
 		ret = -1;
 		goto error_iter;
 	}
 	while ((ctf_event = bt_ctf_iter_read_event(iter))) {
-		ret = sout->parent.event_cb(&sout->parent, ctf_event->parent->stream);
+		struct ctf_stream_definition *stream = ctf_event->parent->stream;
+
+		if (slice && slice->first_real_timestamp == -1ULL
+				&& stream->has_timestamp)
+			slice->first_real_timestamp = stream->real_timestamp;
+		ret = sout->parent.event_cb(&sout->parent, stream);
 		if (ret) {
 			fprintf(stderr, "[error] Writing event failed.\n");
 			goto end;
@@ -650,6 +848,10 @@ int convert_trace(struct bt_trace_descriptor *td_write,
 			goto end;
 	}
 	ret = 0;
+	if (slice) {
+		slice->delta_offset = sout->unknown_delta_offset;
+		slice->last_real_timestamp = sout->last_real_timestamp;
+	}
 
 end:
 	bt_ctf_iter_destroy(iter);
@@ -657,6 +859,446 @@ error_iter:
 	return ret;
 }
 
+static
+int convert_trace(struct bt_trace_descriptor *td_write,
+		  struct bt_context *ctx)
+{
+	struct ctf_text_stream_pos *sout;
+	struct bt_iter_pos begin_pos, end_pos;
+
+	sout = container_of(td_write, struct ctf_text_stream_pos,
+			trace_descriptor);
+
+	if (!sout->parent.event_cb)
+		return 0;
+
+	if (opt_begin) {
+		begin_pos.type = BT_SEEK_TIME;
+		begin_pos.u.seek_time = opt_begin;
+	} else {
+		begin_pos.type = BT_SEEK_BEGIN;
+	}
+	end_pos.type = BT_SEEK_TIME;
+	end_pos.u.seek_time = opt_end;
+	return convert_trace_range(sout, ctx, &begin_pos,
+			opt_end != -1ULL ? &end_pos : NULL, NULL);
+}
+
+static
+gint compare_packet_extent(gconstpointer a, gconstpointer b)
+{
+	const struct packet_extent *e_a = a, *e_b = b;
+
+	if (e_a->begin < e_b->begin)
+		return -1;
+	else if (e_a->begin > e_b->begin)
+		return 1;
+	return 0;
+}
+
+/*
+ * Gather the begin timestamp and size of every packet of the trace
+ * collection, sorted by begin timestamp.
+ */
+static
+GArray *get_packet_extents(struct bt_context *ctx)
+{
+	GArray *extents;
+	int i, j, k, l;
+
+	extents = g_array_new(FALSE, FALSE, sizeof(struct packet_extent));
+	for (i = 0; i < ctx->tc->array->len; i++) {
+		struct bt_trace_descriptor *td_read;
+		struct ctf_trace *tin;
+
+		td_read = g_ptr_array_index(ctx->tc->array, i);
+		if (!td_read)
+			continue;
+		tin = container_of(td_read, struct ctf_trace, parent);
+		for (j = 0; j < tin->streams->len; j++) {
+			struct ctf_stream_declaration *stream_class;
+
+			stream_class = g_ptr_array_index(tin->streams, j);
+			if (!stream_class)
+				continue;
+			for (k = 0; k < stream_class->streams->len; k++) {
+				struct ctf_stream_definition *stream;
+				struct ctf_file_stream *cfs;
+
+				stream = g_ptr_array_index(stream_class->streams, k);
+				if (!stream)
+					continue;
+				cfs = container_of(stream, struct ctf_file_stream,
+						parent);
+				if (!cfs->pos.packet_index)
+					continue;
+				for (l = 0; l < cfs->pos.packet_index->len; l++) {
+					struct packet_index *index;
+					struct packet_extent extent;
+
+					index = &g_array_index(cfs->pos.packet_index,
+							struct packet_index, l);
+					extent.begin = index->ts_real.timestamp_begin;
+					extent.size = index->content_size;
+					g_array_append_val(extents, extent);
+				}
+			}
+		}
+	}
+	g_array_sort(extents, compare_packet_extent);
+	return extents;
+}
+
+/*
+ * Split the trace collection in at most nr_slices time slices holding
+ * about the same amount of data, according to the packet index. Slice
+ * boundaries are packet begin timestamps. Returns the number of slices.
+ */
+static
+int compute_slices(struct bt_context *ctx, struct parallel_slice *slices,
+		int nr_slices)
+{
+	GArray *extents;
+	uint64_t total = 0, cumul = 0;
+	int i, nr = 1;
+
+	extents = get_packet_extents(ctx);
+	for (i = 0; i < extents->len; i++)
+		total += g_array_index(extents, struct packet_extent, i).size;
+
+	slices[0].begin = opt_begin;
+	for (i = 0; i < extents->len && nr < nr_slices; i++) {
+		struct packet_extent *extent =
+			&g_array_index(extents, struct packet_extent, i);
+
+		if (extent->begin > opt_end)
+			break;
+		if (cumul >= total / nr_slices * nr
+				&& extent->begin > slices[nr - 1].begin) {
+			slices[nr++].begin = extent->begin;
+		}
+		cumul += extent->size;
+	}
+	g_array_free(extents, TRUE);
+	return nr;
+}
+
+/*
+ * Child process side of --parallel: convert slice "index" into its
+ * temporary file.
+ */
+static
+void convert_slice(struct ctf_text_stream_pos *sout, struct bt_context *ctx,
+		struct parallel_slice *slices, int nr_slices, int index)
+{
+	struct parallel_slice *slice = &slices[index];
+	struct bt_iter_pos begin_pos, end_pos;
+
+	if (slice->begin) {
+		begin_pos.type = BT_SEEK_TIME;
+		begin_pos.u.seek_time = slice->begin;
+	} else {
+		begin_pos.type = BT_SEEK_BEGIN;
+	}
+	end_pos.type = BT_SEEK_TIME;
+	if (index < nr_slices - 1)
+		end_pos.u.seek_time = MIN(slices[index + 1].begin - 1, opt_end);
+	else
+		end_pos.u.seek_time = opt_end;
+
+	sout->fp = slice->fp;
+	sout->unknown_delta_offset = -1;
+	slice->ret = convert_trace_range(sout, ctx, &begin_pos,
+			end_pos.u.seek_time != -1ULL ? &end_pos : NULL, slice);
+	if (fflush(slice->fp))
+		slice->ret = -errno;
+}
+
+/*
+ * Copy the output of a slice to fp. If prev_timestamp is known, the
+ * delta of the first timestamped event of the slice is filled in.
+ */
+static
+int copy_slice(FILE *fp, struct parallel_slice *slice,
+		uint64_t prev_timestamp)
+{
+	char buf[4096];
+	size_t len;
+	long copied = 0;
+
+	if (fseek(slice->fp, 0, SEEK_SET))
+		return -errno;
+	if (opt_delta_field && slice->delta_offset >= 0
+			&& prev_timestamp != -1ULL) {
+		/* Same format as the delta field of ctf-text. */
+		static const char unknown[] = "+?.?????????";
+		char delta[sizeof(unknown) - 1];
+
+		while (copied < slice->delta_offset) {
+			len = fread(buf, 1, MIN(sizeof(buf),
+					slice->delta_offset - copied), slice->fp);
+			if (!len)
+				return -EIO;
+			if (fwrite(buf, 1, len, fp) != len)
+				return -EIO;
+			copied += len;
+		}
+		len = fread(delta, 1, sizeof(delta), slice->fp);
+		if (len == sizeof(delta) && !memcmp(delta, unknown, len)) {
+			uint64_t delta_ns, delta_sec, delta_nsec;
+
+			delta_ns = slice->first_real_timestamp - prev_timestamp;
+			delta_sec = delta_ns / NSEC_PER_SEC;
+			delta_nsec = delta_ns % NSEC_PER_SEC;
+			fprintf(fp, "+%" PRIu64 ".%09" PRIu64,
+				delta_sec, delta_nsec);
+		} else if (fwrite(delta, 1, len, fp) != len) {
+			return -EIO;
+		}
+	}
+	while ((len = fread(buf, 1, sizeof(buf), slice->fp)) > 0) {
+		if (fwrite(buf, 1, len, fp) != len)
+			return -EIO;
+	}
+	if (ferror(slice->fp) || ferror(fp))
+		return -EIO;
+	return 0;
+}
+
+/*
+ * Convert the trace collection with nr_slices child processes, each
+ * converting its own time slice into a temporary file. The files are
+ * then concatenated in order, which gives the same output as
+ * convert_trace().
+ */
+static
+int convert_trace_parallel(struct bt_trace_descriptor *td_write,
+		struct bt_context *ctx, int nr_slices)
+{
+	struct ctf_text_stream_pos *sout;
+	struct parallel_slice *slices;
+	uint64_t prev_timestamp = -1ULL;
+	size_t slices_len;
+	int ret = 0, i, nr_started = 0;
+
+	sout = container_of(td_write, struct ctf_text_stream_pos,
+			trace_descriptor);
+
+	if (!sout->parent.event_cb)
+		return 0;
+
+	slices_len = nr_slices * sizeof(struct parallel_slice);
+	slices = mmap(NULL, slices_len, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (slices == MAP_FAILED) {
+		perror("mmap");
+		return -1;
+	}
+	memset(slices, 0, slices_len);
+	nr_slices = compute_slices(ctx, slices, nr_slices);
+	printf_verbose("Converting in %d time slices.\n", nr_slices);
+
+	for (i = 0; i < nr_slices; i++) {
+		slices[i].delta_offset = -1;
+		slices[i].first_real_timestamp = -1ULL;
+		slices[i].last_real_timestamp = -1ULL;
+		slices[i].fp = tmpfile();
+		if (!slices[i].fp) {
+			perror("tmpfile");
+			ret = -1;
+			goto end;
+		}
+	}
+
+	/* Don't let the children inherit unflushed output. */
+	fflush(stdout);
+	fflush(stderr);
+	fflush(sout->fp);
+
+	for (i = 0; i < nr_slices; i++) {
+		pid_t pid;
+
+		pid = fork();
+		if (pid < 0) {
+			perror("fork");
+			ret = -1;
+			break;
+		} else if (pid == 0) {
+			convert_slice(sout, ctx, slices, nr_slices, i);
+			_exit(slices[i].ret ? EXIT_FAILURE : EXIT_SUCCESS);
+		}
+		slices[i].pid = pid;
+		nr_started++;
+	}
+
+	for (i = 0; i < nr_started; i++) {
+		int status;
+
+		if (waitpid(slices[i].pid, &status, 0) < 0) {
+			perror("waitpid");
+			ret = -1;
+			continue;
+		}
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			fprintf(stderr, "[error] Converting time slice %d failed.\n", i);
+			ret = -1;
+		}
+	}
+	if (ret)
+		goto end;
+
+	for (i = 0; i < nr_slices; i++) {
+		ret = copy_slice(sout->fp, &slices[i], prev_timestamp);
+		if (ret) {
+			fprintf(stderr, "[error] Writing time slice %d failed.\n", i);
+			goto end;
+		}
+		if (slices[i].last_real_timestamp != -1ULL)
+			prev_timestamp = slices[i].last_real_timestamp;
+	}
+	/* Keep the text output state as if converted serially. */
+	sout->last_real_timestamp = prev_timestamp;
+
+end:
+	for (i = 0; i < nr_slices; i++) {
+		if (slices[i].fp)
+			fclose(slices[i].fp);
+	}
+	munmap(slices, slices_len);
+	return ret;
+}
+
+/*
+ * Copy the traces of the collection into the CTF output trace, each in
+ * its own subdirectory when there are several of them.
+ */
+static
+int copy_traces(struct bt_trace_descriptor *td_write, struct bt_context *ctx)
+{
+	struct trace_collection *tc = ctx->tc;
+	GHashTable *names;
+	int ret = 0, i;
+
+	names = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	for (i = 0; i < tc->array->len; i++) {
+		struct bt_trace_descriptor *td_read;
+		char *name = NULL;
+
+		td_read = g_ptr_array_index(tc->array, i);
+		if (!td_read)
+			continue;
+		if (tc->array->len > 1) {
+			char *base = g_path_get_basename(td_read->path);
+
+			if (g_hash_table_lookup(names, base)) {
+				name = g_strdup_printf("%s-%d", base, i);
+				g_free(base);
+			} else {
+				name = base;
+			}
+			/* The table owns the name. */
+			g_hash_table_insert(names, name, name);
+		}
+		printf_verbose("Copying trace %s\n", td_read->path);
+		ret = ctf_copy_trace(td_write, td_read, name, opt_begin, opt_end);
+		if (ret) {
+			fprintf(stderr, "[error] Copying trace \"%s\" failed.\n",
+				td_read->path);
+			break;
+		}
+	}
+	g_hash_table_destroy(names);
+	return ret;
+}
+
+static
+void print_stats_timestamp(FILE *fp, uint64_t ts)
+{
+	uint64_t sec = ts / NSEC_PER_SEC, nsec = ts % NSEC_PER_SEC;
+
+	fprintf(fp, "%" PRIu64 ".%09" PRIu64, sec, nsec);
+}
+
+/*
+ * Print the statistics of the traces of the context, mostly computed
+ * from the packet indexes, without converting the traces.
+ */
+static
+int print_stats(FILE *fp, struct bt_context *ctx)
+{
+	struct bt_ctf_stats *stats;
+	GArray *cpus;
+	unsigned int i;
+
+	stats = bt_ctf_stats_create(ctx,
+			opt_stats_events ? BT_CTF_STATS_EVENT_COUNTS : 0,
+			opt_stats_events);
+	if (!stats)
+		return -EINVAL;
+
+	fprintf(fp, "Time span: [");
+	print_stats_timestamp(fp, stats->timestamp_begin);
+	fprintf(fp, ", ");
+	print_stats_timestamp(fp, stats->timestamp_end);
+	fprintf(fp, "]\n");
+	fprintf(fp, "Streams: %u, packets: %" PRIu64
+		", content bytes: %" PRIu64 ", packet bytes: %" PRIu64
+		", events discarded: %" PRIu64 "\n",
+		stats->nr_streams, stats->nr_packets, stats->content_bytes,
+		stats->packet_bytes, stats->events_discarded);
+
+	fprintf(fp, "\nStreams:\n");
+	cpus = g_array_new(FALSE, TRUE, sizeof(uint64_t));
+	for (i = 0; i < stats->nr_streams; i++) {
+		struct bt_ctf_stream_stats *sstats = &stats->streams[i];
+
+		fprintf(fp, "  %s: stream id %" PRIu64, sstats->path,
+			sstats->stream_id);
+		if (sstats->cpu_id >= 0)
+			fprintf(fp, ", cpu %" PRId64, sstats->cpu_id);
+		fprintf(fp, ", packets: %" PRIu64 ", content bytes: %" PRIu64
+			", events discarded: %" PRIu64 ", [",
+			sstats->nr_packets, sstats->content_bytes,
+			sstats->events_discarded);
+		print_stats_timestamp(fp, sstats->timestamp_begin);
+		fprintf(fp, ", ");
+		print_stats_timestamp(fp, sstats->timestamp_end);
+		fprintf(fp, "]\n");
+
+		if (sstats->cpu_id < 0)
+			continue;
+		if (sstats->cpu_id >= cpus->len)
+			g_array_set_size(cpus, sstats->cpu_id + 1);
+		g_array_index(cpus, uint64_t, sstats->cpu_id) +=
+			sstats->content_bytes;
+	}
+
+	if (cpus->len) {
+		fprintf(fp, "\nContent bytes per CPU:\n");
+		for (i = 0; i < cpus->len; i++) {
+			fprintf(fp, "  cpu %u: %" PRIu64 "\n", i,
+				g_array_index(cpus, uint64_t, i));
+		}
+	}
+	g_array_free(cpus, TRUE);
+
+	if (opt_stats_events) {
+		fprintf(fp, "\nEvents per event class%s:\n",
+			opt_stats_events > 1 ? " (estimated)" : "");
+		for (i = 0; i < stats->nr_event_classes; i++) {
+			struct bt_ctf_event_class_stats *estats =
+				&stats->event_classes[i];
+
+			if (!estats->count)
+				continue;
+			fprintf(fp, "  %s: %" PRIu64 "\n", estats->name,
+				estats->count);
+		}
+	}
+	bt_ctf_stats_destroy(stats);
+	return 0;
+}
+
 int main(int argc, char **argv)
 {
 	int ret, partial_error = 0, open_success = 0;
@@ -726,6 +1368,9 @@ int main(int argc, char **argv)
 		goto end;
 	}
 
+	bt_ctf_set_stream_limits(opt_max_open_files,
+		(uint64_t) opt_max_mapped_mb << 20);
+
 	ctx = bt_context_create();
 	if (!ctx) {
 		goto error_td_read;
@@ -752,6 +1397,20 @@ int main(int argc, char **argv)
 		goto error_td_read;
 	}
 
+	if (opt_stats) {
+		if (fmt_read->name != g_quark_from_static_string("ctf")) {
+			fprintf(stderr, "[error] Statistics are only supported for CTF input.\n\n");
+			goto error_td_write;
+		}
+		ret = print_stats(stdout, ctx);
+		bt_context_put(ctx);
+		if (ret) {
+			fprintf(stderr, "Error computing trace statistics.\n\n");
+			goto error_td_read;
+		}
+		goto end;
+	}
+
 	td_write = fmt_write->open_trace(opt_output_path, O_RDWR, NULL, NULL);
 	if (!td_write) {
 		fprintf(stderr, "Error opening trace \"%s\" for writing.\n\n",
@@ -766,6 +1425,19 @@ int main(int argc, char **argv)
 	if (partial_error)
 		sleep(PARTIAL_ERROR_SLEEP);
 
+	if (fmt_write->name == g_quark_from_static_string("ctf")) {
+		if (fmt_read->name != g_quark_from_static_string("ctf")) {
+			fprintf(stderr, "[error] CTF output is only supported from CTF input.\n\n");
+			goto error_copy_trace;
+		}
+		ret = copy_traces(td_write, ctx);
+		if (ret) {
+			fprintf(stderr, "Error copying trace.\n\n");
+			goto error_copy_trace;
+		}
+		goto close_td_write;
+	}
+
 	ret = trace_pre_handler(td_write, ctx);
 	if (ret) {
 		fprintf(stderr, "Error in trace pre handle.\n\n");
@@ -774,7 +1446,14 @@ int main(int argc, char **argv)
 
 	/* For now, we support only CTF iterators */
 	if (fmt_read->name == g_quark_from_static_string("ctf")) {
-		ret = convert_trace(td_write, ctx);
+		if (opt_parallel > 1
+				&& fmt_write->name == g_quark_from_static_string("text")) {
+			ret = convert_trace_parallel(td_write, ctx, opt_parallel);
+		} else {
+			if (opt_parallel > 1)
+				fprintf(stderr, "[warning] --parallel is only supported with the text output format, converting serially.\n");
+			ret = convert_trace(td_write, ctx);
+		}
 		if (ret) {
 			fprintf(stderr, "Error printing trace.\n\n");
 			goto error_copy_trace;
@@ -787,6 +1466,7 @@ int main(int argc, char **argv)
 		goto error_copy_trace;
 	}
 
+close_td_write:
 	fmt_write->close_trace(td_write);
 
 	bt_context_put(ctx);
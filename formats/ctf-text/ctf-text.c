@@ -296,6 +296,7 @@ int ctf_text_write_event(struct bt_stream_pos *ppos, struct ctf_stream_definitio
 			fprintf(pos->fp, "+%" PRIu64 ".%09" PRIu64,
 				delta_sec, delta_nsec);
 		} else {
+			pos->unknown_delta_offset = ftell(pos->fp);
 			fprintf(pos->fp, "+?.?????????");
 		}
 		if (!pos->print_names)
@@ -543,6 +544,7 @@ struct bt_trace_descriptor *ctf_text_open_trace(const char *path, int flags,
 
 	pos->last_real_timestamp = -1ULL;
 	pos->last_cycles_timestamp = -1ULL;
+	pos->unknown_delta_offset = -1;
 	switch (flags & O_ACCMODE) {
 	case O_RDWR:
 		if (!path)
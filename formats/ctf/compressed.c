@@ -0,0 +1,527 @@
+/*
+ * compressed.c
+ *
+ * Babeltrace CTF Library
+ *
+ * Compressed stream files, whose packets are compressed independently so
+ * that they can be decompressed on demand when seeking.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <babeltrace/ctf/ctf-compressed.h>
+#include <babeltrace/endian.h>
+#include <glib.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef BABELTRACE_HAVE_LIBZSTD
+#include <zstd.h>
+#endif
+
+#define COMPRESSION_LEVEL	3
+
+struct compressed_packet {
+	off_t logical_offset;	/* offset in the uncompressed stream, in bytes */
+	off_t offset;		/* offset of the compressed data, in bytes */
+	size_t size;		/* compressed size, in bytes */
+	size_t packet_size;	/* uncompressed packet size, in bytes */
+	size_t content_size;	/* bytes compressed, the rest is zeroed */
+};
+
+struct ctf_compressed_stream {
+	int fd;
+	int write;		/* created by ctf_compressed_create() */
+	GArray *packets;	/* struct compressed_packet, in stream order */
+	off_t size;		/* uncompressed size, in bytes */
+	off_t end;		/* end of the compressed data, in bytes */
+
+	/* Decompressed range, returned by ctf_compressed_map() */
+	char *buf;
+	size_t buf_len;
+	off_t buf_offset;
+	size_t buf_valid;	/* bytes of the range decompressed */
+	/* Packet straddling the bounds of the range */
+	char *packet_buf;
+	size_t packet_buf_len;
+	/* Compressed data */
+	char *cbuf;
+	size_t cbuf_len;
+};
+
+static
+int reserve(char **buf, size_t *len, size_t needed)
+{
+	char *new_buf;
+
+	if (needed <= *len) {
+		return 0;
+	}
+	new_buf = g_try_realloc(*buf, needed);
+	if (!new_buf) {
+		return -ENOMEM;
+	}
+	*buf = new_buf;
+	*len = needed;
+	return 0;
+}
+
+static
+int pread_full(int fd, char *buf, size_t len, off_t offset)
+{
+	while (len) {
+		ssize_t ret = pread(fd, buf, len, offset);
+
+		if (ret < 0 && errno == EINTR) {
+			continue;
+		}
+		if (ret <= 0) {
+			return -1;
+		}
+		buf += ret;
+		len -= ret;
+		offset += ret;
+	}
+	return 0;
+}
+
+static
+int pwrite_full(int fd, const char *buf, size_t len, off_t offset)
+{
+	while (len) {
+		ssize_t ret = pwrite(fd, buf, len, offset);
+
+		if (ret < 0 && errno == EINTR) {
+			continue;
+		}
+		if (ret <= 0) {
+			return -1;
+		}
+		buf += ret;
+		len -= ret;
+		offset += ret;
+	}
+	return 0;
+}
+
+static
+int decompress(char *dst, size_t dst_len, const char *src, size_t src_len)
+{
+#ifdef BABELTRACE_HAVE_LIBZSTD
+	size_t ret;
+
+	ret = ZSTD_decompress(dst, dst_len, src, src_len);
+	if (ZSTD_isError(ret)) {
+		fprintf(stderr, "[error] Unable to decompress packet: %s.\n",
+			ZSTD_getErrorName(ret));
+		return -1;
+	}
+	if (ret != dst_len) {
+		fprintf(stderr, "[error] Unexpected decompressed packet size.\n");
+		return -1;
+	}
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+static
+struct ctf_compressed_stream *stream_create(int fd)
+{
+	struct ctf_compressed_stream *stream;
+
+	stream = g_new0(struct ctf_compressed_stream, 1);
+	stream->fd = fd;
+	stream->packets = g_array_new(FALSE, TRUE,
+		sizeof(struct compressed_packet));
+	stream->end = sizeof(struct ctf_compressed_file_hdr);
+	return stream;
+}
+
+static
+void stream_destroy(struct ctf_compressed_stream *stream)
+{
+	g_array_free(stream->packets, TRUE);
+	g_free(stream->buf);
+	g_free(stream->packet_buf);
+	g_free(stream->cbuf);
+	g_free(stream);
+}
+
+static
+int read_table(struct ctf_compressed_stream *stream,
+		struct ctf_compressed_file_hdr *header)
+{
+	uint64_t nr_packets, i;
+	off_t table_offset;
+	struct ctf_compressed_packet *table;
+	size_t table_len;
+	int ret = 0;
+
+	nr_packets = be64toh(header->nr_packets);
+	table_offset = be64toh(header->table_offset);
+	if (!table_offset || nr_packets > SIZE_MAX / sizeof(*table)) {
+		fprintf(stderr, "[error] Invalid compressed stream table.\n");
+		return -EINVAL;
+	}
+	table_len = nr_packets * sizeof(*table);
+	table = g_try_malloc(table_len);
+	if (!table && table_len) {
+		return -ENOMEM;
+	}
+	if (pread_full(stream->fd, (char *) table, table_len, table_offset)) {
+		fprintf(stderr, "[error] Unable to read compressed stream table.\n");
+		ret = -EINVAL;
+		goto end;
+	}
+	for (i = 0; i < nr_packets; i++) {
+		struct compressed_packet packet;
+
+		packet.logical_offset = stream->size;
+		packet.offset = be64toh(table[i].offset);
+		packet.size = be64toh(table[i].size);
+		packet.packet_size = be64toh(table[i].packet_size);
+		packet.content_size = be64toh(table[i].content_size);
+		if (!packet.packet_size ||
+				packet.content_size > packet.packet_size) {
+			fprintf(stderr, "[error] Invalid compressed packet.\n");
+			ret = -EINVAL;
+			goto end;
+		}
+		g_array_append_val(stream->packets, packet);
+		stream->size += packet.packet_size;
+	}
+end:
+	g_free(table);
+	return ret;
+}
+
+int ctf_compressed_open(int fd, struct ctf_compressed_stream **stream)
+{
+	struct ctf_compressed_file_hdr header;
+	int ret;
+
+	*stream = NULL;
+	if (pread_full(fd, (char *) &header, sizeof(header), 0) ||
+			be32toh(header.magic) != CTF_COMPRESSED_MAGIC) {
+		/* Plain stream file */
+		return 0;
+	}
+	if (be32toh(header.major) != CTF_COMPRESSED_MAJOR) {
+		fprintf(stderr, "[error] Unsupported compressed stream version %" PRIu32 ".%" PRIu32 ".\n",
+			be32toh(header.major), be32toh(header.minor));
+		return -EINVAL;
+	}
+#ifdef BABELTRACE_HAVE_LIBZSTD
+	if (be32toh(header.scheme) != CTF_COMPRESSED_ZSTD)
+#endif
+	{
+		fprintf(stderr, "[error] Unsupported stream compression scheme %" PRIu32 ".\n",
+			be32toh(header.scheme));
+		return -ENOTSUP;
+	}
+
+	*stream = stream_create(fd);
+	ret = read_table(*stream, &header);
+	if (ret) {
+		stream_destroy(*stream);
+		*stream = NULL;
+	}
+	return ret;
+}
+
+struct ctf_compressed_stream *ctf_compressed_create(int fd)
+{
+#ifdef BABELTRACE_HAVE_LIBZSTD
+	struct ctf_compressed_stream *stream;
+	struct ctf_compressed_file_hdr header;
+
+	/* Incomplete until the table is written on close */
+	memset(&header, 0, sizeof(header));
+	header.magic = htobe32(CTF_COMPRESSED_MAGIC);
+	header.major = htobe32(CTF_COMPRESSED_MAJOR);
+	header.minor = htobe32(CTF_COMPRESSED_MINOR);
+	header.scheme = htobe32(CTF_COMPRESSED_ZSTD);
+	if (pwrite_full(fd, (const char *) &header, sizeof(header), 0)) {
+		perror("pwrite");
+		return NULL;
+	}
+	stream = stream_create(fd);
+	stream->write = 1;
+	return stream;
+#else
+	return NULL;
+#endif
+}
+
+static
+int write_table(struct ctf_compressed_stream *stream)
+{
+	struct ctf_compressed_file_hdr header;
+	struct ctf_compressed_packet *table;
+	guint i;
+	int ret = 0;
+
+	if (!stream->packets->len) {
+		/* Leave an empty file, as for a stream without packets */
+		if (ftruncate(stream->fd, 0)) {
+			perror("ftruncate");
+			ret = -1;
+		}
+		goto end;
+	}
+
+	table = g_new(struct ctf_compressed_packet, stream->packets->len);
+	for (i = 0; i < stream->packets->len; i++) {
+		struct compressed_packet *packet = &g_array_index(
+			stream->packets, struct compressed_packet, i);
+
+		table[i].offset = htobe64(packet->offset);
+		table[i].size = htobe64(packet->size);
+		table[i].packet_size = htobe64(packet->packet_size);
+		table[i].content_size = htobe64(packet->content_size);
+	}
+	ret = pwrite_full(stream->fd, (const char *) table,
+		stream->packets->len * sizeof(*table), stream->end);
+	g_free(table);
+	if (ret) {
+		perror("pwrite");
+		goto end;
+	}
+
+	memset(&header, 0, sizeof(header));
+	header.magic = htobe32(CTF_COMPRESSED_MAGIC);
+	header.major = htobe32(CTF_COMPRESSED_MAJOR);
+	header.minor = htobe32(CTF_COMPRESSED_MINOR);
+	header.scheme = htobe32(CTF_COMPRESSED_ZSTD);
+	header.nr_packets = htobe64(stream->packets->len);
+	header.table_offset = htobe64(stream->end);
+	ret = pwrite_full(stream->fd, (const char *) &header,
+		sizeof(header), 0);
+	if (ret) {
+		perror("pwrite");
+	}
+end:
+	return ret;
+}
+
+int ctf_compressed_close(struct ctf_compressed_stream *stream)
+{
+	int ret = 0;
+
+	if (!stream) {
+		goto end;
+	}
+	if (stream->write) {
+		ret = write_table(stream);
+		if (close(stream->fd)) {
+			perror("close");
+			ret = -1;
+		}
+	}
+	stream_destroy(stream);
+end:
+	return ret;
+}
+
+void ctf_compressed_set_fd(struct ctf_compressed_stream *stream, int fd)
+{
+	stream->fd = fd;
+}
+
+off_t ctf_compressed_size(struct ctf_compressed_stream *stream)
+{
+	return stream->size;
+}
+
+/* Index of the packet containing "offset" in the uncompressed stream. */
+static
+guint find_packet(struct ctf_compressed_stream *stream, off_t offset)
+{
+	guint low = 0, high = stream->packets->len;
+
+	while (high - low > 1) {
+		guint mid = low + (high - low) / 2;
+
+		if (g_array_index(stream->packets, struct compressed_packet,
+				mid).logical_offset <= offset) {
+			low = mid;
+		} else {
+			high = mid;
+		}
+	}
+	return low;
+}
+
+/* Decompress a packet into "dst", which holds packet_size bytes. */
+static
+int read_packet(struct ctf_compressed_stream *stream,
+		struct compressed_packet *packet, char *dst)
+{
+	int ret;
+
+	ret = reserve(&stream->cbuf, &stream->cbuf_len, packet->size);
+	if (ret) {
+		return ret;
+	}
+	if (pread_full(stream->fd, stream->cbuf, packet->size,
+			packet->offset)) {
+		fprintf(stderr, "[error] Unable to read compressed packet.\n");
+		return -EIO;
+	}
+	ret = decompress(dst, packet->content_size, stream->cbuf,
+		packet->size);
+	if (ret) {
+		return -EINVAL;
+	}
+	memset(dst + packet->content_size, 0,
+		packet->packet_size - packet->content_size);
+	return 0;
+}
+
+/* Decompress the range [offset, offset + length) into the buffer. */
+static
+int read_range(struct ctf_compressed_stream *stream, size_t length,
+		off_t offset)
+{
+	off_t end = offset + length;
+	guint i;
+	int ret;
+
+	ret = reserve(&stream->buf, &stream->buf_len, length);
+	if (ret) {
+		return ret;
+	}
+	for (i = find_packet(stream, offset); i < stream->packets->len; i++) {
+		struct compressed_packet *packet = &g_array_index(
+			stream->packets, struct compressed_packet, i);
+		off_t packet_end = packet->logical_offset + packet->packet_size;
+		off_t from, to;
+
+		if (packet->logical_offset >= end) {
+			break;
+		}
+		if (packet->logical_offset >= offset && packet_end <= end) {
+			/* Whole packet, decompress it in place */
+			ret = read_packet(stream, packet, stream->buf +
+				(packet->logical_offset - offset));
+			if (ret) {
+				return ret;
+			}
+			continue;
+		}
+		ret = reserve(&stream->packet_buf, &stream->packet_buf_len,
+			packet->packet_size);
+		if (ret) {
+			return ret;
+		}
+		ret = read_packet(stream, packet, stream->packet_buf);
+		if (ret) {
+			return ret;
+		}
+		from = offset > packet->logical_offset ?
+			offset : packet->logical_offset;
+		to = end < packet_end ? end : packet_end;
+		memcpy(stream->buf + (from - offset), stream->packet_buf +
+			(from - packet->logical_offset), to - from);
+	}
+	return 0;
+}
+
+struct mmap_align *ctf_compressed_map(struct ctf_compressed_stream *stream,
+		size_t length, off_t offset)
+{
+	struct mmap_align *mma;
+
+	if (offset < 0 || offset >= stream->size) {
+		errno = EINVAL;
+		return MAP_FAILED;
+	}
+	if (length > stream->size - offset) {
+		length = stream->size - offset;
+	}
+
+	mma = malloc(sizeof(*mma));
+	if (!mma) {
+		return MAP_FAILED;
+	}
+	/* Mapping the same range again, e.g. after indexing a packet */
+	if (offset != stream->buf_offset || length > stream->buf_valid) {
+		int ret;
+
+		stream->buf_valid = 0;
+		ret = read_range(stream, length, offset);
+		if (ret) {
+			free(mma);
+			errno = -ret;
+			return MAP_FAILED;
+		}
+		stream->buf_offset = offset;
+		stream->buf_valid = length;
+	}
+	mma->page_aligned_addr = NULL;
+	mma->page_aligned_length = 0;
+	mma->addr = stream->buf;
+	mma->length = length;
+	return mma;
+}
+
+int ctf_compressed_append(struct ctf_compressed_stream *stream,
+		const char *packet, size_t content_len, size_t packet_len)
+{
+#ifdef BABELTRACE_HAVE_LIBZSTD
+	struct compressed_packet entry;
+	size_t size;
+	int ret;
+
+	ret = reserve(&stream->cbuf, &stream->cbuf_len,
+		ZSTD_compressBound(content_len));
+	if (ret) {
+		return ret;
+	}
+	size = ZSTD_compress(stream->cbuf, stream->cbuf_len, packet,
+		content_len, COMPRESSION_LEVEL);
+	if (ZSTD_isError(size)) {
+		fprintf(stderr, "[error] Unable to compress packet: %s.\n",
+			ZSTD_getErrorName(size));
+		return -1;
+	}
+	if (pwrite_full(stream->fd, stream->cbuf, size, stream->end)) {
+		perror("pwrite");
+		return -1;
+	}
+
+	entry.logical_offset = stream->size;
+	entry.offset = stream->end;
+	entry.size = size;
+	entry.packet_size = packet_len;
+	entry.content_size = content_len;
+	g_array_append_val(stream->packets, entry);
+	stream->size += packet_len;
+	stream->end += size;
+	return 0;
+#else
+	return -1;
+#endif
+}
@@ -26,6 +26,7 @@
  * SOFTWARE.
  */
 
+#define _GNU_SOURCE
 #include <babeltrace/format.h>
 #include <babeltrace/ctf/types.h>
 #include <babeltrace/ctf/metadata.h>
@@ -36,6 +37,10 @@
 #include <babeltrace/compat/uuid.h>
 #include <babeltrace/endian.h>
 #include <babeltrace/ctf/ctf-index.h>
+#include <babeltrace/ctf/ctf-compressed.h>
+#include <babeltrace/ctf/ctf-packet-io.h>
+#include <babeltrace/ctf/packet-stream-internal.h>
+#include <babeltrace/ctf/iterator.h>
 #include <inttypes.h>
 #include <stdio.h>
 #include <sys/mman.h>
@@ -66,6 +71,18 @@
  */
 #define WRITE_PACKET_LEN	(getpagesize() * 8 * CHAR_BIT)
 
+/*
+ * Number of packets worth of file space the writer allocates at once,
+ * so that posix_fallocate() is not called for every packet.
+ */
+#define WRITE_PACKET_PREALLOC	8
+
+/*
+ * Default number of packets read ahead of the current packet of each
+ * stream, see bt_ctf_set_readahead().
+ */
+#define DEFAULT_READAHEAD_PACKETS	2
+
 #ifndef min
 #define min(a, b)	(((a) < (b)) ? (a) : (b))
 #endif
@@ -74,6 +91,12 @@
 
 #define INDEX_PATH "./index/%s.idx"
 
+/*
+ * Size of the buffer used to copy packets when copy_file_range() is
+ * unavailable, in bytes.
+ */
+#define COPY_BUF_LEN	(getpagesize() * 16)
+
 int opt_clock_cycles,
 	opt_clock_seconds,
 	opt_clock_date,
@@ -119,6 +142,14 @@ uint64_t ctf_timestamp_end(struct bt_trace_descriptor *descriptor,
 		struct bt_trace_handle *handle, enum bt_clock_type type);
 static
 int ctf_convert_index_timestamp(struct bt_trace_descriptor *tdp);
+static
+struct ctf_stream_definition *ctf_open_stream_cursor(
+		struct ctf_stream_definition *stream);
+static
+int ctf_close_stream_cursor(struct ctf_stream_definition *cursor);
+static
+int packet_stream_index(struct ctf_trace *td,
+		struct ctf_file_stream *file_stream);
 
 static
 rw_dispatch read_dispatch_table[] = {
@@ -154,6 +185,8 @@ struct bt_format ctf_format = {
 	.timestamp_begin = ctf_timestamp_begin,
 	.timestamp_end = ctf_timestamp_end,
 	.convert_index_timestamp = ctf_convert_index_timestamp,
+	.open_stream_cursor = ctf_open_stream_cursor,
+	.close_stream_cursor = ctf_close_stream_cursor,
 };
 
 static
@@ -194,9 +227,9 @@ uint64_t ctf_timestamp_begin(struct bt_trace_descriptor *descriptor,
 			if (stream_pos->packet_index->len <= 0)
 				continue;
 
+			/* Packets are indexed in time order. */
 			index = &g_array_index(stream_pos->packet_index,
-					struct packet_index,
-					stream_pos->packet_index->len - 1);
+					struct packet_index, 0);
 			if (type == BT_CLOCK_REAL) {
 				if (index->ts_real.timestamp_begin < begin)
 					begin = index->ts_real.timestamp_begin;
@@ -458,11 +491,350 @@ void ctf_print_discarded(FILE *fp, struct ctf_stream_definition *stream)
 	fflush(fp);
 }
 
+/*
+ * Reader resource limits, see bt_ctf_set_stream_limits(). The file
+ * streams opened while a limit is set and holding an open file are kept
+ * from the most to the least recently read, the latter being parked when
+ * a limit is exceeded. Other streams are not tracked, so that traces
+ * read without limits share no state.
+ */
+static struct {
+	unsigned int max_open_files;	/* 0 if unlimited */
+	uint64_t max_mapped_bytes;	/* 0 if unlimited */
+	unsigned int open_files;
+	uint64_t mapped_bytes;
+	GQueue lru;			/* struct ctf_file_stream */
+} stream_resources = {
+	.lru = G_QUEUE_INIT,
+};
+
+static
+int stream_resources_limited(void)
+{
+	return stream_resources.max_open_files ||
+		stream_resources.max_mapped_bytes;
+}
+
+static
+int stream_resources_exceeded(void)
+{
+	return (stream_resources.max_open_files &&
+			stream_resources.open_files >
+				stream_resources.max_open_files) ||
+		(stream_resources.max_mapped_bytes &&
+			stream_resources.mapped_bytes >
+				stream_resources.max_mapped_bytes);
+}
+
+/* File stream of a reader position, NULL if its resources are unmanaged. */
+static
+struct ctf_file_stream *managed_file_stream(struct ctf_stream_pos *pos)
+{
+	struct ctf_file_stream *file_stream;
+
+	if (pos->prot & PROT_WRITE)
+		return NULL;
+	file_stream = container_of(pos, struct ctf_file_stream, pos);
+	return file_stream->lru.data ? file_stream : NULL;
+}
+
+static
+int stream_pos_unmap(struct ctf_stream_pos *pos)
+{
+	struct ctf_file_stream *file_stream = managed_file_stream(pos);
+
+	if (file_stream)
+		stream_resources.mapped_bytes -= pos->base_mma->length;
+	if (pos->compressed) {
+		/* The decompression buffer is reused */
+		free(pos->base_mma);
+		return 0;
+	}
+	if (pos->packet_reader) {
+		ctf_packet_reader_unmap(pos->packet_reader, pos->base_mma);
+		return 0;
+	}
+	if (pos->packet_stream) {
+		ctf_packet_stream_unmap(pos->packet_stream, pos->base_mma);
+		return 0;
+	}
+	return munmap_align(pos->base_mma);
+}
+
+/*
+ * Unmap the packet and close the file of a stream, keeping its position
+ * to restore it when the stream is read again.
+ */
+static
+void stream_park(struct ctf_file_stream *file_stream)
+{
+	struct ctf_stream_pos *pos = &file_stream->pos;
+
+	file_stream->parked_map_len = 0;
+	if (pos->base_mma) {
+		file_stream->parked_map_len = pos->base_mma->length;
+		if (stream_pos_unmap(pos))
+			perror("Error unmapping parked stream");
+		pos->base_mma = NULL;
+	}
+	/* Reads ahead may not be submitted yet, and the fd reused. */
+	if (pos->packet_reader)
+		ctf_packet_reader_drop_ahead(pos->packet_reader);
+	if (close(pos->fd))
+		perror("Error closing parked stream");
+	pos->fd = -1;
+	g_queue_unlink(&stream_resources.lru, &file_stream->lru);
+	stream_resources.open_files--;
+	file_stream->parked = 1;
+}
+
+/* Park the least recently read streams, but "keep", until within limits. */
+static
+void stream_resources_evict(struct ctf_file_stream *keep)
+{
+	while (stream_resources_exceeded()) {
+		GList *link = g_queue_peek_tail_link(&stream_resources.lru);
+
+		if (!link || link->data == keep)
+			break;
+		stream_park(link->data);
+	}
+}
+
+/* Account for the open file of a stream, most recently read. */
+static
+void stream_resources_add(struct ctf_file_stream *file_stream)
+{
+	file_stream->lru.data = file_stream;
+	g_queue_push_head_link(&stream_resources.lru, &file_stream->lru);
+	stream_resources.open_files++;
+	stream_resources_evict(file_stream);
+}
+
+static
+void stream_resources_remove(struct ctf_file_stream *file_stream)
+{
+	if (!file_stream->lru.data)
+		return;
+	if (!file_stream->parked) {
+		g_queue_unlink(&stream_resources.lru, &file_stream->lru);
+		stream_resources.open_files--;
+	}
+	file_stream->lru.data = NULL;
+}
+
+static
+void stream_touch(struct ctf_file_stream *file_stream)
+{
+	g_queue_unlink(&stream_resources.lru, &file_stream->lru);
+	g_queue_push_head_link(&stream_resources.lru, &file_stream->lru);
+}
+
+/* Reopen the file of a parked stream. */
+static
+int stream_reopen(struct ctf_file_stream *file_stream)
+{
+	struct ctf_trace *td = file_stream->parent.stream_class->trace;
+	int fd;
+
+	fd = openat(td->dirfd, file_stream->parent.path, O_RDONLY);
+	if (fd < 0) {
+		perror("Parked stream openat()");
+		return -errno;
+	}
+	file_stream->pos.fd = fd;
+	if (file_stream->pos.compressed)
+		ctf_compressed_set_fd(file_stream->pos.compressed, fd);
+	file_stream->parked = 0;
+	stream_resources_add(file_stream);
+	return 0;
+}
+
+/*
+ * Map the stream at its current offset. Packets of compressed streams are
+ * decompressed in a buffer instead, packets of streams with a packet
+ * reader are read in a buffer, and packets of packet streams are used in
+ * place from the buffer they are pushed in.
+ */
+static
+struct mmap_align *stream_pos_map(struct ctf_stream_pos *pos, size_t length,
+		int prot, int flags)
+{
+	struct ctf_file_stream *file_stream = managed_file_stream(pos);
+	struct mmap_align *mma;
+
+	if (file_stream && file_stream->parked &&
+			stream_reopen(file_stream))
+		return MAP_FAILED;
+	if (pos->compressed)
+		mma = ctf_compressed_map(pos->compressed, length,
+			pos->mmap_offset);
+	else if (pos->packet_reader)
+		mma = ctf_packet_reader_map(pos->packet_reader, pos->fd,
+			length, pos->mmap_offset);
+	else if (pos->packet_stream)
+		mma = ctf_packet_stream_map(pos->packet_stream, length,
+			pos->mmap_offset);
+	else
+		mma = mmap_align(length, prot, flags, pos->fd,
+			pos->mmap_offset);
+	if (file_stream && mma != MAP_FAILED) {
+		stream_resources.mapped_bytes += mma->length;
+		stream_touch(file_stream);
+		stream_resources_evict(file_stream);
+	}
+	return mma;
+}
+
+/* Reopen a parked stream and map its packet back. */
+static
+int stream_unpark(struct ctf_file_stream *file_stream)
+{
+	struct ctf_stream_pos *pos = &file_stream->pos;
+	size_t map_len = file_stream->parked_map_len;
+	int ret;
+
+	ret = stream_reopen(file_stream);
+	if (ret)
+		return ret;
+	if (map_len) {
+		pos->base_mma = stream_pos_map(pos, map_len, pos->prot,
+				pos->flags);
+		if (pos->base_mma == MAP_FAILED) {
+			pos->base_mma = NULL;
+			return -errno;
+		}
+	}
+	return 0;
+}
+
+/* Stat the stream file, with the uncompressed size of compressed streams. */
+static
+int stream_pos_stat(struct ctf_stream_pos *pos, struct stat *filestats)
+{
+	struct ctf_file_stream *file_stream = managed_file_stream(pos);
+	int ret;
+
+	if (file_stream && file_stream->parked) {
+		ret = stream_reopen(file_stream);
+		if (ret)
+			return ret;
+	}
+	ret = fstat(pos->fd, filestats);
+	if (ret < 0)
+		return ret;
+	if (pos->compressed)
+		filestats->st_size = ctf_compressed_size(pos->compressed);
+	return 0;
+}
+
+void bt_ctf_set_stream_limits(unsigned int max_open_files,
+		uint64_t max_mapped_bytes)
+{
+	stream_resources.max_open_files = max_open_files;
+	stream_resources.max_mapped_bytes = max_mapped_bytes;
+	stream_resources_evict(NULL);
+}
+
+static unsigned int readahead_packets = DEFAULT_READAHEAD_PACKETS;
+
+void bt_ctf_set_readahead(unsigned int nr_packets)
+{
+	readahead_packets = nr_packets;
+}
+
+static
+int event_filter_match(struct ctf_file_stream *file_stream, uint64_t id)
+{
+	GArray *filter = file_stream->event_filter;
+
+	if (id / 64 >= filter->len)
+		return 0;
+	return !!(g_array_index(filter, uint64_t, id / 64) & (1ULL << (id % 64)));
+}
+
+/*
+ * Return whether a packet may hold events of the filter, from the event
+ * ids indexed by bt_ctf_event_id_index().
+ */
+static
+int packet_filter_match(struct ctf_file_stream *file_stream, uint64_t index)
+{
+	struct ctf_file_stream *indexed = file_stream->origin ? : file_stream;
+	GArray *filter = file_stream->event_filter;
+	uint64_t *ids;
+	uint64_t i, nr_words;
+
+	if (!indexed->packet_event_ids)
+		return 1;
+	/* Packets appended after indexing (live) are not excluded. */
+	if (index >= indexed->packet_event_ids->len / indexed->event_ids_words)
+		return 1;
+	ids = &g_array_index(indexed->packet_event_ids, uint64_t,
+			index * indexed->event_ids_words);
+	nr_words = indexed->event_ids_words;
+	if (nr_words > filter->len)
+		nr_words = filter->len;
+	for (i = 0; i < nr_words; i++) {
+		if (ids[i] & g_array_index(filter, uint64_t, i))
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * Have the kernel read the packet just mapped and the next packets of a
+ * stream into the page cache in the background, so that reading them
+ * does not wait for the storage at every page fault. Packets skipped by
+ * the event filter are not read ahead.
+ */
+static
+void stream_readahead(struct ctf_file_stream *file_stream)
+{
+	struct ctf_stream_pos *pos = &file_stream->pos;
+	uint64_t index;
+	unsigned int nr_packets = 0;
+
+	if (!readahead_packets || pos->compressed || pos->fd < 0)
+		return;
+	if (!pos->packet_reader)
+		(void) madvise(pos->base_mma->page_aligned_addr,
+				pos->base_mma->page_aligned_length,
+				MADV_WILLNEED);
+	for (index = pos->cur_index + 1;
+			index < pos->packet_index->len &&
+			nr_packets < readahead_packets; index++) {
+		struct packet_index *packet;
+
+		if (file_stream->event_filter &&
+				!packet_filter_match(file_stream, index))
+			continue;
+		nr_packets++;
+		/* Already read ahead from a previous packet */
+		if (index < file_stream->readahead_index)
+			continue;
+		packet = &g_array_index(pos->packet_index,
+				struct packet_index, index);
+		if (pos->packet_reader &&
+				!ctf_packet_reader_prefetch(pos->packet_reader,
+					pos->fd, packet->packet_size / CHAR_BIT,
+					packet->offset))
+			continue;
+		(void) posix_fadvise(pos->fd, packet->offset,
+				packet->packet_size / CHAR_BIT,
+				POSIX_FADV_WILLNEED);
+	}
+	if (index > file_stream->readahead_index)
+		file_stream->readahead_index = index;
+}
+
 static
 int ctf_read_event(struct bt_stream_pos *ppos, struct ctf_stream_definition *stream)
 {
 	struct ctf_stream_pos *pos =
 		container_of(ppos, struct ctf_stream_pos, parent);
+	struct ctf_file_stream *file_stream =
+		container_of(stream, struct ctf_file_stream, parent);
 	struct ctf_stream_declaration *stream_class = stream->stream_class;
 	struct ctf_event_definition *event;
 	uint64_t id = 0;
@@ -472,6 +844,17 @@ int ctf_read_event(struct bt_stream_pos *ppos, struct ctf_stream_definition *str
 	if (unlikely(pos->offset == EOF))
 		return EOF;
 
+	if (unlikely(file_stream->parked)) {
+		ret = stream_unpark(file_stream);
+		if (ret)
+			return ret;
+	} else if (unlikely(stream_resources_limited() &&
+			file_stream->lru.data)) {
+		/* Most recently read */
+		stream_touch(file_stream);
+	}
+
+next_event:
 	ctf_pos_get_event(pos);
 
 	/* save the current position as a restore point */
@@ -581,6 +964,10 @@ int ctf_read_event(struct bt_stream_pos *ppos, struct ctf_stream_definition *str
 		return -EINVAL;
 	}
 
+	if (unlikely(file_stream->event_filter) &&
+			!event_filter_match(file_stream, id))
+		goto next_event;
+
 	return 0;
 
 error:
@@ -659,7 +1046,7 @@ int find_data_offset(struct ctf_stream_pos *pos,
 
 	pos = &file_stream->pos;
 
-	ret = fstat(pos->fd, &filestats);
+	ret = stream_pos_stat(pos, &filestats);
 	if (ret < 0)
 		return ret;
 	filesize = filestats.st_size;
@@ -676,7 +1063,7 @@ begin:
 
 	if (pos->base_mma) {
 		/* unmap old base */
-		ret = munmap_align(pos->base_mma);
+		ret = stream_pos_unmap(pos);
 		if (ret) {
 			fprintf(stderr, "[error] Unable to unmap old base: %s.\n",
 					strerror(errno));
@@ -685,8 +1072,8 @@ begin:
 		pos->base_mma = NULL;
 	}
 	/* map new base. Need mapping length from header. */
-	pos->base_mma = mmap_align(packet_map_len >> LOG2_CHAR_BIT, PROT_READ,
-			MAP_PRIVATE, pos->fd, pos->mmap_offset);
+	pos->base_mma = stream_pos_map(pos, packet_map_len >> LOG2_CHAR_BIT,
+			PROT_READ, MAP_PRIVATE);
 	assert(pos->base_mma != MAP_FAILED);
 
 	pos->content_size = packet_map_len;
@@ -710,10 +1097,11 @@ begin:
 				goto retry;
 		}
 	}
+	/* Stream cursors sharing this index all store the same value. */
 	packet_index->data_offset = pos->offset;
 
 	/* unmap old base */
-	ret = munmap_align(pos->base_mma);
+	ret = stream_pos_unmap(pos);
 	if (ret) {
 		fprintf(stderr, "[error] Unable to unmap old base: %s.\n",
 				strerror(errno));
@@ -748,6 +1136,10 @@ int ctf_init_pos(struct ctf_stream_pos *pos, struct bt_trace_descriptor *trace,
 		int fd, int open_flags)
 {
 	pos->fd = fd;
+	pos->compressed = NULL;
+	pos->packet_reader = NULL;
+	pos->write_packet_size = 0;
+	pos->reserved_offset = 0;
 	if (fd >= 0) {
 		pos->packet_index = g_array_new(FALSE, TRUE,
 				sizeof(struct packet_index));
@@ -761,6 +1153,8 @@ int ctf_init_pos(struct ctf_stream_pos *pos, struct bt_trace_descriptor *trace,
 		pos->parent.rw_table = read_dispatch_table;
 		pos->parent.event_cb = ctf_read_event;
 		pos->parent.trace = trace;
+		if (fd >= 0)
+			pos->packet_reader = ctf_packet_reader_create();
 		break;
 	case O_RDWR:
 		pos->prot = PROT_READ | PROT_WRITE;
@@ -775,21 +1169,61 @@ int ctf_init_pos(struct ctf_stream_pos *pos, struct bt_trace_descriptor *trace,
 	return 0;
 }
 
+int ctf_pos_reserve(struct ctf_stream_pos *pos, off_t end)
+{
+	off_t reserve_end;
+	int ret;
+
+	if (end <= pos->reserved_offset)
+		return 0;
+	reserve_end = end + (pos->packet_size / CHAR_BIT) *
+		(WRITE_PACKET_PREALLOC - 1);
+	ret = posix_fallocate(pos->fd, pos->reserved_offset,
+			reserve_end - pos->reserved_offset);
+	if (ret) {
+		/* Fall back on allocating only what is needed. */
+		ret = posix_fallocate(pos->fd, pos->reserved_offset,
+				end - pos->reserved_offset);
+		if (ret) {
+			fprintf(stderr, "[error] Unable to allocate packet: %s.\n",
+				strerror(ret));
+			return -ret;
+		}
+		reserve_end = end;
+	}
+	pos->reserved_offset = reserve_end;
+	return 0;
+}
+
 int ctf_fini_pos(struct ctf_stream_pos *pos)
 {
 	if ((pos->prot & PROT_WRITE) && pos->content_size_loc)
 		*pos->content_size_loc = pos->offset;
+	if ((pos->prot & PROT_WRITE) && pos->reserved_offset) {
+		off_t end = pos->mmap_offset + pos->packet_size / CHAR_BIT;
+
+		/* Drop the space allocated ahead for packets never written. */
+		if (pos->reserved_offset > end && ftruncate(pos->fd, end)) {
+			fprintf(stderr, "[error] Unable to truncate stream: %s.\n",
+				strerror(errno));
+			return -1;
+		}
+	}
 	if (pos->base_mma) {
 		int ret;
 
 		/* unmap old base */
-		ret = munmap_align(pos->base_mma);
+		ret = stream_pos_unmap(pos);
 		if (ret) {
 			fprintf(stderr, "[error] Unable to unmap old base: %s.\n",
 				strerror(errno));
 			return -1;
 		}
 	}
+	ctf_packet_reader_destroy(pos->packet_reader);
+	pos->packet_reader = NULL;
+	if (ctf_compressed_close(pos->compressed))
+		return -1;
 	if (pos->packet_index)
 		(void) g_array_free(pos->packet_index, TRUE);
 	return 0;
@@ -849,6 +1283,40 @@ void ctf_update_current_packet_index(struct ctf_stream_definition *stream,
 	stream->events_discarded = events_discarded_diff;
 }
 
+/*
+ * Index the packets pushed to a packet stream after the last packet of
+ * its index. Returns 0 if there is a next packet to read. Otherwise, the
+ * packets read are released, and 1 is returned with the stream inactive
+ * until more packets are pushed, or at its end once it is closed.
+ */
+static
+int packet_stream_next(struct ctf_file_stream *file_stream)
+{
+	struct ctf_stream_pos *pos = &file_stream->pos;
+	struct packet_index *packet_index;
+	int ret;
+
+	ret = packet_stream_index(file_stream->parent.stream_class->trace,
+			file_stream);
+	if (pos->cur_index + 1 < pos->packet_index->len)
+		return 0;
+	packet_index = &g_array_index(pos->packet_index, struct packet_index,
+			pos->cur_index);
+	ctf_packet_stream_release(pos->packet_stream,
+			packet_index->offset +
+			packet_index->packet_size / CHAR_BIT);
+	if (ret == -EAGAIN) {
+		/* Stream is inactive for now, see ctf_read_event(). */
+		pos->content_size = 0;
+		pos->packet_size = 0;
+		pos->data_offset = 0;
+		pos->offset = 0;
+	} else {
+		pos->offset = EOF;
+	}
+	return 1;
+}
+
 /*
  * for SEEK_CUR: go to next packet.
  * for SEEK_SET: go to packet numer (index).
@@ -860,7 +1328,6 @@ void ctf_packet_seek(struct bt_stream_pos *stream_pos, size_t index, int whence)
 	struct ctf_file_stream *file_stream =
 		container_of(pos, struct ctf_file_stream, pos);
 	int ret;
-	off_t off;
 	struct packet_index *packet_index, *prev_index;
 
 	switch (whence) {
@@ -876,7 +1343,7 @@ void ctf_packet_seek(struct bt_stream_pos *stream_pos, size_t index, int whence)
 
 	if (pos->base_mma) {
 		/* unmap old base */
-		ret = munmap_align(pos->base_mma);
+		ret = stream_pos_unmap(pos);
 		if (ret) {
 			fprintf(stderr, "[error] Unable to unmap old base: %s.\n",
 				strerror(errno));
@@ -903,10 +1370,10 @@ void ctf_packet_seek(struct bt_stream_pos *stream_pos, size_t index, int whence)
 			assert(0);
 		}
 		pos->content_size = -1U;	/* Unknown at this point */
-		pos->packet_size = WRITE_PACKET_LEN;
-		off = posix_fallocate(pos->fd, pos->mmap_offset,
-				      pos->packet_size / CHAR_BIT);
-		assert(off >= 0);
+		pos->packet_size = pos->write_packet_size ? : WRITE_PACKET_LEN;
+		ret = ctf_pos_reserve(pos, pos->mmap_offset +
+				pos->packet_size / CHAR_BIT);
+		assert(!ret);
 		pos->offset = 0;
 	} else {
 	read_next_packet:
@@ -917,8 +1384,20 @@ void ctf_packet_seek(struct bt_stream_pos *stream_pos, size_t index, int whence)
 				return;
 			}
 			assert(pos->cur_index < pos->packet_index->len);
+			if (pos->packet_stream &&
+					pos->cur_index + 1 >= pos->packet_index->len &&
+					packet_stream_next(file_stream)) {
+				return;
+			}
 			/* The reader will expect us to skip padding */
 			++pos->cur_index;
+			if (pos->packet_stream) {
+				packet_index = &g_array_index(pos->packet_index,
+						struct packet_index,
+						pos->cur_index);
+				ctf_packet_stream_release(pos->packet_stream,
+						packet_index->offset);
+			}
 			break;
 		}
 		case SEEK_SET:
@@ -926,7 +1405,16 @@ void ctf_packet_seek(struct bt_stream_pos *stream_pos, size_t index, int whence)
 				pos->offset = EOF;
 				return;
 			}
+			/* The buffers of packet streams are read once. */
+			if (pos->packet_stream &&
+					g_array_index(pos->packet_index,
+						struct packet_index, index).offset <
+					ctf_packet_stream_begin(pos->packet_stream)) {
+				pos->offset = EOF;
+				return;
+			}
 			pos->cur_index = index;
+			file_stream->readahead_index = 0;
 			break;
 		default:
 			assert(0);
@@ -966,6 +1454,14 @@ void ctf_packet_seek(struct bt_stream_pos *stream_pos, size_t index, int whence)
 
 		file_stream->parent.real_timestamp = packet_index->ts_real.timestamp_begin;
 
+		/* Skip packets without any event of the filter, unmapped. */
+		if (file_stream->event_filter &&
+				!packet_filter_match(file_stream, pos->cur_index)) {
+			pos->offset = 0;
+			whence = SEEK_CUR;
+			goto read_next_packet;
+		}
+
 		/* Lookup context/packet size in index */
 		if (packet_index->data_offset == -1) {
 			ret = find_data_offset(pos, file_stream, packet_index);
@@ -990,13 +1486,15 @@ void ctf_packet_seek(struct bt_stream_pos *stream_pos, size_t index, int whence)
 		}
 	}
 	/* map new base. Need mapping length from header. */
-	pos->base_mma = mmap_align(pos->packet_size / CHAR_BIT, pos->prot,
-			pos->flags, pos->fd, pos->mmap_offset);
+	pos->base_mma = stream_pos_map(pos, pos->packet_size / CHAR_BIT,
+			pos->prot, pos->flags);
 	if (pos->base_mma == MAP_FAILED) {
 		fprintf(stderr, "[error] mmap error %s.\n",
 			strerror(errno));
 		assert(0);
 	}
+	if (!(pos->prot & PROT_WRITE))
+		stream_readahead(file_stream);
 
 	/* update trace_packet_header and stream_packet_context */
 	if (!(pos->prot & PROT_WRITE) &&
@@ -1518,7 +2016,7 @@ begin:
 
 	if (pos->base_mma) {
 		/* unmap old base */
-		ret = munmap_align(pos->base_mma);
+		ret = stream_pos_unmap(pos);
 		if (ret) {
 			fprintf(stderr, "[error] Unable to unmap old base: %s.\n",
 				strerror(errno));
@@ -1527,8 +2025,8 @@ begin:
 		pos->base_mma = NULL;
 	}
 	/* map new base. Need mapping length from header. */
-	pos->base_mma = mmap_align(packet_map_len >> LOG2_CHAR_BIT, PROT_READ,
-			 MAP_PRIVATE, pos->fd, pos->mmap_offset);
+	pos->base_mma = stream_pos_map(pos, packet_map_len >> LOG2_CHAR_BIT,
+			PROT_READ, MAP_PRIVATE);
 	assert(pos->base_mma != MAP_FAILED);
 	/*
 	 * Use current mapping size as temporary content and packet
@@ -1547,6 +2045,7 @@ begin:
 	packet_index.ts_cycles.timestamp_end = 0;
 	packet_index.events_discarded = 0;
 	packet_index.events_discarded_len = 0;
+	packet_index.cpu_id = -1;
 
 	/* read and check header, set stream id (and check) */
 	if (file_stream->parent.trace_packet_header) {
@@ -1693,6 +2192,15 @@ begin:
 			packet_index.events_discarded = bt_get_unsigned_int(field);
 			packet_index.events_discarded_len = bt_get_int_len(field);
 		}
+
+		/* read cpu id from header */
+		len_index = bt_struct_declaration_lookup_field_index(file_stream->parent.stream_packet_context->declaration, g_quark_from_static_string("cpu_id"));
+		if (len_index >= 0) {
+			struct bt_definition *field;
+
+			field = bt_struct_definition_get_field_from_index(file_stream->parent.stream_packet_context, len_index);
+			packet_index.cpu_id = bt_get_unsigned_int(field);
+		}
 	} else {
 		/* Use file size for packet size */
 		packet_index.packet_size = filesize * CHAR_BIT;
@@ -1763,7 +2271,7 @@ int create_stream_packet_index(struct ctf_trace *td,
 
 	pos = &file_stream->pos;
 
-	ret = fstat(pos->fd, &filestats);
+	ret = stream_pos_stat(pos, &filestats);
 	if (ret < 0)
 		return ret;
 
@@ -1800,6 +2308,46 @@ int create_stream_packet_index(struct ctf_trace *td,
 	return 0;
 }
 
+/*
+ * Index the buffers pushed to a packet stream after the last packet of
+ * its index, each of them holding whole packets. Returns -EAGAIN once
+ * all the buffers pushed are indexed, EOF if the stream is closed, or
+ * another negative error.
+ */
+static
+int packet_stream_index(struct ctf_trace *td,
+		struct ctf_file_stream *file_stream)
+{
+	struct ctf_stream_pos *pos = &file_stream->pos;
+	off_t begin = 0, end;
+	int ret;
+
+	if (pos->packet_index->len) {
+		struct packet_index *last;
+
+		last = &g_array_index(pos->packet_index, struct packet_index,
+				pos->packet_index->len - 1);
+		begin = last->offset + last->packet_size / CHAR_BIT;
+	}
+	while (!(ret = ctf_packet_stream_next(pos->packet_stream, begin,
+			&end))) {
+		for (pos->mmap_offset = begin; pos->mmap_offset < end; ) {
+			ret = create_stream_one_packet_index(pos, td,
+				file_stream, end);
+			if (ret)
+				goto end;
+		}
+		begin = end;
+	}
+end:
+	if (pos->base_mma) {
+		if (stream_pos_unmap(pos))
+			ret = -errno;
+		pos->base_mma = NULL;
+	}
+	return ret;
+}
+
 static
 int create_trace_definitions(struct ctf_trace *td, struct ctf_stream_definition *stream)
 {
@@ -1862,16 +2410,18 @@ int import_stream_packet_index(struct ctf_trace *td,
 		goto error;
 	}
 	packet_index_len = be32toh(index_hdr.packet_index_len);
-	if (packet_index_len == 0) {
-		fprintf(stderr, "[error] Packet index length cannot be 0.\n");
+	if (packet_index_len < CTF_INDEX_1_0_SIZE) {
+		fprintf(stderr, "[error] Packet index length cannot be less than %zu.\n",
+			CTF_INDEX_1_0_SIZE);
 		ret = -1;
 		goto error;
 	}
 	/*
 	 * Allocate the index length found in header, not internal
-	 * representation.
+	 * representation, and at least the size of the fields we know
+	 * about, zeroed.
 	 */
-	ctf_index = g_malloc0(packet_index_len);
+	ctf_index = g_malloc0(MAX(packet_index_len, sizeof(*ctf_index)));
 	while (fread(ctf_index, packet_index_len, 1,
 			pos->index_fp) == 1) {
 		uint64_t stream_id;
@@ -1885,6 +2435,14 @@ int import_stream_packet_index(struct ctf_trace *td,
 		index.ts_cycles.timestamp_end = be64toh(ctf_index->timestamp_end);
 		index.events_discarded = be64toh(ctf_index->events_discarded);
 		index.events_discarded_len = 64;
+		index.cpu_id = -1;
+		if (be32toh(index_hdr.index_minor) >= 1
+				&& packet_index_len >= sizeof(*ctf_index)) {
+			uint64_t cpu_id = be64toh(ctf_index->stream_instance_id);
+
+			if (cpu_id != -1ULL)
+				index.cpu_id = cpu_id;
+		}
 		index.data_offset = -1;
 		stream_id = be64toh(ctf_index->stream_id);
 
@@ -1987,6 +2545,11 @@ int ctf_open_file_stream_read(struct ctf_trace *td, const char *path, int flags,
 	ret = ctf_init_pos(&file_stream->pos, &td->parent, fd, flags);
 	if (ret)
 		goto error_def;
+	ret = ctf_compressed_open(fd, &file_stream->pos.compressed);
+	if (ret)
+		goto error_def;
+	if (stream_resources_limited())
+		stream_resources_add(file_stream);
 	ret = create_trace_definitions(td, &file_stream->parent);
 	if (ret)
 		goto error_def;
@@ -2059,6 +2622,7 @@ error_def:
 	if (closeret) {
 		fprintf(stderr, "Error on ctf_fini_pos\n");
 	}
+	stream_resources_remove(file_stream);
 	g_free(file_stream);
 fd_is_empty_file:
 fd_is_dir_ok:
@@ -2188,6 +2752,33 @@ error:
  * Note that the user must seek the trace after the open (using the iterator)
  * since the index creation read it entirely.
  */
+/*
+ * A CTF trace opened for writing is an output directory, into which
+ * traces opened for reading are copied by ctf_copy_trace().
+ */
+static
+int ctf_open_trace_write(struct ctf_trace *td, const char *path, int flags)
+{
+	int ret;
+
+	td->flags = flags;
+	ret = mkdir(path, S_IRWXU | S_IRWXG | S_IRWXO);
+	if (ret && errno != EEXIST) {
+		fprintf(stderr, "[error] Unable to create trace directory \"%s\".\n", path);
+		perror("Trace directory mkdir");
+		return -errno;
+	}
+	td->dirfd = open(path, O_RDONLY);
+	if (td->dirfd < 0) {
+		fprintf(stderr, "[error] Unable to open trace directory file descriptor for path \"%s\".\n", path);
+		perror("Trace directory open");
+		return -errno;
+	}
+	strncpy(td->parent.path, path, sizeof(td->parent.path));
+	td->parent.path[sizeof(td->parent.path) - 1] = '\0';
+	return 0;
+}
+
 static
 struct bt_trace_descriptor *ctf_open_trace(const char *path, int flags,
 		void (*packet_seek)(struct bt_stream_pos *pos, size_t index,
@@ -2215,8 +2806,14 @@ struct bt_trace_descriptor *ctf_open_trace(const char *path, int flags,
 			goto error;
 		break;
 	case O_RDWR:
-		fprintf(stderr, "[error] Opening CTF traces for output is not supported yet.\n");
-		goto error;
+		if (!path) {
+			fprintf(stderr, "[error] Path missing for output CTF trace.\n");
+			goto error;
+		}
+		ret = ctf_open_trace_write(td, path, flags);
+		if (ret)
+			goto error;
+		break;
 	default:
 		fprintf(stderr, "[error] Incorrect open flags.\n");
 		goto error;
@@ -2246,6 +2843,7 @@ void ctf_init_mmap_pos(struct ctf_stream_pos *pos,
 	pos->parent.rw_table = read_dispatch_table;
 	pos->parent.event_cb = ctf_read_event;
 	pos->priv = mmap_info->priv;
+	pos->packet_stream = ctf_packet_stream_from_mmap(mmap_info);
 	pos->packet_index = g_array_new(FALSE, TRUE,
 			sizeof(struct packet_index));
 }
@@ -2291,6 +2889,11 @@ int ctf_open_mmap_stream_read(struct ctf_trace *td,
 	int ret;
 	struct ctf_file_stream *file_stream;
 
+	if (!ctf_packet_stream_from_mmap(mmap_info) && !packet_seek) {
+		fprintf(stderr, "[error] packet_seek function undefined.\n");
+		return -EINVAL;
+	}
+
 	file_stream = g_new0(struct ctf_file_stream, 1);
 	file_stream->parent.stream_id = -1ULL;
 	file_stream->pos.last_offset = LAST_OFFSET_POISON;
@@ -2303,9 +2906,23 @@ int ctf_open_mmap_stream_read(struct ctf_trace *td,
 		goto error_def;
 	}
 
-	ret = prepare_mmap_stream_definition(td, file_stream, packet_seek);
-	if (ret)
-		goto error_index;
+	if (file_stream->pos.packet_stream) {
+		/* Packets pushed in memory, indexed as those of files. */
+		file_stream->pos.packet_seek = ctf_packet_seek;
+		ret = packet_stream_index(td, file_stream);
+		if (ret != -EAGAIN && ret != EOF)
+			goto error_index;
+		if (!file_stream->pos.packet_index->len) {
+			fprintf(stderr, "[error] No packet pushed to packet stream.\n");
+			ret = -EINVAL;
+			goto error_index;
+		}
+	} else {
+		ret = prepare_mmap_stream_definition(td, file_stream,
+				packet_seek);
+		if (ret)
+			goto error_index;
+	}
 
 	/*
 	 * For now, only a single clock per trace is supported.
@@ -2382,10 +2999,6 @@ struct bt_trace_descriptor *ctf_open_mmap_trace(
 				"required for mmap parsing\n");
 		goto error;
 	}
-	if (!packet_seek) {
-		fprintf(stderr, "[error] packet_seek function undefined.\n");
-		goto error;
-	}
 	td = g_new0(struct ctf_trace, 1);
 	td->dirfd = -1;
 	ret = ctf_open_mmap_trace_read(td, mmap_list, packet_seek, metadata_fp);
@@ -2435,6 +3048,364 @@ int ctf_append_trace_metadata(struct bt_trace_descriptor *tdp,
 	return 0;
 }
 
+/*
+ * Copy len bytes from fd_in at off_in to fd_out at off_out, within the
+ * kernel when possible.
+ */
+static
+int ctf_copy_bytes(int fd_in, off_t off_in, int fd_out, off_t off_out,
+		size_t len)
+{
+	char *buf;
+	int ret = 0;
+
+#ifdef HAVE_COPY_FILE_RANGE
+	{
+		loff_t in = off_in, out = off_out;
+
+		while (len > 0) {
+			ssize_t copied;
+
+			copied = copy_file_range(fd_in, &in, fd_out, &out,
+					len, 0);
+			if (copied <= 0)
+				break;
+			len -= copied;
+		}
+		if (!len)
+			return 0;
+		/* Unsupported by the file systems: fall back on copying. */
+		off_in = in;
+		off_out = out;
+	}
+#endif
+	buf = g_malloc(COPY_BUF_LEN);
+	while (len > 0) {
+		ssize_t nr_read, nr_written;
+
+		nr_read = pread(fd_in, buf, min(len, COPY_BUF_LEN), off_in);
+		if (nr_read <= 0) {
+			ret = nr_read < 0 ? -errno : -EIO;
+			break;
+		}
+		nr_written = pwrite(fd_out, buf, nr_read, off_out);
+		if (nr_written != nr_read) {
+			ret = nr_written < 0 ? -errno : -EIO;
+			break;
+		}
+		off_in += nr_read;
+		off_out += nr_read;
+		len -= nr_read;
+	}
+	g_free(buf);
+	return ret;
+}
+
+static
+void ctf_set_packet_context_field(struct definition_struct *packet_context,
+		const char *name, uint64_t value)
+{
+	struct definition_integer *integer_definition;
+
+	integer_definition = bt_lookup_integer(&packet_context->p, name, FALSE);
+	if (integer_definition)
+		integer_definition->value._unsigned = value;
+}
+
+/*
+ * Write a new packet at *out_offset of out_fd, holding the events of
+ * packet "index" of file_stream which are within [begin, end]. The
+ * packet context is updated to match the events kept, so that compact
+ * event timestamps are still relative to the packet timestamp_begin.
+ * Nothing is written if no event is kept.
+ */
+static
+int ctf_copy_packet_range(struct ctf_file_stream *file_stream, size_t index,
+		struct bt_trace_descriptor *td_write, int out_fd,
+		off_t *out_offset, uint64_t begin, uint64_t end)
+{
+	struct ctf_stream_pos *pos = &file_stream->pos;
+	struct ctf_stream_definition *stream = &file_stream->parent;
+	struct packet_index *packet_index;
+	struct ctf_stream_pos out_pos;
+	uint64_t ts_begin = 0, ts_end = 0, nr_events = 0;
+	uint64_t content_size, packet_size;
+	int64_t context_offset = 0;
+	int dropped_head = 0, dropped_tail = 0;
+	int ret;
+
+	packet_index = &g_array_index(pos->packet_index, struct packet_index,
+			index);
+	pos->packet_seek(&pos->parent, index, SEEK_SET);
+	if (pos->offset == EOF || pos->cur_index != index)
+		return 0;	/* Packet without event */
+
+	memset(&out_pos, 0, sizeof(out_pos));
+	ret = ctf_init_pos(&out_pos, td_write, out_fd, O_RDWR);
+	if (ret)
+		return ret;
+	out_pos.mmap_offset = *out_offset;
+	out_pos.packet_size = packet_index->packet_size;
+	out_pos.content_size = -1U;	/* Unknown at this point */
+	ret = posix_fallocate(out_fd, out_pos.mmap_offset,
+			out_pos.packet_size / CHAR_BIT);
+	if (ret) {
+		fprintf(stderr, "[error] Unable to allocate packet: %s.\n",
+			strerror(ret));
+		ret = -ret;
+		goto end;
+	}
+	out_pos.base_mma = mmap_align(out_pos.packet_size / CHAR_BIT,
+			out_pos.prot, out_pos.flags, out_fd,
+			out_pos.mmap_offset);
+	if (out_pos.base_mma == MAP_FAILED) {
+		fprintf(stderr, "[error] mmap error %s.\n", strerror(errno));
+		out_pos.base_mma = NULL;
+		ret = -errno;
+		goto end;
+	}
+
+	if (stream->trace_packet_header) {
+		ret = generic_rw(&out_pos.parent,
+				&stream->trace_packet_header->p);
+		if (ret)
+			goto end;
+	}
+	if (stream->stream_packet_context) {
+		context_offset = out_pos.offset;
+		ret = generic_rw(&out_pos.parent,
+				&stream->stream_packet_context->p);
+		if (ret)
+			goto end;
+	}
+
+	/*
+	 * Stop at the end of the packet, before reading another event would
+	 * move to the next packet and overwrite the packet context.
+	 */
+	while (pos->offset < pos->content_size) {
+		ret = pos->parent.event_cb(&pos->parent, stream);
+		if (ret == EOF) {
+			ret = 0;
+			break;
+		}
+		if (ret)
+			goto end;
+		if (stream->real_timestamp < begin) {
+			dropped_head = 1;
+			continue;
+		}
+		if (stream->real_timestamp > end) {
+			dropped_tail = 1;
+			break;
+		}
+		ret = ctf_write_event(&out_pos.parent, stream);
+		if (ret)
+			goto end;
+		if (!nr_events++)
+			ts_begin = stream->cycles_timestamp;
+		ts_end = stream->cycles_timestamp;
+	}
+	if (!nr_events)
+		goto end;
+
+	content_size = out_pos.offset;
+	packet_size = content_size + offset_align(content_size,
+			(uint64_t) getpagesize() * CHAR_BIT);
+	packet_size = min(packet_size, packet_index->packet_size);
+	if (stream->stream_packet_context) {
+		struct definition_struct *packet_context =
+			stream->stream_packet_context;
+
+		ctf_set_packet_context_field(packet_context, "content_size",
+			content_size);
+		ctf_set_packet_context_field(packet_context, "packet_size",
+			packet_size);
+		if (dropped_head) {
+			ctf_set_packet_context_field(packet_context,
+				"timestamp_begin", ts_begin);
+		}
+		if (dropped_tail) {
+			ctf_set_packet_context_field(packet_context,
+				"timestamp_end", ts_end);
+		}
+		/* The packet context has a fixed layout: rewrite in place. */
+		out_pos.offset = context_offset;
+		ret = generic_rw(&out_pos.parent, &packet_context->p);
+		if (ret)
+			goto end;
+		out_pos.offset = content_size;
+	}
+	*out_offset += packet_size / CHAR_BIT;
+
+end:
+	if (ctf_fini_pos(&out_pos) && !ret)
+		ret = -1;
+	return ret;
+}
+
+static
+int ctf_copy_stream(struct ctf_file_stream *file_stream,
+		struct bt_trace_descriptor *td_write, int dirfd,
+		uint64_t begin, uint64_t end)
+{
+	struct ctf_stream_pos *pos = &file_stream->pos;
+	const char *name;
+	off_t out_offset = 0;
+	int out_fd, ret = 0, closeret;
+	size_t i;
+
+	if (!pos->packet_index)
+		return 0;
+	if (file_stream->parked) {
+		/* Packets may be copied from the file */
+		ret = stream_reopen(file_stream);
+		if (ret)
+			return ret;
+	}
+	name = strrchr(file_stream->parent.path, '/');
+	name = name ? name + 1 : file_stream->parent.path;
+	out_fd = openat(dirfd, name, O_RDWR | O_CREAT | O_TRUNC,
+			S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	if (out_fd < 0) {
+		fprintf(stderr, "[error] Unable to create stream file \"%s\".\n",
+			name);
+		perror("Stream file open");
+		return -errno;
+	}
+
+	for (i = 0; i < pos->packet_index->len; i++) {
+		struct packet_index *index;
+
+		index = &g_array_index(pos->packet_index, struct packet_index, i);
+		if (index->ts_real.timestamp_end < begin
+				|| index->ts_real.timestamp_begin > end)
+			continue;
+		/*
+		 * Packets of compressed streams are not stored as is, go
+		 * through their events.
+		 */
+		if (!pos->compressed
+				&& index->ts_real.timestamp_begin >= begin
+				&& index->ts_real.timestamp_end <= end) {
+			/* Whole packet within range: copy verbatim. */
+			ret = ctf_copy_bytes(pos->fd, index->offset, out_fd,
+					out_offset, index->packet_size / CHAR_BIT);
+			out_offset += index->packet_size / CHAR_BIT;
+		} else {
+			ret = ctf_copy_packet_range(file_stream, i, td_write,
+					out_fd, &out_offset, begin, end);
+		}
+		if (ret) {
+			fprintf(stderr, "[error] Unable to copy packet %zu of stream \"%s\".\n",
+				i, file_stream->parent.path);
+			goto end;
+		}
+	}
+	/* Discard space allocated past the last packet. */
+	ret = ftruncate(out_fd, out_offset);
+	if (ret) {
+		perror("Stream file ftruncate");
+		ret = -errno;
+	}
+end:
+	closeret = close(out_fd);
+	if (closeret) {
+		perror("Error closing stream file");
+		if (!ret)
+			ret = closeret;
+	}
+	return ret;
+}
+
+static
+int ctf_copy_metadata(struct ctf_trace *td, int dirfd)
+{
+	FILE *fp;
+	int fd, ret = 0;
+
+	if (!td->metadata_string)
+		return -EINVAL;
+	fd = openat(dirfd, "metadata", O_WRONLY | O_CREAT | O_TRUNC,
+			S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	if (fd < 0) {
+		perror("Metadata file open");
+		return -errno;
+	}
+	fp = fdopen(fd, "w");
+	if (!fp) {
+		perror("Metadata file fdopen");
+		close(fd);
+		return -errno;
+	}
+	if (td->metadata_packetized) {
+		fprintf(fp, "/* CTF %u.%u */\n", BT_CTF_MAJOR, BT_CTF_MINOR);
+	}
+	fputs(td->metadata_string, fp);
+	if (ferror(fp))
+		ret = -EIO;
+	if (fclose(fp)) {
+		perror("Error closing metadata file");
+		ret = -errno;
+	}
+	return ret;
+}
+
+int ctf_copy_trace(struct bt_trace_descriptor *td_write,
+		struct bt_trace_descriptor *td_read, const char *name,
+		uint64_t begin, uint64_t end)
+{
+	struct ctf_trace *tout = container_of(td_write, struct ctf_trace, parent);
+	struct ctf_trace *tin = container_of(td_read, struct ctf_trace, parent);
+	int dirfd, ret, i, j;
+
+	if ((tout->flags & O_ACCMODE) != O_RDWR
+			|| (tin->flags & O_ACCMODE) != O_RDONLY)
+		return -EINVAL;
+	if (name) {
+		ret = mkdirat(tout->dirfd, name, S_IRWXU | S_IRWXG | S_IRWXO);
+		if (ret && errno != EEXIST) {
+			fprintf(stderr, "[error] Unable to create trace directory \"%s\".\n", name);
+			perror("Trace directory mkdir");
+			return -errno;
+		}
+		dirfd = openat(tout->dirfd, name, O_RDONLY);
+	} else {
+		dirfd = dup(tout->dirfd);
+	}
+	if (dirfd < 0) {
+		perror("Trace directory open");
+		return -errno;
+	}
+
+	ret = ctf_copy_metadata(tin, dirfd);
+	if (ret) {
+		fprintf(stderr, "[error] Unable to write metadata of trace \"%s\".\n",
+			tin->parent.path);
+		goto end;
+	}
+	for (i = 0; i < tin->streams->len; i++) {
+		struct ctf_stream_declaration *stream;
+
+		stream = g_ptr_array_index(tin->streams, i);
+		if (!stream)
+			continue;
+		for (j = 0; j < stream->streams->len; j++) {
+			struct ctf_file_stream *file_stream;
+
+			file_stream = container_of(g_ptr_array_index(stream->streams, j),
+					struct ctf_file_stream, parent);
+			ret = ctf_copy_stream(file_stream, td_write, dirfd,
+					begin, end);
+			if (ret)
+				goto end;
+		}
+	}
+end:
+	close(dirfd);
+	return ret;
+}
+
 static
 int ctf_convert_index_timestamp(struct bt_trace_descriptor *tdp)
 {
@@ -2486,6 +3457,23 @@ int ctf_close_file_stream(struct ctf_file_stream *file_stream)
 	int ret;
 
 	ret = ctf_fini_pos(&file_stream->pos);
+	stream_resources_remove(file_stream);
+	if (file_stream->event_rate_packets) {
+		g_array_free(file_stream->event_rate_packets, TRUE);
+		file_stream->event_rate_packets = NULL;
+	}
+	if (file_stream->event_rate_counts) {
+		g_array_free(file_stream->event_rate_counts, TRUE);
+		file_stream->event_rate_counts = NULL;
+	}
+	if (file_stream->packet_event_ids) {
+		g_array_free(file_stream->packet_event_ids, TRUE);
+		file_stream->packet_event_ids = NULL;
+	}
+	if (file_stream->event_filter) {
+		g_array_free(file_stream->event_filter, TRUE);
+		file_stream->event_filter = NULL;
+	}
 	if (ret) {
 		fprintf(stderr, "Error on ctf_fini_pos\n");
 		return -1;
@@ -2500,12 +3488,131 @@ int ctf_close_file_stream(struct ctf_file_stream *file_stream)
 	return 0;
 }
 
+static
+void free_stream_definitions(struct ctf_stream_definition *stream)
+{
+	int i;
+
+	for (i = 0; i < stream->events_by_id->len; i++) {
+		struct ctf_event_definition *event;
+
+		event = g_ptr_array_index(stream->events_by_id, i);
+		if (!event)
+			continue;
+		if (event->event_fields)
+			bt_definition_unref(&event->event_fields->p);
+		if (event->event_context)
+			bt_definition_unref(&event->event_context->p);
+		g_free(event);
+	}
+	g_ptr_array_free(stream->events_by_id, TRUE);
+	if (stream->stream_event_context)
+		bt_definition_unref(&stream->stream_event_context->p);
+	if (stream->stream_event_header)
+		bt_definition_unref(&stream->stream_event_header->p);
+	if (stream->stream_packet_context)
+		bt_definition_unref(&stream->stream_packet_context->p);
+	if (stream->trace_packet_header)
+		bt_definition_unref(&stream->trace_packet_header->p);
+}
+
+/*
+ * A cursor reads the file of a stream through its own file descriptor,
+ * packet mapping and definitions, and shares the packet index of the
+ * stream. Streams of memory-mapped (and live) traces have no file to
+ * reopen, and thus no cursor. Cursors are not bounded by the resource
+ * limits: their file is open for as long as their iterator.
+ */
+static
+struct ctf_stream_definition *ctf_open_stream_cursor(
+		struct ctf_stream_definition *stream)
+{
+	struct ctf_file_stream *file_stream, *cursor;
+	struct ctf_trace *td;
+	int ret, fd;
+
+	file_stream = container_of(stream, struct ctf_file_stream, parent);
+	if (stream->path[0] == '\0' || !file_stream->pos.packet_index)
+		return NULL;
+	td = container_of(file_stream->pos.parent.trace, struct ctf_trace,
+			parent);
+	fd = openat(td->dirfd, stream->path, O_RDONLY);
+	if (fd < 0) {
+		perror("File stream openat()");
+		return NULL;
+	}
+
+	cursor = g_new0(struct ctf_file_stream, 1);
+	cursor->origin = file_stream;
+	cursor->pos.last_offset = LAST_OFFSET_POISON;
+	cursor->pos.packet_seek = file_stream->pos.packet_seek;
+	strcpy(cursor->parent.path, stream->path);
+	cursor->parent.stream_id = stream->stream_id;
+	cursor->parent.stream_class = stream->stream_class;
+	cursor->parent.current_clock = stream->current_clock;
+
+	ret = ctf_init_pos(&cursor->pos, &td->parent, fd, O_RDONLY);
+	if (ret)
+		goto error_pos;
+	(void) g_array_free(cursor->pos.packet_index, TRUE);
+	cursor->pos.packet_index = g_array_ref(file_stream->pos.packet_index);
+	ret = ctf_compressed_open(fd, &cursor->pos.compressed);
+	if (ret)
+		goto error_pos;
+	ret = create_trace_definitions(td, &cursor->parent);
+	if (ret)
+		goto error_def;
+	ret = create_stream_definitions(td, &cursor->parent);
+	if (ret)
+		goto error_def;
+	return &cursor->parent;
+
+error_def:
+	if (cursor->parent.trace_packet_header)
+		bt_definition_unref(&cursor->parent.trace_packet_header->p);
+error_pos:
+	if (cursor->pos.packet_index == file_stream->pos.packet_index) {
+		g_array_unref(cursor->pos.packet_index);
+		cursor->pos.packet_index = NULL;
+	}
+	(void) ctf_fini_pos(&cursor->pos);
+	g_free(cursor);
+	if (close(fd))
+		perror("Error on fd close");
+	return NULL;
+}
+
+static
+int ctf_close_stream_cursor(struct ctf_stream_definition *stream)
+{
+	struct ctf_file_stream *cursor;
+	int ret;
+
+	cursor = container_of(stream, struct ctf_file_stream, parent);
+	free_stream_definitions(stream);
+	g_array_unref(cursor->pos.packet_index);
+	cursor->pos.packet_index = NULL;
+	ret = ctf_close_file_stream(cursor);
+	g_free(cursor);
+	return ret;
+}
+
 static
 int ctf_close_trace(struct bt_trace_descriptor *tdp)
 {
 	struct ctf_trace *td = container_of(tdp, struct ctf_trace, parent);
 	int ret;
 
+	if ((td->flags & O_ACCMODE) == O_RDWR) {
+		ret = close(td->dirfd);
+		if (ret) {
+			perror("Error closing dirfd");
+			return ret;
+		}
+		g_free(td);
+		return 0;
+	}
+
 	if (td->streams) {
 		int i;
 
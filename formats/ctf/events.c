@@ -237,6 +237,7 @@ int bt_ctf_get_field_list(const struct bt_ctf_event *ctf_event,
 		def_array = container_of(scope, const struct definition_array, p);
 		if (!def_array)
 			goto error;
+		bt_array_update_elems((struct definition_array *) def_array);
 		if (def_array->elems->pdata) {
 			*list = (struct bt_definition const* const*) def_array->elems->pdata;
 			*count = def_array->elems->len;
@@ -253,6 +254,7 @@ int bt_ctf_get_field_list(const struct bt_ctf_event *ctf_event,
 		def_sequence = container_of(scope, const struct definition_sequence, p);
 		if (!def_sequence)
 			goto error;
+		bt_sequence_update_elems((struct definition_sequence *) def_sequence);
 		if (def_sequence->elems->pdata) {
 			*list = (struct bt_definition const* const*) def_sequence->elems->pdata;
 			*count = (unsigned int) def_sequence->length->value._unsigned;
@@ -596,6 +598,22 @@ end:
 	return ret;
 }
 
+const void *bt_ctf_get_int_array(const struct bt_definition *field,
+		uint64_t *len, size_t *elem_len)
+{
+	const void *ret = NULL;
+
+	if (field && len && elem_len) {
+		ret = bt_get_int_array_values(field, len, elem_len);
+		if (ret)
+			goto end;
+	}
+	bt_ctf_field_set_error(-EINVAL);
+
+end:
+	return ret;
+}
+
 char *bt_ctf_get_string(const struct bt_definition *field)
 {
 	char *ret = NULL;
@@ -26,12 +26,13 @@
  * SOFTWARE.
  */
 
+#define _GNU_SOURCE
 #include <babeltrace/ctf-writer/event-fields.h>
 #include <babeltrace/ctf-ir/event-fields-internal.h>
 #include <babeltrace/ctf-ir/event-types-internal.h>
 #include <babeltrace/compiler.h>
-
-#define PACKET_LEN_INCREMENT	(getpagesize() * 8 * CHAR_BIT)
+#include <babeltrace/bitfield.h>
+#include <babeltrace/endian.h>
 
 static
 struct bt_ctf_field *bt_ctf_field_integer_create(struct bt_ctf_field_type *);
@@ -1768,6 +1769,138 @@ end:
 	return ret;
 }
 
+/*
+ * Store an integer at the current position, which must have been
+ * aligned and checked for space.
+ */
+static inline
+void integer_store(struct ctf_stream_pos *pos,
+		const struct declaration_integer *integer, uint64_t value)
+{
+	char *base;
+
+	/* Dummy positions have no mapping. */
+	if (pos->dummy) {
+		return;
+	}
+	base = mmap_align_addr(pos->base_mma) + pos->mmap_base_offset;
+	if (!(pos->offset % CHAR_BIT) && integer->byte_order == BYTE_ORDER) {
+		char *addr = base + pos->offset / CHAR_BIT;
+
+		switch (integer->len) {
+		case 8:
+		{
+			uint8_t v = value;
+
+			memcpy(addr, &v, sizeof(v));
+			return;
+		}
+		case 16:
+		{
+			uint16_t v = value;
+
+			memcpy(addr, &v, sizeof(v));
+			return;
+		}
+		case 32:
+		{
+			uint32_t v = value;
+
+			memcpy(addr, &v, sizeof(v));
+			return;
+		}
+		case 64:
+			memcpy(addr, &value, sizeof(value));
+			return;
+		default:
+			break;
+		}
+	}
+	if (integer->byte_order == LITTLE_ENDIAN) {
+		bt_bitfield_write_le(base, unsigned char, pos->offset,
+			integer->len, value);
+	} else {
+		bt_bitfield_write_be(base, unsigned char, pos->offset,
+			integer->len, value);
+	}
+}
+
+/*
+ * Serialize the members of a structure with the program of its type.
+ * The space taken by each run of consecutive integer members is
+ * computed and checked once, after which their values are stored
+ * directly. Other members are serialized through their type.
+ */
+static
+int structure_serialize_ops(struct bt_ctf_field_structure *structure,
+		GArray *ops, struct ctf_stream_pos *pos)
+{
+	struct structure_serialize_op *op;
+	struct bt_ctf_field *field;
+	int64_t offset;
+	guint i = 0, j;
+	int ret = 0;
+
+	while (i < ops->len) {
+		op = &g_array_index(ops, struct structure_serialize_op, i);
+		if (!op->integer) {
+			ret = bt_ctf_field_serialize(
+				g_ptr_array_index(structure->fields, op->index),
+				pos);
+			if (ret) {
+				goto end;
+			}
+			i++;
+			continue;
+		}
+
+		/* Space needed by the run of integers starting at i. */
+		offset = pos->offset;
+		for (j = i; j < ops->len; j++) {
+			op = &g_array_index(ops, struct structure_serialize_op,
+				j);
+			if (!op->integer) {
+				break;
+			}
+			offset += offset_align(offset,
+				op->integer->p.alignment);
+			offset += op->integer->len;
+		}
+		while (!ctf_pos_access_ok(pos, offset - pos->offset)) {
+			ret = increase_packet_size(pos);
+			if (ret) {
+				goto end;
+			}
+		}
+
+		for (; i < j; i++) {
+			struct bt_ctf_field_integer *integer;
+
+			op = &g_array_index(ops, struct structure_serialize_op,
+				i);
+			field = g_ptr_array_index(structure->fields, op->index);
+			if (field && op->enumeration) {
+				field = container_of(field,
+					struct bt_ctf_field_enumeration,
+					parent)->payload;
+			}
+			if (!field) {
+				ret = -1;
+				goto end;
+			}
+			integer = container_of(field,
+				struct bt_ctf_field_integer, parent);
+			pos->offset += offset_align(pos->offset,
+				op->integer->p.alignment);
+			integer_store(pos, op->integer,
+				integer->definition.value._unsigned);
+			pos->offset += op->integer->len;
+		}
+	}
+end:
+	return ret;
+}
+
 static
 int bt_ctf_field_structure_serialize(struct bt_ctf_field *field,
 		struct ctf_stream_pos *pos)
@@ -1776,6 +1909,8 @@ int bt_ctf_field_structure_serialize(struct bt_ctf_field *field,
 	int ret = 0;
 	struct bt_ctf_field_structure *structure = container_of(
 		field, struct bt_ctf_field_structure, parent);
+	struct bt_ctf_field_type_structure *structure_type = container_of(
+		field->type, struct bt_ctf_field_type_structure, parent);
 
 	while (!ctf_pos_access_ok(pos,
 		offset_align(pos->offset,
@@ -1791,6 +1926,12 @@ int bt_ctf_field_structure_serialize(struct bt_ctf_field *field,
 		goto end;
 	}
 
+	if (structure_type->serialize_ops) {
+		ret = structure_serialize_ops(structure,
+			structure_type->serialize_ops, pos);
+		goto end;
+	}
+
 	for (i = 0; i < structure->fields->len; i++) {
 		struct bt_ctf_field *field = g_ptr_array_index(
 			structure->fields, i);
@@ -2117,20 +2258,31 @@ static
 int increase_packet_size(struct ctf_stream_pos *pos)
 {
 	int ret;
+	uint64_t packet_size;
 
 	assert(pos);
-	ret = munmap_align(pos->base_mma);
+	/*
+	 * Grow the packet geometrically so that large events only cause
+	 * a logarithmic number of remaps.
+	 */
+	packet_size = pos->packet_size * 2;
+	ret = ctf_pos_reserve(pos, pos->mmap_offset + packet_size / CHAR_BIT);
 	if (ret) {
 		goto end;
 	}
 
-	pos->packet_size += PACKET_LEN_INCREMENT;
-	ret = posix_fallocate(pos->fd, pos->mmap_offset,
-		pos->packet_size / CHAR_BIT);
+#if defined(HAVE_MREMAP) && defined(MREMAP_MAYMOVE)
+	if (!mremap_align(pos->base_mma, packet_size / CHAR_BIT)) {
+		pos->packet_size = packet_size;
+		goto end;
+	}
+#endif
+	ret = munmap_align(pos->base_mma);
 	if (ret) {
 		goto end;
 	}
 
+	pos->packet_size = packet_size;
 	pos->base_mma = mmap_align(pos->packet_size / CHAR_BIT, pos->prot,
 		pos->flags, pos->fd, pos->mmap_offset);
 	if (pos->base_mma == MAP_FAILED) {
@@ -2355,6 +2355,9 @@ void bt_ctf_field_type_structure_destroy(struct bt_ctf_ref *ref)
 		struct bt_ctf_field_type_structure, parent);
 	g_ptr_array_free(structure->fields, TRUE);
 	g_hash_table_destroy(structure->field_name_to_index);
+	if (structure->serialize_ops) {
+		g_array_free(structure->serialize_ops, TRUE);
+	}
 	g_free(structure);
 }
 
@@ -2449,6 +2452,37 @@ void freeze_structure_field(struct structure_field *field)
 	bt_ctf_field_type_freeze(field->type);
 }
 
+static
+GArray *structure_build_serialize_ops(
+		struct bt_ctf_field_type_structure *structure_type)
+{
+	GArray *ops;
+	size_t i;
+
+	ops = g_array_sized_new(FALSE, TRUE,
+		sizeof(struct structure_serialize_op),
+		structure_type->fields->len);
+	for (i = 0; i < structure_type->fields->len; i++) {
+		struct structure_field *field = g_ptr_array_index(
+			structure_type->fields, i);
+		struct bt_ctf_field_type *type = field->type;
+		struct structure_serialize_op op = { .index = i };
+
+		if (type->declaration->id == CTF_TYPE_ENUM) {
+			type = container_of(type,
+				struct bt_ctf_field_type_enumeration,
+				parent)->container;
+			op.enumeration = 1;
+		}
+		if (type->declaration->id == CTF_TYPE_INTEGER) {
+			op.integer = container_of(type->declaration,
+				struct declaration_integer, p);
+		}
+		g_array_append_val(ops, op);
+	}
+	return ops;
+}
+
 static
 void bt_ctf_field_type_structure_freeze(struct bt_ctf_field_type *type)
 {
@@ -2460,6 +2494,10 @@ void bt_ctf_field_type_structure_freeze(struct bt_ctf_field_type *type)
 	generic_field_type_freeze(type);
 	g_ptr_array_foreach(structure_type->fields,
 		(GFunc) freeze_structure_field, NULL);
+	if (!structure_type->serialize_ops) {
+		structure_type->serialize_ops =
+			structure_build_serialize_ops(structure_type);
+	}
 }
 
 static
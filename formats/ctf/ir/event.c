@@ -44,6 +44,8 @@ void bt_ctf_event_class_destroy(struct bt_ctf_ref *ref);
 static
 void bt_ctf_event_destroy(struct bt_ctf_ref *ref);
 static
+void bt_ctf_field_handle_destroy(struct bt_ctf_ref *ref);
+static
 int set_integer_field_value(struct bt_ctf_field *field, uint64_t value);
 
 struct bt_ctf_event_class *bt_ctf_event_class_create(const char *name)
@@ -526,6 +528,91 @@ void bt_ctf_event_class_put(struct bt_ctf_event_class *event_class)
 	bt_ctf_ref_put(&event_class->ref_count, bt_ctf_event_class_destroy);
 }
 
+struct bt_ctf_field_handle *bt_ctf_event_class_get_field_handle(
+		struct bt_ctf_event_class *event_class, const char *path)
+{
+	struct bt_ctf_field_handle *handle = NULL;
+	struct bt_ctf_field_type *type;
+	gchar **names = NULL;
+	int i;
+
+	if (!event_class || !path) {
+		goto error;
+	}
+
+	names = g_strsplit(path, ".", 0);
+	if (!names[0]) {
+		goto error;
+	}
+
+	handle = g_new0(struct bt_ctf_field_handle, 1);
+	bt_ctf_ref_init(&handle->ref_count);
+	handle->indexes = g_array_new(FALSE, FALSE, sizeof(int));
+	if (!strcmp(names[0], "payload")) {
+		type = event_class->fields;
+	} else if (!strcmp(names[0], "context")) {
+		type = event_class->context;
+		handle->context = 1;
+	} else {
+		goto error;
+	}
+	if (!type) {
+		goto error;
+	}
+	bt_ctf_field_type_get(type);
+	handle->root_type = type;
+
+	/* Resolve each name to its index in the enclosing structure. */
+	for (i = 1; names[i]; i++) {
+		struct bt_ctf_field_type_structure *structure;
+		struct structure_field *field;
+		GQuark name_quark;
+		size_t index;
+		int field_index;
+
+		if (type->declaration->id != CTF_TYPE_STRUCT) {
+			goto error;
+		}
+		structure = container_of(type,
+			struct bt_ctf_field_type_structure, parent);
+		name_quark = g_quark_try_string(names[i]);
+		if (!name_quark || !g_hash_table_lookup_extended(
+			structure->field_name_to_index,
+			GUINT_TO_POINTER(name_quark), NULL,
+			(gpointer *) &index)) {
+			goto error;
+		}
+		field = g_ptr_array_index(structure->fields, index);
+		type = field->type;
+		field_index = index;
+		g_array_append_val(handle->indexes, field_index);
+	}
+	g_strfreev(names);
+	return handle;
+error:
+	g_strfreev(names);
+	bt_ctf_field_handle_put(handle);
+	return NULL;
+}
+
+void bt_ctf_field_handle_get(struct bt_ctf_field_handle *handle)
+{
+	if (!handle) {
+		return;
+	}
+
+	bt_ctf_ref_get(&handle->ref_count);
+}
+
+void bt_ctf_field_handle_put(struct bt_ctf_field_handle *handle)
+{
+	if (!handle) {
+		return;
+	}
+
+	bt_ctf_ref_put(&handle->ref_count, bt_ctf_field_handle_destroy);
+}
+
 BT_HIDDEN
 int bt_ctf_event_class_set_stream_id(struct bt_ctf_event_class *event_class,
 		uint32_t stream_id)
@@ -788,6 +875,116 @@ end:
 	return field;
 }
 
+struct bt_ctf_field *bt_ctf_event_get_field_by_handle(
+		struct bt_ctf_event *event, struct bt_ctf_field_handle *handle)
+{
+	struct bt_ctf_field *field = NULL;
+	guint i;
+
+	if (!event || !handle) {
+		goto end;
+	}
+
+	field = handle->context ? event->context_payload :
+		event->fields_payload;
+	/* The handle must have been resolved against this event's types. */
+	if (!field || field->type != handle->root_type) {
+		field = NULL;
+		goto end;
+	}
+
+	bt_ctf_field_get(field);
+	for (i = 0; i < handle->indexes->len; i++) {
+		struct bt_ctf_field *child;
+
+		child = bt_ctf_field_structure_get_field_by_index(field,
+			g_array_index(handle->indexes, int, i));
+		bt_ctf_field_put(field);
+		field = child;
+		if (!field) {
+			goto end;
+		}
+	}
+end:
+	return field;
+}
+
+int bt_ctf_event_set_unsigned_integer_by_handle(
+		struct bt_ctf_event *event, struct bt_ctf_field_handle *handle,
+		uint64_t value)
+{
+	int ret;
+	struct bt_ctf_field *field;
+
+	field = bt_ctf_event_get_field_by_handle(event, handle);
+	if (!field) {
+		ret = -1;
+		goto end;
+	}
+
+	ret = bt_ctf_field_unsigned_integer_set_value(field, value);
+	bt_ctf_field_put(field);
+end:
+	return ret;
+}
+
+int bt_ctf_event_set_signed_integer_by_handle(
+		struct bt_ctf_event *event, struct bt_ctf_field_handle *handle,
+		int64_t value)
+{
+	int ret;
+	struct bt_ctf_field *field;
+
+	field = bt_ctf_event_get_field_by_handle(event, handle);
+	if (!field) {
+		ret = -1;
+		goto end;
+	}
+
+	ret = bt_ctf_field_signed_integer_set_value(field, value);
+	bt_ctf_field_put(field);
+end:
+	return ret;
+}
+
+int bt_ctf_event_set_floating_point_by_handle(
+		struct bt_ctf_event *event, struct bt_ctf_field_handle *handle,
+		double value)
+{
+	int ret;
+	struct bt_ctf_field *field;
+
+	field = bt_ctf_event_get_field_by_handle(event, handle);
+	if (!field) {
+		ret = -1;
+		goto end;
+	}
+
+	ret = bt_ctf_field_floating_point_set_value(field, value);
+	bt_ctf_field_put(field);
+end:
+	return ret;
+}
+
+int bt_ctf_event_set_string_by_handle(
+		struct bt_ctf_event *event, struct bt_ctf_field_handle *handle,
+		const char *value)
+{
+	int ret;
+	struct bt_ctf_field *field;
+
+	field = bt_ctf_event_get_field_by_handle(event, handle);
+	if (!field) {
+		ret = -1;
+		goto end;
+	}
+
+	ret = bt_ctf_field_string_set_value(field, value);
+	bt_ctf_field_put(field);
+end:
+	return ret;
+}
+
 struct bt_ctf_field *bt_ctf_event_get_header(
 		struct bt_ctf_event *event)
 {
@@ -923,9 +1120,31 @@ void bt_ctf_event_class_destroy(struct bt_ctf_ref *ref)
 	if (event_class->fields) {
 		bt_ctf_field_type_put(event_class->fields);
 	}
+	if (event_class->metadata) {
+		g_string_free(event_class->metadata, TRUE);
+	}
 	g_free(event_class);
 }
 
+static
+void bt_ctf_field_handle_destroy(struct bt_ctf_ref *ref)
+{
+	struct bt_ctf_field_handle *handle;
+
+	if (!ref) {
+		return;
+	}
+
+	handle = container_of(ref, struct bt_ctf_field_handle, ref_count);
+	if (handle->root_type) {
+		bt_ctf_field_type_put(handle->root_type);
+	}
+	if (handle->indexes) {
+		g_array_free(handle->indexes, TRUE);
+	}
+	g_free(handle);
+}
+
 static
 void bt_ctf_event_destroy(struct bt_ctf_ref *ref)
 {
@@ -1042,11 +1261,20 @@ int bt_ctf_event_class_serialize(struct bt_ctf_event_class *event_class,
 	int i;
 	int count;
 	int ret = 0;
+	size_t begin;
 	struct bt_object *attr_value = NULL;
 
 	assert(event_class);
 	assert(context);
 
+	begin = context->string->len;
+	if (event_class->metadata) {
+		g_string_append_len(context->string,
+			event_class->metadata->str,
+			event_class->metadata->len);
+		goto end;
+	}
+
 	context->current_indentation_level = 1;
 	g_string_assign(context->field_name, "");
 	g_string_append(context->string, "event {\n");
@@ -1130,6 +1358,11 @@ int bt_ctf_event_class_serialize(struct bt_ctf_event_class *event_class,
 	}
 
 	g_string_append(context->string, "};\n\n");
+	if (event_class->frozen) {
+		event_class->metadata = g_string_new_len(
+			context->string->str + begin,
+			context->string->len - begin);
+	}
 end:
 	context->current_indentation_level = 0;
 	BT_OBJECT_PUT(attr_value);
@@ -1148,6 +1381,10 @@ void bt_ctf_event_class_set_native_byte_order(
 		byte_order);
 	bt_ctf_field_type_set_native_byte_order(event_class->fields,
 		byte_order);
+	if (event_class->metadata) {
+		g_string_free(event_class->metadata, TRUE);
+		event_class->metadata = NULL;
+	}
 }
 
 BT_HIDDEN
@@ -1199,6 +1436,67 @@ end:
 	return ret;
 }
 
+/*
+ * A compact event header is populated in its extended form, which always
+ * holds the event's id and timestamp. The stream switches it to the
+ * compact form when writing the packet, once the previous event is known.
+ */
+static
+int populate_compact_event_header(struct bt_ctf_event *event)
+{
+	int ret = 0;
+	struct bt_ctf_field *id_field = NULL, *id_container = NULL;
+	struct bt_ctf_field *variant = NULL, *extended = NULL;
+	struct bt_ctf_field *extended_id = NULL, *timestamp_field = NULL;
+	struct bt_ctf_clock *clock = event->event_class->stream_class->clock;
+
+	id_field = bt_ctf_field_structure_get_field(event->event_header, "id");
+	variant = bt_ctf_field_structure_get_field(event->event_header, "v");
+	id_container = bt_ctf_field_enumeration_get_container(id_field);
+	if (!variant || !id_container) {
+		ret = -1;
+		goto end;
+	}
+
+	ret = bt_ctf_field_unsigned_integer_set_value(id_container,
+		COMPACT_EVENT_HEADER_EXTENDED_ID);
+	if (ret) {
+		goto end;
+	}
+
+	extended = bt_ctf_field_variant_get_field(variant, id_field);
+	extended_id = bt_ctf_field_structure_get_field(extended, "id");
+	timestamp_field = bt_ctf_field_structure_get_field(extended,
+		"timestamp");
+	if (!extended_id || !timestamp_field) {
+		ret = -1;
+		goto end;
+	}
+
+	ret = bt_ctf_field_unsigned_integer_set_value(extended_id,
+		(uint64_t) bt_ctf_event_class_get_id(event->event_class));
+	if (ret) {
+		goto end;
+	}
+
+	if (clock) {
+		uint64_t timestamp = bt_ctf_clock_get_time(clock);
+
+		if (timestamp != (uint64_t) -1ULL) {
+			ret = bt_ctf_field_unsigned_integer_set_value(
+				timestamp_field, timestamp);
+		}
+	}
+end:
+	bt_ctf_field_put(id_field);
+	bt_ctf_field_put(id_container);
+	bt_ctf_field_put(variant);
+	bt_ctf_field_put(extended);
+	bt_ctf_field_put(extended_id);
+	bt_ctf_field_put(timestamp_field);
+	return ret;
+}
+
 BT_HIDDEN
 int bt_ctf_event_populate_event_header(struct bt_ctf_event *event)
 {
@@ -1210,6 +1508,12 @@ int bt_ctf_event_populate_event_header(struct bt_ctf_event *event)
 		goto end;
 	}
 
+	if (event->event_class->stream_class &&
+		event->event_class->stream_class->compact_event_header) {
+		ret = populate_compact_event_header(event);
+		goto end;
+	}
+
 	id_field = bt_ctf_field_structure_get_field(event->event_header, "id");
 	if (id_field) {
 		ret = set_integer_field_value(id_field,
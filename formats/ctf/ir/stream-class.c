@@ -45,6 +45,8 @@ void bt_ctf_stream_class_destroy(struct bt_ctf_ref *ref);
 static
 int init_event_header(struct bt_ctf_stream_class *stream_class);
 static
+int init_compact_event_header(struct bt_ctf_stream_class *stream_class);
+static
 int init_packet_context(struct bt_ctf_stream_class *stream_class);
 
 struct bt_ctf_stream_class *bt_ctf_stream_class_create(const char *name)
@@ -134,6 +136,37 @@ end:
 	return ret;
 }
 
+int64_t bt_ctf_stream_class_get_packet_size(
+		struct bt_ctf_stream_class *stream_class)
+{
+	int64_t ret;
+
+	if (!stream_class) {
+		ret = -1;
+		goto end;
+	}
+
+	ret = (int64_t) stream_class->packet_size;
+end:
+	return ret;
+}
+
+int bt_ctf_stream_class_set_packet_size(
+		struct bt_ctf_stream_class *stream_class, uint64_t packet_size)
+{
+	int ret = 0;
+
+	if (!stream_class || packet_size % getpagesize() ||
+		packet_size > INT64_MAX / CHAR_BIT) {
+		ret = -1;
+		goto end;
+	}
+
+	stream_class->packet_size = packet_size;
+end:
+	return ret;
+}
+
 struct bt_ctf_clock *bt_ctf_stream_class_get_clock(
 		struct bt_ctf_stream_class *stream_class)
 {
@@ -149,6 +182,58 @@ end:
 	return clock;
 }
 
+/*
+ * Map a clock to the timestamps of both forms of a compact event header,
+ * unless they are already mapped.
+ */
+static
+int map_compact_event_header_clock(struct bt_ctf_field_type *event_header_type,
+		struct bt_ctf_clock *clock)
+{
+	int ret = 0, i;
+	struct bt_ctf_field_type *variant_type = NULL;
+	static const char *names[] = { "compact", "extended" };
+
+	variant_type = bt_ctf_field_type_structure_get_field_type_by_name(
+		event_header_type, "v");
+	if (!variant_type) {
+		ret = -1;
+		goto end;
+	}
+
+	for (i = 0; i < 2; i++) {
+		struct bt_ctf_field_type *header_type, *timestamp_type;
+		struct bt_ctf_clock *mapped_clock;
+
+		header_type = bt_ctf_field_type_variant_get_field_type_by_name(
+			variant_type, names[i]);
+		timestamp_type = header_type ?
+			bt_ctf_field_type_structure_get_field_type_by_name(
+				header_type, "timestamp") : NULL;
+		bt_ctf_field_type_put(header_type);
+		if (!timestamp_type) {
+			ret = -1;
+			goto end;
+		}
+
+		mapped_clock = bt_ctf_field_type_integer_get_mapped_clock(
+			timestamp_type);
+		if (mapped_clock) {
+			bt_ctf_clock_put(mapped_clock);
+		} else {
+			ret = bt_ctf_field_type_integer_set_mapped_clock(
+				timestamp_type, clock);
+		}
+		bt_ctf_field_type_put(timestamp_type);
+		if (ret) {
+			goto end;
+		}
+	}
+end:
+	bt_ctf_field_type_put(variant_type);
+	return ret;
+}
+
 int bt_ctf_stream_class_set_clock(struct bt_ctf_stream_class *stream_class,
 		struct bt_ctf_clock *clock)
 {
@@ -184,6 +269,14 @@ int bt_ctf_stream_class_set_clock(struct bt_ctf_stream_class *stream_class,
 		}
 	}
 
+	if (stream_class->compact_event_header) {
+		ret = map_compact_event_header_clock(
+			stream_class->event_header_type, clock);
+		if (ret) {
+			goto end;
+		}
+	}
+
 	if (stream_class->clock) {
 		bt_ctf_clock_put(stream_class->clock);
 	}
@@ -561,6 +654,49 @@ int bt_ctf_stream_class_set_event_header_type(
 	bt_ctf_field_type_put(stream_class->event_header_type);
 	bt_ctf_field_type_get(event_header_type);
 	stream_class->event_header_type = event_header_type;
+	stream_class->compact_event_header = 0;
+end:
+	return ret;
+}
+
+int bt_ctf_stream_class_set_compact_event_header(
+		struct bt_ctf_stream_class *stream_class, int compact)
+{
+	int ret = 0;
+
+	if (!stream_class || stream_class->frozen) {
+		ret = -1;
+		goto end;
+	}
+
+	compact = !!compact;
+	if (compact == stream_class->compact_event_header) {
+		goto end;
+	}
+
+	ret = compact ? init_compact_event_header(stream_class) :
+		init_event_header(stream_class);
+	if (ret) {
+		goto end;
+	}
+
+	stream_class->compact_event_header = compact;
+	if (!stream_class->clock) {
+		goto end;
+	}
+
+	if (compact) {
+		ret = map_compact_event_header_clock(
+			stream_class->event_header_type, stream_class->clock);
+	} else {
+		struct bt_ctf_field_type *timestamp_type =
+			bt_ctf_field_type_structure_get_field_type_by_name(
+				stream_class->event_header_type, "timestamp");
+
+		ret = bt_ctf_field_type_integer_set_mapped_clock(
+			timestamp_type, stream_class->clock);
+		bt_ctf_field_type_put(timestamp_type);
+	}
 end:
 	return ret;
 }
@@ -666,6 +802,10 @@ int bt_ctf_stream_class_set_byte_order(struct bt_ctf_stream_class *stream_class,
 	}
 
 	stream_class->byte_order = internal_byte_order;
+	if (stream_class->metadata) {
+		g_string_free(stream_class->metadata, TRUE);
+		stream_class->metadata = NULL;
+	}
 
 	/* Set native byte order to little or big endian */
 	bt_ctf_field_type_set_native_byte_order(
@@ -687,17 +827,17 @@ end:
 	return ret;
 }
 
-BT_HIDDEN
-int bt_ctf_stream_class_serialize(struct bt_ctf_stream_class *stream_class,
+static
+int serialize_stream_declaration(struct bt_ctf_stream_class *stream_class,
 		struct metadata_context *context)
 {
-	int64_t ret = 0;
-	size_t i;
+	int ret = 0;
+	size_t begin = context->string->len;
 
-	g_string_assign(context->field_name, "");
-	context->current_indentation_level = 1;
-	if (!stream_class->id_set) {
-		ret = -1;
+	if (stream_class->metadata) {
+		g_string_append_len(context->string,
+			stream_class->metadata->str,
+			stream_class->metadata->len);
 		goto end;
 	}
 
@@ -727,10 +867,45 @@ int bt_ctf_stream_class_serialize(struct bt_ctf_stream_class *stream_class,
 	}
 
 	g_string_append(context->string, ";\n};\n\n");
+	if (stream_class->frozen) {
+		stream_class->metadata = g_string_new_len(
+			context->string->str + begin,
+			context->string->len - begin);
+	}
+end:
+	return ret;
+}
+
+BT_HIDDEN
+int bt_ctf_stream_class_serialize(struct bt_ctf_stream_class *stream_class,
+		struct metadata_context *context)
+{
+	int64_t ret = 0;
+	size_t i;
+
+	g_string_assign(context->field_name, "");
+	context->current_indentation_level = 1;
+	if (!stream_class->id_set) {
+		ret = -1;
+		goto end;
+	}
+
+	if (!metadata_context_emitted(context, stream_class,
+			stream_class->frozen)) {
+		ret = serialize_stream_declaration(stream_class, context);
+		if (ret) {
+			goto end;
+		}
+	}
+
 	for (i = 0; i < stream_class->event_classes->len; i++) {
 		struct bt_ctf_event_class *event_class =
 			stream_class->event_classes->pdata[i];
 
+		if (metadata_context_emitted(context, event_class,
+				event_class->frozen)) {
+			continue;
+		}
 		ret = bt_ctf_event_class_serialize(event_class, context);
 		if (ret) {
 			goto end;
@@ -799,6 +974,9 @@ void bt_ctf_stream_class_destroy(struct bt_ctf_ref *ref)
 	if (stream_class->event_context_type) {
 		bt_ctf_field_type_put(stream_class->event_context_type);
 	}
+	if (stream_class->metadata) {
+		g_string_free(stream_class->metadata, TRUE);
+	}
 	g_free(stream_class);
 }
 
@@ -844,6 +1022,129 @@ end:
 	return ret;
 }
 
+/*
+ * Create the compact event header type:
+ *
+ * struct {
+ *	enum : uint5_t { compact = 0 ... 30, extended = 31 } id;
+ *	variant <id> {
+ *		struct { uint27_t timestamp; } compact;
+ *		struct { uint32_t id; uint64_t timestamp; } extended;
+ *	} v;
+ * };
+ */
+static
+int init_compact_event_header(struct bt_ctf_stream_class *stream_class)
+{
+	int ret = 0;
+	struct bt_ctf_field_type *event_header_type =
+		bt_ctf_field_type_structure_create();
+	struct bt_ctf_field_type *compact_type =
+		bt_ctf_field_type_structure_create();
+	struct bt_ctf_field_type *extended_type =
+		bt_ctf_field_type_structure_create();
+	struct bt_ctf_field_type *id_container_type =
+		bt_ctf_field_type_integer_create(COMPACT_EVENT_HEADER_ID_LEN);
+	struct bt_ctf_field_type *compact_timestamp_type =
+		bt_ctf_field_type_integer_create(
+			COMPACT_EVENT_HEADER_TIMESTAMP_LEN);
+	struct bt_ctf_field_type *_uint32_t =
+		get_field_type(FIELD_TYPE_ALIAS_UINT32_T);
+	struct bt_ctf_field_type *_uint64_t =
+		get_field_type(FIELD_TYPE_ALIAS_UINT64_T);
+	struct bt_ctf_field_type *id_type = NULL, *variant_type = NULL;
+
+	if (!event_header_type || !compact_type || !extended_type ||
+		!id_container_type || !compact_timestamp_type) {
+		ret = -1;
+		goto end;
+	}
+
+	id_type = bt_ctf_field_type_enumeration_create(id_container_type);
+	if (!id_type) {
+		ret = -1;
+		goto end;
+	}
+
+	ret = bt_ctf_field_type_enumeration_add_mapping_unsigned(id_type,
+		"compact", 0, COMPACT_EVENT_HEADER_EXTENDED_ID - 1);
+	if (ret) {
+		goto end;
+	}
+
+	ret = bt_ctf_field_type_enumeration_add_mapping_unsigned(id_type,
+		"extended", COMPACT_EVENT_HEADER_EXTENDED_ID,
+		COMPACT_EVENT_HEADER_EXTENDED_ID);
+	if (ret) {
+		goto end;
+	}
+
+	ret = bt_ctf_field_type_structure_add_field(compact_type,
+		compact_timestamp_type, "timestamp");
+	if (ret) {
+		goto end;
+	}
+
+	ret = bt_ctf_field_type_structure_add_field(extended_type,
+		_uint32_t, "id");
+	if (ret) {
+		goto end;
+	}
+
+	ret = bt_ctf_field_type_structure_add_field(extended_type,
+		_uint64_t, "timestamp");
+	if (ret) {
+		goto end;
+	}
+
+	variant_type = bt_ctf_field_type_variant_create(id_type, "id");
+	if (!variant_type) {
+		ret = -1;
+		goto end;
+	}
+
+	ret = bt_ctf_field_type_variant_add_field(variant_type, compact_type,
+		"compact");
+	if (ret) {
+		goto end;
+	}
+
+	ret = bt_ctf_field_type_variant_add_field(variant_type, extended_type,
+		"extended");
+	if (ret) {
+		goto end;
+	}
+
+	ret = bt_ctf_field_type_structure_add_field(event_header_type,
+		id_type, "id");
+	if (ret) {
+		goto end;
+	}
+
+	ret = bt_ctf_field_type_structure_add_field(event_header_type,
+		variant_type, "v");
+	if (ret) {
+		goto end;
+	}
+
+	if (stream_class->event_header_type) {
+		bt_ctf_field_type_put(stream_class->event_header_type);
+	}
+	stream_class->event_header_type = event_header_type;
+	event_header_type = NULL;
+end:
+	bt_ctf_field_type_put(event_header_type);
+	bt_ctf_field_type_put(compact_type);
+	bt_ctf_field_type_put(extended_type);
+	bt_ctf_field_type_put(id_container_type);
+	bt_ctf_field_type_put(compact_timestamp_type);
+	bt_ctf_field_type_put(id_type);
+	bt_ctf_field_type_put(variant_type);
+	bt_ctf_field_type_put(_uint32_t);
+	bt_ctf_field_type_put(_uint64_t);
+	return ret;
+}
+
 static
 int init_packet_context(struct bt_ctf_stream_class *stream_class)
 {
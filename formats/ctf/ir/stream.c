@@ -36,9 +36,13 @@
 #include <babeltrace/ctf-ir/stream-internal.h>
 #include <babeltrace/ctf-ir/stream-class-internal.h>
 #include <babeltrace/ctf-writer/functor-internal.h>
+#include <babeltrace/ctf-writer/flush-queue-internal.h>
 #include <babeltrace/compiler.h>
 #include <babeltrace/align.h>
 #include <babeltrace/ctf/ctf-index.h>
+#include <babeltrace/ctf/ctf-compressed.h>
+#include <babeltrace/endian.h>
+#include <sched.h>
 
 static
 void bt_ctf_stream_destroy(struct bt_ctf_ref *ref);
@@ -300,6 +304,7 @@ struct bt_ctf_stream *bt_ctf_stream_create(
 	}
 
 	stream->pos.fd = -1;
+	stream->index_fd = -1;
 	stream->id = stream_class->next_stream_id++;
 	stream->stream_class = stream_class;
 	bt_ctf_stream_class_get(stream_class);
@@ -341,6 +346,19 @@ error_destroy:
 	return NULL;
 }
 
+BT_HIDDEN
+void bt_ctf_stream_set_flush_queue(struct bt_ctf_stream *stream,
+		struct bt_ctf_flush_queue *queue)
+{
+	if (queue) {
+		bt_ctf_flush_queue_get(queue);
+	}
+	if (stream->flush_queue) {
+		bt_ctf_flush_queue_put(stream->flush_queue);
+	}
+	stream->flush_queue = queue;
+}
+
 BT_HIDDEN
 int bt_ctf_stream_set_fd(struct bt_ctf_stream *stream, int fd)
 {
@@ -353,6 +371,52 @@ int bt_ctf_stream_set_fd(struct bt_ctf_stream *stream, int fd)
 
 	ctf_init_pos(&stream->pos, NULL, fd, O_RDWR);
 	stream->pos.fd = fd;
+	stream->pos.write_packet_size =
+		stream->stream_class->packet_size * CHAR_BIT;
+end:
+	return ret;
+}
+
+BT_HIDDEN
+int bt_ctf_stream_set_index_fd(struct bt_ctf_stream *stream, int fd)
+{
+	int ret = 0;
+	struct ctf_packet_index_file_hdr header;
+
+	if (stream->index_fd != -1) {
+		ret = -1;
+		goto end;
+	}
+
+	header.magic = htobe32(CTF_INDEX_MAGIC);
+	header.index_major = htobe32(CTF_INDEX_MAJOR);
+	header.index_minor = htobe32(CTF_INDEX_MINOR);
+	header.packet_index_len = htobe32(sizeof(struct ctf_packet_index));
+	if (write(fd, &header, sizeof(header)) != sizeof(header)) {
+		perror("write");
+		ret = -1;
+		goto end;
+	}
+	stream->index_fd = fd;
+end:
+	return ret;
+}
+
+BT_HIDDEN
+int bt_ctf_stream_set_compressed_fd(struct bt_ctf_stream *stream, int fd)
+{
+	int ret = 0;
+
+	if (stream->compressed) {
+		ret = -1;
+		goto end;
+	}
+
+	stream->compressed = ctf_compressed_create(fd);
+	if (!stream->compressed) {
+		ret = -1;
+		goto end;
+	}
 end:
 	return ret;
 }
@@ -372,21 +436,16 @@ end:
 	return stream_class;
 }
 
-int bt_ctf_stream_get_discarded_events_count(
-		struct bt_ctf_stream *stream, uint64_t *count)
+static
+int get_events_discarded(struct bt_ctf_field *packet_context, uint64_t *count)
 {
 	int64_t ret = 0;
 	int field_signed;
 	struct bt_ctf_field *events_discarded_field = NULL;
 	struct bt_ctf_field_type *events_discarded_field_type = NULL;
 
-	if (!stream || !count || !stream->packet_context) {
-		ret = -1;
-		goto end;
-	}
-
 	events_discarded_field = bt_ctf_field_structure_get_field(
-		stream->packet_context, "events_discarded");
+		packet_context, "events_discarded");
 	if (!events_discarded_field) {
 		ret = -1;
 		goto end;
@@ -437,6 +496,16 @@ end:
 	return ret;
 }
 
+int bt_ctf_stream_get_discarded_events_count(
+		struct bt_ctf_stream *stream, uint64_t *count)
+{
+	if (!stream || !count || !stream->packet_context) {
+		return -1;
+	}
+
+	return get_events_discarded(stream->packet_context, count);
+}
+
 void bt_ctf_stream_append_discarded_events(struct bt_ctf_stream *stream,
 		uint64_t event_count)
 {
@@ -499,6 +568,176 @@ end:
 	}
 }
 
+int bt_ctf_stream_set_concurrent(struct bt_ctf_stream *stream,
+		int concurrent)
+{
+	int ret = 0;
+	size_t i;
+	struct bt_ctf_stream_class *stream_class;
+
+	if (!stream) {
+		ret = -1;
+		goto end;
+	}
+
+	/* Events already appended must be flushed first */
+	if (stream->events->len ||
+		__sync_fetch_and_add(&stream->reserved_seq, 0) !=
+		stream->collected_seq) {
+		ret = -1;
+		goto end;
+	}
+
+	/*
+	 * Freeze the classes now rather than on the first event created by
+	 * each producer, since freezing a class is not thread-safe.
+	 */
+	stream_class = stream->stream_class;
+	bt_ctf_stream_class_freeze(stream_class);
+	for (i = 0; i < stream_class->event_classes->len; i++) {
+		bt_ctf_event_class_freeze(
+			g_ptr_array_index(stream_class->event_classes, i));
+	}
+	stream->concurrent = !!concurrent;
+end:
+	return ret;
+}
+
+static
+void push_append_nodes(struct bt_ctf_stream *stream,
+		struct bt_ctf_stream_append_node *first,
+		struct bt_ctf_stream_append_node *last)
+{
+	struct bt_ctf_stream_append_node *head;
+
+	do {
+		head = stream->append_head;
+		last->next = head;
+	} while (!__sync_bool_compare_and_swap(&stream->append_head, head,
+		first));
+}
+
+static
+int append_event_concurrent(struct bt_ctf_stream *stream,
+		struct bt_ctf_event *event)
+{
+	int ret = 0;
+	uint64_t seq;
+	struct bt_ctf_stream_append_node *node;
+
+	/*
+	 * Reserve a sequence number. The clock is sampled after reading
+	 * the next free sequence number and before claiming it: an event
+	 * reserved later read that number after our claim, and therefore
+	 * sampled the clock after we did.
+	 */
+	do {
+		seq = __sync_fetch_and_add(&stream->reserved_seq, 0);
+		ret = bt_ctf_event_populate_event_header(event);
+		if (ret) {
+			/* Nothing reserved yet */
+			goto end;
+		}
+	} while (!__sync_bool_compare_and_swap(&stream->reserved_seq, seq,
+		seq + 1));
+
+	node = g_new0(struct bt_ctf_stream_append_node, 1);
+	node->seq = seq;
+
+	/* Make sure the event's payload is set */
+	ret = bt_ctf_event_validate(event);
+	if (ret) {
+		goto commit;
+	}
+
+	if (stream->event_context) {
+		ret = bt_ctf_field_validate(stream->event_context);
+		if (ret) {
+			goto commit;
+		}
+
+		node->event_context = bt_ctf_field_copy(stream->event_context);
+		if (!node->event_context) {
+			ret = -1;
+			goto commit;
+		}
+	}
+
+	bt_ctf_event_get(event);
+	node->event = event;
+commit:
+	/*
+	 * A failed append is still committed, without its event, so that
+	 * flush does not wait for its sequence number.
+	 */
+	push_append_nodes(stream, node, node);
+end:
+	return ret;
+}
+
+/*
+ * Move the events reserved so far to the stream's current packet, in
+ * sequence order. Appends still in progress are waited for; events
+ * reserved after the start of the collection are left for the next one.
+ */
+static
+void collect_concurrent_events(struct bt_ctf_stream *stream)
+{
+	uint64_t begin_seq, end_seq, nr_events, nr_collected = 0, i;
+	struct bt_ctf_stream_append_node **nodes;
+	struct bt_ctf_stream_append_node *node, *next;
+	struct bt_ctf_stream_append_node *later = NULL, *later_last = NULL;
+
+	begin_seq = stream->collected_seq;
+	end_seq = __sync_fetch_and_add(&stream->reserved_seq, 0);
+	nr_events = end_seq - begin_seq;
+	if (!nr_events) {
+		return;
+	}
+
+	nodes = g_new0(struct bt_ctf_stream_append_node *, nr_events);
+	while (nr_collected < nr_events) {
+		node = __sync_lock_test_and_set(&stream->append_head, NULL);
+		if (!node) {
+			/* Wait for the appends in progress to commit */
+			sched_yield();
+			continue;
+		}
+
+		for (; node; node = next) {
+			next = node->next;
+			if (node->seq < end_seq) {
+				nodes[node->seq - begin_seq] = node;
+				nr_collected++;
+			} else {
+				node->next = later;
+				if (!later) {
+					later_last = node;
+				}
+				later = node;
+			}
+		}
+	}
+
+	if (later) {
+		push_append_nodes(stream, later, later_last);
+	}
+
+	for (i = 0; i < nr_events; i++) {
+		node = nodes[i];
+		if (node->event) {
+			g_ptr_array_add(stream->events, node->event);
+			if (node->event_context) {
+				g_ptr_array_add(stream->event_contexts,
+					node->event_context);
+			}
+		}
+		g_free(node);
+	}
+	g_free(nodes);
+	stream->collected_seq = end_seq;
+}
+
 int bt_ctf_stream_append_event(struct bt_ctf_stream *stream,
 		struct bt_ctf_event *event)
 {
@@ -517,6 +756,11 @@ int bt_ctf_stream_append_event(struct bt_ctf_stream *stream,
 		goto end;
 	}
 
+	if (stream->concurrent) {
+		ret = append_event_concurrent(stream, event);
+		goto end;
+	}
+
 	ret = bt_ctf_event_populate_event_header(event);
 	if (ret) {
 		goto end;
@@ -687,88 +931,271 @@ end:
 }
 
 static
-int get_event_header_timestamp(struct bt_ctf_field *event_header, uint64_t *timestamp)
+int get_structure_field_integer(struct bt_ctf_field *structure,
+		const char *name, uint64_t *value)
 {
 	int ret = 0;
-	struct bt_ctf_field *timestamp_field = NULL;
-	struct bt_ctf_field_type *timestamp_field_type = NULL;
+	struct bt_ctf_field *field = NULL;
+	struct bt_ctf_field_type *field_type = NULL;
 
-	timestamp_field = bt_ctf_field_structure_get_field(event_header,
-		"timestamp");
-	if (!timestamp_field) {
+	field = bt_ctf_field_structure_get_field(structure, name);
+	if (!field) {
 		ret = -1;
 		goto end;
 	}
 
-	timestamp_field_type = bt_ctf_field_get_type(timestamp_field);
-	assert(timestamp_field_type);
-	if (bt_ctf_field_type_get_type_id(timestamp_field_type) !=
+	field_type = bt_ctf_field_get_type(field);
+	assert(field_type);
+	if (bt_ctf_field_type_get_type_id(field_type) !=
 		CTF_TYPE_INTEGER) {
 		ret = -1;
 		goto end;
 	}
 
-	if (bt_ctf_field_type_integer_get_signed(timestamp_field_type)) {
+	if (bt_ctf_field_type_integer_get_signed(field_type)) {
 		int64_t val;
 
-		ret = bt_ctf_field_signed_integer_get_value(timestamp_field,
+		ret = bt_ctf_field_signed_integer_get_value(field,
 			&val);
 		if (ret) {
 			goto end;
 		}
-		*timestamp = (uint64_t) val;
+		*value = (uint64_t) val;
 	} else {
-		ret = bt_ctf_field_unsigned_integer_get_value(timestamp_field,
-			timestamp);
+		ret = bt_ctf_field_unsigned_integer_get_value(field,
+			value);
 		if (ret) {
 			goto end;
 		}
 	}
 end:
+	bt_ctf_field_put(field);
+	bt_ctf_field_type_put(field_type);
+	return ret;
+}
+
+/*
+ * Get the timestamp of an event header, from its extended form "v" when
+ * it is a compact event header.
+ */
+static
+int get_event_header_timestamp(struct bt_ctf_field *event_header,
+		uint64_t *timestamp)
+{
+	int ret;
+	struct bt_ctf_field *variant = NULL, *extended = NULL;
+
+	ret = get_structure_field_integer(event_header, "timestamp",
+		timestamp);
+	if (!ret) {
+		goto end;
+	}
+
+	variant = bt_ctf_field_structure_get_field(event_header, "v");
+	extended = bt_ctf_field_variant_get_current_field(variant);
+	if (!extended) {
+		ret = -1;
+		goto end;
+	}
+	ret = get_structure_field_integer(extended, "timestamp", timestamp);
+end:
+	bt_ctf_field_put(variant);
+	bt_ctf_field_put(extended);
+	return ret;
+}
+
+/*
+ * Unset the packet context's fields, keeping the number of discarded
+ * events which carries over to the next packet.
+ */
+static
+int reset_packet_context(struct bt_ctf_field *packet_context)
+{
+	int ret;
+	uint64_t events_discarded;
+
+	ret = get_events_discarded(packet_context, &events_discarded);
+	if (ret) {
+		goto end;
+	}
+
+	ret = bt_ctf_field_reset(packet_context);
+	if (ret) {
+		goto end;
+	}
+
+	/* Set the previous number of discarded events. */
+	ret = set_structure_field_integer(packet_context,
+		"events_discarded", events_discarded);
+end:
+	return ret;
+}
+
+/*
+ * Switch a compact event header from its extended form, set on append, to
+ * its compact form when readers can recover the event's id and timestamp
+ * from it: the id must be lower than the extended id, and the timestamp
+ * must follow the previous one of the packet by less than 2^27 cycles.
+ */
+static
+int compact_event_header(struct bt_ctf_field *event_header,
+		uint64_t *last_timestamp)
+{
+	int ret = 0;
+	uint64_t id, timestamp;
+	struct bt_ctf_field *id_field = NULL, *id_container = NULL;
+	struct bt_ctf_field *variant = NULL, *extended = NULL;
+	struct bt_ctf_field *compact = NULL, *timestamp_field = NULL;
+
+	id_field = bt_ctf_field_structure_get_field(event_header, "id");
+	variant = bt_ctf_field_structure_get_field(event_header, "v");
+	extended = bt_ctf_field_variant_get_current_field(variant);
+	if (!id_field || !extended) {
+		ret = -1;
+		goto end;
+	}
+
+	if (get_structure_field_integer(extended, "id", &id) ||
+		get_structure_field_integer(extended, "timestamp",
+			&timestamp)) {
+		/* No timestamp to compact */
+		goto end;
+	}
+
+	if (id >= COMPACT_EVENT_HEADER_EXTENDED_ID ||
+		timestamp < *last_timestamp ||
+		timestamp - *last_timestamp >=
+			(1ULL << COMPACT_EVENT_HEADER_TIMESTAMP_LEN)) {
+		goto update;
+	}
+
+	id_container = bt_ctf_field_enumeration_get_container(id_field);
+	ret = bt_ctf_field_unsigned_integer_set_value(id_container, id);
+	if (ret) {
+		goto end;
+	}
+
+	compact = bt_ctf_field_variant_get_field(variant, id_field);
+	timestamp_field = bt_ctf_field_structure_get_field(compact,
+		"timestamp");
+	ret = bt_ctf_field_unsigned_integer_set_value(timestamp_field,
+		timestamp & ((1ULL << COMPACT_EVENT_HEADER_TIMESTAMP_LEN) - 1));
+	if (ret) {
+		goto end;
+	}
+update:
+	*last_timestamp = timestamp;
+end:
+	bt_ctf_field_put(id_field);
+	bt_ctf_field_put(id_container);
+	bt_ctf_field_put(variant);
+	bt_ctf_field_put(extended);
+	bt_ctf_field_put(compact);
 	bt_ctf_field_put(timestamp_field);
-	bt_ctf_field_type_put(timestamp_field_type);
 	return ret;
 }
 
-int bt_ctf_stream_flush(struct bt_ctf_stream *stream)
+/*
+ * Append the index entry of the packet just written at "offset". "cpu_id"
+ * is -1ULL if the packet context has none.
+ */
+static
+int write_packet_index(struct bt_ctf_stream *stream, off_t offset,
+		struct bt_ctf_field *packet_context,
+		uint64_t timestamp_begin, uint64_t timestamp_end,
+		uint64_t cpu_id)
 {
 	int ret = 0;
-	size_t i;
-	uint64_t timestamp_begin, timestamp_end, events_discarded;
-	struct bt_ctf_field *integer = NULL;
-	struct ctf_stream_pos packet_context_pos;
+	uint64_t events_discarded = 0;
+	struct ctf_packet_index index;
 
-	if (!stream || stream->pos.fd < 0) {
-		/*
-		 * Stream does not have an associated fd. It is,
-		 * therefore, not a stream being used to write events.
-		 */
-		ret = -1;
+	if (stream->index_fd < 0) {
 		goto end;
 	}
 
-	if (!stream->events->len) {
+	(void) get_events_discarded(packet_context, &events_discarded);
+	index.offset = htobe64(offset);
+	index.packet_size = htobe64(stream->pos.packet_size);
+	index.content_size = htobe64(stream->pos.offset);
+	index.timestamp_begin = htobe64(timestamp_begin);
+	index.timestamp_end = htobe64(timestamp_end);
+	index.events_discarded = htobe64(events_discarded);
+	index.stream_id = htobe64(stream->stream_class->id);
+	index.stream_instance_id = htobe64(cpu_id);
+	index.packet_seq_num = htobe64(stream->flushed_packet_count);
+	if (write(stream->index_fd, &index, sizeof(index)) != sizeof(index)) {
+		perror("write");
+		ret = -1;
+	}
+end:
+	return ret;
+}
+
+/*
+ * Compress the packet just written and rewind the scratch file, the next
+ * packet reusing its space.
+ */
+static
+int compress_packet(struct bt_ctf_stream *stream)
+{
+	int ret;
+	struct ctf_stream_pos *pos = &stream->pos;
+
+	ret = ctf_compressed_append(stream->compressed,
+		mmap_align_addr(pos->base_mma),
+		(pos->offset + CHAR_BIT - 1) / CHAR_BIT,
+		pos->packet_size / CHAR_BIT);
+	if (ret) {
 		goto end;
 	}
 
-	ret = bt_ctf_field_validate(stream->packet_header);
+	ret = munmap_align(pos->base_mma);
 	if (ret) {
+		perror("munmap");
 		goto end;
 	}
+	pos->base_mma = NULL;
+	pos->mmap_offset = 0;
+	pos->packet_size = 0;
+end:
+	return ret;
+}
+
+/*
+ * Serialize a packet made of the given header, context and events at the
+ * stream's current position.
+ */
+static
+int write_packet(struct bt_ctf_stream *stream,
+		struct bt_ctf_field *packet_header,
+		struct bt_ctf_field *packet_context,
+		GPtrArray *events, GPtrArray *event_contexts)
+{
+	int ret = 0;
+	size_t i;
+	off_t packet_offset;
+	uint64_t timestamp_begin, timestamp_end;
+	uint64_t index_begin = 0, index_end = 0, last_timestamp;
+	uint64_t cpu_id = -1ULL;
+	struct ctf_stream_pos packet_context_pos;
 
 	/* mmap the next packet */
 	ctf_packet_seek(&stream->pos.parent, 0, SEEK_CUR);
+	packet_offset = stream->pos.mmap_offset;
 
-	ret = bt_ctf_field_serialize(stream->packet_header, &stream->pos);
+	ret = bt_ctf_field_serialize(packet_header, &stream->pos);
 	if (ret) {
 		goto end;
 	}
 
-	/* Set the default context attributes if present and unset. */
+	/*
+	 * Set the default context attributes if present and unset. Compact
+	 * event headers are still in their extended form at this point.
+	 */
 	if (!get_event_header_timestamp(
 		((struct bt_ctf_event *) g_ptr_array_index(
-		stream->events, 0))->event_header, &timestamp_begin)) {
-		ret = set_structure_field_integer(stream->packet_context,
+		events, 0))->event_header, &timestamp_begin)) {
+		ret = set_structure_field_integer(packet_context,
 			"timestamp_begin", timestamp_begin);
 		if (ret) {
 			goto end;
@@ -777,58 +1204,62 @@ int bt_ctf_stream_flush(struct bt_ctf_stream *stream)
 
 	if (!get_event_header_timestamp(
 		((struct bt_ctf_event *) g_ptr_array_index(
-		stream->events, stream->events->len - 1))->event_header,
-		&timestamp_end)) {
+		events, events->len - 1))->event_header, &timestamp_end)) {
 
-		ret = set_structure_field_integer(stream->packet_context,
+		ret = set_structure_field_integer(packet_context,
 			"timestamp_end", timestamp_end);
 		if (ret) {
 			goto end;
 		}
 	}
-	ret = set_structure_field_integer(stream->packet_context,
+	ret = set_structure_field_integer(packet_context,
 		"content_size", UINT64_MAX);
 	if (ret) {
 		goto end;
 	}
 
-	ret = set_structure_field_integer(stream->packet_context,
+	ret = set_structure_field_integer(packet_context,
 		"packet_size", UINT64_MAX);
 	if (ret) {
 		goto end;
 	}
 
+	/* Timestamps set by the user take precedence, index them */
+	(void) get_structure_field_integer(packet_context, "timestamp_begin",
+		&index_begin);
+	(void) get_structure_field_integer(packet_context, "timestamp_end",
+		&index_end);
+	/* Unset by the reset below, before the index entry is written */
+	if (get_structure_field_integer(packet_context, "cpu_id", &cpu_id)) {
+		cpu_id = -1ULL;
+	}
+
 	/* Write packet context */
 	memcpy(&packet_context_pos, &stream->pos,
 	       sizeof(struct ctf_stream_pos));
-	ret = bt_ctf_field_serialize(stream->packet_context,
+	ret = bt_ctf_field_serialize(packet_context,
 		&stream->pos);
 	if (ret) {
 		goto end;
 	}
 
-	ret = bt_ctf_stream_get_discarded_events_count(stream,
-		&events_discarded);
+	ret = reset_packet_context(packet_context);
 	if (ret) {
 		goto end;
 	}
 
-	/* Unset the packet context's fields. */
-	ret = bt_ctf_field_reset(stream->packet_context);
-	if (ret) {
-		goto end;
-	}
+	/* Readers start from the packet's timestamp_begin */
+	last_timestamp = index_begin;
+	for (i = 0; i < events->len; i++) {
+		struct bt_ctf_event *event = g_ptr_array_index(events, i);
 
-	/* Set the previous number of discarded events. */
-	ret = set_structure_field_integer(stream->packet_context,
-		"events_discarded", events_discarded);
-	if (ret) {
-		goto end;
-	}
-
-	for (i = 0; i < stream->events->len; i++) {
-		struct bt_ctf_event *event = g_ptr_array_index(
-			stream->events, i);
+		if (stream->stream_class->compact_event_header) {
+			ret = compact_event_header(event->event_header,
+				&last_timestamp);
+			if (ret) {
+				goto end;
+			}
+		}
 
 		ret = bt_ctf_field_reset(event->event_header);
 		if (ret) {
@@ -843,9 +1274,9 @@ int bt_ctf_stream_flush(struct bt_ctf_stream *stream)
 		}
 
 		/* Write stream event context */
-		if (stream->event_contexts) {
+		if (event_contexts) {
 			ret = bt_ctf_field_serialize(
-				g_ptr_array_index(stream->event_contexts, i),
+				g_ptr_array_index(event_contexts, i),
 				&stream->pos);
 			if (ret) {
 				goto end;
@@ -866,31 +1297,185 @@ int bt_ctf_stream_flush(struct bt_ctf_stream *stream)
 	 * packet is resized).
 	 */
 	packet_context_pos.base_mma = stream->pos.base_mma;
-	ret = set_structure_field_integer(stream->packet_context,
+	ret = set_structure_field_integer(packet_context,
 		"content_size", stream->pos.offset);
 	if (ret) {
 		goto end;
 	}
 
-	ret = set_structure_field_integer(stream->packet_context,
+	ret = set_structure_field_integer(packet_context,
 		"packet_size", stream->pos.packet_size);
 	if (ret) {
 		goto end;
 	}
 
-	ret = bt_ctf_field_serialize(stream->packet_context,
+	ret = bt_ctf_field_serialize(packet_context,
 		&packet_context_pos);
 	if (ret) {
 		goto end;
 	}
 
+	if (stream->compressed) {
+		/* Index the packet's offset in the uncompressed stream */
+		packet_offset = ctf_compressed_size(stream->compressed);
+	}
+
+	ret = write_packet_index(stream, packet_offset, packet_context,
+		index_begin, index_end, cpu_id);
+	if (ret) {
+		goto end;
+	}
+
+	if (stream->compressed) {
+		ret = compress_packet(stream);
+		if (ret) {
+			goto end;
+		}
+	}
+
+	stream->flushed_packet_count++;
+end:
+	return ret;
+}
+
+BT_HIDDEN
+int bt_ctf_stream_write_packet(struct bt_ctf_stream_packet *packet)
+{
+	return write_packet(packet->stream, packet->packet_header,
+		packet->packet_context, packet->events,
+		packet->event_contexts);
+}
+
+BT_HIDDEN
+void bt_ctf_stream_packet_destroy(struct bt_ctf_stream_packet *packet)
+{
+	if (!packet) {
+		return;
+	}
+
+	if (packet->events) {
+		g_ptr_array_free(packet->events, TRUE);
+	}
+	if (packet->event_contexts) {
+		g_ptr_array_free(packet->event_contexts, TRUE);
+	}
+	bt_ctf_field_put(packet->packet_header);
+	bt_ctf_field_put(packet->packet_context);
+	bt_ctf_stream_put(packet->stream);
+	g_free(packet);
+}
+
+/*
+ * Hand the current packet over to the writer's I/O thread and start a new
+ * one. Returns 1 if the I/O thread is not running, in which case the
+ * packet must be written by the caller.
+ */
+static
+int queue_packet(struct bt_ctf_stream *stream)
+{
+	int ret;
+	struct bt_ctf_stream_packet *packet;
+
+	packet = g_new0(struct bt_ctf_stream_packet, 1);
+	packet->packet_header = bt_ctf_field_copy(stream->packet_header);
+	packet->packet_context = bt_ctf_field_copy(stream->packet_context);
+	if (!packet->packet_header || !packet->packet_context) {
+		ret = -1;
+		goto error;
+	}
+
+	packet->stream = stream;
+	bt_ctf_stream_get(stream);
+	packet->events = stream->events;
+	packet->event_contexts = stream->event_contexts;
+	ret = bt_ctf_flush_queue_push_packet(stream->flush_queue, packet);
+	if (ret) {
+		/* The events stay in the stream's current packet */
+		packet->events = NULL;
+		packet->event_contexts = NULL;
+		bt_ctf_stream_packet_destroy(packet);
+	}
+
+	switch (ret) {
+	case 0:
+		break;
+	case -EAGAIN:
+		/* Queue full: drop the packet's events and account for them */
+		bt_ctf_stream_append_discarded_events(stream,
+			stream->events->len);
+		g_ptr_array_set_size(stream->events, 0);
+		if (stream->event_contexts) {
+			g_ptr_array_set_size(stream->event_contexts, 0);
+		}
+		ret = 0;
+		goto end;
+	case -ESHUTDOWN:
+		ret = 1;
+		goto end;
+	default:
+		goto end;
+	}
+
+	/* The queued packet owns the events, start a new packet. */
+	stream->events = g_ptr_array_new_with_free_func(
+		(GDestroyNotify) put_event);
+	if (stream->event_contexts) {
+		stream->event_contexts = g_ptr_array_new_with_free_func(
+			(GDestroyNotify) bt_ctf_field_put);
+	}
+	ret = reset_packet_context(stream->packet_context);
+end:
+	return ret;
+error:
+	bt_ctf_stream_packet_destroy(packet);
+	return ret;
+}
+
+int bt_ctf_stream_flush(struct bt_ctf_stream *stream)
+{
+	int ret = 0;
+
+	if (!stream || stream->pos.fd < 0) {
+		/*
+		 * Stream does not have an associated fd. It is,
+		 * therefore, not a stream being used to write events.
+		 */
+		ret = -1;
+		goto end;
+	}
+
+	if (stream->concurrent) {
+		collect_concurrent_events(stream);
+	}
+
+	if (!stream->events->len) {
+		goto end;
+	}
+
+	ret = bt_ctf_field_validate(stream->packet_header);
+	if (ret) {
+		goto end;
+	}
+
+	if (stream->flush_queue) {
+		ret = queue_packet(stream);
+		if (ret <= 0) {
+			goto end;
+		}
+	}
+
+	ret = write_packet(stream, stream->packet_header,
+		stream->packet_context, stream->events,
+		stream->event_contexts);
+	if (ret) {
+		goto end;
+	}
+
 	g_ptr_array_set_size(stream->events, 0);
 	if (stream->event_contexts) {
 		g_ptr_array_set_size(stream->event_contexts, 0);
 	}
-	stream->flushed_packet_count++;
 end:
-	bt_ctf_field_put(integer);
 	return ret;
 }
 
@@ -923,9 +1508,25 @@ void bt_ctf_stream_destroy(struct bt_ctf_ref *ref)
 
 	stream = container_of(ref, struct bt_ctf_stream, ref_count);
 	ctf_fini_pos(&stream->pos);
+	if (ctf_compressed_close(stream->compressed)) {
+		fprintf(stderr, "[error] Unable to complete compressed stream file.\n");
+	}
+	while (stream->append_head) {
+		struct bt_ctf_stream_append_node *node = stream->append_head;
+
+		stream->append_head = node->next;
+		if (node->event) {
+			put_event(node->event);
+		}
+		bt_ctf_field_put(node->event_context);
+		g_free(node);
+	}
 	if (stream->pos.fd >= 0 && close(stream->pos.fd)) {
 		perror("close");
 	}
+	if (stream->index_fd >= 0 && close(stream->index_fd)) {
+		perror("close");
+	}
 
 	if (stream->stream_class) {
 		bt_ctf_stream_class_put(stream->stream_class);
@@ -945,6 +1546,9 @@ void bt_ctf_stream_destroy(struct bt_ctf_ref *ref)
 	if (stream->event_context) {
 		bt_ctf_field_put(stream->event_context);
 	}
+	if (stream->flush_queue) {
+		bt_ctf_flush_queue_put(stream->flush_queue);
+	}
 	g_free(stream);
 }
 
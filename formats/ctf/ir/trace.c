@@ -90,7 +90,9 @@ struct bt_ctf_trace *bt_ctf_trace_create(void)
 		(GDestroyNotify) bt_ctf_stream_put);
 	trace->stream_classes = g_ptr_array_new_with_free_func(
 		(GDestroyNotify) put_stream_class);
-	if (!trace->clocks || !trace->stream_classes || !trace->streams) {
+	trace->emitted = g_hash_table_new(g_direct_hash, g_direct_equal);
+	if (!trace->clocks || !trace->stream_classes || !trace->streams ||
+		!trace->emitted) {
 		goto error_destroy;
 	}
 
@@ -140,6 +142,14 @@ void bt_ctf_trace_destroy(struct bt_ctf_ref *ref)
 		g_ptr_array_free(trace->stream_classes, TRUE);
 	}
 
+	if (trace->emitted) {
+		g_hash_table_destroy(trace->emitted);
+	}
+
+	if (trace->emitted_header) {
+		g_string_free(trace->emitted_header, TRUE);
+	}
+
 	bt_ctf_field_type_put(trace->packet_header_type);
 	g_free(trace);
 }
@@ -711,16 +721,10 @@ loop_next:
 	g_string_append(context->string, "};\n\n");
 }
 
-char *bt_ctf_trace_get_metadata_string(struct bt_ctf_trace *trace)
+static
+struct metadata_context *metadata_context_create(void)
 {
-	char *metadata = NULL;
-	struct metadata_context *context = NULL;
-	int err = 0;
-	size_t i;
-
-	if (!trace) {
-		goto end;
-	}
+	struct metadata_context *context;
 
 	context = g_new0(struct metadata_context, 1);
 	if (!context) {
@@ -729,29 +733,143 @@ char *bt_ctf_trace_get_metadata_string(struct bt_ctf_trace *trace)
 
 	context->field_name = g_string_sized_new(DEFAULT_IDENTIFIER_SIZE);
 	context->string = g_string_sized_new(DEFAULT_METADATA_STRING_SIZE);
+end:
+	return context;
+}
+
+/* Return the context's string, which the caller must free, on success. */
+static
+char *metadata_context_destroy(struct metadata_context *context, int err)
+{
+	char *metadata = err ? NULL : context->string->str;
+
+	g_string_free(context->string, err ? TRUE : FALSE);
+	g_string_free(context->field_name, TRUE);
+	g_free(context);
+	return metadata;
+}
+
+static
+int append_header_metadata(struct bt_ctf_trace *trace,
+		struct metadata_context *context)
+{
+	int ret;
+
 	g_string_append(context->string, "/* CTF 1.8 */\n\n");
-	if (append_trace_metadata(trace, context)) {
-		goto error;
+	ret = append_trace_metadata(trace, context);
+	if (ret) {
+		goto end;
 	}
 	append_env_metadata(trace, context);
-	g_ptr_array_foreach(trace->clocks,
-		(GFunc)bt_ctf_clock_serialize, context);
+end:
+	return ret;
+}
+
+/* Append the clock, stream and event class declarations. */
+static
+int append_declarations_metadata(struct bt_ctf_trace *trace,
+		struct metadata_context *context)
+{
+	int ret = 0;
+	size_t i;
+
+	for (i = 0; i < trace->clocks->len; i++) {
+		struct bt_ctf_clock *clock = g_ptr_array_index(trace->clocks, i);
+
+		if (!metadata_context_emitted(context, clock, clock->frozen)) {
+			bt_ctf_clock_serialize(clock, context);
+		}
+	}
 
 	for (i = 0; i < trace->stream_classes->len; i++) {
-		err = bt_ctf_stream_class_serialize(
+		ret = bt_ctf_stream_class_serialize(
 			trace->stream_classes->pdata[i], context);
-		if (err) {
-			goto error;
+		if (ret) {
+			goto end;
 		}
 	}
+end:
+	return ret;
+}
 
-	metadata = context->string->str;
-error:
-	g_string_free(context->string, err ? TRUE : FALSE);
-	g_string_free(context->field_name, TRUE);
-	g_free(context);
+char *bt_ctf_trace_get_metadata_string(struct bt_ctf_trace *trace)
+{
+	struct metadata_context *context = NULL;
+	int err = 0;
+
+	if (!trace) {
+		return NULL;
+	}
+
+	context = metadata_context_create();
+	if (!context) {
+		return NULL;
+	}
+
+	err = append_header_metadata(trace, context);
+	if (err) {
+		goto end;
+	}
+	err = append_declarations_metadata(trace, context);
 end:
-	return metadata;
+	return metadata_context_destroy(context, err);
+}
+
+BT_HIDDEN
+char *bt_ctf_trace_get_metadata_update(struct bt_ctf_trace *trace,
+		int *append)
+{
+	struct metadata_context *context = NULL;
+	int err = 0;
+
+	if (!trace || !append) {
+		return NULL;
+	}
+
+	context = metadata_context_create();
+	if (!context) {
+		return NULL;
+	}
+
+	/*
+	 * The trace and environment blocks can't be amended: any change
+	 * requires the whole metadata to be emitted again.
+	 */
+	err = append_header_metadata(trace, context);
+	if (err) {
+		goto end;
+	}
+	if (trace->emitted_header && !trace->emitted_unfrozen &&
+		!strcmp(trace->emitted_header->str, context->string->str)) {
+		*append = 1;
+		g_string_truncate(context->string, 0);
+	} else {
+		*append = 0;
+		g_hash_table_remove_all(trace->emitted);
+		trace->emitted_unfrozen = 0;
+		if (trace->emitted_header) {
+			g_string_free(trace->emitted_header, TRUE);
+		}
+		trace->emitted_header = g_string_new(context->string->str);
+	}
+
+	context->emitted = trace->emitted;
+	err = append_declarations_metadata(trace, context);
+	trace->emitted_unfrozen |= context->emitted_unfrozen;
+end:
+	if (err) {
+		bt_ctf_trace_reset_metadata_update(trace);
+	}
+	return metadata_context_destroy(context, err);
+}
+
+BT_HIDDEN
+void bt_ctf_trace_reset_metadata_update(struct bt_ctf_trace *trace)
+{
+	if (trace->emitted_header) {
+		g_string_free(trace->emitted_header, TRUE);
+		trace->emitted_header = NULL;
+	}
 }
 
 enum bt_ctf_byte_order bt_ctf_trace_get_byte_order(struct bt_ctf_trace *trace)
@@ -63,6 +63,108 @@ struct bt_ctf_iter *bt_ctf_iter_create(struct bt_context *ctx,
 	return iter;
 }
 
+/*
+ * Set the event filter of the file stream read by "iter" for a stream of
+ * its context. "ids" is NULL to remove the filter.
+ */
+static
+void set_stream_event_filter(struct bt_ctf_iter *iter,
+		struct ctf_stream_definition *stream, GArray *ids)
+{
+	struct ctf_file_stream *file_stream;
+
+	file_stream = container_of(stream, struct ctf_file_stream, parent);
+	if (iter->parent.cursors)
+		file_stream = g_hash_table_lookup(iter->parent.cursors,
+				file_stream);
+	if (!file_stream)
+		return;
+	if (file_stream->event_filter)
+		g_array_free(file_stream->event_filter, TRUE);
+	file_stream->event_filter = NULL;
+	if (ids) {
+		file_stream->event_filter = g_array_sized_new(FALSE, FALSE,
+				sizeof(uint64_t), ids->len);
+		g_array_append_vals(file_stream->event_filter, ids->data,
+				ids->len);
+	}
+	/* The last event depends on the filter. */
+	file_stream->last_event_nr_packets = 0;
+}
+
+/*
+ * Apply the event ids of "names" ("nr_names" 0 for no filter) to the
+ * streams of every trace of the iterator's context.
+ */
+static
+void set_event_filter(struct bt_ctf_iter *iter, const char * const *names,
+		unsigned int nr_names)
+{
+	struct trace_collection *tc = iter->parent.ctx->tc;
+	GArray *ids = NULL;
+	int i, j, k;
+	unsigned int n;
+
+	if (nr_names)
+		ids = g_array_new(FALSE, TRUE, sizeof(uint64_t));
+	for (i = 0; i < tc->array->len; i++) {
+		struct bt_trace_descriptor *td_read;
+		struct ctf_trace *tin;
+
+		td_read = g_ptr_array_index(tc->array, i);
+		if (!td_read)
+			continue;
+		tin = container_of(td_read, struct ctf_trace, parent);
+		for (j = 0; j < tin->streams->len; j++) {
+			struct ctf_stream_declaration *stream_class;
+
+			stream_class = g_ptr_array_index(tin->streams, j);
+			if (!stream_class)
+				continue;
+			if (ids) {
+				g_array_set_size(ids, 0);
+				g_array_set_size(ids,
+					(stream_class->events_by_id->len + 63) / 64 ? : 1);
+				for (n = 0; n < nr_names; n++) {
+					uint64_t *id;
+					GQuark name = g_quark_try_string(names[n]);
+
+					if (!name)
+						continue;
+					id = g_hash_table_lookup(stream_class->event_quark_to_id,
+						(gconstpointer) (unsigned long) name);
+					if (!id || *id / 64 >= ids->len)
+						continue;
+					g_array_index(ids, uint64_t, *id / 64) |=
+						1ULL << (*id % 64);
+				}
+			}
+			for (k = 0; k < stream_class->streams->len; k++) {
+				struct ctf_stream_definition *stream;
+
+				stream = g_ptr_array_index(stream_class->streams, k);
+				if (stream)
+					set_stream_event_filter(iter, stream, ids);
+			}
+		}
+	}
+	if (ids)
+		g_array_free(ids, TRUE);
+}
+
+int bt_ctf_iter_set_event_filter(struct bt_ctf_iter *iter,
+		const char * const *names, unsigned int nr_names)
+{
+	struct bt_iter_pos pos;
+
+	if (!iter || (nr_names && !names))
+		return -EINVAL;
+
+	set_event_filter(iter, names, nr_names);
+	pos.type = BT_SEEK_BEGIN;
+	return bt_iter_set_pos(&iter->parent, &pos);
+}
+
 void bt_ctf_iter_destroy(struct bt_ctf_iter *iter)
 {
 	struct bt_stream_callbacks *bt_stream_cb;
@@ -71,6 +173,10 @@ void bt_ctf_iter_destroy(struct bt_ctf_iter *iter)
 
 	assert(iter);
 
+	/* The trace's own streams outlive the iterator reading them. */
+	if (!iter->parent.cursors)
+		set_event_filter(iter, NULL, 0);
+
 	/* free all events callbacks */
 	if (iter->main_callbacks.callback)
 		g_array_free(iter->main_callbacks.callback, TRUE);
@@ -39,6 +39,7 @@
 #include <babeltrace/compat/uuid.h>
 #include <babeltrace/endian.h>
 #include <babeltrace/ctf/events-internal.h>
+#include <babeltrace/clock-internal.h>
 #include "ctf-scanner.h"
 #include "ctf-parser.h"
 #include "ctf-ast.h"
@@ -2481,6 +2482,7 @@ int ctf_clock_visit(FILE *fd, int depth, struct ctf_node *node, struct ctf_trace
 		}
 		clock->absolute = 1;
 	}
+	clock_compute_ns_conversion(clock);
 	if (!CTF_CLOCK_FIELD_IS_SET(clock, name)) {
 		ret = -EPERM;
 		fprintf(fd, "[error] %s: missing name field in clock declaration\n", __func__);
@@ -2525,6 +2527,7 @@ void ctf_clock_default(FILE *fd, int depth, struct ctf_trace *trace)
 	} else {
 		clock->absolute = 0;	/* Not an absolute reference across traces */
 	}
+	clock_compute_ns_conversion(clock);
 
 	trace->parent.single_clock = clock;
 	g_hash_table_insert(trace->parent.clocks, (gpointer) (unsigned long) clock->name, clock);
@@ -0,0 +1,413 @@
+/*
+ * packet-io.c
+ *
+ * Babeltrace CTF Library
+ *
+ * Packets read in buffers with pread() or io_uring instead of mapped, so
+ * that reading the next packets can overlap decoding the current ones.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <babeltrace/ctf/ctf-packet-io.h>
+#include <babeltrace/ctf/iterator.h>
+#include <glib.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef BABELTRACE_HAVE_LIBURING
+#include <liburing.h>
+#include <pthread.h>
+#endif
+
+/* Entries of the io_uring submission queue */
+#define PACKET_IO_QUEUE_DEPTH	64
+/* Reads queued before they are submitted together */
+#define PACKET_IO_BATCH		16
+
+struct packet_buf {
+	char *data;
+	off_t offset;		/* offset in the file, in bytes */
+	size_t length;		/* in bytes */
+	size_t valid;		/* bytes read so far */
+	int in_flight;		/* read queued on the ring, not completed */
+	int error;		/* read on the ring failed */
+};
+
+struct ctf_packet_reader {
+	GQueue ahead;			/* struct packet_buf, by offset */
+	struct packet_buf *current;	/* buffer of the current mapping */
+};
+
+static enum bt_ctf_packet_io packet_io = BT_CTF_PACKET_IO_MMAP;
+
+#ifdef BABELTRACE_HAVE_LIBURING
+/*
+ * The ring is shared by the streams of all the traces, so that the reads
+ * ahead of many streams go in the same submission. Iterators may run on
+ * different threads, hence the lock.
+ */
+static struct {
+	struct io_uring ring;
+	int initialized;
+	unsigned int queued;	/* reads queued but not submitted */
+	pthread_mutex_t lock;
+} uring = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static
+int uring_init(void)
+{
+	int ret = 0;
+
+	pthread_mutex_lock(&uring.lock);
+	if (!uring.initialized) {
+		ret = io_uring_queue_init(PACKET_IO_QUEUE_DEPTH,
+			&uring.ring, 0);
+		uring.initialized = !ret;
+	}
+	pthread_mutex_unlock(&uring.lock);
+	return ret;
+}
+
+/* Called with the lock held. */
+static
+int uring_submit(void)
+{
+	int ret;
+
+	ret = io_uring_submit(&uring.ring);
+	if (ret < 0) {
+		return ret;
+	}
+	uring.queued = (unsigned int) ret < uring.queued ?
+		uring.queued - ret : 0;
+	return 0;
+}
+
+/* Called with the lock held. */
+static
+void uring_complete(struct io_uring_cqe *cqe)
+{
+	struct packet_buf *buf = io_uring_cqe_get_data(cqe);
+
+	if (cqe->res >= 0) {
+		buf->valid += cqe->res;
+	} else {
+		buf->error = 1;
+	}
+	buf->in_flight = 0;
+	io_uring_cqe_seen(&uring.ring, cqe);
+}
+
+static
+int uring_queue(struct packet_buf *buf, int fd)
+{
+	struct io_uring_sqe *sqe;
+	int ret = 0;
+
+	pthread_mutex_lock(&uring.lock);
+	sqe = io_uring_get_sqe(&uring.ring);
+	if (!sqe) {
+		/* Submission queue full */
+		ret = uring_submit();
+		if (ret) {
+			goto end;
+		}
+		sqe = io_uring_get_sqe(&uring.ring);
+		if (!sqe) {
+			ret = -EBUSY;
+			goto end;
+		}
+	}
+	io_uring_prep_read(sqe, fd, buf->data, buf->length, buf->offset);
+	io_uring_sqe_set_data(sqe, buf);
+	buf->in_flight = 1;
+	if (++uring.queued >= PACKET_IO_BATCH) {
+		/* The read is queued either way, submitted by a later call. */
+		(void) uring_submit();
+	}
+end:
+	pthread_mutex_unlock(&uring.lock);
+	return ret;
+}
+
+/* Wait for the read of a buffer, reaping the completions of others. */
+static
+int uring_wait(struct packet_buf *buf)
+{
+	int ret = 0;
+
+	pthread_mutex_lock(&uring.lock);
+	while (buf->in_flight) {
+		struct io_uring_cqe *cqe;
+
+		if (uring.queued) {
+			ret = uring_submit();
+			if (ret) {
+				break;
+			}
+		}
+		ret = io_uring_wait_cqe(&uring.ring, &cqe);
+		if (ret == -EINTR) {
+			continue;
+		}
+		if (ret) {
+			break;
+		}
+		uring_complete(cqe);
+	}
+	pthread_mutex_unlock(&uring.lock);
+	return ret;
+}
+#else /* BABELTRACE_HAVE_LIBURING */
+static
+int uring_init(void)
+{
+	return -ENOSYS;
+}
+
+static
+int uring_queue(struct packet_buf *buf, int fd)
+{
+	return -ENOSYS;
+}
+
+static
+int uring_wait(struct packet_buf *buf)
+{
+	return 0;
+}
+#endif /* BABELTRACE_HAVE_LIBURING */
+
+enum bt_ctf_packet_io bt_ctf_set_packet_io(enum bt_ctf_packet_io io)
+{
+	switch (io) {
+	case BT_CTF_PACKET_IO_URING:
+		if (uring_init()) {
+			io = BT_CTF_PACKET_IO_READ;
+		}
+		break;
+	case BT_CTF_PACKET_IO_MMAP:
+	case BT_CTF_PACKET_IO_READ:
+		break;
+	default:
+		return packet_io;
+	}
+	packet_io = io;
+	return packet_io;
+}
+
+static
+struct packet_buf *buf_create(off_t offset, size_t length)
+{
+	struct packet_buf *buf;
+
+	buf = g_new0(struct packet_buf, 1);
+	buf->data = malloc(length);
+	if (!buf->data && length) {
+		g_free(buf);
+		return NULL;
+	}
+	buf->offset = offset;
+	buf->length = length;
+	return buf;
+}
+
+static
+void buf_destroy(struct packet_buf *buf)
+{
+	if (uring_wait(buf) || buf->in_flight) {
+		/* The kernel may still write to it: leak it. */
+		fprintf(stderr, "[error] Unable to wait for a packet read.\n");
+		return;
+	}
+	free(buf->data);
+	g_free(buf);
+}
+
+/*
+ * Read the bytes of a buffer not read yet, zeroing those past the end of
+ * the file.
+ */
+static
+int buf_read(struct packet_buf *buf, int fd)
+{
+	while (buf->valid < buf->length) {
+		ssize_t ret;
+
+		ret = pread(fd, buf->data + buf->valid,
+			buf->length - buf->valid, buf->offset + buf->valid);
+		if (ret < 0 && errno == EINTR) {
+			continue;
+		}
+		if (ret < 0) {
+			return -errno;
+		}
+		if (!ret) {
+			memset(buf->data + buf->valid, 0,
+				buf->length - buf->valid);
+			buf->valid = buf->length;
+			break;
+		}
+		buf->valid += ret;
+	}
+	return 0;
+}
+
+static
+void reader_clear_ahead(struct ctf_packet_reader *reader)
+{
+	struct packet_buf *buf;
+
+	while ((buf = g_queue_pop_head(&reader->ahead))) {
+		buf_destroy(buf);
+	}
+}
+
+struct ctf_packet_reader *ctf_packet_reader_create(void)
+{
+	struct ctf_packet_reader *reader;
+
+	if (packet_io == BT_CTF_PACKET_IO_MMAP) {
+		return NULL;
+	}
+	reader = g_new0(struct ctf_packet_reader, 1);
+	g_queue_init(&reader->ahead);
+	return reader;
+}
+
+void ctf_packet_reader_destroy(struct ctf_packet_reader *reader)
+{
+	if (!reader) {
+		return;
+	}
+	reader_clear_ahead(reader);
+	if (reader->current) {
+		buf_destroy(reader->current);
+	}
+	g_free(reader);
+}
+
+struct mmap_align *ctf_packet_reader_map(struct ctf_packet_reader *reader,
+		int fd, size_t length, off_t offset)
+{
+	struct packet_buf *buf = NULL, *ahead;
+	struct mmap_align *mma;
+	int ret;
+
+	mma = malloc(sizeof(*mma));
+	if (!mma) {
+		return MAP_FAILED;
+	}
+	/* Packets read ahead are mapped in order, drop the ones skipped. */
+	while ((ahead = g_queue_peek_head(&reader->ahead))) {
+		if (ahead->offset > offset) {
+			break;
+		}
+		g_queue_pop_head(&reader->ahead);
+		if (ahead->offset == offset && ahead->length >= length) {
+			buf = ahead;
+			break;
+		}
+		buf_destroy(ahead);
+	}
+	if (buf) {
+		ret = uring_wait(buf);
+		if (ret || buf->in_flight) {
+			/* Leave it to the kernel, read it again. */
+			buf = NULL;
+		} else if (buf->error) {
+			buf->valid = 0;
+		}
+	}
+	if (!buf) {
+		buf = buf_create(offset, length);
+		if (!buf) {
+			free(mma);
+			errno = ENOMEM;
+			return MAP_FAILED;
+		}
+	}
+	ret = buf_read(buf, fd);
+	if (ret) {
+		buf_destroy(buf);
+		free(mma);
+		errno = -ret;
+		return MAP_FAILED;
+	}
+	reader->current = buf;
+	mma->page_aligned_addr = NULL;
+	mma->page_aligned_length = 0;
+	mma->addr = buf->data;
+	mma->length = length;
+	return mma;
+}
+
+void ctf_packet_reader_unmap(struct ctf_packet_reader *reader,
+		struct mmap_align *mma)
+{
+	if (reader->current) {
+		buf_destroy(reader->current);
+		reader->current = NULL;
+	}
+	free(mma);
+}
+
+void ctf_packet_reader_drop_ahead(struct ctf_packet_reader *reader)
+{
+	reader_clear_ahead(reader);
+}
+
+int ctf_packet_reader_prefetch(struct ctf_packet_reader *reader,
+		int fd, size_t length, off_t offset)
+{
+	struct packet_buf *buf;
+	GList *link;
+	int ret;
+
+	if (packet_io != BT_CTF_PACKET_IO_URING) {
+		return -ENOSYS;
+	}
+	for (link = reader->ahead.head; link; link = link->next) {
+		buf = link->data;
+		if (buf->offset == offset && buf->length >= length) {
+			return 0;	/* Already read ahead */
+		}
+	}
+	buf = g_queue_peek_tail(&reader->ahead);
+	if (buf && buf->offset > offset) {
+		/* Seeked backwards, the packets ahead are not needed. */
+		reader_clear_ahead(reader);
+	}
+	buf = buf_create(offset, length);
+	if (!buf) {
+		return -ENOMEM;
+	}
+	ret = uring_queue(buf, fd);
+	if (ret) {
+		buf_destroy(buf);
+		return ret;
+	}
+	g_queue_push_tail(&reader->ahead, buf);
+	return 0;
+}
@@ -0,0 +1,260 @@
+/*
+ * packet-stream.c
+ *
+ * Babeltrace CTF Library
+ *
+ * Streams of packets pushed in memory by the caller, decoded in place
+ * instead of read from a file.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <babeltrace/ctf/packet-stream-internal.h>
+#include <babeltrace/format.h>
+#include <babeltrace/compiler.h>
+#include <glib.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <pthread.h>
+
+struct packet_buffer {
+	const char *data;
+	size_t len;		/* in bytes */
+	off_t offset;		/* offset in the stream, in bytes */
+	bt_ctf_packet_release_cb release;
+	void *priv;
+};
+
+/*
+ * Packets are pushed by the producer and read by the reader of the trace,
+ * which may run on different threads, hence the lock. Buffers are only
+ * removed by the reader, so they stay valid while it reads them without
+ * the lock held.
+ */
+struct bt_ctf_packet_stream {
+	pthread_mutex_t lock;
+	GQueue buffers;		/* struct packet_buffer, by offset */
+	off_t begin;		/* offset of the first buffer not released */
+	off_t end;		/* offset after the last buffer pushed */
+	int closed;
+	/* fd is -1, priv points to the packet stream itself */
+	struct bt_mmap_stream mmap_stream;
+};
+
+static
+void buffer_release(struct packet_buffer *buf)
+{
+	if (buf->release) {
+		buf->release(buf->data, buf->len, buf->priv);
+	}
+	g_free(buf);
+}
+
+/* Buffer holding "offset", NULL if none. Called with the lock held. */
+static
+struct packet_buffer *buffer_lookup(struct bt_ctf_packet_stream *stream,
+		off_t offset)
+{
+	GList *link;
+
+	for (link = stream->buffers.head; link; link = link->next) {
+		struct packet_buffer *buf = link->data;
+
+		if (offset < buf->offset) {
+			break;
+		}
+		if (offset < buf->offset + buf->len) {
+			return buf;
+		}
+	}
+	return NULL;
+}
+
+struct bt_ctf_packet_stream *bt_ctf_packet_stream_create(void)
+{
+	struct bt_ctf_packet_stream *stream;
+
+	stream = g_new0(struct bt_ctf_packet_stream, 1);
+	pthread_mutex_init(&stream->lock, NULL);
+	g_queue_init(&stream->buffers);
+	stream->mmap_stream.fd = -1;
+	stream->mmap_stream.priv = stream;
+	return stream;
+}
+
+void bt_ctf_packet_stream_destroy(struct bt_ctf_packet_stream *stream)
+{
+	struct packet_buffer *buf;
+
+	if (!stream) {
+		return;
+	}
+	while ((buf = g_queue_pop_head(&stream->buffers))) {
+		buffer_release(buf);
+	}
+	pthread_mutex_destroy(&stream->lock);
+	g_free(stream);
+}
+
+int bt_ctf_packet_stream_push(struct bt_ctf_packet_stream *stream,
+		const void *data, size_t len, bt_ctf_packet_release_cb release,
+		void *priv)
+{
+	struct packet_buffer *buf;
+	int ret = 0;
+
+	if (!stream || !data || !len) {
+		return -EINVAL;
+	}
+	buf = g_new0(struct packet_buffer, 1);
+	buf->data = data;
+	buf->len = len;
+	buf->release = release;
+	buf->priv = priv;
+
+	pthread_mutex_lock(&stream->lock);
+	if (stream->closed) {
+		ret = -EINVAL;
+		goto end;
+	}
+	buf->offset = stream->end;
+	stream->end += len;
+	g_queue_push_tail(&stream->buffers, buf);
+	buf = NULL;
+end:
+	pthread_mutex_unlock(&stream->lock);
+	g_free(buf);
+	return ret;
+}
+
+void bt_ctf_packet_stream_close(struct bt_ctf_packet_stream *stream)
+{
+	if (!stream) {
+		return;
+	}
+	pthread_mutex_lock(&stream->lock);
+	stream->closed = 1;
+	pthread_mutex_unlock(&stream->lock);
+}
+
+struct bt_mmap_stream *bt_ctf_packet_stream_mmap_stream(
+		struct bt_ctf_packet_stream *stream)
+{
+	if (!stream) {
+		return NULL;
+	}
+	return &stream->mmap_stream;
+}
+
+struct bt_ctf_packet_stream *ctf_packet_stream_from_mmap(
+		struct bt_mmap_stream *mmap_stream)
+{
+	struct bt_ctf_packet_stream *stream;
+
+	/* Only compares addresses: other mmap streams are not embedded. */
+	stream = container_of(mmap_stream, struct bt_ctf_packet_stream,
+		mmap_stream);
+	if (mmap_stream->fd != -1 || mmap_stream->priv != stream) {
+		return NULL;
+	}
+	return stream;
+}
+
+int ctf_packet_stream_next(struct bt_ctf_packet_stream *stream,
+		off_t offset, off_t *end)
+{
+	struct packet_buffer *buf;
+	int ret = 0;
+
+	pthread_mutex_lock(&stream->lock);
+	buf = buffer_lookup(stream, offset);
+	if (!buf) {
+		ret = stream->closed ? EOF : -EAGAIN;
+	} else if (buf->offset != offset) {
+		/* The packets of the previous buffer overflow it. */
+		ret = -EINVAL;
+	} else {
+		*end = buf->offset + buf->len;
+	}
+	pthread_mutex_unlock(&stream->lock);
+	return ret;
+}
+
+off_t ctf_packet_stream_begin(struct bt_ctf_packet_stream *stream)
+{
+	/* Only updated by the reader */
+	return stream->begin;
+}
+
+struct mmap_align *ctf_packet_stream_map(struct bt_ctf_packet_stream *stream,
+		size_t length, off_t offset)
+{
+	struct packet_buffer *buf;
+	struct mmap_align *mma;
+
+	pthread_mutex_lock(&stream->lock);
+	buf = buffer_lookup(stream, offset);
+	pthread_mutex_unlock(&stream->lock);
+	if (!buf || offset + length > buf->offset + buf->len) {
+		fprintf(stderr, "[error] Packet at offset %zd is not within a single buffer.\n",
+			(ssize_t) offset);
+		errno = EINVAL;
+		return MAP_FAILED;
+	}
+	mma = malloc(sizeof(*mma));
+	if (!mma) {
+		return MAP_FAILED;
+	}
+	mma->page_aligned_addr = NULL;
+	mma->page_aligned_length = 0;
+	/* Never written: the reader maps with PROT_READ. */
+	mma->addr = (char *) buf->data + (offset - buf->offset);
+	mma->length = length;
+	return mma;
+}
+
+void ctf_packet_stream_unmap(struct bt_ctf_packet_stream *stream,
+		struct mmap_align *mma)
+{
+	free(mma);
+}
+
+void ctf_packet_stream_release(struct bt_ctf_packet_stream *stream,
+		off_t offset)
+{
+	GQueue released = G_QUEUE_INIT;
+	struct packet_buffer *buf;
+
+	pthread_mutex_lock(&stream->lock);
+	while ((buf = g_queue_peek_head(&stream->buffers))) {
+		if (buf->offset + buf->len > offset) {
+			break;
+		}
+		g_queue_pop_head(&stream->buffers);
+		g_queue_push_tail(&released, buf);
+		stream->begin = buf->offset + buf->len;
+	}
+	pthread_mutex_unlock(&stream->lock);
+	/* The callbacks may push packets, call them without the lock. */
+	while ((buf = g_queue_pop_head(&released))) {
+		buffer_release(buf);
+	}
+}
@@ -0,0 +1,569 @@
+/*
+ * snapshot.c
+ *
+ * Babeltrace Library
+ *
+ * CTF event snapshots, copied into arenas to outlive the iterator.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <babeltrace/babeltrace.h>
+#include <babeltrace/ctf/snapshot.h>
+#include <babeltrace/ctf/events.h>
+#include <babeltrace/ctf-ir/metadata.h>
+#include <babeltrace/iterator-internal.h>
+#include <babeltrace/ctf/events-internal.h>
+#include <babeltrace/types.h>
+#include <string.h>
+#include <errno.h>
+#include <glib.h>
+
+/* Allocations larger than this get a block of their own. */
+#define ARENA_BLOCK_SIZE	(256 * 1024)
+#define ARENA_LARGE_SIZE	(ARENA_BLOCK_SIZE / 4)
+#define ARENA_ALIGN		sizeof(uint64_t)
+
+#define NR_SCOPES		(BT_EVENT_FIELDS + 1)
+
+/* Priority of the scopes when looking a field up by name */
+static const enum bt_ctf_scope field_scopes[NR_SCOPES] = {
+	BT_EVENT_FIELDS,
+	BT_EVENT_CONTEXT,
+	BT_STREAM_EVENT_CONTEXT,
+	BT_STREAM_EVENT_HEADER,
+	BT_STREAM_PACKET_CONTEXT,
+	BT_TRACE_PACKET_HEADER,
+};
+
+struct snapshot_layout_key {
+	int handle_id;
+	uint64_t stream_id;
+	uint64_t event_id;
+};
+
+/*
+ * Fields of an event class of a stream class, shared by its snapshots.
+ * The top-level fields of a snapshot are stored by scope, in the order
+ * of enum bt_ctf_scope.
+ */
+struct snapshot_layout {
+	struct snapshot_layout_key key;
+	const char *event_name;
+	unsigned int nr_fields;
+	unsigned int scope_begin[NR_SCOPES];
+	unsigned int scope_len[NR_SCOPES];
+	GHashTable *fields_by_name;	/* GQuark to field index + 1 */
+};
+
+struct bt_ctf_event_snapshot {
+	const struct snapshot_layout *layout;
+	uint64_t cycles;
+	uint64_t timestamp;
+	struct bt_ctf_snapshot_field fields[];
+};
+
+struct bt_ctf_snapshot_arena {
+	GPtrArray *blocks;	/* ARENA_BLOCK_SIZE blocks, kept on reset */
+	GPtrArray *large;	/* large allocations, freed on reset */
+	unsigned int cur_block;
+	size_t block_used;	/* bytes used in the current block */
+	size_t size;		/* bytes used by the snapshots */
+	struct bt_context *ctx;
+	GHashTable *layouts;	/* struct snapshot_layout_key to layout */
+};
+
+static
+guint layout_key_hash(gconstpointer key)
+{
+	const struct snapshot_layout_key *k = key;
+
+	return (guint) k->handle_id ^ (guint) (k->stream_id * 31) ^
+		(guint) (k->event_id * 1000003);
+}
+
+static
+gboolean layout_key_equal(gconstpointer a, gconstpointer b)
+{
+	const struct snapshot_layout_key *ka = a, *kb = b;
+
+	return ka->handle_id == kb->handle_id &&
+		ka->stream_id == kb->stream_id &&
+		ka->event_id == kb->event_id;
+}
+
+static
+void layout_destroy(gpointer data)
+{
+	struct snapshot_layout *layout = data;
+
+	g_hash_table_destroy(layout->fields_by_name);
+	g_free(layout);
+}
+
+struct bt_ctf_snapshot_arena *bt_ctf_snapshot_arena_create(void)
+{
+	struct bt_ctf_snapshot_arena *arena;
+
+	arena = g_new0(struct bt_ctf_snapshot_arena, 1);
+	arena->blocks = g_ptr_array_new_with_free_func(g_free);
+	arena->large = g_ptr_array_new_with_free_func(g_free);
+	arena->layouts = g_hash_table_new_full(layout_key_hash,
+		layout_key_equal, NULL, layout_destroy);
+	return arena;
+}
+
+void bt_ctf_snapshot_arena_destroy(struct bt_ctf_snapshot_arena *arena)
+{
+	if (!arena)
+		return;
+	g_ptr_array_free(arena->blocks, TRUE);
+	g_ptr_array_free(arena->large, TRUE);
+	g_hash_table_destroy(arena->layouts);
+	g_free(arena);
+}
+
+void bt_ctf_snapshot_arena_reset(struct bt_ctf_snapshot_arena *arena)
+{
+	if (!arena)
+		return;
+	g_ptr_array_set_size(arena->large, 0);
+	arena->cur_block = 0;
+	arena->block_used = 0;
+	arena->size = 0;
+}
+
+size_t bt_ctf_snapshot_arena_get_size(const struct bt_ctf_snapshot_arena *arena)
+{
+	if (!arena)
+		return 0;
+	return arena->size;
+}
+
+/*
+ * Allocate "len" bytes in the arena, aligned on ARENA_ALIGN. Small
+ * allocations are carved out of the current block, moving to the next
+ * block (allocated if needed) when it is full.
+ */
+static
+void *arena_alloc(struct bt_ctf_snapshot_arena *arena, size_t len)
+{
+	void *ret;
+
+	len = (len + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+	arena->size += len;
+	if (len > ARENA_LARGE_SIZE) {
+		ret = g_malloc(len);
+		g_ptr_array_add(arena->large, ret);
+		return ret;
+	}
+	if (arena->cur_block < arena->blocks->len &&
+			arena->block_used + len > ARENA_BLOCK_SIZE) {
+		arena->cur_block++;
+		arena->block_used = 0;
+	}
+	if (arena->cur_block == arena->blocks->len)
+		g_ptr_array_add(arena->blocks, g_malloc(ARENA_BLOCK_SIZE));
+	ret = (char *) g_ptr_array_index(arena->blocks, arena->cur_block) +
+		arena->block_used;
+	arena->block_used += len;
+	return ret;
+}
+
+static
+const char *arena_strndup(struct bt_ctf_snapshot_arena *arena,
+		const char *str, size_t len)
+{
+	char *copy;
+
+	copy = arena_alloc(arena, len + 1);
+	memcpy(copy, str, len);
+	copy[len] = '\0';
+	return copy;
+}
+
+static
+int is_text_element(const struct bt_declaration *elem)
+{
+	const struct declaration_integer *integer;
+
+	if (elem->id != CTF_TYPE_INTEGER)
+		return 0;
+	integer = container_of(elem, const struct declaration_integer, p);
+	return integer->len == CHAR_BIT &&
+		(integer->encoding == CTF_STRING_UTF8 ||
+		integer->encoding == CTF_STRING_ASCII);
+}
+
+static
+int copy_field(struct bt_ctf_snapshot_arena *arena,
+		struct bt_ctf_snapshot_field *copy,
+		const struct bt_definition *field, const char *name);
+
+static
+int copy_elements(struct bt_ctf_snapshot_arena *arena,
+		struct bt_ctf_snapshot_field *copy,
+		const struct bt_definition *field, GString *string,
+		const struct bt_declaration *elem, uint64_t len)
+{
+	struct bt_ctf_snapshot_field *elems;
+	const void *values;
+	uint64_t i, values_len;
+	size_t elem_len;
+
+	copy->len = len;
+	if (string && is_text_element(elem)) {
+		copy->flags |= BT_CTF_SNAPSHOT_FIELD_TEXT;
+		copy->str = arena_strndup(arena, string->str, string->len);
+		return 0;
+	}
+	values = bt_get_int_array_values(field, &values_len, &elem_len);
+	if (values) {
+		void *packed;
+
+		copy->flags |= BT_CTF_SNAPSHOT_FIELD_PACKED;
+		if (container_of(elem, const struct declaration_integer,
+				p)->signedness)
+			copy->flags |= BT_CTF_SNAPSHOT_FIELD_SIGNED;
+		copy->elem_len = elem_len;
+		packed = arena_alloc(arena, values_len * elem_len / CHAR_BIT);
+		memcpy(packed, values, values_len * elem_len / CHAR_BIT);
+		copy->u.values = packed;
+		return 0;
+	}
+	elems = arena_alloc(arena, len * sizeof(*elems));
+	copy->u.fields = elems;
+	for (i = 0; i < len; i++) {
+		struct bt_definition *elem_field;
+		int ret;
+
+		if (field->declaration->id == CTF_TYPE_ARRAY)
+			elem_field = bt_array_index(container_of(field,
+				struct definition_array, p), i);
+		else
+			elem_field = bt_sequence_index(container_of(field,
+				struct definition_sequence, p), i);
+		ret = copy_field(arena, &elems[i], elem_field, NULL);
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
+static
+int copy_struct(struct bt_ctf_snapshot_arena *arena,
+		struct bt_ctf_snapshot_field *copy, GPtrArray *fields)
+{
+	struct bt_ctf_snapshot_field *members;
+	unsigned int i;
+
+	copy->len = fields->len;
+	members = arena_alloc(arena, fields->len * sizeof(*members));
+	copy->u.fields = members;
+	for (i = 0; i < fields->len; i++) {
+		const struct bt_definition *member =
+			g_ptr_array_index(fields, i);
+		int ret;
+
+		ret = copy_field(arena, &members[i], member,
+			bt_ctf_field_name(member));
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
+/*
+ * Copy the last value read of "field" into "copy". Names and enumeration
+ * labels are quark strings, which live as long as the process, so only
+ * their pointers are copied.
+ */
+static
+int copy_field(struct bt_ctf_snapshot_arena *arena,
+		struct bt_ctf_snapshot_field *copy,
+		const struct bt_definition *field, const char *name)
+{
+	if (!field)
+		return -EINVAL;
+	memset(copy, 0, sizeof(*copy));
+	copy->name = name;
+	copy->type = field->declaration->id;
+	switch (copy->type) {
+	case CTF_TYPE_INTEGER:
+	{
+		const struct definition_integer *integer =
+			container_of(field, const struct definition_integer, p);
+
+		if (integer->declaration->signedness)
+			copy->flags |= BT_CTF_SNAPSHOT_FIELD_SIGNED;
+		copy->u._unsigned = integer->value._unsigned;
+		return 0;
+	}
+	case CTF_TYPE_FLOAT:
+		copy->u._float = container_of(field,
+			const struct definition_float, p)->value;
+		return 0;
+	case CTF_TYPE_ENUM:
+	{
+		const struct definition_enum *enumeration =
+			container_of(field, const struct definition_enum, p);
+
+		if (enumeration->integer->declaration->signedness)
+			copy->flags |= BT_CTF_SNAPSHOT_FIELD_SIGNED;
+		copy->u._unsigned = enumeration->integer->value._unsigned;
+		copy->str = bt_ctf_get_enum_str(field);
+		/* A value matching no label is not an error here. */
+		(void) bt_ctf_field_get_error();
+		return 0;
+	}
+	case CTF_TYPE_STRING:
+	{
+		const struct definition_string *string =
+			container_of(field, const struct definition_string, p);
+		size_t len = string->value ? strlen(string->value) : 0;
+
+		copy->len = len;
+		copy->str = arena_strndup(arena, string->value ? : "", len);
+		return 0;
+	}
+	case CTF_TYPE_STRUCT:
+		return copy_struct(arena, copy, container_of(field,
+			const struct definition_struct, p)->fields);
+	case CTF_TYPE_VARIANT:
+	{
+		const struct definition_variant *variant =
+			container_of(field, const struct definition_variant, p);
+		struct bt_ctf_snapshot_field *selected;
+
+		selected = arena_alloc(arena, sizeof(*selected));
+		copy->len = 1;
+		copy->u.fields = selected;
+		return copy_field(arena, selected, variant->current_field,
+			bt_ctf_field_name(variant->current_field));
+	}
+	case CTF_TYPE_ARRAY:
+	{
+		const struct definition_array *array =
+			container_of(field, const struct definition_array, p);
+
+		return copy_elements(arena, copy, field, array->string,
+			array->declaration->elem, array->declaration->len);
+	}
+	case CTF_TYPE_SEQUENCE:
+	{
+		struct definition_sequence *sequence =
+			container_of(field, struct definition_sequence, p);
+
+		return copy_elements(arena, copy, field, sequence->string,
+			sequence->declaration->elem,
+			bt_sequence_len(sequence));
+	}
+	default:
+		return -EINVAL;
+	}
+}
+
+static
+struct snapshot_layout *get_layout(struct bt_ctf_snapshot_arena *arena,
+		const struct bt_ctf_event *event)
+{
+	const struct ctf_stream_definition *stream = event->parent->stream;
+	struct snapshot_layout_key key;
+	struct snapshot_layout *layout;
+	int i;
+
+	key.handle_id = bt_ctf_event_get_handle_id(event);
+	key.stream_id = stream->stream_id;
+	key.event_id = stream->event_id;
+	layout = g_hash_table_lookup(arena->layouts, &key);
+	if (layout)
+		return layout;
+
+	layout = g_new0(struct snapshot_layout, 1);
+	layout->key = key;
+	layout->event_name = bt_ctf_event_name(event);
+	layout->fields_by_name = g_hash_table_new(g_direct_hash,
+		g_direct_equal);
+	for (i = 0; i < NR_SCOPES; i++) {
+		const struct bt_definition *scope;
+		struct bt_definition const * const *list;
+		unsigned int count;
+
+		layout->scope_begin[i] = layout->nr_fields;
+		scope = bt_ctf_get_top_level_scope(event, i);
+		if (!scope || bt_ctf_get_field_list(event, scope, &list,
+				&count) < 0)
+			continue;
+		layout->scope_len[i] = count;
+		layout->nr_fields += count;
+	}
+	/* Index the names by decreasing scope priority. */
+	for (i = 0; i < NR_SCOPES; i++) {
+		enum bt_ctf_scope scope_id = field_scopes[i];
+		const struct bt_definition *scope;
+		struct bt_definition const * const *list;
+		unsigned int j, count;
+
+		if (!layout->scope_len[scope_id])
+			continue;
+		scope = bt_ctf_get_top_level_scope(event, scope_id);
+		bt_ctf_get_field_list(event, scope, &list, &count);
+		for (j = 0; j < count; j++) {
+			gpointer name = GUINT_TO_POINTER(g_quark_from_string(
+				bt_ctf_field_name(list[j])));
+
+			if (g_hash_table_lookup(layout->fields_by_name, name))
+				continue;
+			g_hash_table_insert(layout->fields_by_name, name,
+				GUINT_TO_POINTER(layout->scope_begin[scope_id]
+					+ j + 1));
+		}
+	}
+	g_hash_table_insert(arena->layouts, &layout->key, layout);
+	return layout;
+}
+
+const struct bt_ctf_event_snapshot *bt_ctf_event_snapshot_create(
+		struct bt_ctf_snapshot_arena *arena,
+		const struct bt_ctf_event *event)
+{
+	struct bt_ctf_event_snapshot *snapshot;
+	const struct snapshot_layout *layout;
+	struct bt_context *ctx;
+	int i;
+
+	if (!arena || !event)
+		return NULL;
+	ctx = bt_ctf_event_get_context(event);
+	if (!ctx || (arena->ctx && arena->ctx != ctx))
+		return NULL;
+	arena->ctx = ctx;
+
+	layout = get_layout(arena, event);
+	snapshot = arena_alloc(arena, sizeof(*snapshot) +
+		layout->nr_fields * sizeof(snapshot->fields[0]));
+	snapshot->layout = layout;
+	snapshot->cycles = bt_ctf_get_cycles(event);
+	snapshot->timestamp = bt_ctf_get_timestamp(event);
+	for (i = 0; i < NR_SCOPES; i++) {
+		const struct bt_definition *scope;
+		struct bt_definition const * const *list;
+		unsigned int j, count;
+
+		if (!layout->scope_len[i])
+			continue;
+		scope = bt_ctf_get_top_level_scope(event, i);
+		bt_ctf_get_field_list(event, scope, &list, &count);
+		for (j = 0; j < count; j++) {
+			if (copy_field(arena,
+					&snapshot->fields[layout->scope_begin[i] + j],
+					list[j], bt_ctf_field_name(list[j])))
+				return NULL;
+		}
+	}
+	return snapshot;
+}
+
+const char *bt_ctf_event_snapshot_name(
+		const struct bt_ctf_event_snapshot *snapshot)
+{
+	if (!snapshot)
+		return NULL;
+	return snapshot->layout->event_name;
+}
+
+uint64_t bt_ctf_event_snapshot_get_cycles(
+		const struct bt_ctf_event_snapshot *snapshot)
+{
+	if (!snapshot)
+		return -1ULL;
+	return snapshot->cycles;
+}
+
+uint64_t bt_ctf_event_snapshot_get_timestamp(
+		const struct bt_ctf_event_snapshot *snapshot)
+{
+	if (!snapshot)
+		return -1ULL;
+	return snapshot->timestamp;
+}
+
+int bt_ctf_event_snapshot_get_handle_id(
+		const struct bt_ctf_event_snapshot *snapshot)
+{
+	if (!snapshot)
+		return -EINVAL;
+	return snapshot->layout->key.handle_id;
+}
+
+unsigned int bt_ctf_event_snapshot_get_field_count(
+		const struct bt_ctf_event_snapshot *snapshot,
+		enum bt_ctf_scope scope)
+{
+	if (!snapshot || (int) scope < 0 || scope >= NR_SCOPES)
+		return 0;
+	return snapshot->layout->scope_len[scope];
+}
+
+const struct bt_ctf_snapshot_field *bt_ctf_event_snapshot_get_field_index(
+		const struct bt_ctf_event_snapshot *snapshot,
+		enum bt_ctf_scope scope, unsigned int index)
+{
+	const struct snapshot_layout *layout;
+
+	if (!snapshot || (int) scope < 0 || scope >= NR_SCOPES)
+		return NULL;
+	layout = snapshot->layout;
+	if (index >= layout->scope_len[scope])
+		return NULL;
+	return &snapshot->fields[layout->scope_begin[scope] + index];
+}
+
+const struct bt_ctf_snapshot_field *bt_ctf_event_snapshot_get_field(
+		const struct bt_ctf_event_snapshot *snapshot,
+		const char *name)
+{
+	GQuark quark;
+	unsigned int index;
+
+	if (!snapshot || !name)
+		return NULL;
+	quark = g_quark_try_string(name);
+	if (!quark)
+		return NULL;
+	index = GPOINTER_TO_UINT(g_hash_table_lookup(
+		snapshot->layout->fields_by_name, GUINT_TO_POINTER(quark)));
+	if (!index)
+		return NULL;
+	return &snapshot->fields[index - 1];
+}
+
+const struct bt_ctf_snapshot_field *bt_ctf_snapshot_field_get_member(
+		const struct bt_ctf_snapshot_field *field, const char *name)
+{
+	uint64_t i;
+
+	if (!field || !name || field->type != CTF_TYPE_STRUCT)
+		return NULL;
+	for (i = 0; i < field->len; i++) {
+		if (!strcmp(field->u.fields[i].name, name))
+			return &field->u.fields[i];
+	}
+	return NULL;
+}
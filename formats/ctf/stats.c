@@ -0,0 +1,992 @@
+/*
+ * stats.c
+ *
+ * Babeltrace Library
+ *
+ * CTF trace statistics, computed from the packet index.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <babeltrace/babeltrace.h>
+#include <babeltrace/context-internal.h>
+#include <babeltrace/trace-collection.h>
+#include <babeltrace/trace-handle-internal.h>
+#include <babeltrace/ctf/stats.h>
+#include <babeltrace/ctf/types.h>
+#include <babeltrace/ctf/metadata.h>
+#include <babeltrace/ctf/events-internal.h>
+#include <babeltrace/ctf/ctf-index.h>
+#include <babeltrace/endian.h>
+#include <sys/stat.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <glib.h>
+
+#define EVENT_RATE_PATH			"index/%s.rate"
+#define EVENT_IDS_PATH			"index/%s.ids"
+/* Bound the counts of packets with bogus timestamps. */
+#define EVENT_RATE_MAX_PACKET_BUCKETS	(1ULL << 20)
+
+/*
+ * Number of events discarded between the previous packet and this one,
+ * from the cumulative counter of the packet contexts.
+ */
+static
+uint64_t packet_events_discarded(struct packet_index *prev_index,
+		struct packet_index *cur_index)
+{
+	uint64_t diff = cur_index->events_discarded;
+
+	if (prev_index) {
+		diff -= prev_index->events_discarded;
+		/* Deal with 32-bit wrap-around. */
+		if (prev_index->events_discarded_len == 32)
+			diff = (uint32_t) diff;
+	}
+	return diff;
+}
+
+static
+void stats_stream_index(struct bt_ctf_stream_stats *sstats,
+		struct ctf_file_stream *file_stream)
+{
+	struct ctf_stream_definition *stream = &file_stream->parent;
+	GArray *packet_index = file_stream->pos.packet_index;
+	uint64_t i;
+
+	sstats->path = stream->path;
+	sstats->handle_id = stream->stream_class->trace->parent.handle->id;
+	sstats->stream_id = stream->stream_id;
+	sstats->cpu_id = -1;
+	sstats->nr_packets = packet_index->len;
+	sstats->timestamp_begin = -1ULL;
+	sstats->timestamp_end = 0;
+
+	for (i = 0; i < packet_index->len; i++) {
+		struct packet_index *index, *prev_index = NULL;
+
+		index = &g_array_index(packet_index, struct packet_index, i);
+		if (i > 0)
+			prev_index = &g_array_index(packet_index,
+					struct packet_index, i - 1);
+		sstats->events_discarded +=
+			packet_events_discarded(prev_index, index);
+		/* The cpu_id is constant within a stream. */
+		if (sstats->cpu_id < 0)
+			sstats->cpu_id = index->cpu_id;
+		sstats->content_bytes += index->content_size / CHAR_BIT;
+		sstats->packet_bytes += index->packet_size / CHAR_BIT;
+		if (index->ts_real.timestamp_begin < sstats->timestamp_begin)
+			sstats->timestamp_begin = index->ts_real.timestamp_begin;
+		if (index->ts_real.timestamp_end > sstats->timestamp_end)
+			sstats->timestamp_end = index->ts_real.timestamp_end;
+	}
+	if (!packet_index->len)
+		sstats->timestamp_begin = 0;
+}
+
+/*
+ * Count the events of one packet out of "sample_every" of the stream,
+ * by event id, adding the counts scaled to the number of packets of
+ * the stream into "counts".
+ */
+static
+int stats_stream_event_counts(struct ctf_file_stream *file_stream,
+		GArray *counts, unsigned int sample_every)
+{
+	struct ctf_stream_definition *stream = &file_stream->parent;
+	struct ctf_stream_pos *pos = &file_stream->pos;
+	uint64_t nr_packets = pos->packet_index->len;
+	uint64_t nr_sampled = 0, i, id;
+	GArray *stream_counts;
+	int ret = 0;
+
+	if (!nr_packets)
+		return 0;
+	stream_counts = g_array_sized_new(FALSE, TRUE, sizeof(uint64_t),
+			counts->len);
+	g_array_set_size(stream_counts, counts->len);
+
+	for (i = 0; i < nr_packets; i += sample_every) {
+		nr_sampled++;
+		pos->packet_seek(&pos->parent, i, SEEK_SET);
+		if (pos->offset == EOF || pos->cur_index != i)
+			continue;	/* Packet without event */
+		for (;;) {
+			ret = pos->parent.event_cb(&pos->parent, stream);
+			/* Stop at the end of the packet. */
+			if (ret == EOF || ret == EAGAIN || pos->cur_index != i) {
+				ret = 0;
+				break;
+			}
+			if (ret) {
+				fprintf(stderr, "[error] Unable to read event of stream %s.\n",
+					stream->path);
+				goto end;
+			}
+			if (stream->event_id >= stream_counts->len)
+				continue;
+			g_array_index(stream_counts, uint64_t, stream->event_id)++;
+		}
+	}
+
+	for (id = 0; id < stream_counts->len; id++) {
+		uint64_t count = g_array_index(stream_counts, uint64_t, id);
+
+		if (nr_sampled != nr_packets)
+			count = (uint64_t) ((double) count * nr_packets
+					/ nr_sampled + 0.5);
+		g_array_index(counts, uint64_t, id) += count;
+	}
+end:
+	g_array_free(stream_counts, TRUE);
+	return ret;
+}
+
+static
+int stats_stream_class(struct ctf_stream_declaration *stream_class,
+		int handle_id, GArray *streams, GArray *event_classes,
+		int flags, unsigned int sample_every)
+{
+	GArray *counts = NULL;
+	uint64_t i;
+	int ret = 0;
+
+	if (flags & BT_CTF_STATS_EVENT_COUNTS) {
+		counts = g_array_sized_new(FALSE, TRUE, sizeof(uint64_t),
+				stream_class->events_by_id->len);
+		g_array_set_size(counts, stream_class->events_by_id->len);
+	}
+
+	for (i = 0; i < stream_class->streams->len; i++) {
+		struct ctf_stream_definition *stream;
+		struct ctf_file_stream *file_stream;
+		struct bt_ctf_stream_stats sstats;
+
+		stream = g_ptr_array_index(stream_class->streams, i);
+		if (!stream)
+			continue;
+		file_stream = container_of(stream, struct ctf_file_stream,
+				parent);
+		memset(&sstats, 0, sizeof(sstats));
+		stats_stream_index(&sstats, file_stream);
+		g_array_append_val(streams, sstats);
+
+		if (counts) {
+			ret = stats_stream_event_counts(file_stream, counts,
+					sample_every);
+			if (ret)
+				goto end;
+		}
+	}
+
+	if (!counts)
+		goto end;
+	for (i = 0; i < stream_class->events_by_id->len; i++) {
+		struct ctf_event_declaration *event;
+		struct bt_ctf_event_class_stats estats;
+
+		event = g_ptr_array_index(stream_class->events_by_id, i);
+		if (!event)
+			continue;
+		estats.name = g_quark_to_string(event->name);
+		estats.handle_id = handle_id;
+		estats.stream_id = stream_class->stream_id;
+		estats.event_id = event->id;
+		estats.count = g_array_index(counts, uint64_t, i);
+		g_array_append_val(event_classes, estats);
+	}
+end:
+	if (counts)
+		g_array_free(counts, TRUE);
+	return ret;
+}
+
+struct bt_ctf_stats *bt_ctf_stats_create(struct bt_context *ctx,
+		int flags, unsigned int sample_every)
+{
+	struct bt_ctf_stats *stats;
+	GArray *streams, *event_classes;
+	unsigned int i;
+	uint64_t j;
+	int ret;
+
+	if (!ctx || !ctx->tc)
+		return NULL;
+	/* Decoding packets would move the positions of the iterator. */
+	if ((flags & BT_CTF_STATS_EVENT_COUNTS) && ctx->current_iterator) {
+		fprintf(stderr, "[error] Cannot count events while an iterator exists on the context.\n");
+		return NULL;
+	}
+	if (sample_every == 0)
+		sample_every = 1;
+
+	streams = g_array_new(FALSE, TRUE, sizeof(struct bt_ctf_stream_stats));
+	event_classes = g_array_new(FALSE, TRUE,
+			sizeof(struct bt_ctf_event_class_stats));
+
+	for (i = 0; i < ctx->tc->array->len; i++) {
+		struct bt_trace_descriptor *td;
+		struct ctf_trace *trace;
+
+		td = g_ptr_array_index(ctx->tc->array, i);
+		if (!td)
+			continue;
+		trace = container_of(td, struct ctf_trace, parent);
+		for (j = 0; j < trace->streams->len; j++) {
+			struct ctf_stream_declaration *stream_class;
+
+			stream_class = g_ptr_array_index(trace->streams, j);
+			if (!stream_class)
+				continue;
+			ret = stats_stream_class(stream_class, td->handle->id,
+					streams, event_classes, flags,
+					sample_every);
+			if (ret)
+				goto error;
+		}
+	}
+
+	stats = g_new0(struct bt_ctf_stats, 1);
+	stats->timestamp_begin = -1ULL;
+	for (i = 0; i < streams->len; i++) {
+		struct bt_ctf_stream_stats *sstats;
+
+		sstats = &g_array_index(streams, struct bt_ctf_stream_stats, i);
+		stats->nr_packets += sstats->nr_packets;
+		stats->events_discarded += sstats->events_discarded;
+		stats->content_bytes += sstats->content_bytes;
+		stats->packet_bytes += sstats->packet_bytes;
+		if (!sstats->nr_packets)
+			continue;
+		if (sstats->timestamp_begin < stats->timestamp_begin)
+			stats->timestamp_begin = sstats->timestamp_begin;
+		if (sstats->timestamp_end > stats->timestamp_end)
+			stats->timestamp_end = sstats->timestamp_end;
+	}
+	if (!stats->nr_packets)
+		stats->timestamp_begin = 0;
+	stats->nr_streams = streams->len;
+	stats->streams = (struct bt_ctf_stream_stats *)
+		g_array_free(streams, FALSE);
+	stats->nr_event_classes = event_classes->len;
+	stats->event_classes = (struct bt_ctf_event_class_stats *)
+		g_array_free(event_classes, FALSE);
+	return stats;
+
+error:
+	g_array_free(streams, TRUE);
+	g_array_free(event_classes, TRUE);
+	return NULL;
+}
+
+void bt_ctf_stats_destroy(struct bt_ctf_stats *stats)
+{
+	if (!stats)
+		return;
+	g_free(stats->streams);
+	g_free(stats->event_classes);
+	g_free(stats);
+}
+
+/*
+ * Buckets spanned by a packet, 0 if it has no timestamps.
+ */
+static
+uint64_t packet_first_bucket(struct packet_index *index, uint64_t bucket_ns)
+{
+	return index->ts_real.timestamp_begin / bucket_ns;
+}
+
+static
+uint64_t packet_nr_buckets(struct packet_index *index, uint64_t bucket_ns)
+{
+	uint64_t first, last;
+
+	if (!index->ts_cycles.timestamp_end)
+		return 0;
+	first = index->ts_real.timestamp_begin / bucket_ns;
+	last = index->ts_real.timestamp_end / bucket_ns;
+	if (last < first)
+		return 1;
+	if (last - first >= EVENT_RATE_MAX_PACKET_BUCKETS)
+		return EVENT_RATE_MAX_PACKET_BUCKETS;
+	return last - first + 1;
+}
+
+static
+void event_rate_reset(struct ctf_file_stream *file_stream, uint64_t bucket_ns)
+{
+	if (file_stream->event_rate_packets) {
+		g_array_set_size(file_stream->event_rate_packets, 0);
+		g_array_set_size(file_stream->event_rate_counts, 0);
+	} else {
+		file_stream->event_rate_packets = g_array_new(FALSE, TRUE,
+				sizeof(struct ctf_event_rate_packet));
+		file_stream->event_rate_counts = g_array_new(FALSE, TRUE,
+				sizeof(uint32_t));
+	}
+	file_stream->event_rate_bucket_ns = bucket_ns;
+}
+
+/*
+ * Append the entry of a packet spanning "nr_buckets" buckets, its
+ * counts zeroed.
+ */
+static
+struct ctf_event_rate_packet *event_rate_add_packet(
+		struct ctf_file_stream *file_stream, uint64_t first_bucket,
+		uint64_t nr_buckets)
+{
+	GArray *packets = file_stream->event_rate_packets;
+	GArray *counts = file_stream->event_rate_counts;
+	struct ctf_event_rate_packet rate;
+
+	rate.nr_events = 0;
+	rate.first_bucket = first_bucket;
+	rate.nr_buckets = nr_buckets;
+	rate.counts_offset = counts->len;
+	g_array_set_size(counts, counts->len + nr_buckets);
+	g_array_append_val(packets, rate);
+	return &g_array_index(packets, struct ctf_event_rate_packet,
+			packets->len - 1);
+}
+
+/*
+ * Load the event rate index of a stream from its file. Returns 0 on
+ * success, a negative value if there is no such file or if it does not
+ * match the bucket duration or the packet index.
+ */
+static
+int event_rate_load(struct ctf_trace *trace,
+		struct ctf_file_stream *file_stream, uint64_t bucket_ns)
+{
+	GArray *packet_index = file_stream->pos.packet_index;
+	struct ctf_event_rate_file_hdr hdr;
+	gchar *name;
+	FILE *fp = NULL;
+	uint64_t i, j;
+	int fd, ret = -1;
+
+	if (!file_stream->parent.path[0])
+		return -1;
+	name = g_strdup_printf(EVENT_RATE_PATH, file_stream->parent.path);
+	fd = openat(trace->dirfd, name, O_RDONLY);
+	g_free(name);
+	if (fd < 0)
+		return -1;
+	fp = fdopen(fd, "r");
+	if (!fp) {
+		close(fd);
+		return -1;
+	}
+	if (fread(&hdr, sizeof(hdr), 1, fp) != 1 ||
+			be32toh(hdr.magic) != CTF_EVENT_RATE_MAGIC ||
+			be32toh(hdr.major) != CTF_EVENT_RATE_MAJOR ||
+			be64toh(hdr.bucket_ns) != bucket_ns ||
+			be64toh(hdr.nr_packets) != packet_index->len)
+		goto end;
+	event_rate_reset(file_stream, bucket_ns);
+	for (i = 0; i < packet_index->len; i++) {
+		struct packet_index *index;
+		struct ctf_event_rate_entry entry;
+		struct ctf_event_rate_packet *rate;
+		uint32_t *counts;
+
+		index = &g_array_index(packet_index, struct packet_index, i);
+		if (fread(&entry, sizeof(entry), 1, fp) != 1 ||
+				be64toh(entry.offset) != index->offset ||
+				be64toh(entry.nr_buckets) !=
+					packet_nr_buckets(index, bucket_ns))
+			goto end;
+		rate = event_rate_add_packet(file_stream,
+				be64toh(entry.first_bucket),
+				be64toh(entry.nr_buckets));
+		rate->nr_events = be64toh(entry.nr_events);
+		counts = &g_array_index(file_stream->event_rate_counts,
+				uint32_t, rate->counts_offset);
+		if (rate->nr_buckets && fread(counts, sizeof(uint32_t),
+				rate->nr_buckets, fp) != rate->nr_buckets)
+			goto end;
+		for (j = 0; j < rate->nr_buckets; j++)
+			counts[j] = be32toh(counts[j]);
+	}
+	ret = 0;
+end:
+	if (ret)
+		event_rate_reset(file_stream, 0);
+	fclose(fp);
+	return ret;
+}
+
+static
+int event_rate_save(struct ctf_trace *trace,
+		struct ctf_file_stream *file_stream)
+{
+	GArray *packet_index = file_stream->pos.packet_index;
+	struct ctf_event_rate_file_hdr hdr;
+	gchar *name;
+	FILE *fp;
+	uint64_t i, j;
+	int fd, ret = 0;
+
+	if (!file_stream->parent.path[0])
+		return 0;	/* Not backed by a file */
+	if (mkdirat(trace->dirfd, "index", S_IRWXU | S_IRWXG) &&
+			errno != EEXIST) {
+		perror("Event rate index mkdirat()");
+		return -errno;
+	}
+	name = g_strdup_printf(EVENT_RATE_PATH, file_stream->parent.path);
+	fd = openat(trace->dirfd, name, O_WRONLY | O_CREAT | O_TRUNC,
+			S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+	g_free(name);
+	if (fd < 0) {
+		perror("Event rate index openat()");
+		return -errno;
+	}
+	fp = fdopen(fd, "w");
+	if (!fp) {
+		close(fd);
+		return -errno;
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = htobe32(CTF_EVENT_RATE_MAGIC);
+	hdr.major = htobe32(CTF_EVENT_RATE_MAJOR);
+	hdr.minor = htobe32(CTF_EVENT_RATE_MINOR);
+	hdr.bucket_ns = htobe64(file_stream->event_rate_bucket_ns);
+	hdr.nr_packets = htobe64(packet_index->len);
+	if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1) {
+		ret = -EIO;
+		goto end;
+	}
+	for (i = 0; i < file_stream->event_rate_packets->len; i++) {
+		struct ctf_event_rate_packet *rate;
+		struct ctf_event_rate_entry entry;
+
+		rate = &g_array_index(file_stream->event_rate_packets,
+				struct ctf_event_rate_packet, i);
+		entry.offset = htobe64(g_array_index(packet_index,
+				struct packet_index, i).offset);
+		entry.nr_events = htobe64(rate->nr_events);
+		entry.first_bucket = htobe64(rate->first_bucket);
+		entry.nr_buckets = htobe64(rate->nr_buckets);
+		if (fwrite(&entry, sizeof(entry), 1, fp) != 1) {
+			ret = -EIO;
+			goto end;
+		}
+		for (j = 0; j < rate->nr_buckets; j++) {
+			uint32_t count = htobe32(g_array_index(
+					file_stream->event_rate_counts,
+					uint32_t, rate->counts_offset + j));
+
+			if (fwrite(&count, sizeof(count), 1, fp) != 1) {
+				ret = -EIO;
+				goto end;
+			}
+		}
+	}
+end:
+	if (fclose(fp) && !ret)
+		ret = -EIO;
+	if (ret)
+		fprintf(stderr, "[error] Unable to save the event rate index of stream %s.\n",
+			file_stream->parent.path);
+	return ret;
+}
+
+/*
+ * Decode the packets of a stream, counting their events per bucket of
+ * the real time of the events.
+ */
+static
+int event_rate_decode(struct ctf_file_stream *file_stream, uint64_t bucket_ns)
+{
+	struct ctf_stream_definition *stream = &file_stream->parent;
+	struct ctf_stream_pos *pos = &file_stream->pos;
+	uint64_t i;
+	int ret = 0;
+
+	event_rate_reset(file_stream, bucket_ns);
+	for (i = 0; i < pos->packet_index->len; i++) {
+		struct packet_index *index;
+		struct ctf_event_rate_packet *rate;
+		uint64_t nr_buckets;
+
+		index = &g_array_index(pos->packet_index, struct packet_index, i);
+		nr_buckets = packet_nr_buckets(index, bucket_ns);
+		rate = event_rate_add_packet(file_stream,
+				packet_first_bucket(index, bucket_ns),
+				nr_buckets);
+		pos->packet_seek(&pos->parent, i, SEEK_SET);
+		if (pos->offset == EOF || pos->cur_index != i)
+			continue;	/* Packet without event */
+		for (;;) {
+			uint64_t bucket;
+
+			ret = pos->parent.event_cb(&pos->parent, stream);
+			/* Stop at the end of the packet. */
+			if (ret == EOF || ret == EAGAIN || pos->cur_index != i) {
+				ret = 0;
+				break;
+			}
+			if (ret) {
+				fprintf(stderr, "[error] Unable to read event of stream %s.\n",
+					stream->path);
+				return ret;
+			}
+			/* The packet entry may have moved, look it up again. */
+			rate = &g_array_index(file_stream->event_rate_packets,
+					struct ctf_event_rate_packet, i);
+			rate->nr_events++;
+			if (!nr_buckets)
+				continue;
+			bucket = stream->real_timestamp / bucket_ns;
+			if (bucket < rate->first_bucket)
+				bucket = rate->first_bucket;
+			else if (bucket - rate->first_bucket >= nr_buckets)
+				bucket = rate->first_bucket + nr_buckets - 1;
+			g_array_index(file_stream->event_rate_counts, uint32_t,
+				rate->counts_offset + bucket -
+				rate->first_bucket)++;
+		}
+	}
+	return 0;
+}
+
+int bt_ctf_event_rate_index(struct bt_context *ctx, uint64_t bucket_ns,
+		int flags)
+{
+	unsigned int i;
+	uint64_t j, k;
+	int ret;
+
+	if (!ctx || !ctx->tc || !bucket_ns)
+		return -EINVAL;
+
+	for (i = 0; i < ctx->tc->array->len; i++) {
+		struct bt_trace_descriptor *td;
+		struct ctf_trace *trace;
+
+		td = g_ptr_array_index(ctx->tc->array, i);
+		if (!td)
+			continue;
+		trace = container_of(td, struct ctf_trace, parent);
+		for (j = 0; j < trace->streams->len; j++) {
+			struct ctf_stream_declaration *stream_class;
+
+			stream_class = g_ptr_array_index(trace->streams, j);
+			if (!stream_class)
+				continue;
+			for (k = 0; k < stream_class->streams->len; k++) {
+				struct ctf_stream_definition *stream;
+				struct ctf_file_stream *file_stream;
+
+				stream = g_ptr_array_index(stream_class->streams, k);
+				if (!stream)
+					continue;
+				file_stream = container_of(stream,
+						struct ctf_file_stream, parent);
+				if (!event_rate_load(trace, file_stream,
+						bucket_ns))
+					continue;
+				/* Decoding packets would move the positions of the iterator. */
+				if (ctx->current_iterator) {
+					fprintf(stderr, "[error] Cannot count events while an iterator exists on the context.\n");
+					return -EBUSY;
+				}
+				ret = event_rate_decode(file_stream, bucket_ns);
+				if (!ret && (flags & BT_CTF_EVENT_RATE_SAVE))
+					ret = event_rate_save(trace, file_stream);
+				if (ret) {
+					event_rate_reset(file_stream, 0);
+					return ret;
+				}
+			}
+		}
+	}
+	return 0;
+}
+
+/* Output bucket of a timestamp within [begin, end) */
+static
+unsigned int query_bucket(uint64_t timestamp, uint64_t begin, uint64_t end,
+		unsigned int nr_buckets)
+{
+	unsigned int bucket;
+
+	bucket = (double) (timestamp - begin) / (end - begin) * nr_buckets;
+	return bucket < nr_buckets ? bucket : nr_buckets - 1;
+}
+
+static
+void event_rate_query_stream(struct ctf_file_stream *file_stream,
+		uint64_t begin, uint64_t end, unsigned int nr_buckets,
+		uint64_t *counts)
+{
+	GArray *packet_index = file_stream->pos.packet_index;
+	uint64_t bucket_ns = file_stream->event_rate_bucket_ns;
+	uint64_t low = 0, high = packet_index->len, i, j;
+
+	/* First packet ending at or after "begin" */
+	while (low < high) {
+		uint64_t mid = low + (high - low) / 2;
+		struct packet_index *index;
+
+		index = &g_array_index(packet_index, struct packet_index, mid);
+		if (index->ts_real.timestamp_end < begin)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	for (i = low; i < packet_index->len; i++) {
+		struct packet_index *index;
+		struct ctf_event_rate_packet *rate;
+		uint64_t packet_begin, packet_end;
+
+		index = &g_array_index(packet_index, struct packet_index, i);
+		rate = &g_array_index(file_stream->event_rate_packets,
+				struct ctf_event_rate_packet, i);
+		packet_begin = index->ts_real.timestamp_begin;
+		packet_end = index->ts_real.timestamp_end;
+		if (packet_begin >= end)
+			break;
+		if (!rate->nr_events || !rate->nr_buckets)
+			continue;
+		/* Packets within a single output bucket only need their total. */
+		if (packet_begin >= begin && packet_end < end &&
+				query_bucket(packet_begin, begin, end, nr_buckets) ==
+				query_bucket(packet_end, begin, end, nr_buckets)) {
+			counts[query_bucket(packet_begin, begin, end,
+				nr_buckets)] += rate->nr_events;
+			continue;
+		}
+		for (j = 0; j < rate->nr_buckets; j++) {
+			uint32_t count;
+			uint64_t timestamp;
+
+			count = g_array_index(file_stream->event_rate_counts,
+					uint32_t, rate->counts_offset + j);
+			if (!count)
+				continue;
+			timestamp = j ? (rate->first_bucket + j) * bucket_ns :
+				packet_begin;
+			if (timestamp < begin || timestamp >= end)
+				continue;
+			counts[query_bucket(timestamp, begin, end,
+				nr_buckets)] += count;
+		}
+	}
+}
+
+int bt_ctf_event_rate_query(struct bt_context *ctx, uint64_t begin,
+		uint64_t end, unsigned int nr_buckets, uint64_t *counts)
+{
+	unsigned int i;
+	uint64_t j, k;
+
+	if (!ctx || !ctx->tc || end <= begin || !nr_buckets || !counts)
+		return -EINVAL;
+	memset(counts, 0, nr_buckets * sizeof(*counts));
+
+	for (i = 0; i < ctx->tc->array->len; i++) {
+		struct bt_trace_descriptor *td;
+		struct ctf_trace *trace;
+
+		td = g_ptr_array_index(ctx->tc->array, i);
+		if (!td)
+			continue;
+		trace = container_of(td, struct ctf_trace, parent);
+		for (j = 0; j < trace->streams->len; j++) {
+			struct ctf_stream_declaration *stream_class;
+
+			stream_class = g_ptr_array_index(trace->streams, j);
+			if (!stream_class)
+				continue;
+			for (k = 0; k < stream_class->streams->len; k++) {
+				struct ctf_stream_definition *stream;
+				struct ctf_file_stream *file_stream;
+
+				stream = g_ptr_array_index(stream_class->streams, k);
+				if (!stream)
+					continue;
+				file_stream = container_of(stream,
+						struct ctf_file_stream, parent);
+				if (!file_stream->event_rate_packets ||
+						!file_stream->event_rate_bucket_ns ||
+						file_stream->event_rate_packets->len !=
+						file_stream->pos.packet_index->len)
+					return -ENOENT;
+				event_rate_query_stream(file_stream, begin, end,
+						nr_buckets, counts);
+			}
+		}
+	}
+	return 0;
+}
+
+static
+void event_ids_reset(struct ctf_file_stream *file_stream, uint64_t nr_words)
+{
+	if (file_stream->packet_event_ids)
+		g_array_set_size(file_stream->packet_event_ids, 0);
+	else
+		file_stream->packet_event_ids = g_array_new(FALSE, TRUE,
+				sizeof(uint64_t));
+	file_stream->event_ids_words = nr_words;
+}
+
+static
+void event_ids_free(struct ctf_file_stream *file_stream)
+{
+	if (file_stream->packet_event_ids) {
+		g_array_free(file_stream->packet_event_ids, TRUE);
+		file_stream->packet_event_ids = NULL;
+	}
+	file_stream->event_ids_words = 0;
+}
+
+/*
+ * Load the event ids of the packets of a stream from its file. Returns
+ * 0 on success, a negative value if there is no such file or if it
+ * does not match the event classes or the packet index.
+ */
+static
+int event_ids_load(struct ctf_trace *trace,
+		struct ctf_file_stream *file_stream, uint64_t nr_words)
+{
+	GArray *packet_index = file_stream->pos.packet_index;
+	struct ctf_event_ids_file_hdr hdr;
+	gchar *name;
+	FILE *fp = NULL;
+	uint64_t i, j, *ids;
+	int fd, ret = -1;
+
+	if (!file_stream->parent.path[0])
+		return -1;
+	name = g_strdup_printf(EVENT_IDS_PATH, file_stream->parent.path);
+	fd = openat(trace->dirfd, name, O_RDONLY);
+	g_free(name);
+	if (fd < 0)
+		return -1;
+	fp = fdopen(fd, "r");
+	if (!fp) {
+		close(fd);
+		return -1;
+	}
+	if (fread(&hdr, sizeof(hdr), 1, fp) != 1 ||
+			be32toh(hdr.magic) != CTF_EVENT_IDS_MAGIC ||
+			be32toh(hdr.major) != CTF_EVENT_IDS_MAJOR ||
+			be64toh(hdr.nr_words) != nr_words ||
+			be64toh(hdr.nr_packets) != packet_index->len)
+		goto end;
+	event_ids_reset(file_stream, nr_words);
+	g_array_set_size(file_stream->packet_event_ids,
+			packet_index->len * nr_words);
+	for (i = 0; i < packet_index->len; i++) {
+		struct ctf_event_ids_entry entry;
+
+		if (fread(&entry, sizeof(entry), 1, fp) != 1 ||
+				be64toh(entry.offset) != g_array_index(packet_index,
+					struct packet_index, i).offset)
+			goto end;
+		ids = &g_array_index(file_stream->packet_event_ids, uint64_t,
+				i * nr_words);
+		if (fread(ids, sizeof(uint64_t), nr_words, fp) != nr_words)
+			goto end;
+		for (j = 0; j < nr_words; j++)
+			ids[j] = be64toh(ids[j]);
+	}
+	ret = 0;
+end:
+	if (ret)
+		event_ids_free(file_stream);
+	fclose(fp);
+	return ret;
+}
+
+static
+int event_ids_save(struct ctf_trace *trace,
+		struct ctf_file_stream *file_stream)
+{
+	GArray *packet_index = file_stream->pos.packet_index;
+	uint64_t nr_words = file_stream->event_ids_words;
+	struct ctf_event_ids_file_hdr hdr;
+	gchar *name;
+	FILE *fp;
+	uint64_t i, j;
+	int fd, ret = 0;
+
+	if (!file_stream->parent.path[0])
+		return 0;	/* Not backed by a file */
+	if (mkdirat(trace->dirfd, "index", S_IRWXU | S_IRWXG) &&
+			errno != EEXIST) {
+		perror("Event id index mkdirat()");
+		return -errno;
+	}
+	name = g_strdup_printf(EVENT_IDS_PATH, file_stream->parent.path);
+	fd = openat(trace->dirfd, name, O_WRONLY | O_CREAT | O_TRUNC,
+			S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+	g_free(name);
+	if (fd < 0) {
+		perror("Event id index openat()");
+		return -errno;
+	}
+	fp = fdopen(fd, "w");
+	if (!fp) {
+		close(fd);
+		return -errno;
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = htobe32(CTF_EVENT_IDS_MAGIC);
+	hdr.major = htobe32(CTF_EVENT_IDS_MAJOR);
+	hdr.minor = htobe32(CTF_EVENT_IDS_MINOR);
+	hdr.nr_words = htobe64(nr_words);
+	hdr.nr_packets = htobe64(packet_index->len);
+	if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1) {
+		ret = -EIO;
+		goto end;
+	}
+	for (i = 0; i < packet_index->len; i++) {
+		struct ctf_event_ids_entry entry;
+
+		entry.offset = htobe64(g_array_index(packet_index,
+				struct packet_index, i).offset);
+		if (fwrite(&entry, sizeof(entry), 1, fp) != 1) {
+			ret = -EIO;
+			goto end;
+		}
+		for (j = 0; j < nr_words; j++) {
+			uint64_t word = htobe64(g_array_index(
+					file_stream->packet_event_ids,
+					uint64_t, i * nr_words + j));
+
+			if (fwrite(&word, sizeof(word), 1, fp) != 1) {
+				ret = -EIO;
+				goto end;
+			}
+		}
+	}
+end:
+	if (fclose(fp) && !ret)
+		ret = -EIO;
+	if (ret)
+		fprintf(stderr, "[error] Unable to save the event id index of stream %s.\n",
+			file_stream->parent.path);
+	return ret;
+}
+
+/*
+ * Decode the packets of a stream, setting the bit of the id of each
+ * event in the bitmap of its packet.
+ */
+static
+int event_ids_decode(struct ctf_file_stream *file_stream, uint64_t nr_words)
+{
+	struct ctf_stream_definition *stream = &file_stream->parent;
+	struct ctf_stream_pos *pos = &file_stream->pos;
+	uint64_t i;
+	int ret;
+
+	event_ids_reset(file_stream, nr_words);
+	g_array_set_size(file_stream->packet_event_ids,
+			pos->packet_index->len * nr_words);
+	for (i = 0; i < pos->packet_index->len; i++) {
+		uint64_t *ids;
+
+		pos->packet_seek(&pos->parent, i, SEEK_SET);
+		if (pos->offset == EOF || pos->cur_index != i)
+			continue;	/* Packet without event */
+		ids = &g_array_index(file_stream->packet_event_ids, uint64_t,
+				i * nr_words);
+		for (;;) {
+			ret = pos->parent.event_cb(&pos->parent, stream);
+			/* Stop at the end of the packet. */
+			if (ret == EOF || ret == EAGAIN || pos->cur_index != i)
+				break;
+			if (ret) {
+				fprintf(stderr, "[error] Unable to read event of stream %s.\n",
+					stream->path);
+				return ret;
+			}
+			ids[stream->event_id / 64] |= 1ULL << (stream->event_id % 64);
+		}
+	}
+	return 0;
+}
+
+int bt_ctf_event_id_index(struct bt_context *ctx, int flags)
+{
+	unsigned int i;
+	uint64_t j, k;
+	int ret;
+
+	if (!ctx || !ctx->tc)
+		return -EINVAL;
+
+	for (i = 0; i < ctx->tc->array->len; i++) {
+		struct bt_trace_descriptor *td;
+		struct ctf_trace *trace;
+
+		td = g_ptr_array_index(ctx->tc->array, i);
+		if (!td)
+			continue;
+		trace = container_of(td, struct ctf_trace, parent);
+		for (j = 0; j < trace->streams->len; j++) {
+			struct ctf_stream_declaration *stream_class;
+			uint64_t nr_words;
+
+			stream_class = g_ptr_array_index(trace->streams, j);
+			if (!stream_class)
+				continue;
+			nr_words = (stream_class->events_by_id->len + 63) / 64 ? : 1;
+			for (k = 0; k < stream_class->streams->len; k++) {
+				struct ctf_stream_definition *stream;
+				struct ctf_file_stream *file_stream;
+
+				stream = g_ptr_array_index(stream_class->streams, k);
+				if (!stream)
+					continue;
+				file_stream = container_of(stream,
+						struct ctf_file_stream, parent);
+				if (!event_ids_load(trace, file_stream, nr_words))
+					continue;
+				/* Decoding packets would move the positions of the iterator. */
+				if (ctx->current_iterator) {
+					fprintf(stderr, "[error] Cannot index event ids while an iterator exists on the context.\n");
+					return -EBUSY;
+				}
+				ret = event_ids_decode(file_stream, nr_words);
+				if (!ret && (flags & BT_CTF_EVENT_ID_INDEX_SAVE))
+					ret = event_ids_save(trace, file_stream);
+				if (ret) {
+					event_ids_free(file_stream);
+					return ret;
+				}
+			}
+		}
+	}
+	return 0;
+}
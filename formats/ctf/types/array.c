@@ -60,10 +60,21 @@ int ctf_array_read(struct bt_stream_pos *ppos, struct bt_definition *definition)
 				/*
 				 * We want to populate both the string
 				 * and the underlying values, so carry
-				 * on calling bt_array_rw().
+				 * on reading the elements.
 				 */
 			}
 		}
+		if (array_definition->values) {
+			int ret;
+
+			ret = ctf_integer_bulk_read(pos, integer_declaration,
+					array_definition->values,
+					array_declaration->len);
+			if (ret)
+				return ret;
+			array_definition->elems_stale = 1;
+			return 0;
+		}
 	}
 	return bt_array_rw(ppos, definition);
 }
@@ -343,3 +343,63 @@ end:
 		return -EFAULT;
 	return 0;
 }
+
+/*
+ * Read "len" consecutive byte-aligned integers into a contiguous array
+ * of values in native byte order. The declaration must satisfy
+ * bt_int_declaration_is_bulk().
+ */
+int ctf_integer_bulk_read(struct ctf_stream_pos *pos,
+		const struct declaration_integer *integer_declaration,
+		GArray *values, uint64_t len)
+{
+	int rbo = (integer_declaration->byte_order != BYTE_ORDER);	/* reverse byte order */
+	uint64_t bit_len;
+	uint64_t i;
+
+	/* "len" may come from a corrupted sequence length field */
+	if (len > UINT64_MAX / integer_declaration->len)
+		return -EFAULT;
+	bit_len = len * integer_declaration->len;
+	if (!ctf_align_pos(pos, integer_declaration->p.alignment))
+		return -EFAULT;
+	if (!ctf_pos_access_ok(pos, bit_len))
+		return -EFAULT;
+
+	g_array_set_size(values, len);
+	if (!len)
+		return 0;
+	memcpy(values->data, ctf_get_pos_addr(pos), bit_len / CHAR_BIT);
+	if (rbo) {
+		switch (integer_declaration->len) {
+		case 8:
+			break;
+		case 16:
+			for (i = 0; i < len; i++) {
+				uint16_t *v = &g_array_index(values, uint16_t, i);
+
+				*v = GUINT16_SWAP_LE_BE(*v);
+			}
+			break;
+		case 32:
+			for (i = 0; i < len; i++) {
+				uint32_t *v = &g_array_index(values, uint32_t, i);
+
+				*v = GUINT32_SWAP_LE_BE(*v);
+			}
+			break;
+		case 64:
+			for (i = 0; i < len; i++) {
+				uint64_t *v = &g_array_index(values, uint64_t, i);
+
+				*v = GUINT64_SWAP_LE_BE(*v);
+			}
+			break;
+		default:
+			assert(0);
+		}
+	}
+	if (!ctf_move_pos(pos, bit_len))
+		return -EFAULT;
+	return 0;
+}
@@ -61,6 +61,17 @@ int ctf_sequence_read(struct bt_stream_pos *ppos, struct bt_definition *definiti
 				return 0;
 			}
 		}
+		if (sequence_definition->values) {
+			int ret;
+
+			ret = ctf_integer_bulk_read(pos, integer_declaration,
+					sequence_definition->values,
+					bt_sequence_len(sequence_definition));
+			if (ret)
+				return ret;
+			sequence_definition->elems_stale = 1;
+			return 0;
+		}
 	}
 	return bt_sequence_rw(ppos, definition);
 }
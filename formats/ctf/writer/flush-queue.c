@@ -0,0 +1,307 @@
+/*
+ * flush-queue.c
+ *
+ * Babeltrace CTF Writer
+ *
+ * Asynchronous packet flush queue, drained by the writer's I/O thread.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+#include <babeltrace/ctf-writer/flush-queue-internal.h>
+#include <babeltrace/ctf-writer/writer.h>
+#include <babeltrace/ctf-writer/writer-internal.h>
+#include <babeltrace/ctf-ir/stream-internal.h>
+#include <babeltrace/compiler.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+
+static
+void bt_ctf_flush_queue_destroy(struct bt_ctf_ref *ref);
+
+/*
+ * Start the writeback of the packet written before the current one. It
+ * is only unmapped, and its pages known to be dirty, once the stream has
+ * moved on to the next packet.
+ */
+static
+void start_writeback(struct bt_ctf_stream *stream, off_t offset, off_t len)
+{
+#ifdef HAVE_SYNC_FILE_RANGE
+	if (!len) {
+		return;
+	}
+	if (sync_file_range(stream->pos.fd, offset, len,
+			SYNC_FILE_RANGE_WRITE)) {
+		perror("sync_file_range");
+	}
+#endif
+}
+
+static
+int write_packet(struct bt_ctf_flush_queue *queue,
+		struct bt_ctf_stream_packet *packet)
+{
+	int ret;
+	struct bt_ctf_stream *stream = packet->stream;
+	off_t offset, len;
+
+	offset = stream->pos.mmap_offset;
+	len = stream->pos.base_mma ? stream->pos.packet_size / CHAR_BIT : 0;
+	ret = bt_ctf_stream_write_packet(packet);
+	if (!ret && (queue->flags & BT_CTF_WRITER_ASYNC_WRITEBACK)) {
+		start_writeback(stream, offset, len);
+	}
+	return ret;
+}
+
+static
+void *flush_queue_thread(void *data)
+{
+	struct bt_ctf_flush_queue *queue = data;
+
+	pthread_mutex_lock(&queue->lock);
+	for (;;) {
+		struct bt_ctf_stream_packet *packet;
+		GString *metadata = NULL;
+		int append, ret;
+
+		while (queue->running && !queue->metadata &&
+				g_queue_is_empty(queue->packets)) {
+			pthread_cond_wait(&queue->cond, &queue->lock);
+		}
+
+		if (queue->metadata) {
+			metadata = queue->metadata;
+			append = queue->metadata_append;
+			queue->metadata = NULL;
+			queue->busy = 1;
+			pthread_mutex_unlock(&queue->lock);
+			ret = bt_ctf_writer_write_metadata(queue->metadata_fd,
+				metadata->str, metadata->len, append);
+		} else if ((packet = g_queue_pop_head(queue->packets))) {
+			queue->busy = 1;
+			/* Room was made for another packet */
+			pthread_cond_broadcast(&queue->cond);
+			pthread_mutex_unlock(&queue->lock);
+			ret = write_packet(queue, packet);
+			bt_ctf_stream_packet_destroy(packet);
+		} else {
+			/* Stopped and drained */
+			break;
+		}
+
+		pthread_mutex_lock(&queue->lock);
+		queue->busy = 0;
+		if (ret) {
+			queue->error = 1;
+			if (metadata) {
+				queue->metadata_error = 1;
+			}
+		}
+		if (metadata) {
+			g_string_free(metadata, TRUE);
+			metadata = NULL;
+		}
+		pthread_cond_broadcast(&queue->cond);
+	}
+	pthread_mutex_unlock(&queue->lock);
+	return NULL;
+}
+
+BT_HIDDEN
+struct bt_ctf_flush_queue *bt_ctf_flush_queue_create(int metadata_fd,
+		unsigned int max_packets, int flags)
+{
+	struct bt_ctf_flush_queue *queue;
+
+	if (!max_packets) {
+		goto error;
+	}
+
+	queue = g_new0(struct bt_ctf_flush_queue, 1);
+	if (!queue) {
+		goto error;
+	}
+
+	bt_ctf_ref_init(&queue->ref_count);
+	pthread_mutex_init(&queue->lock, NULL);
+	pthread_cond_init(&queue->cond, NULL);
+	queue->packets = g_queue_new();
+	queue->max_packets = max_packets;
+	queue->flags = flags;
+	queue->metadata_fd = metadata_fd;
+	queue->running = 1;
+	if (pthread_create(&queue->thread, NULL, flush_queue_thread, queue)) {
+		perror("pthread_create");
+		queue->running = 0;
+		goto error_destroy;
+	}
+	return queue;
+
+error_destroy:
+	bt_ctf_flush_queue_destroy(&queue->ref_count);
+error:
+	return NULL;
+}
+
+BT_HIDDEN
+void bt_ctf_flush_queue_get(struct bt_ctf_flush_queue *queue)
+{
+	if (!queue) {
+		return;
+	}
+
+	bt_ctf_ref_get(&queue->ref_count);
+}
+
+BT_HIDDEN
+void bt_ctf_flush_queue_put(struct bt_ctf_flush_queue *queue)
+{
+	if (!queue) {
+		return;
+	}
+
+	bt_ctf_ref_put(&queue->ref_count, bt_ctf_flush_queue_destroy);
+}
+
+BT_HIDDEN
+int bt_ctf_flush_queue_push_packet(struct bt_ctf_flush_queue *queue,
+		struct bt_ctf_stream_packet *packet)
+{
+	int ret = 0;
+
+	pthread_mutex_lock(&queue->lock);
+	while (queue->running &&
+			g_queue_get_length(queue->packets) >= queue->max_packets) {
+		if (queue->flags & BT_CTF_WRITER_ASYNC_DISCARD) {
+			ret = -EAGAIN;
+			goto end;
+		}
+		pthread_cond_wait(&queue->cond, &queue->lock);
+	}
+
+	if (!queue->running) {
+		ret = -ESHUTDOWN;
+		goto end;
+	}
+
+	g_queue_push_tail(queue->packets, packet);
+	pthread_cond_broadcast(&queue->cond);
+end:
+	pthread_mutex_unlock(&queue->lock);
+	return ret;
+}
+
+BT_HIDDEN
+int bt_ctf_flush_queue_push_metadata(struct bt_ctf_flush_queue *queue,
+		GString *metadata, int append)
+{
+	int ret = 0;
+
+	pthread_mutex_lock(&queue->lock);
+	if (!queue->running) {
+		ret = -ESHUTDOWN;
+		goto end;
+	}
+
+	if (append && queue->metadata) {
+		g_string_append_len(queue->metadata, metadata->str,
+			metadata->len);
+		g_string_free(metadata, TRUE);
+	} else {
+		/* A complete update supersedes the pending one */
+		if (queue->metadata) {
+			g_string_free(queue->metadata, TRUE);
+		}
+		queue->metadata = metadata;
+		queue->metadata_append = append;
+	}
+	pthread_cond_broadcast(&queue->cond);
+end:
+	pthread_mutex_unlock(&queue->lock);
+	return ret;
+}
+
+BT_HIDDEN
+int bt_ctf_flush_queue_metadata_error(struct bt_ctf_flush_queue *queue)
+{
+	int ret;
+
+	pthread_mutex_lock(&queue->lock);
+	ret = queue->metadata_error;
+	queue->metadata_error = 0;
+	pthread_mutex_unlock(&queue->lock);
+	return ret;
+}
+
+BT_HIDDEN
+int bt_ctf_flush_queue_wait(struct bt_ctf_flush_queue *queue)
+{
+	int ret;
+
+	pthread_mutex_lock(&queue->lock);
+	while (queue->busy || queue->metadata ||
+			!g_queue_is_empty(queue->packets)) {
+		pthread_cond_wait(&queue->cond, &queue->lock);
+	}
+	ret = queue->error ? -1 : 0;
+	queue->error = 0;
+	pthread_mutex_unlock(&queue->lock);
+	return ret;
+}
+
+BT_HIDDEN
+void bt_ctf_flush_queue_stop(struct bt_ctf_flush_queue *queue)
+{
+	int running;
+
+	pthread_mutex_lock(&queue->lock);
+	running = queue->running;
+	queue->running = 0;
+	pthread_cond_broadcast(&queue->cond);
+	pthread_mutex_unlock(&queue->lock);
+	if (running && pthread_join(queue->thread, NULL)) {
+		perror("pthread_join");
+	}
+}
+
+static
+void bt_ctf_flush_queue_destroy(struct bt_ctf_ref *ref)
+{
+	struct bt_ctf_flush_queue *queue;
+
+	if (!ref) {
+		return;
+	}
+
+	queue = container_of(ref, struct bt_ctf_flush_queue, ref_count);
+	bt_ctf_flush_queue_stop(queue);
+	g_queue_free(queue->packets);
+	if (queue->metadata) {
+		g_string_free(queue->metadata, TRUE);
+	}
+	pthread_cond_destroy(&queue->cond);
+	pthread_mutex_destroy(&queue->lock);
+	g_free(queue);
+}
@@ -31,9 +31,13 @@
 #include <babeltrace/ctf-ir/event-types-internal.h>
 #include <babeltrace/ctf-ir/event-fields-internal.h>
 #include <babeltrace/ctf-writer/functor-internal.h>
+#include <babeltrace/ctf-writer/flush-queue-internal.h>
 #include <babeltrace/ctf-ir/stream-class-internal.h>
 #include <babeltrace/ctf-ir/stream-internal.h>
+#include <babeltrace/ctf-ir/trace-internal.h>
+#include <babeltrace/ctf/metadata.h>
 #include <babeltrace/compiler.h>
+#include <babeltrace/endian.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/stat.h>
@@ -84,6 +88,13 @@ struct bt_ctf_writer *bt_ctf_writer_create(const char *path)
 		goto error_destroy;
 	}
 
+	/* Packet index files, allowing readers to skip the packet scan */
+	if (mkdirat(writer->trace_dir_fd, "index", S_IRWXU | S_IRWXG) &&
+		errno != EEXIST) {
+		perror("mkdirat");
+		goto error_destroy;
+	}
+
 	writer->metadata_fd = openat(writer->trace_dir_fd, "metadata",
 		O_WRONLY | O_CREAT | O_TRUNC,
 		S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
@@ -107,7 +118,16 @@ void bt_ctf_writer_destroy(struct bt_ctf_ref *ref)
 	}
 
 	writer = container_of(ref, struct bt_ctf_writer, ref_count);
+	if (writer->flush_queue) {
+		/* Rewrite metadata whose queued write failed, if any */
+		(void) bt_ctf_flush_queue_wait(writer->flush_queue);
+	}
 	bt_ctf_writer_flush_metadata(writer);
+	if (writer->flush_queue) {
+		/* Write the queued packets before closing the metadata fd */
+		bt_ctf_flush_queue_stop(writer->flush_queue);
+		bt_ctf_flush_queue_put(writer->flush_queue);
+	}
 	if (writer->path) {
 		g_string_free(writer->path, TRUE);
 	}
@@ -162,6 +182,8 @@ struct bt_ctf_stream *bt_ctf_writer_create_stream(struct bt_ctf_writer *writer,
 		goto error;
 	}
 
+	bt_ctf_stream_set_flush_queue(stream, writer->flush_queue);
+
 	writer->frozen = 1;
 	return stream;
 
@@ -214,41 +236,200 @@ end:
 	return metadata_string;
 }
 
+BT_HIDDEN
+int bt_ctf_writer_write_metadata(int metadata_fd, const char *metadata,
+		size_t len, int append)
+{
+	int ret = -1;
+
+	if (append) {
+		if (lseek(metadata_fd, 0, SEEK_END) == (off_t)-1) {
+			perror("lseek");
+			goto end;
+		}
+	} else {
+		if (lseek(metadata_fd, 0, SEEK_SET) == (off_t)-1) {
+			perror("lseek");
+			goto end;
+		}
+
+		if (ftruncate(metadata_fd, 0)) {
+			perror("ftruncate");
+			goto end;
+		}
+	}
+
+	if (write(metadata_fd, metadata, len) < 0) {
+		perror("write");
+		goto end;
+	}
+	ret = 0;
+end:
+	return ret;
+}
+
+static
+uint32_t metadata_packet_u32(struct bt_ctf_trace *trace, uint32_t value)
+{
+	return trace->byte_order == BYTE_ORDER ? value :
+		GUINT32_SWAP_LE_BE(value);
+}
+
+/* Wrap a metadata update in a packet, as described in the CTF spec. */
+static
+GString *packetize_metadata(struct bt_ctf_trace *trace, const char *metadata)
+{
+	struct metadata_packet_header header;
+	size_t len = header_sizeof(header) + strlen(metadata);
+	GString *packet;
+
+	memset(&header, 0, sizeof(header));
+	header.magic = metadata_packet_u32(trace, TSDL_MAGIC);
+	memcpy(header.uuid, trace->uuid, sizeof(header.uuid));
+	header.content_size = metadata_packet_u32(trace, len * CHAR_BIT);
+	header.packet_size = metadata_packet_u32(trace, len * CHAR_BIT);
+	header.major = 1;
+	header.minor = 8;
+
+	packet = g_string_sized_new(len);
+	g_string_append_len(packet, (const char *) &header,
+		header_sizeof(header));
+	g_string_append(packet, metadata);
+	return packet;
+}
+
+/*
+ * Only the declarations added since the last flush are written, unless
+ * the trace's or environment's description changed.
+ */
 void bt_ctf_writer_flush_metadata(struct bt_ctf_writer *writer)
 {
-	int ret;
 	char *metadata_string = NULL;
+	GString *metadata = NULL;
+	int append;
 
 	if (!writer) {
 		goto end;
 	}
 
-	metadata_string = bt_ctf_trace_get_metadata_string(
-		writer->trace);
+	if (writer->flush_queue &&
+		bt_ctf_flush_queue_metadata_error(writer->flush_queue)) {
+		/* The I/O thread failed to write it: start over */
+		bt_ctf_trace_reset_metadata_update(writer->trace);
+	}
+
+	metadata_string = bt_ctf_trace_get_metadata_update(
+		writer->trace, &append);
 	if (!metadata_string) {
 		goto end;
 	}
 
-	if (lseek(writer->metadata_fd, 0, SEEK_SET) == (off_t)-1) {
-		perror("lseek");
+	if (append && metadata_string[0] == '\0') {
+		/* Nothing new */
 		goto end;
 	}
 
-	if (ftruncate(writer->metadata_fd, 0)) {
-		perror("ftruncate");
-		goto end;
+	if (writer->metadata_packetized) {
+		metadata = packetize_metadata(writer->trace, metadata_string);
+	} else {
+		metadata = g_string_new(metadata_string);
 	}
 
-	ret = write(writer->metadata_fd, metadata_string,
-		strlen(metadata_string));
-	if (ret < 0) {
-		perror("write");
+	if (writer->flush_queue &&
+		!bt_ctf_flush_queue_push_metadata(writer->flush_queue,
+			metadata, append)) {
+		/* Now owned by the queue */
+		metadata = NULL;
 		goto end;
 	}
+
+	if (bt_ctf_writer_write_metadata(writer->metadata_fd,
+		metadata->str, metadata->len, append)) {
+		/* Start over on the next flush */
+		bt_ctf_trace_reset_metadata_update(writer->trace);
+	}
 end:
+	if (metadata) {
+		g_string_free(metadata, TRUE);
+	}
 	g_free(metadata_string);
 }
 
+int bt_ctf_writer_set_packetized_metadata(struct bt_ctf_writer *writer,
+		int packetized)
+{
+	int ret = 0;
+
+	if (!writer) {
+		ret = -1;
+		goto end;
+	}
+
+	writer->metadata_packetized = !!packetized;
+	/* The metadata file must be rewritten in the new format */
+	bt_ctf_trace_reset_metadata_update(writer->trace);
+end:
+	return ret;
+}
+
+int bt_ctf_writer_set_async(struct bt_ctf_writer *writer,
+		unsigned int queue_length, int flags)
+{
+	int ret = 0;
+
+	if (!writer || writer->frozen || writer->flush_queue ||
+		!queue_length) {
+		ret = -1;
+		goto end;
+	}
+
+	writer->flush_queue = bt_ctf_flush_queue_create(writer->metadata_fd,
+		queue_length, flags);
+	if (!writer->flush_queue) {
+		ret = -1;
+		goto end;
+	}
+end:
+	return ret;
+}
+
+int bt_ctf_writer_wait(struct bt_ctf_writer *writer)
+{
+	int ret = 0;
+
+	if (!writer) {
+		ret = -1;
+		goto end;
+	}
+
+	if (writer->flush_queue) {
+		ret = bt_ctf_flush_queue_wait(writer->flush_queue);
+	}
+end:
+	return ret;
+}
+
+int bt_ctf_writer_set_compressed(struct bt_ctf_writer *writer,
+		int compressed)
+{
+	int ret = 0;
+
+	if (!writer || writer->frozen) {
+		ret = -1;
+		goto end;
+	}
+
+#ifndef BABELTRACE_HAVE_LIBZSTD
+	if (compressed) {
+		ret = -1;
+		goto end;
+	}
+#endif
+	writer->compressed = !!compressed;
+end:
+	return ret;
+}
+
 int bt_ctf_writer_set_byte_order(struct bt_ctf_writer *writer,
 		enum bt_ctf_byte_order byte_order)
 {
@@ -283,11 +464,43 @@ void bt_ctf_writer_put(struct bt_ctf_writer *writer)
 	bt_ctf_ref_put(&writer->ref_count, bt_ctf_writer_destroy);
 }
 
+/*
+ * Hand the stream file "fd" over to the stream's compressor and return an
+ * unlinked scratch file in which the stream serializes its packets.
+ */
+static
+int create_scratch_file(struct bt_ctf_writer *writer,
+		struct bt_ctf_stream *stream, const char *name, int fd)
+{
+	int scratch_fd;
+	GString *scratch_name = g_string_new(NULL);
+
+	g_string_printf(scratch_name, ".%s.tmp", name);
+	scratch_fd = openat(writer->trace_dir_fd, scratch_name->str,
+		O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (scratch_fd < 0) {
+		perror("openat");
+		goto end;
+	}
+
+	if (unlinkat(writer->trace_dir_fd, scratch_name->str, 0)) {
+		perror("unlinkat");
+	}
+
+	if (bt_ctf_stream_set_compressed_fd(stream, fd)) {
+		close(scratch_fd);
+		scratch_fd = -1;
+	}
+end:
+	g_string_free(scratch_name, TRUE);
+	return scratch_fd;
+}
+
 static
 int create_stream_file(struct bt_ctf_writer *writer,
 		struct bt_ctf_stream *stream)
 {
-	int fd;
+	int fd, index_fd;
 	GString *filename = g_string_new(stream->stream_class->name->str);
 
 	if (stream->stream_class->name->len == 0) {
@@ -306,6 +519,35 @@ int create_stream_file(struct bt_ctf_writer *writer,
 	fd = openat(writer->trace_dir_fd, filename->str,
 		O_RDWR | O_CREAT | O_TRUNC,
 		S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+	if (fd < 0) {
+		goto error;
+	}
+
+	if (writer->compressed) {
+		int scratch_fd = create_scratch_file(writer, stream,
+			filename->str, fd);
+
+		if (scratch_fd < 0) {
+			close(fd);
+			fd = -1;
+			goto error;
+		}
+		fd = scratch_fd;
+	}
+
+	g_string_prepend(filename, "index/");
+	g_string_append(filename, ".idx");
+	index_fd = openat(writer->trace_dir_fd, filename->str,
+		O_WRONLY | O_CREAT | O_TRUNC,
+		S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+	if (index_fd < 0 || bt_ctf_stream_set_index_fd(stream, index_fd)) {
+		perror("openat");
+		if (index_fd >= 0) {
+			close(index_fd);
+		}
+		close(fd);
+		fd = -1;
+	}
 error:
 	g_string_free(filename, TRUE);
 	return fd;
@@ -48,6 +48,7 @@
 #include <babeltrace/ctf/metadata.h>
 #include <babeltrace/ctf-text/types.h>
 #include <babeltrace/ctf/events-internal.h>
+#include <babeltrace/trace-handle-internal.h>
 #include <formats/ctf/events-private.h>
 
 #include <babeltrace/endian.h>
@@ -1271,6 +1272,10 @@ retry:
 
 		ctf_update_current_packet_index(&file_stream->parent,
 				prev_index, cur_index);
+		if (file_stream->parent.stream_class) {
+			bt_trace_handle_invalidate_timestamps(
+				file_stream->parent.stream_class->trace->parent.handle);
+		}
 
 		file_stream->parent.cycles_timestamp =
 				cur_index->ts_cycles.timestamp_begin;
@@ -169,6 +169,13 @@ struct trace_collection {
 	int64_t delta_offset_first_sum;
 	int offset_nr;
 	int clock_use_offset_avg;
+
+	/* Bounds of the timestamps of all the traces, see bt_context_get_timestamp_begin() */
+	uint64_t real_timestamp_begin;
+	uint64_t real_timestamp_end;
+	uint64_t cycles_timestamp_begin;
+	uint64_t cycles_timestamp_end;
+	int timestamps_stale;	/* recompute from the trace handles */
 };
 
 extern int opt_all_field_names,
@@ -30,29 +30,103 @@
  * SOFTWARE.
  */
 
+/*
+ * Multiply a 64-bit value by a 64-bit multiplier, and shift the 128-bit
+ * product right by "shift" bits (0 <= shift < 128). The result is
+ * truncated to 64 bits.
+ */
+static inline
+uint64_t clock_mul_u64_shr(uint64_t a, uint64_t mult, unsigned int shift)
+{
+	uint64_t a_lo = (uint32_t) a, a_hi = a >> 32;
+	uint64_t m_lo = (uint32_t) mult, m_hi = mult >> 32;
+	uint64_t p0, p1, p2, p3, mid, lo, hi;
+
+	p0 = a_lo * m_lo;
+	p1 = a_lo * m_hi;
+	p2 = a_hi * m_lo;
+	p3 = a_hi * m_hi;
+	mid = (p0 >> 32) + (uint32_t) p1 + (uint32_t) p2;
+	lo = (mid << 32) | (uint32_t) p0;
+	hi = p3 + (p1 >> 32) + (p2 >> 32) + (mid >> 32);
+
+	if (!shift)
+		return lo;
+	if (shift < 64)
+		return (lo >> shift) | (hi << (64 - shift));
+	return hi >> (shift - 64);
+}
+
+/*
+ * Convert cycles to ns, exactly as floor(cycles * 1000000000 / freq) for
+ * frequencies below 2^61 Hz. The fixed-point multiplier is rounded down,
+ * so that the product is at most a few ns below the exact quotient: the
+ * remainder of the division is then small enough to be computed modulo
+ * 2^64, and corrects the estimate.
+ */
 static inline
 uint64_t clock_cycles_to_ns(struct ctf_clock *clock, uint64_t cycles)
 {
-	if (clock->freq == 1000000000ULL) {
+	uint64_t ns, rem;
+
+	if (clock->freq == 1000000000ULL || !clock->freq) {
 		/* 1GHZ freq, no need to scale cycles value */
 		return cycles;
+	}
+	ns = clock_mul_u64_shr(cycles, clock->ns_mult, clock->ns_shift);
+	rem = cycles * 1000000000ULL - ns * clock->freq;
+	while (rem >= clock->freq) {
+		rem -= clock->freq;
+		ns++;
+	}
+	return ns;
+}
+
+/*
+ * Precompute the fixed-point cycles to nanoseconds conversion of a
+ * clock, used by clock_cycles_to_ns(). The multiplier is
+ * floor((1000000000 << shift) / freq), with as many significant bits as
+ * fit in 63 bits: its relative error is below 2^-62, so the estimate of
+ * a conversion up to 2^64 ns is at most 5 ns below the exact value.
+ * Must be called whenever freq or offset change.
+ */
+static inline
+void clock_compute_ns_conversion(struct ctf_clock *clock)
+{
+	uint64_t q, r;
+	unsigned int shift = 0;
+
+	if (!clock->freq || clock->freq == 1000000000ULL) {
+		clock->ns_mult = 1;
+		clock->ns_shift = 0;
 	} else {
-		return (double) cycles * 1000000000.0
-				/ (double) clock->freq;
+		/* Long division of (1000000000 << shift) by freq. */
+		q = 1000000000ULL / clock->freq;
+		r = 1000000000ULL % clock->freq;
+		while (!(q & (1ULL << 62)) && shift < 127) {
+			q <<= 1;
+			if (r >= clock->freq - r) {
+				r -= clock->freq - r;
+				q |= 1;
+			} else {
+				r <<= 1;
+			}
+			shift++;
+		}
+		clock->ns_mult = q;
+		clock->ns_shift = shift;
 	}
+	clock->offset_ns = clock->offset_s * 1000000000ULL
+		+ clock_cycles_to_ns(clock, clock->offset);
 }
 
 /*
- * Note: if using a frequency different from 1GHz for clock->offset, it
- * is recommended to express the seconds in offset_s, otherwise there
- * will be a loss of precision caused by the limited size of the double
- * mantissa.
+ * The offset in ns is precomputed by clock_compute_ns_conversion().
  */
 static inline
 uint64_t clock_offset_ns(struct ctf_clock *clock)
 {
-	return clock->offset_s * 1000000000ULL
-			+ clock_cycles_to_ns(clock, clock->offset);
+	return clock->offset_ns;
 }
 
 #endif /* _BABELTRACE_CLOCK_INTERNAL_H */
@@ -95,6 +95,21 @@ int bt_context_add_trace(struct bt_context *ctx, const char *path,
  */
 int bt_context_remove_trace(struct bt_context *ctx, int trace_id);
 
+/*
+ * bt_context_get_timestamp_begin and bt_context_get_timestamp_end :
+ * returns the earliest buffer creation time and the latest buffer
+ * destruction time (in nanoseconds or cycles depending on type) of
+ * all the traces of the context, or -1ULL on error.
+ *
+ * These are maintained as traces are added, from the same bounds as
+ * bt_trace_handle_get_timestamp_begin and _end, so they are cheap to
+ * query.
+ */
+uint64_t bt_context_get_timestamp_begin(struct bt_context *ctx,
+		enum bt_clock_type type);
+uint64_t bt_context_get_timestamp_end(struct bt_context *ctx,
+		enum bt_clock_type type);
+
 /*
  * bt_context_get and bt_context_put : increments and decrement the
  * refcount of the context
@@ -53,6 +53,8 @@ struct bt_ctf_event_class {
 	/* Structure type containing the event's fields */
 	struct bt_ctf_field_type *fields;
 	int frozen;
+	/* Serialized declaration, cached once frozen */
+	GString *metadata;
 };
 
 struct bt_ctf_event {
@@ -65,6 +67,14 @@ struct bt_ctf_event {
 	struct bt_ctf_field *fields_payload;
 };
 
+struct bt_ctf_field_handle {
+	struct bt_ctf_ref ref_count;
+	/* Payload or context type the path was resolved against */
+	struct bt_ctf_field_type *root_type;
+	int context;		/* path within the event context if set */
+	GArray *indexes;	/* structure member index, for each level */
+};
+
 BT_HIDDEN
 void bt_ctf_event_class_freeze(struct bt_ctf_event_class *event_class);
 
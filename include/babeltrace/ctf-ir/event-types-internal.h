@@ -112,11 +112,24 @@ struct structure_field {
 	struct bt_ctf_field_type *type;
 };
 
+/*
+ * Serialization program of a frozen structure type: one operation per
+ * member. Integer and enumeration members have a fixed size and are
+ * stored directly; the others are serialized through their type.
+ */
+struct structure_serialize_op {
+	int index;		/* member index in the structure */
+	int enumeration;	/* member is an enumeration of "integer" */
+	/* NULL if the member does not have a fixed-size layout */
+	const struct declaration_integer *integer;
+};
+
 struct bt_ctf_field_type_structure {
 	struct bt_ctf_field_type parent;
 	GHashTable *field_name_to_index;
 	GPtrArray *fields; /* Array of pointers to struct structure_field */
 	struct declaration_struct declaration;
+	GArray *serialize_ops; /* struct structure_serialize_op, once frozen */
 };
 
 struct bt_ctf_field_type_variant {
@@ -42,6 +42,7 @@ struct bt_ctf_event_class;
 struct bt_ctf_event;
 struct bt_ctf_field;
 struct bt_ctf_field_type;
+struct bt_ctf_field_handle;
 struct bt_ctf_stream_class;
 
 /*
@@ -320,6 +321,37 @@ extern int bt_ctf_event_class_set_context_type(
 extern void bt_ctf_event_class_get(struct bt_ctf_event_class *event_class);
 extern void bt_ctf_event_class_put(struct bt_ctf_event_class *event_class);
 
+/*
+ * bt_ctf_event_class_get_field_handle: resolve a field path once.
+ *
+ * Resolve a path of structure field names, starting with the "payload" or
+ * "context" scope (e.g. "payload.foo.bar"), into a handle which can then be
+ * used to access the field of any event of this class by index, without
+ * looking up field names. Only structure members can be traversed.
+ *
+ * The handle remains valid as long as the event class' payload and context
+ * types are not replaced.
+ *
+ * @param event_class Event class.
+ * @param path Dot-separated field path.
+ *
+ * Returns a field handle on success, NULL on error.
+ */
+extern struct bt_ctf_field_handle *bt_ctf_event_class_get_field_handle(
+		struct bt_ctf_event_class *event_class, const char *path);
+
+/*
+ * bt_ctf_field_handle_get and bt_ctf_field_handle_put: increment and
+ * decrement the field handle's reference count.
+ *
+ * When the field handle's reference count is decremented to 0 by a
+ * bt_ctf_field_handle_put, the field handle is freed.
+ *
+ * @param handle Field handle.
+ */
+extern void bt_ctf_field_handle_get(struct bt_ctf_field_handle *handle);
+extern void bt_ctf_field_handle_put(struct bt_ctf_field_handle *handle);
+
 /*
  * bt_ctf_event_create: instanciate an event.
  *
@@ -444,6 +476,46 @@ extern int bt_ctf_event_set_payload(struct bt_ctf_event *event,
 extern struct bt_ctf_field *bt_ctf_event_get_payload_by_index(
 		struct bt_ctf_event *event, int index);
 
+/*
+ * bt_ctf_event_get_field_by_handle: get an event's field by handle.
+ *
+ * Returns the field designated by a handle obtained from the event's class,
+ * instanciating it if needed. bt_ctf_field_put() must be called on the
+ * returned value.
+ *
+ * @param event Event instance.
+ * @param handle Field handle.
+ *
+ * Returns the event's field, NULL on error.
+ */
+extern struct bt_ctf_field *bt_ctf_event_get_field_by_handle(
+		struct bt_ctf_event *event, struct bt_ctf_field_handle *handle);
+
+/*
+ * bt_ctf_event_set_*_by_handle: set the value of an event's field by handle.
+ *
+ * Shorthands for bt_ctf_event_get_field_by_handle() followed by the
+ * corresponding bt_ctf_field_*_set_value() call.
+ *
+ * @param event Event instance.
+ * @param handle Field handle.
+ * @param value Value.
+ *
+ * Returns 0 on success, a negative value on error.
+ */
+extern int bt_ctf_event_set_unsigned_integer_by_handle(
+		struct bt_ctf_event *event, struct bt_ctf_field_handle *handle,
+		uint64_t value);
+extern int bt_ctf_event_set_signed_integer_by_handle(
+		struct bt_ctf_event *event, struct bt_ctf_field_handle *handle,
+		int64_t value);
+extern int bt_ctf_event_set_floating_point_by_handle(
+		struct bt_ctf_event *event, struct bt_ctf_field_handle *handle,
+		double value);
+extern int bt_ctf_event_set_string_by_handle(
+		struct bt_ctf_event *event, struct bt_ctf_field_handle *handle,
+		const char *value);
+
 /*
  * bt_ctf_event_get_header: get an event's header.
  *
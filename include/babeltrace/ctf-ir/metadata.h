@@ -114,6 +114,14 @@ struct ctf_clock {
 	/* Fine clock offset from Epoch, in (1/freq) units. */
 	uint64_t offset;
 	int absolute;
+	/*
+	 * Cycles to ns conversion, precomputed by
+	 * clock_compute_ns_conversion(): ns is estimated as
+	 * (cycles * ns_mult) >> ns_shift, see clock_cycles_to_ns().
+	 */
+	uint64_t ns_mult;
+	unsigned int ns_shift;
+	uint64_t offset_ns;	/* offset from Epoch, in ns */
 
 	enum {					/* Fields populated mask */
 		CTF_CLOCK_name		=	(1U << 0),
@@ -36,6 +36,13 @@
 #include <babeltrace/ctf/types.h>
 #include <glib.h>
 
+/* Compact event header: an id of this length, then a truncated timestamp */
+#define COMPACT_EVENT_HEADER_ID_LEN		5
+#define COMPACT_EVENT_HEADER_TIMESTAMP_LEN	27
+/* Id selecting the extended header, holding the full id and timestamp */
+#define COMPACT_EVENT_HEADER_EXTENDED_ID \
+	((1U << COMPACT_EVENT_HEADER_ID_LEN) - 1)
+
 struct bt_ctf_stream_class {
 	struct bt_ctf_ref ref_count;
 	GString *name;
@@ -52,6 +59,10 @@ struct bt_ctf_stream_class {
 	struct bt_ctf_field_type *event_context_type;
 	int frozen;
 	int byte_order;
+	uint64_t packet_size;	/* initial packet size, in bytes. 0: default */
+	int compact_event_header; /* see bt_ctf_stream_class_set_compact_event_header */
+	/* Serialized stream declaration, cached once frozen */
+	GString *metadata;
 };
 
 BT_HIDDEN
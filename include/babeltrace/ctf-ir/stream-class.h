@@ -120,6 +120,36 @@ extern int bt_ctf_stream_class_set_clock(
 		struct bt_ctf_stream_class *stream_class,
 		struct bt_ctf_clock *clock);
 
+/*
+ * bt_ctf_stream_class_get_packet_size: get the initial size of the packets
+ * written by instances of a stream class.
+ *
+ * @param stream_class Stream class.
+ *
+ * Returns the packet size in bytes, 0 if the default size is used, a
+ * negative value on error.
+ */
+extern int64_t bt_ctf_stream_class_get_packet_size(
+		struct bt_ctf_stream_class *stream_class);
+
+/*
+ * bt_ctf_stream_class_set_packet_size: set the initial size of the packets
+ * written by instances of a stream class.
+ *
+ * Packets are allocated with this size and grown as needed to hold the
+ * events appended before a flush. Larger packets mean fewer packet
+ * headers and file allocations; smaller ones, finer grained seeking.
+ * This only applies to streams created after the call.
+ *
+ * @param stream_class Stream class.
+ * @param packet_size Packet size in bytes, a multiple of the page size,
+ *	or 0 to use the default size.
+ *
+ * Returns 0 on success, a negative value on error.
+ */
+extern int bt_ctf_stream_class_set_packet_size(
+		struct bt_ctf_stream_class *stream_class, uint64_t packet_size);
+
 /*
  * bt_ctf_stream_class_get_id: Get a stream class' id.
  *
@@ -261,6 +291,27 @@ extern int bt_ctf_stream_class_set_event_header_type(
 		struct bt_ctf_stream_class *stream_class,
 		struct bt_ctf_field_type *event_header_type);
 
+/*
+ * bt_ctf_stream_class_set_compact_event_header: use compact event headers.
+ *
+ * Replace the stream class' event header type by the compact header used
+ * by LTTng: a 5-bit event id followed by the low 27 bits of the event's
+ * timestamp, which readers extend using the previous timestamp. Events
+ * whose id does not fit, or which follow the previous event of their
+ * packet by 2^27 clock cycles or more, are written with an extended
+ * header holding a 32-bit id and a 64-bit timestamp.
+ *
+ * The header's id and timestamp are set automatically; passing 0 restores
+ * the default event header.
+ *
+ * @param stream_class Stream class.
+ * @param compact 1 to use compact event headers, 0 for the default ones.
+ *
+ * Returns 0 on success, a negative value on error.
+ */
+extern int bt_ctf_stream_class_set_compact_event_header(
+		struct bt_ctf_stream_class *stream_class, int compact);
+
 /*
  * bt_ctf_stream_class_get_event_context_type: get the stream class'
  * event context type.
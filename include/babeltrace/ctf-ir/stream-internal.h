@@ -36,6 +36,18 @@
 #include <babeltrace/ctf/types.h>
 #include <glib.h>
 
+/* Event appended to a concurrent stream, see bt_ctf_stream_set_concurrent */
+struct bt_ctf_stream_append_node {
+	struct bt_ctf_stream_append_node *next;
+	uint64_t seq;
+	/* NULL if the append failed after its sequence number was reserved */
+	struct bt_ctf_event *event;
+	struct bt_ctf_field *event_context;
+};
+
+struct bt_ctf_flush_queue;
+struct ctf_compressed_stream;
+
 struct bt_ctf_stream {
 	struct bt_ctf_ref ref_count;
 	/* Trace owning this stream. A stream does not own a trace. */
@@ -53,6 +65,29 @@ struct bt_ctf_stream {
 	struct bt_ctf_field *packet_context;
 	struct bt_ctf_field *event_header;
 	struct bt_ctf_field *event_context;
+	/* Concurrent append mode */
+	int concurrent;
+	uint64_t reserved_seq;	/* next sequence number to reserve */
+	uint64_t collected_seq;	/* first sequence number not yet collected */
+	/* Lock-free stack of committed appends, most recent first */
+	struct bt_ctf_stream_append_node *append_head;
+	/* Writer I/O thread queue, NULL if packets are written on flush */
+	struct bt_ctf_flush_queue *flush_queue;
+	int index_fd;	/* packet index file, -1 if unset */
+	/*
+	 * Compressed stream file, NULL if unset. Packets are serialized in
+	 * the scratch file "pos" and compressed once written.
+	 */
+	struct ctf_compressed_stream *compressed;
+};
+
+/* Flushed packet, written by the writer's I/O thread */
+struct bt_ctf_stream_packet {
+	struct bt_ctf_stream *stream;
+	struct bt_ctf_field *packet_header;
+	struct bt_ctf_field *packet_context;
+	GPtrArray *events;
+	GPtrArray *event_contexts;
 };
 
 /* Stream class should be locked by the caller after creating a stream */
@@ -64,4 +99,29 @@ struct bt_ctf_stream *bt_ctf_stream_create(
 BT_HIDDEN
 int bt_ctf_stream_set_fd(struct bt_ctf_stream *stream, int fd);
 
+/*
+ * Set the file in which an entry is written for each packet, in the
+ * format of the LTTng index files (see ctf-index.h). Writes the file's
+ * header.
+ */
+BT_HIDDEN
+int bt_ctf_stream_set_index_fd(struct bt_ctf_stream *stream, int fd);
+
+/*
+ * Compress the stream's packets into the file "fd", which is then owned
+ * by the stream. The stream's own file only holds the current packet.
+ */
+BT_HIDDEN
+int bt_ctf_stream_set_compressed_fd(struct bt_ctf_stream *stream, int fd);
+
+BT_HIDDEN
+void bt_ctf_stream_set_flush_queue(struct bt_ctf_stream *stream,
+		struct bt_ctf_flush_queue *queue);
+
+BT_HIDDEN
+int bt_ctf_stream_write_packet(struct bt_ctf_stream_packet *packet);
+
+BT_HIDDEN
+void bt_ctf_stream_packet_destroy(struct bt_ctf_stream_packet *packet);
+
 #endif /* BABELTRACE_CTF_WRITER_STREAM_INTERNAL_H */
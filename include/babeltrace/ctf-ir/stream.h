@@ -98,6 +98,34 @@ extern void bt_ctf_stream_append_discarded_events(struct bt_ctf_stream *stream,
 extern int bt_ctf_stream_append_event(struct bt_ctf_stream *stream,
 		struct bt_ctf_event *event);
 
+/*
+ * bt_ctf_stream_set_concurrent: allow concurrent appends to a stream.
+ *
+ * In concurrent mode, bt_ctf_stream_append_event may be called from any
+ * number of threads at once, without locking. Each append reserves a
+ * sequence number atomically, sampling the stream's clock as part of the
+ * reservation so that timestamps never decrease in sequence order, and
+ * then commits the event to a lock-free list. The events of a given
+ * thread are written in the order in which that thread appended them.
+ *
+ * bt_ctf_stream_flush may run while other threads append events, but
+ * must only be called from one thread at a time. It writes every event
+ * reserved before the call, waiting for the appends still in progress to
+ * be committed, and leaves later events to the next packet.
+ *
+ * The stream's packet header, packet context, event context and
+ * discarded events count must not be modified while events are being
+ * appended concurrently. Concurrent mode freezes the stream class and its
+ * event classes, and can only be changed while no event is pending.
+ *
+ * @param stream Stream instance.
+ * @param concurrent 1 to allow concurrent appends, 0 to disallow them.
+ *
+ * Returns 0 on success, a negative value on error.
+ */
+extern int bt_ctf_stream_set_concurrent(struct bt_ctf_stream *stream,
+		int concurrent);
+
 /*
  * bt_ctf_stream_get_packet_header: get a stream's packet header.
  *
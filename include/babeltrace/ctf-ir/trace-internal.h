@@ -58,18 +58,63 @@ struct bt_ctf_trace {
 	GPtrArray *streams; /* Array of ptrs to bt_ctf_stream */
 	struct bt_ctf_field_type *packet_header_type;
 	uint64_t next_stream_id;
+	/* Metadata emitted so far, see bt_ctf_trace_get_metadata_update */
+	GString *emitted_header;	/* NULL: next update is complete */
+	GHashTable *emitted;	/* clocks, stream and event classes emitted */
+	int emitted_unfrozen;	/* an emitted declaration may still change */
 };
 
 struct metadata_context {
 	GString *string;
 	GString *field_name;
 	unsigned int current_indentation_level;
+	/* Declarations to skip, NULL to serialize everything */
+	GHashTable *emitted;
+	int emitted_unfrozen;
 };
 
+/*
+ * Return 1 if the declaration of "object" was already emitted. Otherwise,
+ * record it as emitted and return 0.
+ */
+static inline
+int metadata_context_emitted(struct metadata_context *context,
+		void *object, int frozen)
+{
+	if (!context->emitted) {
+		return 0;
+	}
+
+	if (g_hash_table_lookup_extended(context->emitted, object,
+			NULL, NULL)) {
+		return 1;
+	}
+
+	g_hash_table_insert(context->emitted, object, object);
+	if (!frozen) {
+		context->emitted_unfrozen = 1;
+	}
+	return 0;
+}
+
 BT_HIDDEN
 const char *get_byte_order_string(int byte_order);
 
 BT_HIDDEN
 struct bt_ctf_field_type *get_field_type(enum field_type_alias alias);
 
+/*
+ * Get the metadata declared since the last update. "append" is set to 1
+ * if the returned text must be appended to the metadata emitted so far,
+ * to 0 if it replaces it: the first time, when the trace or environment
+ * changed, or when a declaration emitted earlier was not frozen yet.
+ */
+BT_HIDDEN
+char *bt_ctf_trace_get_metadata_update(struct bt_ctf_trace *trace,
+		int *append);
+
+/* Make the next metadata update complete. */
+BT_HIDDEN
+void bt_ctf_trace_reset_metadata_update(struct bt_ctf_trace *trace);
+
 #endif /* BABELTRACE_CTF_IR_TRACE_INTERNAL_H */
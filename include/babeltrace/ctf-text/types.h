@@ -50,6 +50,7 @@ struct ctf_text_stream_pos {
 	int field_nr;
 	uint64_t last_real_timestamp;	/* to print delta */
 	uint64_t last_cycles_timestamp;	/* to print delta */
+	long unknown_delta_offset;	/* offset of last unknown delta, or -1 */
 	GString *string;	/* Current string */
 };
 
@@ -0,0 +1,98 @@
+#ifndef BABELTRACE_CTF_WRITER_FLUSH_QUEUE_INTERNAL_H
+#define BABELTRACE_CTF_WRITER_FLUSH_QUEUE_INTERNAL_H
+
+/*
+ * BabelTrace - CTF Writer: Asynchronous packet flush queue
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <babeltrace/ctf-writer/ref-internal.h>
+#include <babeltrace/babeltrace-internal.h>
+#include <glib.h>
+#include <pthread.h>
+
+struct bt_ctf_stream_packet;
+
+/*
+ * Packets flushed by the streams of an asynchronous writer, written in
+ * order by the writer's I/O thread.
+ */
+struct bt_ctf_flush_queue {
+	struct bt_ctf_ref ref_count;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	/* Signaled whenever the queue or the I/O thread's state changes */
+	pthread_cond_t cond;
+	GQueue *packets;	/* struct bt_ctf_stream_packet, oldest first */
+	unsigned int max_packets;
+	int flags;		/* enum bt_ctf_writer_async_flags */
+	int running;		/* I/O thread accepts new packets */
+	int busy;		/* I/O thread is writing */
+	int error;		/* a write failed since the last wait */
+	int metadata_fd;
+	GString *metadata;	/* metadata not yet written, or NULL */
+	int metadata_append;	/* append "metadata" to the file */
+	int metadata_error;	/* a metadata write failed since last checked */
+};
+
+BT_HIDDEN
+struct bt_ctf_flush_queue *bt_ctf_flush_queue_create(int metadata_fd,
+		unsigned int max_packets, int flags);
+
+BT_HIDDEN
+void bt_ctf_flush_queue_get(struct bt_ctf_flush_queue *queue);
+
+BT_HIDDEN
+void bt_ctf_flush_queue_put(struct bt_ctf_flush_queue *queue);
+
+/*
+ * Queue a packet. Returns 0 on success, -EAGAIN if the queue is full and
+ * packets are discarded, -ESHUTDOWN if the I/O thread is stopped. The
+ * queue owns the packet only on success.
+ */
+BT_HIDDEN
+int bt_ctf_flush_queue_push_packet(struct bt_ctf_flush_queue *queue,
+		struct bt_ctf_stream_packet *packet);
+
+/*
+ * Queue a metadata update, which is either appended to any update not yet
+ * written or replaces it. Takes ownership of the string on success.
+ * Returns -ESHUTDOWN if the I/O thread is stopped.
+ */
+BT_HIDDEN
+int bt_ctf_flush_queue_push_metadata(struct bt_ctf_flush_queue *queue,
+		GString *metadata, int append);
+
+/*
+ * Return whether a metadata write failed since the last call, in which
+ * case the metadata file may be incomplete and must be rewritten.
+ */
+BT_HIDDEN
+int bt_ctf_flush_queue_metadata_error(struct bt_ctf_flush_queue *queue);
+
+/* Wait until everything queued is written. Returns -1 on write error. */
+BT_HIDDEN
+int bt_ctf_flush_queue_wait(struct bt_ctf_flush_queue *queue);
+
+/* Write everything queued and stop the I/O thread. */
+BT_HIDDEN
+void bt_ctf_flush_queue_stop(struct bt_ctf_flush_queue *queue);
+
+#endif /* BABELTRACE_CTF_WRITER_FLUSH_QUEUE_INTERNAL_H */
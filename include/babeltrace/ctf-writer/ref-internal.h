@@ -29,6 +29,11 @@
 
 #include <assert.h>
 
+/*
+ * Reference counts are updated atomically so that objects shared by
+ * concurrent producers (event classes, field types, clocks) can be
+ * taken and released from any thread.
+ */
 struct bt_ctf_ref {
 	long refcount;
 };
@@ -44,7 +49,7 @@ static inline
 void bt_ctf_ref_get(struct bt_ctf_ref *ref)
 {
 	assert(ref);
-	ref->refcount++;
+	(void) __sync_add_and_fetch(&ref->refcount, 1);
 }
 
 static inline
@@ -53,7 +58,7 @@ void bt_ctf_ref_put(struct bt_ctf_ref *ref,
 {
 	assert(ref);
 	assert(release);
-	if ((--ref->refcount) == 0) {
+	if (__sync_sub_and_fetch(&ref->refcount, 1) == 0) {
 		release(ref);
 	}
 }
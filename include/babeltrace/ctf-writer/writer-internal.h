@@ -35,6 +35,8 @@
 #include <sys/types.h>
 #include <babeltrace/ctf-ir/trace.h>
 
+struct bt_ctf_flush_queue;
+
 struct bt_ctf_writer {
 	struct bt_ctf_ref ref_count;
 	int frozen; /* Protects attributes that can't be changed mid-trace */
@@ -42,6 +44,18 @@ struct bt_ctf_writer {
 	GString *path;
 	int trace_dir_fd;
 	int metadata_fd;
+	/* I/O thread queue, NULL unless the writer is asynchronous */
+	struct bt_ctf_flush_queue *flush_queue;
+	int metadata_packetized; /* Wrap metadata updates in packets */
+	int compressed; /* Write compressed stream files */
 };
 
+/*
+ * Write "len" bytes of metadata, either appended to the metadata file or
+ * replacing its content.
+ */
+BT_HIDDEN
+int bt_ctf_writer_write_metadata(int metadata_fd, const char *metadata,
+		size_t len, int append);
+
 #endif /* BABELTRACE_CTF_WRITER_WRITER_INTERNAL_H */
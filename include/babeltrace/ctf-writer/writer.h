@@ -42,6 +42,14 @@ struct bt_ctf_stream;
 struct bt_ctf_stream_class;
 struct bt_ctf_clock;
 
+/* Flags of bt_ctf_writer_set_async */
+enum bt_ctf_writer_async_flags {
+	/* Drop packets flushed while the queue is full instead of waiting */
+	BT_CTF_WRITER_ASYNC_DISCARD = (1 << 0),
+	/* Start the writeback of packets to disk as soon as they are written */
+	BT_CTF_WRITER_ASYNC_WRITEBACK = (1 << 1),
+};
+
 /*
  * bt_ctf_writer_create: create a writer instance.
  *
@@ -128,10 +136,86 @@ extern char *bt_ctf_writer_get_metadata_string(struct bt_ctf_writer *writer);
  * be flushed automatically when the Writer instance is released (last call to
  * bt_ctf_writer_put).
  *
+ * Declarations already flushed are not written again: only the clocks,
+ * stream classes and event classes added since the last flush are appended
+ * to the metadata file. The whole file is rewritten if the trace's
+ * attributes or environment changed, if a declaration written earlier
+ * could still be modified, or if the previous write failed.
+ *
  * @param writer Writer instance.
  */
 extern void bt_ctf_writer_flush_metadata(struct bt_ctf_writer *writer);
 
+/*
+ * bt_ctf_writer_set_packetized_metadata: use the packetized metadata format.
+ *
+ * Write each metadata flush as a metadata packet, headed by the trace's
+ * UUID and the CTF version, rather than as plain text. The metadata file
+ * is rewritten in the new format on the next flush.
+ *
+ * @param writer Writer instance.
+ * @param packetized 1 to write metadata packets, 0 to write plain text.
+ *
+ * Returns 0 on success, a negative value on error.
+ */
+extern int bt_ctf_writer_set_packetized_metadata(struct bt_ctf_writer *writer,
+		int packetized);
+
+/*
+ * bt_ctf_writer_set_async: write packets from a background thread.
+ *
+ * Once set, bt_ctf_stream_flush hands the current packet over to an I/O
+ * thread owned by the writer and returns immediately, the stream starting
+ * a new packet right away. bt_ctf_writer_flush_metadata queues the
+ * metadata in the same way. At most queue_length packets may be waiting
+ * to be written; when the queue is full, flushing a stream either waits
+ * for a packet to be written (default) or, with
+ * BT_CTF_WRITER_ASYNC_DISCARD, drops the packet's events and adds them to
+ * the stream's discarded events count.
+ *
+ * Must be called before the writer's first stream is created.
+ *
+ * @param writer Writer instance.
+ * @param queue_length Maximum number of packets waiting to be written.
+ * @param flags Bitwise OR of enum bt_ctf_writer_async_flags.
+ *
+ * Returns 0 on success, a negative value on error.
+ */
+extern int bt_ctf_writer_set_async(struct bt_ctf_writer *writer,
+		unsigned int queue_length, int flags);
+
+/*
+ * bt_ctf_writer_wait: wait for queued packets to be written.
+ *
+ * Wait until the I/O thread has written every packet and metadata update
+ * queued so far. Has no effect if the writer is not asynchronous.
+ *
+ * @param writer Writer instance.
+ *
+ * Returns 0 on success, a negative value if the writer is invalid or if
+ * any packet or metadata update could not be written since the last call.
+ */
+extern int bt_ctf_writer_wait(struct bt_ctf_writer *writer);
+
+/*
+ * bt_ctf_writer_set_compressed: compress the trace's stream files.
+ *
+ * Write each stream file as a compressed container in which every packet
+ * is compressed independently, so that readers can still seek to any
+ * packet. The stream file is complete once the stream is released.
+ * Requires babeltrace to be built with libzstd.
+ *
+ * Must be called before the writer's first stream is created.
+ *
+ * @param writer Writer instance.
+ * @param compressed 1 to compress stream files, 0 to write them as is.
+ *
+ * Returns 0 on success, a negative value on error or if compression is
+ * not supported.
+ */
+extern int bt_ctf_writer_set_compressed(struct bt_ctf_writer *writer,
+		int compressed);
+
 /*
  * bt_ctf_writer_set_byte_order: set a field type's byte order.
  *
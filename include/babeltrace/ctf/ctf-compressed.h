@@ -0,0 +1,123 @@
+#ifndef _BABELTRACE_CTF_COMPRESSED_H
+#define _BABELTRACE_CTF_COMPRESSED_H
+
+/*
+ * Common Trace Format
+ *
+ * Compressed stream file container.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <babeltrace/babeltrace-internal.h>
+#include <babeltrace/mmap-align.h>
+#include <sys/types.h>
+#include <stdint.h>
+
+/*
+ * A compressed stream file holds the packets of a CTF stream, each
+ * compressed independently, followed by a table locating them. Packets
+ * are addressed by their offset in the uncompressed stream, so that the
+ * packet index (and index files) of a compressed stream are the same as
+ * those of the uncompressed one.
+ */
+#define CTF_COMPRESSED_MAGIC	0xC1FC0C0D
+#define CTF_COMPRESSED_MAJOR	1
+#define CTF_COMPRESSED_MINOR	0
+
+enum ctf_compressed_scheme {
+	CTF_COMPRESSED_ZSTD = 1,
+};
+
+/*
+ * Header at the beginning of each compressed stream file.
+ * All integer fields are stored in big endian.
+ */
+struct ctf_compressed_file_hdr {
+	uint32_t magic;
+	uint32_t major;
+	uint32_t minor;
+	uint32_t scheme;		/* enum ctf_compressed_scheme */
+	uint64_t nr_packets;
+	uint64_t table_offset;		/* offset of the packet table, in bytes */
+} __attribute__((__packed__));
+
+/*
+ * Packet table entry, one per packet, in stream order.
+ * All integer fields are stored in big endian.
+ */
+struct ctf_compressed_packet {
+	uint64_t offset;		/* offset of the compressed data, in bytes */
+	uint64_t size;			/* compressed size, in bytes */
+	uint64_t packet_size;		/* uncompressed packet size, in bytes */
+	uint64_t content_size;		/* bytes compressed, the rest is zeroed */
+} __attribute__((__packed__));
+
+struct ctf_compressed_stream;
+
+/*
+ * Open the compressed stream file "fd" for reading. Sets "stream" to NULL
+ * if the file is a plain stream file. Returns 0 on success, a negative
+ * value on error.
+ */
+BT_HIDDEN
+int ctf_compressed_open(int fd, struct ctf_compressed_stream **stream);
+
+/*
+ * Create a compressed stream file in the empty file "fd", which is then
+ * owned by the stream. Returns NULL on error or if babeltrace is built
+ * without compression support.
+ */
+BT_HIDDEN
+struct ctf_compressed_stream *ctf_compressed_create(int fd);
+
+/*
+ * Finish writing the stream, if it was created, and free it. Returns 0
+ * on success, a negative value on error.
+ */
+BT_HIDDEN
+int ctf_compressed_close(struct ctf_compressed_stream *stream);
+
+/* Read the stream from "fd" from now on, e.g. after reopening it. */
+BT_HIDDEN
+void ctf_compressed_set_fd(struct ctf_compressed_stream *stream, int fd);
+
+/* Size of the uncompressed stream, in bytes. */
+BT_HIDDEN
+off_t ctf_compressed_size(struct ctf_compressed_stream *stream);
+
+/*
+ * Decompress "length" bytes of the uncompressed stream at "offset" into
+ * the stream's buffer, which is reused by the next call. The returned
+ * struct mmap_align only describes that buffer: free() it once done,
+ * without freeing or unmapping its address. Returns MAP_FAILED on error.
+ */
+BT_HIDDEN
+struct mmap_align *ctf_compressed_map(struct ctf_compressed_stream *stream,
+		size_t length, off_t offset);
+
+/*
+ * Append a packet of "packet_len" bytes, of which the first "content_len"
+ * are stored. Returns 0 on success, a negative value on error.
+ */
+BT_HIDDEN
+int ctf_compressed_append(struct ctf_compressed_stream *stream,
+		const char *packet, size_t content_len, size_t packet_len);
+
+#endif /* _BABELTRACE_CTF_COMPRESSED_H */
@@ -26,10 +26,11 @@
 #define LTTNG_INDEX_H
 
 #include <babeltrace/compat/limits.h>
+#include <stddef.h>
 
 #define CTF_INDEX_MAGIC 0xC1F1DCC1
 #define CTF_INDEX_MAJOR 1
-#define CTF_INDEX_MINOR 0
+#define CTF_INDEX_MINOR 1
 
 /*
  * Header at the beginning of each index file.
@@ -55,6 +56,63 @@ struct ctf_packet_index {
 	uint64_t timestamp_end;
 	uint64_t events_discarded;
 	uint64_t stream_id;
+	/* CTF_INDEX 1.0 limit */
+	uint64_t stream_instance_id;	/* cpu_id of the packets, -1ULL if none */
+	uint64_t packet_seq_num;	/* packet sequence number */
+} __attribute__((__packed__));
+
+/* Length of the entries of 1.0 index files */
+#define CTF_INDEX_1_0_SIZE	offsetof(struct ctf_packet_index, stream_instance_id)
+
+/*
+ * Event rate index file, "index/<stream>.rate", written by
+ * bt_ctf_event_rate_index(). All integer fields are stored in big
+ * endian. The header is followed by one entry per packet of the
+ * stream, each followed by its "nr_buckets" 32-bit event counts.
+ */
+#define CTF_EVENT_RATE_MAGIC 0xC1F1DCE7
+#define CTF_EVENT_RATE_MAJOR 1
+#define CTF_EVENT_RATE_MINOR 0
+
+struct ctf_event_rate_file_hdr {
+	uint32_t magic;
+	uint32_t major;
+	uint32_t minor;
+	uint32_t reserved;
+	uint64_t bucket_ns;		/* bucket duration, in ns */
+	uint64_t nr_packets;
+} __attribute__((__packed__));
+
+struct ctf_event_rate_entry {
+	uint64_t offset;		/* offset of the packet in the file, in bytes */
+	uint64_t nr_events;
+	uint64_t first_bucket;		/* real timestamp_begin / bucket_ns */
+	uint64_t nr_buckets;
+} __attribute__((__packed__));
+
+/*
+ * Event id index file, "index/<stream>.ids", written by
+ * bt_ctf_event_id_index(). All integer fields are stored in big endian.
+ * The header is followed by one entry per packet of the stream, each
+ * followed by its "nr_words" 64-bit words of event id bitmap: bit
+ * (id % 64) of word (id / 64) is set if the packet holds an event of
+ * that id.
+ */
+#define CTF_EVENT_IDS_MAGIC 0xC1F1DCE8
+#define CTF_EVENT_IDS_MAJOR 1
+#define CTF_EVENT_IDS_MINOR 0
+
+struct ctf_event_ids_file_hdr {
+	uint32_t magic;
+	uint32_t major;
+	uint32_t minor;
+	uint32_t reserved;
+	uint64_t nr_words;		/* bitmap words per packet */
+	uint64_t nr_packets;
+} __attribute__((__packed__));
+
+struct ctf_event_ids_entry {
+	uint64_t offset;		/* offset of the packet in the file, in bytes */
 } __attribute__((__packed__));
 
 #endif /* LTTNG_INDEX_H */
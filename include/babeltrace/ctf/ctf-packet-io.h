@@ -0,0 +1,82 @@
+#ifndef _BABELTRACE_CTF_PACKET_IO_H
+#define _BABELTRACE_CTF_PACKET_IO_H
+
+/*
+ * Common Trace Format
+ *
+ * Packets read in buffers instead of mapped.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <babeltrace/babeltrace-internal.h>
+#include <babeltrace/mmap-align.h>
+#include <sys/types.h>
+
+/*
+ * The packets of a stream read with the read or io_uring backend, see
+ * bt_ctf_set_packet_io(): the packet currently read, and the packets
+ * read ahead of it.
+ */
+struct ctf_packet_reader;
+
+/*
+ * Create a packet reader if the current backend reads packets in
+ * buffers. Returns NULL with the mmap backend.
+ */
+BT_HIDDEN
+struct ctf_packet_reader *ctf_packet_reader_create(void);
+
+/* Wait for the reads in flight of a packet reader, and free it. */
+BT_HIDDEN
+void ctf_packet_reader_destroy(struct ctf_packet_reader *reader);
+
+/*
+ * Read "length" bytes of file "fd" at "offset" into a buffer, or take
+ * them from the buffer of a packet read ahead. Bytes past the end of the
+ * file read as zeroes. The buffer is released with
+ * ctf_packet_reader_unmap(). Returns MAP_FAILED on error.
+ */
+BT_HIDDEN
+struct mmap_align *ctf_packet_reader_map(struct ctf_packet_reader *reader,
+		int fd, size_t length, off_t offset);
+
+BT_HIDDEN
+void ctf_packet_reader_unmap(struct ctf_packet_reader *reader,
+		struct mmap_align *mma);
+
+/*
+ * Start reading "length" bytes of file "fd" at "offset" ahead, for a
+ * later ctf_packet_reader_map(). The reads of all the streams are
+ * submitted together in batches. Returns 0 if the read is started or
+ * already in flight, a negative value if the backend can only read
+ * packets synchronously.
+ */
+BT_HIDDEN
+int ctf_packet_reader_prefetch(struct ctf_packet_reader *reader,
+		int fd, size_t length, off_t offset);
+
+/*
+ * Wait for the reads ahead of a packet reader and drop their buffers,
+ * before closing the file they read.
+ */
+BT_HIDDEN
+void ctf_packet_reader_drop_ahead(struct ctf_packet_reader *reader);
+
+#endif /* _BABELTRACE_CTF_PACKET_IO_H */
@@ -230,12 +230,18 @@ uint64_t bt_ctf_get_struct_field_count(const struct bt_definition *field);
  * bt_ctf_get_enum_int gets the integer field of an enumeration.
  * bt_ctf_get_enum_str gets the string matching the current enumeration
  * value, or NULL if the current value does not match any string.
+ * bt_ctf_get_int_array gets the elements of an array or sequence of
+ * byte-aligned 8, 16, 32 or 64-bit integers as a contiguous buffer of
+ * "*len" values of "*elem_len" bits, in native byte order. The buffer
+ * is only valid until the next event is read.
  */
 uint64_t bt_ctf_get_uint64(const struct bt_definition *field);
 int64_t bt_ctf_get_int64(const struct bt_definition *field);
 const struct bt_definition *bt_ctf_get_enum_int(const struct bt_definition *field);
 const char *bt_ctf_get_enum_str(const struct bt_definition *field);
 char *bt_ctf_get_char_array(const struct bt_definition *field);
+const void *bt_ctf_get_int_array(const struct bt_definition *field,
+		uint64_t *len, size_t *elem_len);
 char *bt_ctf_get_string(const struct bt_definition *field);
 double bt_ctf_get_float(const struct bt_definition *field);
 const struct bt_definition *bt_ctf_get_variant(const struct bt_definition *field);
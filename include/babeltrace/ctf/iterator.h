@@ -54,10 +54,13 @@ struct bt_ctf_event;
  *
  * Return a pointer to the newly allocated iterator.
  *
- * Only one iterator can be created against a context. If more than one
- * iterator is being created for the same context, the second creation
- * will return NULL. The previous iterator must be destroyed before
- * creation of the new iterator for this function to succeed.
+ * Several iterators can be created against a context, each with its
+ * own position and events. Every iterator but the first one opens its
+ * own file descriptor and mapping on each stream, sharing the packet
+ * indexes: traces opened from memory-mapped streams (e.g. lttng-live)
+ * only support one iterator, and the second creation returns NULL.
+ * Iterators can then be used concurrently from different threads, one
+ * thread per iterator; creating and destroying them must be serialized.
  */
 struct bt_ctf_iter *bt_ctf_iter_create(struct bt_context *ctx,
 		const struct bt_iter_pos *begin_pos,
@@ -94,6 +97,24 @@ struct bt_ctf_event *bt_ctf_iter_read_event(struct bt_ctf_iter *iter);
 struct bt_ctf_event *bt_ctf_iter_read_event_flags(struct bt_ctf_iter *iter,
 		int *flags);
 
+/*
+ * bt_ctf_iter_set_event_filter: only read the events named in "names".
+ *
+ * @iter: trace collection iterator (input). Should NOT be NULL.
+ * @names: names of the events to read.
+ * @nr_names: number of names, 0 to read all the events again.
+ *
+ * The other events are skipped while decoding. Packets holding none of
+ * the events to read are skipped without being mapped, for the streams
+ * whose event ids were indexed with bt_ctf_event_id_index().
+ *
+ * The iterator is moved back to the beginning of the trace collection.
+ *
+ * Return 0 on success, a negative value on error.
+ */
+int bt_ctf_iter_set_event_filter(struct bt_ctf_iter *iter,
+		const char * const *names, unsigned int nr_names);
+
 /*
  * bt_ctf_get_lost_events_count: returns the number of events discarded
  * immediately prior to the last event read
@@ -104,6 +125,77 @@ struct bt_ctf_event *bt_ctf_iter_read_event_flags(struct bt_ctf_iter *iter,
  */
 uint64_t bt_ctf_get_lost_events_count(struct bt_ctf_iter *iter);
 
+/*
+ * bt_ctf_set_stream_limits: bound the resources held by CTF streams.
+ *
+ * Cap the number of stream files kept open and the bytes of packets kept
+ * mapped by the CTF traces opened for reading, for instance to merge
+ * thousands of streams. When a limit is exceeded, the least recently read
+ * streams are parked: their packet is unmapped and their file closed.
+ * A parked stream is reopened at the same position when it is read
+ * again. The current packet of a stream being read is always kept, so
+ * the limits may be exceeded by a single stream.
+ *
+ * @max_open_files: maximum number of open stream files, 0 for no limit.
+ * @max_mapped_bytes: maximum bytes of mapped packets, 0 for no limit.
+ *
+ * There is no limit by default. The limits apply to all the traces of
+ * the process, to the streams opened while a limit is set. The cursors
+ * opened by the second and later iterators of a context read their own
+ * copy of the stream files, which is not bounded.
+ *
+ * Reading a stream may park the streams of other traces, so when limits
+ * are set, all the traces must be read from the same thread. Streams
+ * opened without limits are not tracked, and the traces of different
+ * contexts can then be read from different threads.
+ */
+void bt_ctf_set_stream_limits(unsigned int max_open_files,
+		uint64_t max_mapped_bytes);
+
+/*
+ * bt_ctf_set_readahead: set how many packets are read ahead.
+ *
+ * When a stream of a CTF trace opened for reading moves to a packet,
+ * the kernel is asked to read that packet and the next "nr_packets"
+ * packets of the stream into the page cache in the background, so that
+ * reading a trace from slow storage does not block on every page of
+ * every packet. Packets of compressed streams are not read ahead.
+ *
+ * @nr_packets: packets read ahead of the current one, 0 to disable.
+ *
+ * The default is 2 packets. The setting applies to all the traces of
+ * the process.
+ */
+void bt_ctf_set_readahead(unsigned int nr_packets);
+
+enum bt_ctf_packet_io {
+	/* Packets are mapped in memory, and read by page faults. */
+	BT_CTF_PACKET_IO_MMAP = 0,
+	/* Packets are read in buffers with pread(). */
+	BT_CTF_PACKET_IO_READ,
+	/*
+	 * Packets are read in buffers, and the packets read ahead (see
+	 * bt_ctf_set_readahead()) of all the streams are read
+	 * asynchronously with io_uring, submitted in batches.
+	 */
+	BT_CTF_PACKET_IO_URING,
+};
+
+/*
+ * bt_ctf_set_packet_io: choose how the packets of CTF traces are read.
+ *
+ * BT_CTF_PACKET_IO_URING falls back to BT_CTF_PACKET_IO_READ when
+ * babeltrace is built without liburing or when the kernel does not
+ * support io_uring. Packets of compressed streams are always read by
+ * decompressing them.
+ *
+ * The default is BT_CTF_PACKET_IO_MMAP. The setting applies to the
+ * streams opened afterwards, in all the traces of the process.
+ *
+ * Return the backend used from now on.
+ */
+enum bt_ctf_packet_io bt_ctf_set_packet_io(enum bt_ctf_packet_io io);
+
 #ifdef __cplusplus
 }
 #endif
@@ -41,9 +41,38 @@
 #define CTF_MAGIC	0xC1FC1FC1
 #define TSDL_MAGIC	0x75D11D57
 
+/* Events of a packet, see bt_ctf_event_rate_index() */
+struct ctf_event_rate_packet {
+	uint64_t nr_events;
+	uint64_t first_bucket;		/* real timestamp / bucket_ns */
+	uint64_t nr_buckets;		/* 0 if the packet has no timestamps */
+	uint64_t counts_offset;		/* first count, in event_rate_counts */
+};
+
 struct ctf_file_stream {
 	struct ctf_stream_definition parent;
 	struct ctf_stream_pos pos;	/* current stream position */
+	struct ctf_file_stream *origin;	/* stream read by this cursor, or NULL */
+	/* Reader resource limits, see bt_ctf_set_stream_limits() */
+	GList lru;		/* open streams link, data NULL if untracked */
+	int parked;		/* file closed and packet unmapped */
+	size_t parked_map_len;	/* packet mapping to restore, in bytes */
+	/* Last event, cached by BT_SEEK_LAST while nr_packets is unchanged */
+	size_t last_event_nr_packets;	/* packets in the index, 0 if unknown */
+	size_t last_event_index;	/* packet holding the last event */
+	int64_t last_event_offset;	/* offset of the last event, in bits */
+	uint64_t last_event_real_timestamp;
+	uint64_t last_event_cycles_timestamp;
+	/* Event rate index, NULL arrays if not built */
+	uint64_t event_rate_bucket_ns;
+	GArray *event_rate_packets;	/* struct ctf_event_rate_packet, per packet */
+	GArray *event_rate_counts;	/* uint32_t events per bucket of the packets */
+	/* Event ids of each packet, NULL if not indexed. Unused by cursors. */
+	uint64_t event_ids_words;	/* bitmap words per packet */
+	GArray *packet_event_ids;	/* uint64_t bitmap words, per packet */
+	/* Ids of the events read, NULL to read all of them */
+	GArray *event_filter;		/* uint64_t bitmap words */
+	uint64_t readahead_index;	/* first packet not read ahead yet */
 };
 
 #define HEADER_END		char end_field
@@ -0,0 +1,86 @@
+#ifndef _BABELTRACE_CTF_PACKET_STREAM_INTERNAL_H
+#define _BABELTRACE_CTF_PACKET_STREAM_INTERNAL_H
+
+/*
+ * Common Trace Format
+ *
+ * Packets decoded in place from buffers held in memory by the caller.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <babeltrace/babeltrace-internal.h>
+#include <babeltrace/mmap-align.h>
+#include <babeltrace/ctf/packet-stream.h>
+#include <sys/types.h>
+
+/*
+ * The buffers pushed to a packet stream are laid out one after the other
+ * at increasing offsets, as if they were the contents of a stream file,
+ * so that its packets are indexed and read with the offsets of files.
+ */
+
+/*
+ * Packet stream described by "mmap_stream", NULL if it was not returned
+ * by bt_ctf_packet_stream_mmap_stream().
+ */
+BT_HIDDEN
+struct bt_ctf_packet_stream *ctf_packet_stream_from_mmap(
+		struct bt_mmap_stream *mmap_stream);
+
+/*
+ * Get the end offset of the buffer pushed at "offset" in "end".
+ * Returns 0 on success, -EAGAIN if no buffer is pushed there yet, EOF
+ * if the stream is closed before "offset", or -EINVAL if "offset" is
+ * within a buffer.
+ */
+BT_HIDDEN
+int ctf_packet_stream_next(struct bt_ctf_packet_stream *stream,
+		off_t offset, off_t *end);
+
+/*
+ * Offset of the first buffer which is not released yet: the packets
+ * before it cannot be read anymore.
+ */
+BT_HIDDEN
+off_t ctf_packet_stream_begin(struct bt_ctf_packet_stream *stream);
+
+/*
+ * Get a mapping of "length" bytes at "offset" in the buffer holding
+ * them, which is not copied. The mapping is freed with
+ * ctf_packet_stream_unmap(). Returns MAP_FAILED with errno set if the
+ * range is not within a single buffer.
+ */
+BT_HIDDEN
+struct mmap_align *ctf_packet_stream_map(struct bt_ctf_packet_stream *stream,
+		size_t length, off_t offset);
+
+BT_HIDDEN
+void ctf_packet_stream_unmap(struct bt_ctf_packet_stream *stream,
+		struct mmap_align *mma);
+
+/*
+ * Release the buffers which end at or before "offset", the reader having
+ * moved past them.
+ */
+BT_HIDDEN
+void ctf_packet_stream_release(struct bt_ctf_packet_stream *stream,
+		off_t offset);
+
+#endif /* _BABELTRACE_CTF_PACKET_STREAM_INTERNAL_H */
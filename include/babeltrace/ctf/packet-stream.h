@@ -0,0 +1,117 @@
+#ifndef _BABELTRACE_CTF_PACKET_STREAM_H
+#define _BABELTRACE_CTF_PACKET_STREAM_H
+
+/*
+ * BabelTrace
+ *
+ * CTF in-memory packet stream API
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A packet stream is a CTF stream whose packets are held in memory by
+ * the caller, for instance in the sub-buffers of a ring buffer, instead
+ * of read from a file. The packets are decoded in place, without being
+ * copied.
+ *
+ * Packet streams are read as the streams of a trace added with
+ * bt_context_add_trace(), with a NULL path and a bt_mmap_stream_list
+ * holding the struct bt_mmap_stream of each packet stream, returned by
+ * bt_ctf_packet_stream_mmap_stream(). The "packet_seek" argument may be
+ * NULL if all the streams of the list are packet streams. At least one
+ * packet must be pushed to each packet stream before the trace is
+ * added, to find its stream class.
+ *
+ * Packets may keep being pushed while the trace is read, for in-process
+ * live analysis: once a stream has no packet left to read, the iterator
+ * reports more events may come (BT_ITER_FLAG_RETRY) until new packets
+ * are pushed, or reaches the end of the stream once it is closed.
+ *
+ * The buffer of a packet is released once the stream is read past its
+ * packets, so that the packets of a stream can only be read once:
+ * seeking back before the current packet reaches the end of the stream.
+ *
+ * Buffers need no particular alignment in memory: the fields are read
+ * in place with byte accesses or memcpy(), their CTF alignment being
+ * relative to the beginning of their packet. Packets do not need to be
+ * page aligned either, but each packet must be whole within a buffer.
+ */
+struct bt_ctf_packet_stream;
+struct bt_mmap_stream;
+
+/*
+ * Called when a buffer pushed to a packet stream is not used anymore.
+ */
+typedef void (*bt_ctf_packet_release_cb)(const void *data, size_t len,
+		void *priv);
+
+/*
+ * bt_ctf_packet_stream_create: create an empty packet stream.
+ *
+ * Returns NULL on error.
+ */
+struct bt_ctf_packet_stream *bt_ctf_packet_stream_create(void);
+
+/*
+ * bt_ctf_packet_stream_destroy: release the buffers left in a packet
+ * stream and free it. The trace reading the stream must have been
+ * removed from its context first.
+ */
+void bt_ctf_packet_stream_destroy(struct bt_ctf_packet_stream *stream);
+
+/*
+ * bt_ctf_packet_stream_push: append a buffer of "len" bytes, holding one
+ * or more whole packets, to a packet stream. "data" must stay valid and
+ * unchanged until "release" (which may be NULL) is called with "priv".
+ * Packets may be pushed from another thread than the one reading the
+ * stream.
+ *
+ * Returns 0 on success, -EINVAL for an empty buffer or a closed stream.
+ */
+int bt_ctf_packet_stream_push(struct bt_ctf_packet_stream *stream,
+		const void *data, size_t len, bt_ctf_packet_release_cb release,
+		void *priv);
+
+/*
+ * bt_ctf_packet_stream_close: mark the end of a packet stream, once its
+ * last packet is pushed.
+ */
+void bt_ctf_packet_stream_close(struct bt_ctf_packet_stream *stream);
+
+/*
+ * bt_ctf_packet_stream_mmap_stream: get the struct bt_mmap_stream to add
+ * to a bt_mmap_stream_list to read a packet stream. It belongs to the
+ * packet stream and must not be modified but for its "list" member.
+ */
+struct bt_mmap_stream *bt_ctf_packet_stream_mmap_stream(
+		struct bt_ctf_packet_stream *stream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _BABELTRACE_CTF_PACKET_STREAM_H */
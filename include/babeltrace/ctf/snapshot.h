@@ -0,0 +1,179 @@
+#ifndef _BABELTRACE_CTF_SNAPSHOT_H
+#define _BABELTRACE_CTF_SNAPSHOT_H
+
+/*
+ * BabelTrace
+ *
+ * CTF event snapshot API
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <babeltrace/ctf/events.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * An event read from an iterator is only valid until the iterator moves
+ * to the next event. A snapshot is a copy of the decoded fields of an
+ * event, which stays valid until its arena is reset or destroyed, even
+ * after the iterator moves or the trace is removed from its context.
+ *
+ * Snapshots are allocated in large blocks of their arena and are never
+ * freed individually: the whole arena is reset or destroyed at once.
+ * An arena may only hold snapshots of the events of a single context,
+ * and is not thread-safe.
+ */
+struct bt_ctf_snapshot_arena;
+struct bt_ctf_event_snapshot;
+
+enum bt_ctf_snapshot_field_flags {
+	/* Integer, enumeration and packed integer array values are signed. */
+	BT_CTF_SNAPSHOT_FIELD_SIGNED =		(1 << 0),
+	/* Array or sequence of text, in "str". */
+	BT_CTF_SNAPSHOT_FIELD_TEXT =		(1 << 1),
+	/* Array or sequence of integers, packed in "u.values". */
+	BT_CTF_SNAPSHOT_FIELD_PACKED =		(1 << 2),
+};
+
+/*
+ * A field of a snapshot. Depending on its type:
+ *
+ * - CTF_TYPE_INTEGER: the value is in u._unsigned or u._signed.
+ * - CTF_TYPE_FLOAT: the value is in u._float.
+ * - CTF_TYPE_ENUM: the label is in "str" (NULL if the value matches no
+ *   label) and the integer value in u._unsigned or u._signed.
+ * - CTF_TYPE_STRING: the "len" bytes of the string are in "str".
+ * - CTF_TYPE_STRUCT: the "len" fields are in u.fields.
+ * - CTF_TYPE_VARIANT: the selected field is u.fields[0], "len" is 1.
+ * - CTF_TYPE_ARRAY, CTF_TYPE_SEQUENCE: the "len" elements are either
+ *   text in "str" (BT_CTF_SNAPSHOT_FIELD_TEXT), integers of "elem_len"
+ *   bits in native byte order in u.values (BT_CTF_SNAPSHOT_FIELD_PACKED),
+ *   or fields in u.fields.
+ *
+ * Strings are null-terminated. Field names are NULL for the elements of
+ * arrays and sequences.
+ */
+struct bt_ctf_snapshot_field {
+	const char *name;
+	enum ctf_type_id type;
+	uint16_t flags;
+	uint16_t elem_len;
+	uint64_t len;
+	const char *str;
+	union {
+		uint64_t _unsigned;
+		int64_t _signed;
+		double _float;
+		const struct bt_ctf_snapshot_field *fields;
+		const void *values;
+	} u;
+};
+
+/*
+ * bt_ctf_snapshot_arena_create: create an empty arena.
+ *
+ * Returns NULL on error.
+ */
+struct bt_ctf_snapshot_arena *bt_ctf_snapshot_arena_create(void);
+
+/*
+ * bt_ctf_snapshot_arena_destroy: free an arena and all its snapshots.
+ */
+void bt_ctf_snapshot_arena_destroy(struct bt_ctf_snapshot_arena *arena);
+
+/*
+ * bt_ctf_snapshot_arena_reset: free all the snapshots of an arena,
+ * keeping its memory to allocate the next ones.
+ */
+void bt_ctf_snapshot_arena_reset(struct bt_ctf_snapshot_arena *arena);
+
+/*
+ * bt_ctf_snapshot_arena_get_size: number of bytes used by the snapshots
+ * of an arena.
+ */
+size_t bt_ctf_snapshot_arena_get_size(const struct bt_ctf_snapshot_arena *arena);
+
+/*
+ * bt_ctf_event_snapshot_create: copy the fields of an event into a new
+ * snapshot allocated in "arena".
+ *
+ * Returns NULL on error, including for an event of another context
+ * than the previous snapshots of the arena.
+ */
+const struct bt_ctf_event_snapshot *bt_ctf_event_snapshot_create(
+		struct bt_ctf_snapshot_arena *arena,
+		const struct bt_ctf_event *event);
+
+/*
+ * Event information, as bt_ctf_event_name(), bt_ctf_get_cycles(),
+ * bt_ctf_get_timestamp() and bt_ctf_event_get_handle_id().
+ */
+const char *bt_ctf_event_snapshot_name(
+		const struct bt_ctf_event_snapshot *snapshot);
+uint64_t bt_ctf_event_snapshot_get_cycles(
+		const struct bt_ctf_event_snapshot *snapshot);
+uint64_t bt_ctf_event_snapshot_get_timestamp(
+		const struct bt_ctf_event_snapshot *snapshot);
+int bt_ctf_event_snapshot_get_handle_id(
+		const struct bt_ctf_event_snapshot *snapshot);
+
+/*
+ * bt_ctf_event_snapshot_get_field_count: number of fields of a top-level
+ * scope of the event, 0 if the event has no such scope.
+ *
+ * bt_ctf_event_snapshot_get_field_index: the field at position "index"
+ * of a top-level scope, or NULL if out of range.
+ */
+unsigned int bt_ctf_event_snapshot_get_field_count(
+		const struct bt_ctf_event_snapshot *snapshot,
+		enum bt_ctf_scope scope);
+const struct bt_ctf_snapshot_field *bt_ctf_event_snapshot_get_field_index(
+		const struct bt_ctf_event_snapshot *snapshot,
+		enum bt_ctf_scope scope, unsigned int index);
+
+/*
+ * bt_ctf_event_snapshot_get_field: the field named "name" of the first
+ * scope declaring it, in the order: event fields, event context, stream
+ * event context, event header, packet context and packet header.
+ * The lookup takes constant time.
+ *
+ * Returns NULL if no scope has such a field.
+ */
+const struct bt_ctf_snapshot_field *bt_ctf_event_snapshot_get_field(
+		const struct bt_ctf_event_snapshot *snapshot,
+		const char *name);
+
+/*
+ * bt_ctf_snapshot_field_get_member: the field named "name" of a
+ * structure field, or NULL if there is none.
+ */
+const struct bt_ctf_snapshot_field *bt_ctf_snapshot_field_get_member(
+		const struct bt_ctf_snapshot_field *field, const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _BABELTRACE_CTF_SNAPSHOT_H */
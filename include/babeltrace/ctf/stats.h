@@ -0,0 +1,173 @@
+#ifndef _BABELTRACE_CTF_STATS_H
+#define _BABELTRACE_CTF_STATS_H
+
+/*
+ * BabelTrace
+ *
+ * CTF trace statistics API
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct bt_context;
+
+/*
+ * Statistics of a stream file, computed from its packet index.
+ * Timestamps are real timestamps, in nanoseconds.
+ */
+struct bt_ctf_stream_stats {
+	const char *path;		/* stream file path */
+	int handle_id;			/* handle of the trace of the stream */
+	uint64_t stream_id;		/* stream class id */
+	int64_t cpu_id;			/* packet context cpu_id, -1 if none */
+	uint64_t nr_packets;
+	uint64_t events_discarded;	/* events discarded by the tracer */
+	uint64_t content_bytes;		/* bytes of packet content */
+	uint64_t packet_bytes;		/* bytes of packets, padding included */
+	uint64_t timestamp_begin;
+	uint64_t timestamp_end;
+};
+
+/*
+ * Number of events of an event class. Only computed with
+ * BT_CTF_STATS_EVENT_COUNTS, by decoding the packets. The count is an
+ * estimate when the packets are sampled.
+ */
+struct bt_ctf_event_class_stats {
+	const char *name;
+	int handle_id;
+	uint64_t stream_id;
+	uint64_t event_id;
+	uint64_t count;
+};
+
+struct bt_ctf_stats {
+	/* Totals over the trace collection */
+	uint64_t nr_packets;
+	uint64_t events_discarded;
+	uint64_t content_bytes;
+	uint64_t packet_bytes;
+	uint64_t timestamp_begin;
+	uint64_t timestamp_end;
+
+	unsigned int nr_streams;
+	struct bt_ctf_stream_stats *streams;
+	unsigned int nr_event_classes;
+	struct bt_ctf_event_class_stats *event_classes;
+};
+
+enum bt_ctf_stats_flags {
+	/* Also count events per event class by decoding packets. */
+	BT_CTF_STATS_EVENT_COUNTS =	(1 << 0),
+};
+
+/*
+ * bt_ctf_stats_create: compute the statistics of all the traces of a
+ * context.
+ *
+ * Everything but the event counts is aggregated from the packet
+ * indexes, without reading trace data. With BT_CTF_STATS_EVENT_COUNTS,
+ * one packet out of every "sample_every" packets of each stream is
+ * decoded (all of them if sample_every is 0 or 1), and the counts are
+ * scaled to the number of packets of the stream.
+ *
+ * Decoding packets moves the streams positions, so this cannot be
+ * called while an iterator exists on the context.
+ *
+ * Returns NULL on error.
+ */
+struct bt_ctf_stats *bt_ctf_stats_create(struct bt_context *ctx,
+		int flags, unsigned int sample_every);
+
+/*
+ * bt_ctf_stats_destroy: free statistics returned by
+ * bt_ctf_stats_create().
+ */
+void bt_ctf_stats_destroy(struct bt_ctf_stats *stats);
+
+enum bt_ctf_event_rate_flags {
+	/* Save the event rate index next to the stream index files. */
+	BT_CTF_EVENT_RATE_SAVE =	(1 << 0),
+};
+
+/*
+ * bt_ctf_event_rate_index: count the events of each packet of all the
+ * traces of a context, in total and per "bucket_ns" nanoseconds of
+ * real time, for bt_ctf_event_rate_query().
+ *
+ * The counts of a stream are loaded from its "index/<stream>.rate"
+ * file when it matches the bucket duration and the packet index.
+ * Otherwise, its packets are decoded, which moves the streams positions:
+ * this cannot be called while an iterator exists on the context. With
+ * BT_CTF_EVENT_RATE_SAVE, the counts decoded are saved to that file.
+ *
+ * Returns 0 on success, a negative value on error.
+ */
+int bt_ctf_event_rate_index(struct bt_context *ctx, uint64_t bucket_ns,
+		int flags);
+
+/*
+ * bt_ctf_event_rate_query: number of events of all the traces of a
+ * context within [begin, end) (real timestamps, in ns), split in
+ * "nr_buckets" buckets of equal duration stored in "counts".
+ *
+ * Only the packet index and the counts of bt_ctf_event_rate_index()
+ * are read, and events are attributed to buckets with the resolution
+ * of its "bucket_ns".
+ *
+ * Returns 0 on success, -ENOENT if a stream was not indexed with
+ * bt_ctf_event_rate_index(), another negative value on error.
+ */
+int bt_ctf_event_rate_query(struct bt_context *ctx, uint64_t begin,
+		uint64_t end, unsigned int nr_buckets, uint64_t *counts);
+
+enum bt_ctf_event_id_index_flags {
+	/* Save the event id index next to the stream index files. */
+	BT_CTF_EVENT_ID_INDEX_SAVE =	(1 << 0),
+};
+
+/*
+ * bt_ctf_event_id_index: record the ids of the events held by each
+ * packet of all the traces of a context, so that iterators filtering
+ * events with bt_ctf_iter_set_event_filter() skip the packets holding
+ * none of the events they read without mapping them.
+ *
+ * The event ids of a stream are loaded from its "index/<stream>.ids"
+ * file when it matches the event classes and the packet index.
+ * Otherwise, its packets are decoded, which moves the streams positions:
+ * this cannot be called while an iterator exists on the context. With
+ * BT_CTF_EVENT_ID_INDEX_SAVE, the event ids decoded are saved to that
+ * file.
+ *
+ * Returns 0 on success, a negative value on error.
+ */
+int bt_ctf_event_id_index(struct bt_context *ctx, int flags);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _BABELTRACE_CTF_STATS_H */
@@ -43,6 +43,9 @@
 #define LAST_OFFSET_POISON	((int64_t) ~0ULL)
 
 struct bt_stream_callbacks;
+struct ctf_compressed_stream;
+struct ctf_packet_reader;
+struct bt_ctf_packet_stream;
 
 struct packet_index_time {
 	uint64_t timestamp_begin;
@@ -56,6 +59,7 @@ struct packet_index {
 	uint64_t content_size;	/* content size, in bits */
 	uint64_t events_discarded;
 	uint64_t events_discarded_len;	/* length of the field, in bits */
+	int64_t cpu_id;		/* packet context cpu_id, -1 if unknown */
 	struct packet_index_time ts_cycles;	/* timestamp in cycles */
 	struct packet_index_time ts_real;	/* realtime timestamp */
 };
@@ -70,6 +74,12 @@ struct ctf_stream_pos {
 	GArray *packet_index;	/* contains struct packet_index */
 	int prot;		/* mmap protection */
 	int flags;		/* mmap flags */
+	/* Reader only: packets decompressed instead of mapped. NULL if unset. */
+	struct ctf_compressed_stream *compressed;
+	/* Reader only: packets read in buffers instead of mapped. NULL if unset. */
+	struct ctf_packet_reader *packet_reader;
+	/* Reader only: packets pushed in memory instead of mapped. NULL if unset. */
+	struct bt_ctf_packet_stream *packet_stream;
 
 	/* Current position */
 	off_t mmap_offset;	/* mmap offset in the file, in bytes */
@@ -86,6 +96,10 @@ struct ctf_stream_pos {
 	void (*packet_seek)(struct bt_stream_pos *pos, size_t index,
 			int whence); /* function called to switch packet */
 
+	/* Writer only */
+	uint64_t write_packet_size;	/* size of new packets, in bits. 0: default */
+	off_t reserved_offset;	/* end of the file space allocated ahead, in bytes */
+
 	int dummy;		/* dummy position, for length calculation */
 	struct bt_stream_callbacks *cb;	/* Callbacks registered for iterator. */
 	void *priv;
@@ -102,6 +116,10 @@ int ctf_integer_read(struct bt_stream_pos *pos, struct bt_definition *definition
 BT_HIDDEN
 int ctf_integer_write(struct bt_stream_pos *pos, struct bt_definition *definition);
 BT_HIDDEN
+int ctf_integer_bulk_read(struct ctf_stream_pos *pos,
+		const struct declaration_integer *integer_declaration,
+		GArray *values, uint64_t len);
+BT_HIDDEN
 int ctf_float_read(struct bt_stream_pos *pos, struct bt_definition *definition);
 BT_HIDDEN
 int ctf_float_write(struct bt_stream_pos *pos, struct bt_definition *definition);
@@ -131,6 +149,8 @@ void ctf_packet_seek(struct bt_stream_pos *pos, size_t index, int whence);
 int ctf_init_pos(struct ctf_stream_pos *pos, struct bt_trace_descriptor *trace,
 		int fd, int open_flags);
 int ctf_fini_pos(struct ctf_stream_pos *pos);
+BT_HIDDEN
+int ctf_pos_reserve(struct ctf_stream_pos *pos, off_t end);
 
 static inline
 int ctf_pos_access_ok(struct ctf_stream_pos *pos, uint64_t bit_len)
@@ -246,5 +266,13 @@ void ctf_print_timestamp(FILE *fp, struct ctf_stream_definition *stream,
 			uint64_t timestamp);
 int ctf_append_trace_metadata(struct bt_trace_descriptor *tdp,
 			FILE *metadata_fp);
+/*
+ * Copy a CTF trace opened for reading into a CTF trace opened for
+ * writing, in its subdirectory "name" (or its top directory if NULL),
+ * keeping only the events within [begin, end] (real timestamps, in ns).
+ */
+int ctf_copy_trace(struct bt_trace_descriptor *td_write,
+		struct bt_trace_descriptor *td_read, const char *name,
+		uint64_t begin, uint64_t end);
 
 #endif /* _BABELTRACE_CTF_TYPES_H */
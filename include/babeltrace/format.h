@@ -45,6 +45,7 @@ struct bt_stream_pos;
 struct bt_context;
 struct bt_trace_handle;
 struct bt_trace_descriptor;
+struct ctf_stream_definition;
 
 struct bt_mmap_stream {
 	int fd;
@@ -78,6 +79,13 @@ struct bt_format {
 	uint64_t (*timestamp_end)(struct bt_trace_descriptor *descriptor,
 			struct bt_trace_handle *handle, enum bt_clock_type type);
 	int (*convert_index_timestamp)(struct bt_trace_descriptor *descriptor);
+	/*
+	 * Iterator-private cursor on a stream, used by every iterator but
+	 * the first one created on a context. NULL if unsupported.
+	 */
+	struct ctf_stream_definition *(*open_stream_cursor)(
+			struct ctf_stream_definition *stream);
+	int (*close_stream_cursor)(struct ctf_stream_definition *cursor);
 };
 
 extern struct bt_format *bt_lookup_format(bt_intern_str qname);
@@ -30,6 +30,7 @@
  */
 
 #include <babeltrace/ctf/events.h>
+#include <glib.h>
 
 /*
  * struct bt_iter: data structure representing an iterator on a trace
@@ -39,6 +40,12 @@ struct bt_iter {
 	struct ptr_heap *stream_heap;
 	struct bt_context *ctx;
 	const struct bt_iter_pos *end_pos;
+	/*
+	 * Private cursors of this iterator, indexed by the file stream
+	 * they read. NULL for the iterator reading the file streams
+	 * themselves, the context's current_iterator.
+	 */
+	GHashTable *cursors;
 };
 
 /*
@@ -52,6 +59,12 @@ struct bt_iter {
  * By default, if begin_pos is NULL, a BT_SEEK_CUR is performed at
  * creation. By default, if end_pos is NULL, a BT_SEEK_END (end of
  * trace) is the EOF criterion.
+ *
+ * Several iterators can be created on a context: the first one reads
+ * the file streams of the traces, the others each open their own cursor
+ * on every stream, sharing the packet indexes. Once created, iterators
+ * can be used concurrently from different threads; creating and
+ * destroying them must be serialized.
  */
 struct bt_iter *bt_iter_create(struct bt_context *ctx,
 		const struct bt_iter_pos *begin_pos,
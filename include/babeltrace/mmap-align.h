@@ -87,6 +87,32 @@ int munmap_align(struct mmap_align *mma)
 	return munmap(page_aligned_addr, page_aligned_length);
 }
 
+#if defined(HAVE_MREMAP) && defined(MREMAP_MAYMOVE)
+/*
+ * Resize a mapping to "length" bytes from its virtual address, possibly
+ * moving it. Returns 0 on success, -1 on error, in which case the
+ * mapping is unchanged.
+ */
+static inline
+int mremap_align(struct mmap_align *mma, size_t length)
+{
+	size_t page_offset, page_aligned_length;
+	void *page_aligned_addr;
+
+	page_offset = (char *) mma->addr - (char *) mma->page_aligned_addr;
+	page_aligned_length = ALIGN(length + page_offset, PAGE_SIZE);
+	page_aligned_addr = mremap(mma->page_aligned_addr,
+		mma->page_aligned_length, page_aligned_length, MREMAP_MAYMOVE);
+	if (page_aligned_addr == MAP_FAILED)
+		return -1;
+	mma->page_aligned_addr = page_aligned_addr;
+	mma->page_aligned_length = page_aligned_length;
+	mma->addr = (char *) page_aligned_addr + page_offset;
+	mma->length = length;
+	return 0;
+}
+#endif
+
 static inline
 void *mmap_align_addr(struct mmap_align *mma)
 {
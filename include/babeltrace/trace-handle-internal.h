@@ -32,6 +32,7 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <babeltrace/babeltrace-internal.h>
 #include <babeltrace/context.h>
 #include <babeltrace/format.h>
 
@@ -50,6 +51,11 @@ struct bt_trace_handle {
 	uint64_t real_timestamp_end;
 	uint64_t cycles_timestamp_begin;
 	uint64_t cycles_timestamp_end;
+	/*
+	 * Set when packets were indexed after the timestamps above were
+	 * computed (live traces): they are updated on the next access.
+	 */
+	int timestamps_stale;
 };
 
 /*
@@ -64,4 +70,18 @@ struct bt_trace_handle *bt_trace_handle_create(struct bt_context *ctx);
  */
 void bt_trace_handle_destroy(struct bt_trace_handle *bt);
 
+/*
+ * bt_trace_handle_update_timestamps : extend the cached begin and end
+ * timestamps of a trace to the packets indexed so far
+ */
+BT_HIDDEN
+void bt_trace_handle_update_timestamps(struct bt_trace_handle *handle);
+
+/*
+ * bt_trace_handle_invalidate_timestamps : mark the cached begin and end
+ * timestamps of a trace, and of its trace collection, as stale after
+ * new packets were indexed
+ */
+void bt_trace_handle_invalidate_timestamps(struct bt_trace_handle *handle);
+
 #endif /* _BABELTRACE_TRACE_HANDLE_INTERNAL_H */
@@ -293,6 +293,13 @@ struct definition_array {
 	struct declaration_array *declaration;
 	GPtrArray *elems;		/* Array of pointers to struct bt_definition */
 	GString *string;		/* String for encoded integer children */
+	/*
+	 * Contiguous integer element values, in native byte order and
+	 * element width. Only allocated when the element declaration
+	 * can be bulk-decoded (see bt_int_declaration_is_bulk()).
+	 */
+	GArray *values;
+	int elems_stale;		/* elems need update from values */
 };
 
 struct declaration_sequence {
@@ -308,6 +315,8 @@ struct definition_sequence {
 	struct definition_integer *length;
 	GPtrArray *elems;		/* Array of pointers to struct bt_definition */
 	GString *string;		/* String for encoded integer children */
+	GArray *values;			/* Contiguous integer values, or NULL */
+	int elems_stale;		/* elems need update from values */
 };
 
 int bt_register_declaration(GQuark declaration_name,
@@ -387,6 +396,20 @@ int bt_get_int_base(const struct bt_definition *field);
 size_t bt_get_int_len(const struct bt_definition *field);	/* in bits */
 enum ctf_string_encoding bt_get_int_encoding(const struct bt_definition *field);
 
+/*
+ * Arrays and sequences of integers which are 8, 16, 32 or 64 bits
+ * wide, byte-aligned and packed (no padding between elements) are
+ * decoded in bulk into a contiguous buffer of values rather than
+ * element by element.
+ */
+int bt_int_declaration_is_bulk(const struct declaration_integer *integer_declaration);
+/*
+ * Update the first "len" element definitions from a contiguous values
+ * buffer.
+ */
+void bt_int_values_to_definitions(const struct declaration_integer *integer_declaration,
+		const GArray *values, GPtrArray *elems, uint64_t len);
+
 /*
  * mantissa_len is the length of the number of bytes represented by the mantissa
  * (e.g. result of DBL_MANT_DIG). It includes the leading 1.
@@ -504,6 +527,11 @@ struct bt_definition *bt_array_index(struct definition_array *array, uint64_t i)
 int bt_array_rw(struct bt_stream_pos *pos, struct bt_definition *definition);
 GString *bt_get_char_array(const struct bt_definition *field);
 int bt_get_array_len(const struct bt_definition *field);
+/*
+ * Bring the element definitions of a bulk-decoded array up to date with
+ * its contiguous values. Only needed before accessing "elems" directly.
+ */
+void bt_array_update_elems(struct definition_array *array);
 
 /*
  * int_declaration and elem_declaration passed as parameter now belong
@@ -516,6 +544,16 @@ struct declaration_sequence *
 uint64_t bt_sequence_len(struct definition_sequence *sequence);
 struct bt_definition *bt_sequence_index(struct definition_sequence *sequence, uint64_t i);
 int bt_sequence_rw(struct bt_stream_pos *pos, struct bt_definition *definition);
+void bt_sequence_update_elems(struct definition_sequence *sequence);
+
+/*
+ * Contiguous-values view of an array or sequence of integers. Returns
+ * a pointer to "*len" values of "*elem_len" bits each, in native byte
+ * order, or NULL if the field is not bulk-decoded. The values are only
+ * valid until the field is read again.
+ */
+const void *bt_get_int_array_values(const struct bt_definition *field,
+		uint64_t *len, size_t *elem_len);
 
 /*
  * in: path (dot separated), out: q (GArray of GQuark)
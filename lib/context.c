@@ -48,6 +48,21 @@
 static
 void remove_trace_handle(struct bt_trace_handle *handle);
 
+/* Extend the bounds of the trace collection to those of a trace. */
+static
+void merge_timestamps(struct trace_collection *tc,
+		const struct bt_trace_handle *handle)
+{
+	if (handle->real_timestamp_begin < tc->real_timestamp_begin)
+		tc->real_timestamp_begin = handle->real_timestamp_begin;
+	if (handle->real_timestamp_end > tc->real_timestamp_end)
+		tc->real_timestamp_end = handle->real_timestamp_end;
+	if (handle->cycles_timestamp_begin < tc->cycles_timestamp_begin)
+		tc->cycles_timestamp_begin = handle->cycles_timestamp_begin;
+	if (handle->cycles_timestamp_end > tc->cycles_timestamp_end)
+		tc->cycles_timestamp_end = handle->cycles_timestamp_end;
+}
+
 struct bt_context *bt_context_create(void)
 {
 	struct bt_context *ctx;
@@ -143,18 +158,9 @@ int bt_context_add_trace(struct bt_context *ctx, const char *path,
 			goto error;
 	}
 
-	if (fmt->timestamp_begin)
-		handle->real_timestamp_begin = fmt->timestamp_begin(td,
-				handle, BT_CLOCK_REAL);
-	if (fmt->timestamp_end)
-		handle->real_timestamp_end = fmt->timestamp_end(td, handle,
-				BT_CLOCK_REAL);
-	if (fmt->timestamp_begin)
-		handle->cycles_timestamp_begin = fmt->timestamp_begin(td,
-				handle, BT_CLOCK_CYCLES);
-	if (fmt->timestamp_end)
-		handle->cycles_timestamp_end = fmt->timestamp_end(td, handle,
-				BT_CLOCK_CYCLES);
+	bt_trace_handle_update_timestamps(handle);
+	if (!ctx->tc->timestamps_stale)
+		merge_timestamps(ctx->tc, handle);
 
 	return handle->id;
 
@@ -208,6 +214,60 @@ void bt_context_destroy(struct bt_context *ctx)
 	g_free(ctx);
 }
 
+/*
+ * Recompute the bounds of the trace collection after a trace was
+ * removed or live packets were indexed.
+ */
+static
+void update_timestamps(struct bt_context *ctx)
+{
+	struct trace_collection *tc = ctx->tc;
+	GHashTableIter iter;
+	gpointer value;
+
+	tc->real_timestamp_begin = -1ULL;
+	tc->real_timestamp_end = 0;
+	tc->cycles_timestamp_begin = -1ULL;
+	tc->cycles_timestamp_end = 0;
+	g_hash_table_iter_init(&iter, ctx->trace_handles);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		struct bt_trace_handle *handle = value;
+
+		if (handle->timestamps_stale)
+			bt_trace_handle_update_timestamps(handle);
+		merge_timestamps(tc, handle);
+	}
+	tc->timestamps_stale = 0;
+}
+
+uint64_t bt_context_get_timestamp_begin(struct bt_context *ctx,
+		enum bt_clock_type type)
+{
+	if (!ctx)
+		return -1ULL;
+	if (ctx->tc->timestamps_stale)
+		update_timestamps(ctx);
+	if (type == BT_CLOCK_REAL)
+		return ctx->tc->real_timestamp_begin;
+	else if (type == BT_CLOCK_CYCLES)
+		return ctx->tc->cycles_timestamp_begin;
+	return -1ULL;
+}
+
+uint64_t bt_context_get_timestamp_end(struct bt_context *ctx,
+		enum bt_clock_type type)
+{
+	if (!ctx)
+		return -1ULL;
+	if (ctx->tc->timestamps_stale)
+		update_timestamps(ctx);
+	if (type == BT_CLOCK_REAL)
+		return ctx->tc->real_timestamp_end;
+	else if (type == BT_CLOCK_CYCLES)
+		return ctx->tc->cycles_timestamp_end;
+	return -1ULL;
+}
+
 void bt_context_get(struct bt_context *ctx)
 {
 	assert(ctx);
@@ -30,6 +30,8 @@
 #include <babeltrace/babeltrace.h>
 #include <babeltrace/context.h>
 #include <babeltrace/context-internal.h>
+#include <babeltrace/format-internal.h>
+#include <babeltrace/trace-handle-internal.h>
 #include <babeltrace/iterator-internal.h>
 #include <babeltrace/iterator.h>
 #include <babeltrace/prio_heap.h>
@@ -44,7 +46,9 @@ static int babeltrace_filestream_seek(struct ctf_file_stream *file_stream,
 struct stream_saved_pos {
 	/*
 	 * Use file_stream pointer to check if the trace collection we
-	 * restore to match the one we saved from, for each stream.
+	 * restore to match the one we saved from, for each stream. Always
+	 * the stream of the trace, never an iterator cursor, so positions
+	 * can be restored on any iterator of the context.
 	 */
 	struct ctf_file_stream *file_stream;
 	size_t cur_index;	/* current index in packet index */
@@ -75,6 +79,54 @@ static int stream_read_event(struct ctf_file_stream *sin)
 	return 0;
 }
 
+/*
+ * Return the file stream read by the iterator for a file stream of its
+ * context: the stream itself, or the iterator's cursor on it.
+ */
+static struct ctf_file_stream *iter_file_stream(struct bt_iter *iter,
+		struct ctf_file_stream *file_stream)
+{
+	if (!iter->cursors)
+		return file_stream;
+	return g_hash_table_lookup(iter->cursors, file_stream);
+}
+
+static struct ctf_file_stream *iter_open_cursor(struct bt_iter *iter,
+		struct ctf_file_stream *file_stream)
+{
+	struct bt_format *fmt = file_stream->pos.parent.trace->handle->format;
+	struct ctf_stream_definition *cursor;
+
+	if (!fmt->open_stream_cursor) {
+		fprintf(stderr, "[error] Format does not support multiple iterators.\n");
+		return NULL;
+	}
+	cursor = fmt->open_stream_cursor(&file_stream->parent);
+	if (!cursor)
+		return NULL;
+	g_hash_table_insert(iter->cursors, file_stream, cursor);
+	return container_of(cursor, struct ctf_file_stream, parent);
+}
+
+static void iter_close_cursors(struct bt_iter *iter)
+{
+	GHashTableIter it;
+	gpointer key, value;
+
+	g_hash_table_iter_init(&it, iter->cursors);
+	while (g_hash_table_iter_next(&it, &key, &value)) {
+		struct ctf_stream_definition *cursor = value;
+		struct ctf_file_stream *file_stream = key;
+		struct bt_format *fmt;
+
+		fmt = file_stream->pos.parent.trace->handle->format;
+		if (fmt->close_stream_cursor(cursor))
+			fprintf(stderr, "[error] Unable to close stream cursor.\n");
+	}
+	g_hash_table_destroy(iter->cursors);
+	iter->cursors = NULL;
+}
+
 /*
  * Return true if a < b, false otherwise.
  * If time stamps are exactly the same, compare by stream path. This
@@ -165,8 +217,9 @@ static int seek_file_stream_by_timestamp(struct ctf_file_stream *cfs,
  * user the timestamp is out of the scope.
  * On other errors, return positive value.
  */
-static int seek_ctf_trace_by_timestamp(struct ctf_trace *tin,
-		uint64_t timestamp, struct ptr_heap *stream_heap)
+static int seek_ctf_trace_by_timestamp(struct bt_iter *iter,
+		struct ctf_trace *tin, uint64_t timestamp,
+		struct ptr_heap *stream_heap)
 {
 	int i, j, ret;
 	int found = 0;
@@ -186,8 +239,8 @@ static int seek_ctf_trace_by_timestamp(struct ctf_trace *tin,
 			stream = g_ptr_array_index(stream_class->streams, j);
 			if (!stream)
 				continue;
-			cfs = container_of(stream, struct ctf_file_stream,
-					parent);
+			cfs = iter_file_stream(iter, container_of(stream,
+					struct ctf_file_stream, parent));
 			ret = seek_file_stream_by_timestamp(cfs, timestamp);
 			if (ret == 0) {
 				/* Add to heap */
@@ -211,25 +264,114 @@ static int seek_ctf_trace_by_timestamp(struct ctf_trace *tin,
 }
 
 /*
- * Find timestamp of last event in the stream.
+ * Position a file stream on the event at bit "offset" of packet "index",
+ * whose timestamps are known, and read it.
+ */
+static int restore_file_stream_pos(struct ctf_file_stream *file_stream,
+		size_t index, int64_t offset, uint64_t real_timestamp,
+		uint64_t cycles_timestamp)
+{
+	struct ctf_stream_definition *stream = &file_stream->parent;
+	struct ctf_stream_pos *stream_pos = &file_stream->pos;
+
+	stream_pos->packet_seek(&stream_pos->parent, index, SEEK_SET);
+
+	/*
+	 * the timestamp needs to be restored after packet_seek, because
+	 * this function resets the timestamp to the beginning of the
+	 * packet
+	 */
+	stream->real_timestamp = real_timestamp;
+	stream->cycles_timestamp = cycles_timestamp;
+	stream_pos->offset = offset;
+	stream_pos->last_offset = LAST_OFFSET_POISON;
+
+	stream->current.real.begin = 0;
+	stream->current.real.end = 0;
+	stream->current.cycles.begin = 0;
+	stream->current.cycles.end = 0;
+
+	stream->prev.real.begin = 0;
+	stream->prev.real.end = 0;
+	stream->prev.cycles.begin = 0;
+	stream->prev.cycles.end = 0;
+
+	printf_debug("restored to cur_index = %" PRId64 " and "
+		"offset = %" PRId64 ", timestamp = %" PRIu64 "\n",
+		stream_pos->cur_index,
+		stream_pos->offset, stream->real_timestamp);
+
+	return stream_read_event(file_stream);
+}
+
+/* True if the index shows packet "index" holds no event. */
+static int packet_is_empty(struct packet_index *index)
+{
+	/* data_offset is -1 until the packet context has been read. */
+	return index->data_offset >= 0 &&
+		(uint64_t) index->data_offset >= index->content_size;
+}
+
+/*
+ * Upper bound of the timestamp of the last event in the stream: the
+ * timestamp of its cached last event, or else the end timestamp of the
+ * last packet of the index which may hold events.
+ *
+ * Return value: 0 if OK, EOF if the index shows no event.
+ */
+static int last_timestamp_bound_ctf_file_stream(struct ctf_file_stream *cfs,
+		uint64_t *bound)
+{
+	struct ctf_stream_pos *stream_pos = &cfs->pos;
+	int i;
+
+	if (cfs->last_event_nr_packets &&
+			cfs->last_event_nr_packets == stream_pos->packet_index->len) {
+		*bound = cfs->last_event_real_timestamp;
+		return 0;
+	}
+	for (i = stream_pos->packet_index->len - 1; i >= 0; i--) {
+		struct packet_index *index;
+
+		index = &g_array_index(stream_pos->packet_index,
+				struct packet_index, i);
+		if (packet_is_empty(index))
+			continue;
+		/* Packets without timestamp_end bound nothing. */
+		if (!index->ts_cycles.timestamp_end)
+			*bound = UINT64_MAX;
+		else
+			*bound = index->ts_real.timestamp_end;
+		return 0;
+	}
+	return EOF;
+}
+
+/*
+ * Find the last event in the stream and cache its position. Only the
+ * last packet holding events is decoded, and only once as long as no
+ * packet is added to the stream.
  *
  * Return value: 0 if OK, positive error value on error, EOF if no
  * events were found.
  */
-static int find_max_timestamp_ctf_file_stream(struct ctf_file_stream *cfs,
-		uint64_t *timestamp_end)
+static int find_last_event_ctf_file_stream(struct ctf_file_stream *cfs)
 {
+	struct ctf_stream_pos *stream_pos = &cfs->pos;
+	size_t nr_packets = stream_pos->packet_index->len;
 	int ret, count = 0, i;
-	uint64_t timestamp = 0;
-	struct ctf_stream_pos *stream_pos;
 
-	stream_pos = &cfs->pos;
+	if (cfs->last_event_nr_packets && cfs->last_event_nr_packets == nr_packets)
+		return 0;
 	/*
 	 * We start by the last packet, and iterate backwards until we
 	 * either find at least one event, or we reach the first packet
 	 * (some packets can be empty).
 	 */
-	for (i = stream_pos->packet_index->len - 1; i >= 0; i--) {
+	for (i = nr_packets - 1; i >= 0; i--) {
+		if (packet_is_empty(&g_array_index(stream_pos->packet_index,
+				struct packet_index, i)))
+			continue;
 		stream_pos->packet_seek(&stream_pos->parent, i, SEEK_SET);
 		count = 0;
 		/* read each event until we reach the end of the stream */
@@ -237,86 +379,69 @@ static int find_max_timestamp_ctf_file_stream(struct ctf_file_stream *cfs,
 			ret = stream_read_event(cfs);
 			if (ret == 0) {
 				count++;
-				timestamp = cfs->parent.real_timestamp;
+				cfs->last_event_index = stream_pos->cur_index;
+				cfs->last_event_offset = stream_pos->last_offset;
+				cfs->last_event_real_timestamp =
+					cfs->parent.real_timestamp;
+				cfs->last_event_cycles_timestamp =
+					cfs->parent.cycles_timestamp;
 			}
 		} while (ret == 0);
 
 		/* Error */
 		if (ret > 0)
-			goto end;
+			return ret;
 		assert(ret == EOF);
-		if (count)
-			break;
-	}
-
-	if (count) {
-		*timestamp_end = timestamp;
-		ret = 0;
-	} else {
-		/* Return EOF if no events were found */
-		ret = EOF;
+		if (count) {
+			cfs->last_event_nr_packets = nr_packets;
+			return 0;
+		}
 	}
-end:
-	return ret;
+	/* Return EOF if no events were found */
+	return EOF;
 }
 
-/*
- * Find the stream within a stream class that contains the event with
- * the largest timestamp, and save that timestamp.
- *
- * Return 0 if OK, EOF if no events were found in the streams, or
- * positive value on error.
- */
-static int find_max_timestamp_ctf_stream_class(
-		struct ctf_stream_declaration *stream_class,
-		struct ctf_file_stream **cfsp,
-		uint64_t *max_timestamp)
-{
-	int ret = EOF, i, found = 0;
+struct last_event_candidate {
+	struct ctf_file_stream *cfs;
+	uint64_t bound;		/* upper bound of its last timestamp */
+};
 
-	for (i = 0; i < stream_class->streams->len; i++) {
-		struct ctf_stream_definition *stream;
-		struct ctf_file_stream *cfs;
-		uint64_t current_max_ts = 0;
+/* Sort candidates by decreasing bound. */
+static gint compare_last_event_candidates(gconstpointer a, gconstpointer b)
+{
+	const struct last_event_candidate *c_a = a, *c_b = b;
 
-		stream = g_ptr_array_index(stream_class->streams, i);
-		if (!stream)
-			continue;
-		cfs = container_of(stream, struct ctf_file_stream, parent);
-		ret = find_max_timestamp_ctf_file_stream(cfs, &current_max_ts);
-		if (ret == EOF)
-			continue;
-		if (ret != 0)
-			break;
-		if (current_max_ts >= *max_timestamp) {
-			*max_timestamp = current_max_ts;
-			*cfsp = cfs;
-			found = 1;
-		}
-	}
-	assert(ret >= 0 || ret == EOF);
-	if (found) {
-		return 0;
-	}
-	return ret;
+	if (c_a->bound > c_b->bound)
+		return -1;
+	else if (c_a->bound < c_b->bound)
+		return 1;
+	return 0;
 }
 
 /*
  * seek_last_ctf_trace_collection: seek trace collection to last event.
  *
+ * The packet indexes give an upper bound of the last timestamp of each
+ * stream: streams are decoded by decreasing bound, until no remaining
+ * stream can end after the last event found, which usually means a
+ * single packet is decoded.
+ *
  * Return 0 if OK, EOF if no events were found, or positive error value
  * on error.
  */
-static int seek_last_ctf_trace_collection(struct trace_collection *tc,
-		struct ctf_file_stream **cfsp)
+static int seek_last_ctf_trace_collection(struct bt_iter *iter,
+		struct trace_collection *tc, struct ctf_file_stream **cfsp)
 {
-	int i, j, ret;
+	GArray *candidates;
+	int i, j, k, ret;
 	int found = 0;
 	uint64_t max_timestamp = 0;
 
 	if (!tc)
 		return 1;
 
+	candidates = g_array_new(FALSE, FALSE,
+			sizeof(struct last_event_candidate));
 	/* For each trace in the trace_collection */
 	for (i = 0; i < tc->array->len; i++) {
 		struct ctf_trace *tin;
@@ -333,26 +458,65 @@ static int seek_last_ctf_trace_collection(struct trace_collection *tc,
 			stream_class = g_ptr_array_index(tin->streams, j);
 			if (!stream_class)
 				continue;
-			ret = find_max_timestamp_ctf_stream_class(stream_class,
-					cfsp, &max_timestamp);
-			if (ret > 0)
-				goto end;
-			if (ret == 0)
-				found = 1;
-			assert(ret == EOF || ret == 0);
+			/* For each file stream of the stream class */
+			for (k = 0; k < stream_class->streams->len; k++) {
+				struct ctf_stream_definition *stream;
+				struct last_event_candidate candidate;
+
+				stream = g_ptr_array_index(stream_class->streams, k);
+				if (!stream)
+					continue;
+				candidate.cfs = iter_file_stream(iter,
+						container_of(stream,
+						struct ctf_file_stream, parent));
+				ret = last_timestamp_bound_ctf_file_stream(
+						candidate.cfs, &candidate.bound);
+				if (ret == EOF)
+					continue;
+				g_array_append_val(candidates, candidate);
+			}
+		}
+	}
+	g_array_sort(candidates, compare_last_event_candidates);
+
+	for (i = 0; i < candidates->len; i++) {
+		struct last_event_candidate *candidate;
+
+		candidate = &g_array_index(candidates,
+				struct last_event_candidate, i);
+		if (found && candidate->bound < max_timestamp)
+			break;
+		ret = find_last_event_ctf_file_stream(candidate->cfs);
+		if (ret == EOF)
+			continue;
+		if (ret != 0)
+			goto end;
+		if (!found ||
+				candidate->cfs->last_event_real_timestamp >= max_timestamp) {
+			max_timestamp = candidate->cfs->last_event_real_timestamp;
+			*cfsp = candidate->cfs;
+			found = 1;
 		}
 	}
 	/*
 	 * Now we know in which file stream the last event is located,
-	 * and we know its timestamp.
+	 * and where it is.
 	 */
 	if (!found) {
 		ret = EOF;
 	} else {
-		ret = seek_file_stream_by_timestamp(*cfsp, max_timestamp);
-		assert(ret == 0);
+		struct ctf_file_stream *cfs = *cfsp;
+
+		ret = restore_file_stream_pos(cfs, cfs->last_event_index,
+				cfs->last_event_offset,
+				cfs->last_event_real_timestamp,
+				cfs->last_event_cycles_timestamp);
+		/* The last event was read before, it can't be missing now. */
+		if (ret == EOF)
+			ret = -EFAULT;
 	}
 end:
+	g_array_free(candidates, TRUE);
 	return ret;
 }
 
@@ -377,51 +541,27 @@ int bt_iter_set_pos(struct bt_iter *iter, const struct bt_iter_pos *iter_pos)
 		for (i = 0; i < iter_pos->u.restore->stream_saved_pos->len;
 				i++) {
 			struct stream_saved_pos *saved_pos;
-			struct ctf_stream_pos *stream_pos;
-			struct ctf_stream_definition *stream;
+			struct ctf_file_stream *file_stream;
 
 			saved_pos = &g_array_index(
 					iter_pos->u.restore->stream_saved_pos,
 					struct stream_saved_pos, i);
-			stream = &saved_pos->file_stream->parent;
-			stream_pos = &saved_pos->file_stream->pos;
-
-			stream_pos->packet_seek(&stream_pos->parent,
-					saved_pos->cur_index, SEEK_SET);
-
-			/*
-			 * the timestamp needs to be restored after
-			 * packet_seek, because this function resets
-			 * the timestamp to the beginning of the packet
-			 */
-			stream->real_timestamp = saved_pos->current_real_timestamp;
-			stream->cycles_timestamp = saved_pos->current_cycles_timestamp;
-			stream_pos->offset = saved_pos->offset;
-			stream_pos->last_offset = LAST_OFFSET_POISON;
-
-			stream->current.real.begin = 0;
-			stream->current.real.end = 0;
-			stream->current.cycles.begin = 0;
-			stream->current.cycles.end = 0;
-
-			stream->prev.real.begin = 0;
-			stream->prev.real.end = 0;
-			stream->prev.cycles.begin = 0;
-			stream->prev.cycles.end = 0;
-
-			printf_debug("restored to cur_index = %" PRId64 " and "
-				"offset = %" PRId64 ", timestamp = %" PRIu64 "\n",
-				stream_pos->cur_index,
-				stream_pos->offset, stream->real_timestamp);
-
-			ret = stream_read_event(saved_pos->file_stream);
+			file_stream = iter_file_stream(iter,
+					saved_pos->file_stream);
+			if (!file_stream) {
+				ret = -EINVAL;
+				goto error;
+			}
+			ret = restore_file_stream_pos(file_stream,
+					saved_pos->cur_index, saved_pos->offset,
+					saved_pos->current_real_timestamp,
+					saved_pos->current_cycles_timestamp);
 			if (ret != 0) {
 				goto error;
 			}
 
 			/* Add to heap */
-			ret = bt_heap_insert(iter->stream_heap,
-					saved_pos->file_stream);
+			ret = bt_heap_insert(iter->stream_heap, file_stream);
 			if (ret)
 				goto error;
 		}
@@ -444,7 +584,7 @@ int bt_iter_set_pos(struct bt_iter *iter, const struct bt_iter_pos *iter_pos)
 				continue;
 			tin = container_of(td_read, struct ctf_trace, parent);
 
-			ret = seek_ctf_trace_by_timestamp(tin,
+			ret = seek_ctf_trace_by_timestamp(iter, tin,
 					iter_pos->u.seek_time,
 					iter->stream_heap);
 			/*
@@ -493,6 +633,8 @@ int bt_iter_set_pos(struct bt_iter *iter, const struct bt_iter_pos *iter_pos)
 							filenr);
 					if (!file_stream)
 						continue;
+					file_stream = iter_file_stream(iter,
+							file_stream);
 					ret = babeltrace_filestream_seek(
 							file_stream, iter_pos,
 							stream_id);
@@ -515,7 +657,7 @@ int bt_iter_set_pos(struct bt_iter *iter, const struct bt_iter_pos *iter_pos)
 		struct ctf_file_stream *cfs = NULL;
 
 		tc = iter->ctx->tc;
-		ret = seek_last_ctf_trace_collection(tc, &cfs);
+		ret = seek_last_ctf_trace_collection(iter, tc, &cfs);
 		if (ret != 0 || !cfs)
 			goto error;
 		/* remove all streams from the heap */
@@ -582,7 +724,7 @@ struct bt_iter_pos *bt_iter_get_pos(struct bt_iter *iter)
 
 		assert(file_stream->pos.last_offset != LAST_OFFSET_POISON);
 		saved_pos.offset = file_stream->pos.last_offset;
-		saved_pos.file_stream = file_stream;
+		saved_pos.file_stream = file_stream->origin ? : file_stream;
 		saved_pos.cur_index = file_stream->pos.cur_index;
 
 		saved_pos.current_real_timestamp = file_stream->parent.real_timestamp;
@@ -690,6 +832,14 @@ int bt_iter_add_trace(struct bt_iter *iter,
 					filenr);
 			if (!file_stream)
 				continue;
+			if (iter->cursors) {
+				file_stream = iter_open_cursor(iter,
+						file_stream);
+				if (!file_stream) {
+					ret = -1;
+					goto error;
+				}
+			}
 
 			pos.type = BT_SEEK_BEGIN;
 			ret = babeltrace_filestream_seek(file_stream,
@@ -724,10 +874,9 @@ int bt_iter_init(struct bt_iter *iter,
 		return -EINVAL;
 
 	if (ctx->current_iterator) {
-		ret = -1;
-		goto error_ctx;
+		iter->cursors = g_hash_table_new(g_direct_hash,
+				g_direct_equal);
 	}
-
 	iter->stream_heap = g_new(struct ptr_heap, 1);
 	iter->end_pos = end_pos;
 	bt_context_get(ctx);
@@ -748,19 +897,27 @@ int bt_iter_init(struct bt_iter *iter,
 			goto error;
 	}
 
-	ctx->current_iterator = iter;
+	if (!iter->cursors)
+		ctx->current_iterator = iter;
 	if (begin_pos && begin_pos->type != BT_SEEK_BEGIN) {
 		ret = bt_iter_set_pos(iter, begin_pos);
+		if (ret)
+			goto error_set_pos;
 	}
 
-	return ret;
+	return 0;
 
+error_set_pos:
+	if (!iter->cursors)
+		ctx->current_iterator = NULL;
 error:
 	bt_heap_free(iter->stream_heap);
 error_heap_init:
 	g_free(iter->stream_heap);
 	iter->stream_heap = NULL;
-error_ctx:
+	if (iter->cursors)
+		iter_close_cursors(iter);
+	bt_context_put(ctx);
 	return ret;
 }
 
@@ -790,7 +947,10 @@ void bt_iter_fini(struct bt_iter *iter)
 		bt_heap_free(iter->stream_heap);
 		g_free(iter->stream_heap);
 	}
-	iter->ctx->current_iterator = NULL;
+	if (iter->cursors)
+		iter_close_cursors(iter);
+	else
+		iter->ctx->current_iterator = NULL;
 	bt_context_put(iter->ctx);
 }
 
@@ -202,6 +202,8 @@ int bt_trace_collection_remove(struct trace_collection *tc,
 		return -EINVAL;
 
 	if (g_ptr_array_remove(tc->array, td)) {
+		/* The bounds of the remaining traces may be narrower. */
+		tc->timestamps_stale = 1;
 		return 0;
 	} else {
 		return -1;
@@ -218,6 +220,11 @@ void bt_init_trace_collection(struct trace_collection *tc)
 	tc->offset_first = 0;
 	tc->delta_offset_first_sum = 0;
 	tc->offset_nr = 0;
+	tc->real_timestamp_begin = -1ULL;
+	tc->real_timestamp_end = 0;
+	tc->cycles_timestamp_begin = -1ULL;
+	tc->cycles_timestamp_end = 0;
+	tc->timestamps_stale = 0;
 }
 
 /*
@@ -34,6 +34,7 @@
 #include <babeltrace/context-internal.h>
 #include <babeltrace/trace-handle.h>
 #include <babeltrace/trace-handle-internal.h>
+#include <babeltrace/format-internal.h>
 
 struct bt_trace_handle *bt_trace_handle_create(struct bt_context *ctx)
 {
@@ -44,6 +45,8 @@ struct bt_trace_handle *bt_trace_handle_create(struct bt_context *ctx)
 
 	th = g_new0(struct bt_trace_handle, 1);
 	th->id = ctx->last_trace_handle_id++;
+	th->real_timestamp_begin = -1ULL;
+	th->cycles_timestamp_begin = -1ULL;
 	return th;
 }
 
@@ -52,6 +55,54 @@ void bt_trace_handle_destroy(struct bt_trace_handle *th)
 	g_free(th);
 }
 
+static
+void update_begin(uint64_t *begin, uint64_t timestamp)
+{
+	if (timestamp < *begin)
+		*begin = timestamp;
+}
+
+static
+void update_end(uint64_t *end, uint64_t timestamp)
+{
+	/* -1ULL is an error */
+	if (timestamp != -1ULL && timestamp > *end)
+		*end = timestamp;
+}
+
+/*
+ * The bounds only grow: live traces only keep the index of their last
+ * packets, so the earlier packets only count through the cached bounds.
+ */
+void bt_trace_handle_update_timestamps(struct bt_trace_handle *handle)
+{
+	struct bt_format *fmt = handle->format;
+	struct bt_trace_descriptor *td = handle->td;
+
+	if (fmt->timestamp_begin) {
+		update_begin(&handle->real_timestamp_begin,
+			fmt->timestamp_begin(td, handle, BT_CLOCK_REAL));
+		update_begin(&handle->cycles_timestamp_begin,
+			fmt->timestamp_begin(td, handle, BT_CLOCK_CYCLES));
+	}
+	if (fmt->timestamp_end) {
+		update_end(&handle->real_timestamp_end,
+			fmt->timestamp_end(td, handle, BT_CLOCK_REAL));
+		update_end(&handle->cycles_timestamp_end,
+			fmt->timestamp_end(td, handle, BT_CLOCK_CYCLES));
+	}
+	handle->timestamps_stale = 0;
+}
+
+void bt_trace_handle_invalidate_timestamps(struct bt_trace_handle *handle)
+{
+	if (!handle)
+		return;
+	handle->timestamps_stale = 1;
+	if (handle->td && handle->td->ctx)
+		handle->td->ctx->tc->timestamps_stale = 1;
+}
+
 const char *bt_trace_handle_get_path(struct bt_context *ctx, int handle_id)
 {
 	struct bt_trace_handle *handle;
@@ -81,6 +132,8 @@ uint64_t bt_trace_handle_get_timestamp_begin(struct bt_context *ctx,
 		ret = -1ULL;
 		goto end;
 	}
+	if (handle->timestamps_stale)
+		bt_trace_handle_update_timestamps(handle);
 	if (type == BT_CLOCK_REAL) {
 		ret = handle->real_timestamp_begin;
 	} else if (type == BT_CLOCK_CYCLES) {
@@ -108,6 +161,8 @@ uint64_t bt_trace_handle_get_timestamp_end(struct bt_context *ctx,
 		ret = -1ULL;
 		goto end;
 	}
+	if (handle->timestamps_stale)
+		bt_trace_handle_update_timestamps(handle);
 	if (type == BT_CLOCK_REAL) {
 		ret = handle->real_timestamp_end;
 	} else if (type == BT_CLOCK_CYCLES) {
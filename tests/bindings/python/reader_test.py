@@ -0,0 +1,141 @@
+# reader_test.py
+#
+# Tests the event field accessors of the babeltrace.reader module,
+# printing TAP results.
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+import shutil
+import tempfile
+import babeltrace.reader as btr
+import babeltrace.writer as btw
+
+NR_EVENTS = 10
+NR_VALUES = 3
+NR_TESTS = 8
+
+test_number = 0
+
+
+def ok(result, description):
+    global test_number
+
+    test_number += 1
+    print("{}ok {} - {}".format("" if result else "not ",
+                                test_number, description))
+
+
+def write_trace(path):
+    writer = btw.Writer(path)
+    clock = btw.Clock("test_clock")
+    writer.add_clock(clock)
+
+    stream_class = btw.StreamClass("test_stream")
+    stream_class.clock = clock
+
+    uint8_type = btw.IntegerFieldDeclaration(8)
+    uint32_type = btw.IntegerFieldDeclaration(32)
+    uint64_type = btw.IntegerFieldDeclaration(64)
+
+    # "timestamp" is also a field of the default stream event header.
+    event_class = btw.EventClass("test_event")
+    event_class.add_field(uint32_type, "seq")
+    event_class.add_field(uint64_type, "timestamp")
+    event_class.add_field(btw.StringFieldDeclaration(), "name")
+    event_class.add_field(btw.ArrayFieldDeclaration(uint8_type, NR_VALUES),
+                          "values")
+    stream_class.add_event_class(event_class)
+    stream = writer.create_stream(stream_class)
+
+    for i in range(NR_EVENTS):
+        event = btw.Event(event_class)
+        clock.time = i * 1000
+        event.payload("seq").value = i
+        event.payload("timestamp").value = i * 10
+        event.payload("name").value = "event {}".format(i)
+        values = event.payload("values")
+
+        for j in range(NR_VALUES):
+            values.field(j).value = i + j
+
+        stream.append_event(event)
+
+    stream.flush()
+    writer.flush_metadata()
+
+
+def read_trace(path):
+    traces = btr.TraceCollection()
+
+    if traces.add_trace(path, "ctf") is None:
+        return None
+
+    nr_events = 0
+    len_ok = True
+    getitem_ok = True
+    contains_ok = True
+    dict_ok = True
+    tuple_ok = True
+    values_ok = True
+
+    for event in traces.events:
+        keys = event.keys()
+
+        if len(event) != len(keys) or len(keys) != len(set(keys)):
+            len_ok = False
+        if event["seq"] != nr_events or event["timestamp"] != nr_events * 10:
+            getitem_ok = False
+        if "seq" not in event or "missing" in event or \
+                event.get("missing") is not None:
+            contains_ok = False
+        if event.as_dict() != {key: event[key] for key in keys}:
+            dict_ok = False
+        if event.as_tuple() != tuple(event[key] for key in keys):
+            tuple_ok = False
+        if list(event["values"]) != [nr_events + j for j in range(NR_VALUES)]:
+            values_ok = False
+        nr_events += 1
+
+    return (nr_events, len_ok, getitem_ok, contains_ok, dict_ok, tuple_ok,
+            values_ok)
+
+
+print("1..{}".format(NR_TESTS))
+trace_path = tempfile.mkdtemp()
+
+try:
+    write_trace(trace_path)
+    result = read_trace(trace_path)
+finally:
+    shutil.rmtree(trace_path)
+
+ok(result is not None, "Open the trace written with babeltrace.writer")
+
+if result is None:
+    result = (0,) + (False,) * (NR_TESTS - 2)
+
+(nr_events, len_ok, getitem_ok, contains_ok, dict_ok, tuple_ok,
+ values_ok) = result
+ok(nr_events == NR_EVENTS, "Read back every event of the trace")
+ok(len_ok, "len(Event) counts field names shared by several scopes once")
+ok(getitem_ok, "Event[] returns the field of the highest priority scope")
+ok(contains_ok, "Event \"in\" and get() handle missing fields")
+ok(dict_ok, "Event.as_dict() matches the fields accessed one at a time")
+ok(tuple_ok, "Event.as_tuple() follows the order of Event.keys()")
+ok(values_ok, "Array fields are read back as sequences of values")
@@ -0,0 +1,292 @@
+/*
+ * bench-ctf-writer.c
+ *
+ * CTF Writer throughput benchmark
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; under version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Usage: bench_ctf_writer [NR_EVENTS [PACKET_SIZE [FLUSH_EVERY]]]
+ *
+ * Appends NR_EVENTS events of the "small" (integer and string, as in the
+ * packet resize test) and "large" (4 kiB integer array) scenarios to a
+ * stream whose packets are PACKET_SIZE bytes, flushing every FLUSH_EVERY
+ * events, and prints the throughput of each scenario. The trace is
+ * written in a temporary directory, removed on exit.
+ */
+
+#define _GNU_SOURCE
+#include <babeltrace/ctf-writer/writer.h>
+#include <babeltrace/ctf-writer/clock.h>
+#include <babeltrace/ctf-writer/stream.h>
+#include <babeltrace/ctf-writer/event.h>
+#include <babeltrace/ctf-writer/event-types.h>
+#include <babeltrace/ctf-writer/event-fields.h>
+#include <babeltrace/ctf-ir/stream-class.h>
+#include <babeltrace/compat/limits.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#define DEFAULT_NR_EVENTS	1000000
+#define DEFAULT_FLUSH_EVERY	10000
+#define LARGE_ARRAY_LENGTH	4096
+
+enum scenario {
+	SCENARIO_SMALL,
+	SCENARIO_LARGE,
+};
+
+static const char *scenario_names[] = {
+	[SCENARIO_SMALL] = "small",
+	[SCENARIO_LARGE] = "large",
+};
+
+static
+double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static
+uint64_t trace_size(const char *path)
+{
+	DIR *dir;
+	struct dirent *entry;
+	uint64_t size = 0;
+	char file[PATH_MAX];
+	struct stat st;
+
+	dir = opendir(path);
+	if (!dir) {
+		return 0;
+	}
+	while ((entry = readdir(dir))) {
+		snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+		if (!stat(file, &st) && S_ISREG(st.st_mode)) {
+			size += st.st_size;
+		}
+	}
+	closedir(dir);
+	return size;
+}
+
+static
+void remove_trace(const char *path)
+{
+	DIR *dir;
+	struct dirent *entry;
+	char file[PATH_MAX];
+
+	dir = opendir(path);
+	if (!dir) {
+		return;
+	}
+	while ((entry = readdir(dir))) {
+		if (entry->d_name[0] == '.') {
+			continue;
+		}
+		snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+		if (entry->d_type == DT_DIR) {
+			/* index/ */
+			remove_trace(file);
+		} else {
+			unlink(file);
+		}
+	}
+	closedir(dir);
+	rmdir(path);
+}
+
+static
+struct bt_ctf_event_class *create_event_class(enum scenario scenario)
+{
+	struct bt_ctf_event_class *event_class;
+	struct bt_ctf_field_type *integer_type, *string_type, *array_type;
+
+	event_class = bt_ctf_event_class_create(scenario_names[scenario]);
+	switch (scenario) {
+	case SCENARIO_SMALL:
+		integer_type = bt_ctf_field_type_integer_create(17);
+		string_type = bt_ctf_field_type_string_create();
+		bt_ctf_event_class_add_field(event_class, integer_type,
+			"field_1");
+		bt_ctf_event_class_add_field(event_class, string_type,
+			"a_string");
+		bt_ctf_field_type_put(integer_type);
+		bt_ctf_field_type_put(string_type);
+		break;
+	case SCENARIO_LARGE:
+		integer_type = bt_ctf_field_type_integer_create(8);
+		array_type = bt_ctf_field_type_array_create(integer_type,
+			LARGE_ARRAY_LENGTH);
+		bt_ctf_event_class_add_field(event_class, array_type,
+			"an_array");
+		bt_ctf_field_type_put(integer_type);
+		bt_ctf_field_type_put(array_type);
+		break;
+	}
+	return event_class;
+}
+
+static
+int fill_event(struct bt_ctf_event *event, enum scenario scenario,
+		uint64_t i)
+{
+	struct bt_ctf_field *field, *array;
+	int ret = 0, j;
+
+	switch (scenario) {
+	case SCENARIO_SMALL:
+		field = bt_ctf_event_get_payload(event, "field_1");
+		ret |= bt_ctf_field_unsigned_integer_set_value(field,
+			i & 0x1FFFF);
+		bt_ctf_field_put(field);
+		field = bt_ctf_event_get_payload(event, "a_string");
+		ret |= bt_ctf_field_string_set_value(field, "This is a test");
+		bt_ctf_field_put(field);
+		break;
+	case SCENARIO_LARGE:
+		array = bt_ctf_event_get_payload(event, "an_array");
+		for (j = 0; j < LARGE_ARRAY_LENGTH; j++) {
+			field = bt_ctf_field_array_get_field(array, j);
+			ret |= bt_ctf_field_unsigned_integer_set_value(field,
+				(i + j) & 0xFF);
+			bt_ctf_field_put(field);
+		}
+		bt_ctf_field_put(array);
+		break;
+	}
+	return ret;
+}
+
+static
+int run_scenario(enum scenario scenario, uint64_t nr_events,
+		uint64_t packet_size, uint64_t flush_every)
+{
+	char trace_path[] = "/tmp/bench_ctf_writer_XXXXXX";
+	struct bt_ctf_writer *writer = NULL;
+	struct bt_ctf_clock *clock = NULL;
+	struct bt_ctf_stream_class *stream_class = NULL;
+	struct bt_ctf_event_class *event_class = NULL;
+	struct bt_ctf_stream *stream = NULL;
+	uint64_t i, bytes;
+	double begin, duration;
+	int ret = 0;
+
+	if (!mkdtemp(trace_path)) {
+		perror("mkdtemp");
+		return -1;
+	}
+
+	writer = bt_ctf_writer_create(trace_path);
+	clock = bt_ctf_clock_create("bench_clock");
+	stream_class = bt_ctf_stream_class_create("bench_stream");
+	if (!writer || !clock || !stream_class) {
+		ret = -1;
+		goto end;
+	}
+	ret |= bt_ctf_writer_add_clock(writer, clock);
+	ret |= bt_ctf_stream_class_set_clock(stream_class, clock);
+	ret |= bt_ctf_stream_class_set_packet_size(stream_class, packet_size);
+	event_class = create_event_class(scenario);
+	ret |= bt_ctf_stream_class_add_event_class(stream_class, event_class);
+	if (ret) {
+		goto end;
+	}
+	stream = bt_ctf_writer_create_stream(writer, stream_class);
+	if (!stream) {
+		ret = -1;
+		goto end;
+	}
+
+	begin = now();
+	for (i = 0; i < nr_events; i++) {
+		struct bt_ctf_event *event = bt_ctf_event_create(event_class);
+
+		ret |= bt_ctf_clock_set_time(clock, i);
+		ret |= fill_event(event, scenario, i);
+		ret |= bt_ctf_stream_append_event(stream, event);
+		bt_ctf_event_put(event);
+		if (!ret && (i + 1) % flush_every == 0) {
+			ret = bt_ctf_stream_flush(stream);
+		}
+		if (ret) {
+			goto end;
+		}
+	}
+	ret = bt_ctf_stream_flush(stream);
+	if (ret) {
+		goto end;
+	}
+	bt_ctf_stream_put(stream);
+	stream = NULL;
+	duration = now() - begin;
+
+	bytes = trace_size(trace_path);
+	printf("%-6s %" PRIu64 " events in %.3f s: %.0f events/s, %.1f MiB/s\n",
+		scenario_names[scenario], nr_events, duration,
+		nr_events / duration, bytes / duration / (1024 * 1024));
+end:
+	if (ret) {
+		fprintf(stderr, "Scenario \"%s\" failed\n",
+			scenario_names[scenario]);
+	}
+	bt_ctf_stream_put(stream);
+	bt_ctf_event_class_put(event_class);
+	bt_ctf_stream_class_put(stream_class);
+	bt_ctf_clock_put(clock);
+	bt_ctf_writer_put(writer);
+	remove_trace(trace_path);
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	uint64_t nr_events = DEFAULT_NR_EVENTS;
+	uint64_t packet_size = 0;
+	uint64_t flush_every = DEFAULT_FLUSH_EVERY;
+	int ret = 0;
+
+	if (argc > 1) {
+		nr_events = strtoull(argv[1], NULL, 0);
+	}
+	if (argc > 2) {
+		packet_size = strtoull(argv[2], NULL, 0);
+	}
+	if (argc > 3) {
+		flush_every = strtoull(argv[3], NULL, 0);
+	}
+	if (!nr_events || !flush_every) {
+		fprintf(stderr, "Usage: %s [NR_EVENTS [PACKET_SIZE [FLUSH_EVERY]]]\n",
+			argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	ret |= run_scenario(SCENARIO_SMALL, nr_events, packet_size,
+		flush_every);
+	/* Large events are ~1000 times bigger, scale the count down. */
+	ret |= run_scenario(SCENARIO_LARGE, nr_events / 100 ? : 1,
+		packet_size, flush_every / 100 ? : 1);
+	return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,150 @@
+/*
+ * test_clock.c
+ *
+ * BabelTrace - clock cycles to ns conversion test program
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; under version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <babeltrace/ctf-ir/metadata.h>
+#include <babeltrace/clock-internal.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <tap/tap.h>
+
+/* Random cycle values checked per frequency */
+#define NR_RANDOM_CYCLES 100000
+
+struct conversion {
+	uint64_t freq;
+	uint64_t cycles;
+	uint64_t ns;
+};
+
+static const struct conversion conversions[] = {
+	{ 3000000000ULL, 3000000000ULL, 1000000000ULL },
+	{ 1500000000ULL, 12345ULL, 8230ULL },
+	{ 2399999999ULL, 1ULL, 0ULL },
+	{ 2399999999ULL, 1000000000000000000ULL, 416666666840277777ULL },
+	{ 32768ULL, 32767ULL, 999969482ULL },
+	{ 19200000ULL, 9223372036854775ULL, 480383960252852864ULL },
+	{ 1000000001ULL, UINT64_MAX, 18446744055262807559ULL },
+};
+
+/* Frequencies of the random checks, none a power of ten */
+static const uint64_t freqs[] = {
+	3ULL, 32768ULL, 19200000ULL, 999999999ULL, 1000000001ULL,
+	1500000000ULL, 2399999999ULL, 3000000000ULL, 14318180000ULL,
+};
+
+static
+uint64_t random_u64(void)
+{
+	uint64_t value;
+
+	value = ((uint64_t) rand() << 42) ^ ((uint64_t) rand() << 21) ^ rand();
+	/* Cover small values as well as large ones */
+	return value >> (rand() % 64);
+}
+
+/*
+ * Reference conversion with 64-bit divisions: cycles = q * freq + r, with
+ * r * 1000000000 fitting in 64 bits for frequencies below 18 GHz. Returns
+ * 0 if the result does not fit in 64 bits.
+ */
+static
+int reference_ns(uint64_t freq, uint64_t cycles, uint64_t *ns)
+{
+	uint64_t q = cycles / freq, r = cycles % freq;
+
+	if (q > UINT64_MAX / 1000000000ULL)
+		return 0;
+	*ns = q * 1000000000ULL;
+	if (*ns > UINT64_MAX - r * 1000000000ULL / freq)
+		return 0;
+	*ns += r * 1000000000ULL / freq;
+	return 1;
+}
+
+static
+void test_conversions(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < sizeof(conversions) / sizeof(conversions[0]); i++) {
+		struct ctf_clock clock = { .freq = conversions[i].freq };
+		uint64_t ns;
+
+		clock_compute_ns_conversion(&clock);
+		ns = clock_cycles_to_ns(&clock, conversions[i].cycles);
+		ok(ns == conversions[i].ns,
+			"%" PRIu64 " cycles at %" PRIu64 " Hz are %" PRIu64 " ns (got %" PRIu64 ")",
+			conversions[i].cycles, conversions[i].freq,
+			conversions[i].ns, ns);
+	}
+}
+
+static
+void test_random_cycles(void)
+{
+	unsigned int i, j;
+
+	srand(42);
+	for (i = 0; i < sizeof(freqs) / sizeof(freqs[0]); i++) {
+		struct ctf_clock clock = { .freq = freqs[i] };
+		int exact = 1;
+
+		clock_compute_ns_conversion(&clock);
+		for (j = 0; j < NR_RANDOM_CYCLES; j++) {
+			uint64_t cycles = random_u64(), ns;
+
+			if (!reference_ns(freqs[i], cycles, &ns))
+				continue;
+			if (clock_cycles_to_ns(&clock, cycles) != ns) {
+				diag("%" PRIu64 " cycles: got %" PRIu64 " ns, expected %" PRIu64,
+					cycles, clock_cycles_to_ns(&clock, cycles), ns);
+				exact = 0;
+				break;
+			}
+		}
+		ok(exact, "Conversions at %" PRIu64 " Hz are exact", freqs[i]);
+	}
+}
+
+static
+void test_offset(void)
+{
+	struct ctf_clock clock = {
+		.freq = 3000000000ULL,
+		.offset_s = 10,
+		.offset = 4500000000ULL,
+	};
+
+	clock_compute_ns_conversion(&clock);
+	ok(clock_offset_ns(&clock) == 11500000000ULL,
+		"Clock offset is converted exactly");
+}
+
+int main(int argc, char **argv)
+{
+	plan_no_plan();
+
+	test_conversions();
+	test_random_cycles();
+	test_offset();
+
+	return exit_status();
+}
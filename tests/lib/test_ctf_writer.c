@@ -28,7 +28,19 @@
 #include <babeltrace/ctf-writer/event-fields.h>
 #include <babeltrace/ctf-ir/stream-class.h>
 #include <babeltrace/ctf/events.h>
+#include <babeltrace/ctf/iterator.h>
+#include <babeltrace/ctf/snapshot.h>
+#include <babeltrace/ctf/stats.h>
+#include <babeltrace/ctf/packet-stream.h>
+#include <babeltrace/format.h>
+#include <babeltrace/context.h>
+#include <babeltrace/trace-handle.h>
+#include <babeltrace/iterator.h>
 #include <babeltrace/objects.h>
+#include <babeltrace/ctf/ctf-index.h>
+#include <babeltrace/ctf/types.h>
+#include <babeltrace/context-internal.h>
+#include <babeltrace/endian.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -36,17 +48,46 @@
 #include <babeltrace/compat/limits.h>
 #include <string.h>
 #include <assert.h>
+#include <errno.h>
 #include <sys/wait.h>
+#include <sys/stat.h>
 #include <fcntl.h>
 #include <dirent.h>
 #include "tap/tap.h"
 #include <math.h>
 #include <float.h>
+#include <pthread.h>
+#include <inttypes.h>
+#include <glib.h>
 
 #define METADATA_LINE_SIZE 512
 #define SEQUENCE_TEST_LENGTH 10
 #define ARRAY_TEST_LENGTH 5
 #define PACKET_RESIZE_TEST_LENGTH 100000
+#define CONCURRENT_TEST_THREADS 8
+#define CONCURRENT_TEST_LENGTH 20000
+#define ASYNC_TEST_LENGTH 50000
+#define ASYNC_TEST_FLUSH_EVERY 100
+#define INDEX_TEST_PACKETS 10
+#define INDEX_TEST_PACKET_LENGTH 100
+#define COPY_TEST_PACKETS 3
+#define COPY_TEST_PACKET_LENGTH 10
+#define COPY_TEST_BEGIN 5
+#define COPY_TEST_END 24
+#define STATS_TEST_STREAMS 2
+#define STATS_TEST_PACKETS 4
+#define STATS_TEST_PACKET_LENGTH 10
+#define STATS_TEST_CPU_ID 3
+#define COMPACT_TEST_LENGTH 1000
+#define COMPACT_TEST_FLUSH_EVERY 100
+#define LIMITS_TEST_STREAMS 16
+#define LIMITS_TEST_LENGTH 50
+#define LIMITS_TEST_FLUSH_EVERY 10
+#define ITERATORS_TEST_COUNT 4
+#define FILTER_TEST_RARE_PACKET 3
+#define FILTER_TEST_RARE_LENGTH 5
+#define INT_ARRAY_TEST_LENGTH 7
+#define INT_STORE_TEST_LENGTH 16
 
 #define DEFAULT_CLOCK_FREQ 1000000000
 #define DEFAULT_CLOCK_PRECISION 1
@@ -788,6 +829,7 @@ void append_complex_event(struct bt_ctf_stream_class *stream_class,
 	struct bt_ctf_stream_class *ret_stream_class;
 	struct bt_ctf_event_class *ret_event_class;
 	struct bt_ctf_field *packet_context, *packet_context_field;
+	struct bt_ctf_field_handle *field_handle;
 	struct bt_object *obj;
 
 	bt_ctf_field_type_set_alignment(int_16_type, 32);
@@ -1149,6 +1191,49 @@ void append_complex_event(struct bt_ctf_stream_class *stream_class,
 		"bt_ctf_field_unsigned_integer_get_value fails on a signed field");
 	bt_ctf_field_put(int_16_field);
 
+	ok(bt_ctf_event_class_get_field_handle(NULL, "payload.uint_35") == NULL,
+		"bt_ctf_event_class_get_field_handle handles a NULL event class correctly");
+	ok(bt_ctf_event_class_get_field_handle(event_class, NULL) == NULL,
+		"bt_ctf_event_class_get_field_handle handles a NULL path correctly");
+	ok(bt_ctf_event_class_get_field_handle(event_class, "uint_35") == NULL,
+		"bt_ctf_event_class_get_field_handle rejects a path without scope");
+	ok(bt_ctf_event_class_get_field_handle(event_class,
+		"payload.no_such_field") == NULL,
+		"bt_ctf_event_class_get_field_handle rejects an unknown field");
+	ok(bt_ctf_event_class_get_field_handle(event_class,
+		"payload.uint_35.value") == NULL,
+		"bt_ctf_event_class_get_field_handle rejects a path through a non-structure field");
+	field_handle = bt_ctf_event_class_get_field_handle(event_class,
+		"payload.int_16");
+	ok(field_handle, "Resolve a payload field handle");
+	ok(bt_ctf_event_set_signed_integer_by_handle(event, field_handle,
+		-12345) == 0,
+		"bt_ctf_event_set_signed_integer_by_handle succeeds");
+	ok(bt_ctf_event_set_unsigned_integer_by_handle(event, field_handle,
+		42) < 0,
+		"bt_ctf_event_set_unsigned_integer_by_handle fails on a signed field");
+	int_16_field = bt_ctf_event_get_field_by_handle(event, field_handle);
+	ok(int_16_field && !bt_ctf_field_signed_integer_get_value(int_16_field,
+		&ret_signed_int) && ret_signed_int == -12345,
+		"bt_ctf_event_get_field_by_handle returns the correct field");
+	bt_ctf_field_put(int_16_field);
+	ok(bt_ctf_event_get_field_by_handle(NULL, field_handle) == NULL,
+		"bt_ctf_event_get_field_by_handle handles a NULL event correctly");
+	bt_ctf_field_handle_put(field_handle);
+	field_handle = bt_ctf_event_class_get_field_handle(event_class,
+		"payload.complex_structure.inner_structure.seq_len");
+	ok(field_handle, "Resolve a nested payload field handle");
+	ok(bt_ctf_event_set_unsigned_integer_by_handle(event, field_handle,
+		SEQUENCE_TEST_LENGTH) == 0,
+		"bt_ctf_event_set_unsigned_integer_by_handle succeeds on a nested field");
+	uint_35_field = bt_ctf_event_get_field_by_handle(event, field_handle);
+	ok(uint_35_field && !bt_ctf_field_unsigned_integer_get_value(
+		uint_35_field, &ret_unsigned_int) &&
+		ret_unsigned_int == SEQUENCE_TEST_LENGTH,
+		"A nested field set by handle holds the correct value");
+	bt_ctf_field_put(uint_35_field);
+	bt_ctf_field_handle_put(field_handle);
+
 	complex_structure_field = bt_ctf_event_get_payload(event,
 		"complex_structure");
 
@@ -2429,172 +2514,2789 @@ void append_existing_event_class(struct bt_ctf_stream_class *stream_class)
 	bt_ctf_event_class_put(event_class);
 }
 
-int main(int argc, char **argv)
+void remove_trace_dir(const char *path)
 {
-	char trace_path[] = "/tmp/ctfwriter_XXXXXX";
-	char metadata_path[sizeof(trace_path) + 9];
-	const char *clock_name = "test_clock";
-	const char *clock_description = "This is a test clock";
-	const char *returned_clock_name;
-	const char *returned_clock_description;
-	const uint64_t frequency = 1123456789;
-	const uint64_t offset_s = 1351530929945824323;
-	const uint64_t offset = 1234567;
-	const uint64_t precision = 10;
-	const int is_absolute = 0xFF;
-	char *metadata_string;
-	struct bt_ctf_writer *writer;
-	struct utsname name;
-	char hostname[BABELTRACE_HOST_NAME_MAX];
-	struct bt_ctf_clock *clock, *ret_clock;
-	struct bt_ctf_stream_class *stream_class, *ret_stream_class;
-	struct bt_ctf_stream *stream1;
-	const char *ret_string;
-	const unsigned char *ret_uuid;
-	unsigned char tmp_uuid[16] = { 0 };
-	struct bt_ctf_field_type *packet_context_type,
-		*packet_context_field_type,
-		*packet_header_type,
-		*packet_header_field_type,
-		*integer_type,
-		*stream_event_context_type,
-		*ret_field_type,
-		*event_header_field_type;
-	struct bt_ctf_field *packet_header, *packet_header_field;
-	struct bt_ctf_trace *trace;
+	DIR *trace_dir;
+	struct dirent *entry;
+
+	trace_dir = opendir(path);
+	if (!trace_dir) {
+		perror("# opendir");
+		return;
+	}
+
+	while ((entry = readdir(trace_dir))) {
+		if (entry->d_type == DT_REG) {
+			unlinkat(dirfd(trace_dir), entry->d_name, 0);
+		} else if (entry->d_type == DT_DIR &&
+			entry->d_name[0] != '.') {
+			/* index/ */
+			gchar *subdir = g_build_filename(path,
+				entry->d_name, NULL);
+
+			remove_trace_dir(subdir);
+			g_free(subdir);
+		}
+	}
+
+	rmdir(path);
+	closedir(trace_dir);
+}
+
+struct concurrent_producer {
+	pthread_t thread;
+	struct bt_ctf_stream *stream;
+	struct bt_ctf_event_class *event_class;
+	unsigned int id;
 	int ret;
-	int64_t ret_int64_t;
-	struct bt_object *obj;
+};
 
-	if (argc < 3) {
-		printf("Usage: tests-ctf-writer path_to_ctf_parser_test path_to_babeltrace\n");
-		return -1;
+static int concurrent_producers_done;
+
+static
+void *concurrent_produce(void *data)
+{
+	struct concurrent_producer *producer = data;
+	struct bt_ctf_field *field;
+	int i;
+
+	for (i = 0; i < CONCURRENT_TEST_LENGTH && !producer->ret; i++) {
+		struct bt_ctf_event *event =
+			bt_ctf_event_create(producer->event_class);
+
+		if (!event) {
+			producer->ret = -1;
+			break;
+		}
+		field = bt_ctf_event_get_payload(event, "producer");
+		producer->ret |= bt_ctf_field_unsigned_integer_set_value(field,
+			producer->id);
+		bt_ctf_field_put(field);
+		field = bt_ctf_event_get_payload(event, "seq");
+		producer->ret |= bt_ctf_field_unsigned_integer_set_value(field,
+			i);
+		bt_ctf_field_put(field);
+		producer->ret |= bt_ctf_stream_append_event(producer->stream,
+			event);
+		bt_ctf_event_put(event);
 	}
+	(void) __sync_add_and_fetch(&concurrent_producers_done, 1);
+	return NULL;
+}
 
-	plan_no_plan();
+void concurrent_append_test(void)
+{
+	char trace_path[] = "/tmp/ctfwriter_concurrent_XXXXXX";
+	struct concurrent_producer producers[CONCURRENT_TEST_THREADS];
+	uint64_t next_seq[CONCURRENT_TEST_THREADS] = { 0 };
+	struct bt_ctf_writer *writer = NULL;
+	struct bt_ctf_clock *clock = NULL;
+	struct bt_ctf_stream_class *stream_class = NULL;
+	struct bt_ctf_event_class *event_class = NULL;
+	struct bt_ctf_field_type *uint_32_type = NULL;
+	struct bt_ctf_stream *stream = NULL;
+	struct bt_context *ctx = NULL;
+	struct bt_ctf_iter *iter = NULL;
+	struct bt_ctf_event *event;
+	uint64_t time = 0, nr_events = 0, last_timestamp = 0;
+	int ret = 0, nr_threads = 0, nr_flushes = 0, in_order = 1;
+	int monotonic = 1;
+	int i;
 
 	if (!mkdtemp(trace_path)) {
 		perror("# perror");
+		return;
 	}
 
-	strcpy(metadata_path, trace_path);
-	strcat(metadata_path + sizeof(trace_path) - 1, "/metadata");
-
 	writer = bt_ctf_writer_create(trace_path);
-	ok(writer, "bt_ctf_create succeeds in creating trace with path");
+	clock = bt_ctf_clock_create("concurrent_clock");
+	stream_class = bt_ctf_stream_class_create("concurrent_stream");
+	event_class = bt_ctf_event_class_create("concurrent_event");
+	uint_32_type = bt_ctf_field_type_integer_create(32);
+	if (!writer || !clock || !stream_class || !event_class ||
+		!uint_32_type) {
+		diag("Failed to create the concurrent append test trace");
+		ret = -1;
+		goto end;
+	}
+	ret |= bt_ctf_writer_add_clock(writer, clock);
+	ret |= bt_ctf_stream_class_set_clock(stream_class, clock);
+	ret |= bt_ctf_event_class_add_field(event_class, uint_32_type,
+		"producer");
+	ret |= bt_ctf_event_class_add_field(event_class, uint_32_type, "seq");
+	ret |= bt_ctf_stream_class_add_event_class(stream_class, event_class);
+	if (ret) {
+		diag("Failed to set up the concurrent append test trace");
+		goto end;
+	}
+	stream = bt_ctf_writer_create_stream(writer, stream_class);
+	if (!stream) {
+		ret = -1;
+		goto end;
+	}
 
-	ok(!bt_ctf_writer_get_trace(NULL),
-		"bt_ctf_writer_get_trace correctly handles NULL");
-	trace = bt_ctf_writer_get_trace(writer);
-	ok(trace,
-		"bt_ctf_writer_get_trace returns a bt_ctf_trace object");
-	ok(bt_ctf_trace_set_byte_order(trace, BT_CTF_BYTE_ORDER_BIG_ENDIAN) == 0,
-		"Set a trace's byte order to big endian");
-	ok(bt_ctf_trace_get_byte_order(trace) == BT_CTF_BYTE_ORDER_BIG_ENDIAN,
-		"bt_ctf_trace_get_byte_order returns a correct endianness");
+	ok(bt_ctf_stream_set_concurrent(NULL, 1) < 0,
+		"bt_ctf_stream_set_concurrent handles NULL correctly");
+	ok(!bt_ctf_stream_set_concurrent(stream, 1),
+		"Enable concurrent appends on a stream");
+
+	for (i = 0; i < CONCURRENT_TEST_THREADS; i++) {
+		producers[i].stream = stream;
+		producers[i].event_class = event_class;
+		producers[i].id = i;
+		producers[i].ret = 0;
+		if (pthread_create(&producers[i].thread, NULL,
+			concurrent_produce, &producers[i])) {
+			break;
+		}
+		nr_threads++;
+	}
+	ok(nr_threads == CONCURRENT_TEST_THREADS,
+		"Start %d concurrent producers", CONCURRENT_TEST_THREADS);
+
+	/* Advance the clock and flush while the producers append events */
+	while (__sync_add_and_fetch(&concurrent_producers_done, 0) <
+		nr_threads) {
+		ret |= bt_ctf_clock_set_time(clock, ++time);
+		ret |= bt_ctf_stream_flush(stream);
+		nr_flushes++;
+	}
+	for (i = 0; i < nr_threads; i++) {
+		pthread_join(producers[i].thread, NULL);
+		ret |= producers[i].ret;
+	}
+	ok(ret == 0, "Append events from concurrent producers (%d flushes)",
+		nr_flushes);
+	ok(!bt_ctf_stream_flush(stream),
+		"Flush a stream after concurrent appends");
+	ok(!bt_ctf_stream_set_concurrent(stream, 0),
+		"Disable concurrent appends once all events are flushed");
+	bt_ctf_stream_put(stream);
+	stream = NULL;
+	bt_ctf_writer_flush_metadata(writer);
+	bt_ctf_writer_put(writer);
+	writer = NULL;
 
-	/* Add environment context to the trace */
-	ret = gethostname(hostname, sizeof(hostname));
-	if (ret < 0) {
-		return ret;
+	/* Read the trace back and check every producer's sequence */
+	ctx = bt_context_create();
+	if (!ctx || bt_context_add_trace(ctx, trace_path, "ctf", NULL, NULL,
+		NULL) < 0) {
+		diag("Failed to open the concurrent append test trace");
+		ret = -1;
+		goto end;
 	}
-	ok(bt_ctf_writer_add_environment_field(writer, "host", hostname) == 0,
-		"Add host (%s) environment field to writer instance",
-		hostname);
-	ok(bt_ctf_writer_add_environment_field(NULL, "test_field",
-		"test_value"),
-		"bt_ctf_writer_add_environment_field error with NULL writer");
-	ok(bt_ctf_writer_add_environment_field(writer, NULL,
-		"test_value"),
-		"bt_ctf_writer_add_environment_field error with NULL field name");
-	ok(bt_ctf_writer_add_environment_field(writer, "test_field",
-		NULL),
-		"bt_ctf_writer_add_environment_field error with NULL field value");
+	iter = bt_ctf_iter_create(ctx, NULL, NULL);
+	if (!iter) {
+		ret = -1;
+		goto end;
+	}
+	while ((event = bt_ctf_iter_read_event(iter))) {
+		const struct bt_definition *scope;
+		uint64_t producer, seq, timestamp;
+
+		scope = bt_ctf_get_top_level_scope(event, BT_EVENT_FIELDS);
+		producer = bt_ctf_get_uint64(bt_ctf_get_field(event, scope,
+			"producer"));
+		seq = bt_ctf_get_uint64(bt_ctf_get_field(event, scope, "seq"));
+		timestamp = bt_ctf_get_cycles(event);
+		if (producer >= CONCURRENT_TEST_THREADS ||
+			seq != next_seq[producer]) {
+			in_order = 0;
+		} else {
+			next_seq[producer]++;
+		}
+		if (timestamp < last_timestamp) {
+			monotonic = 0;
+		}
+		last_timestamp = timestamp;
+		nr_events++;
+		if (bt_iter_next(bt_ctf_get_iter(iter)) < 0) {
+			break;
+		}
+	}
+	ok(nr_events == CONCURRENT_TEST_THREADS * CONCURRENT_TEST_LENGTH,
+		"No event is lost by concurrent appends");
+	ok(in_order, "Events of each producer are written in append order");
+	ok(monotonic,
+		"Timestamps of concurrently appended events are monotonic");
+end:
+	ok(ret == 0, "Concurrent append test completes");
+	if (iter) {
+		bt_ctf_iter_destroy(iter);
+	}
+	if (ctx) {
+		bt_context_put(ctx);
+	}
+	bt_ctf_stream_put(stream);
+	bt_ctf_field_type_put(uint_32_type);
+	bt_ctf_event_class_put(event_class);
+	bt_ctf_stream_class_put(stream_class);
+	bt_ctf_clock_put(clock);
+	bt_ctf_writer_put(writer);
+	remove_trace_dir(trace_path);
+}
 
-	/* Test bt_ctf_trace_set_environment_field with an integer object */
-	obj = bt_object_integer_create_init(23);
-	assert(obj);
-	ok(bt_ctf_trace_set_environment_field(NULL, "test_env_int_obj", obj),
-		"bt_ctf_trace_set_environment_field handles a NULL trace correctly");
-	ok(bt_ctf_trace_set_environment_field(trace, NULL, obj),
-		"bt_ctf_trace_set_environment_field handles a NULL name correctly");
-	ok(bt_ctf_trace_set_environment_field(trace, "test_env_int_obj", NULL),
-		"bt_ctf_trace_set_environment_field handles a NULL value correctly");
-	ok(!bt_ctf_trace_set_environment_field(trace, "test_env_int_obj", obj),
-		"bt_ctf_trace_set_environment_field succeeds in adding an integer object");
-	BT_OBJECT_PUT(obj);
+static
+int64_t count_trace_events(const char *path)
+{
+	struct bt_context *ctx;
+	struct bt_ctf_iter *iter = NULL;
+	int64_t count = -1;
 
-	/* Test bt_ctf_trace_set_environment_field with a string object */
-	obj = bt_object_string_create_init("the value");
-	assert(obj);
-	ok(!bt_ctf_trace_set_environment_field(trace, "test_env_str_obj", obj),
-		"bt_ctf_trace_set_environment_field succeeds in adding a string object");
-	BT_OBJECT_PUT(obj);
+	ctx = bt_context_create();
+	if (!ctx || bt_context_add_trace(ctx, path, "ctf", NULL, NULL,
+		NULL) < 0) {
+		goto end;
+	}
+	iter = bt_ctf_iter_create(ctx, NULL, NULL);
+	if (!iter) {
+		goto end;
+	}
+	count = 0;
+	while (bt_ctf_iter_read_event(iter)) {
+		count++;
+		if (bt_iter_next(bt_ctf_get_iter(iter)) < 0) {
+			break;
+		}
+	}
+end:
+	if (iter) {
+		bt_ctf_iter_destroy(iter);
+	}
+	if (ctx) {
+		bt_context_put(ctx);
+	}
+	return count;
+}
 
-	/* Test bt_ctf_trace_set_environment_field_integer */
-	ok(bt_ctf_trace_set_environment_field_integer(NULL, "test_env_int",
-		-194875),
-		"bt_ctf_trace_set_environment_field_integer handles a NULL trace correctly");
-	ok(bt_ctf_trace_set_environment_field_integer(trace, NULL, -194875),
-		"bt_ctf_trace_set_environment_field_integer handles a NULL name correctly");
-	ok(!bt_ctf_trace_set_environment_field_integer(trace, "test_env_int",
-		-164973),
-		"bt_ctf_trace_set_environment_field_integer succeeds");
+/*
+ * Write ASYNC_TEST_LENGTH events through an asynchronous writer and
+ * check that every event is either in the trace or counted as discarded.
+ */
+void async_writer_test(int flags)
+{
+	char trace_path[] = "/tmp/ctfwriter_async_XXXXXX";
+	struct bt_ctf_writer *writer = NULL;
+	struct bt_ctf_clock *clock = NULL;
+	struct bt_ctf_stream_class *stream_class = NULL;
+	struct bt_ctf_event_class *event_class = NULL;
+	struct bt_ctf_field_type *uint_32_type = NULL;
+	struct bt_ctf_stream *stream = NULL;
+	struct bt_ctf_field *field;
+	uint64_t discarded = 0;
+	int64_t nr_events;
+	int ret = 0, i;
+	const char *mode = flags & BT_CTF_WRITER_ASYNC_DISCARD ?
+		"discarding" : "blocking";
 
-	/* Test bt_ctf_trace_set_environment_field_string */
-	ok(bt_ctf_trace_set_environment_field_string(NULL, "test_env_str",
-		"yeah"),
-		"bt_ctf_trace_set_environment_field_string handles a NULL trace correctly");
-	ok(bt_ctf_trace_set_environment_field_string(trace, NULL, "yeah"),
-		"bt_ctf_trace_set_environment_field_string handles a NULL name correctly");
-	ok(bt_ctf_trace_set_environment_field_string(trace, "test_env_str",
-		NULL),
-		"bt_ctf_trace_set_environment_field_string handles a NULL value correctly");
-	ok(!bt_ctf_trace_set_environment_field_string(trace, "test_env_str",
-		"oh yeah"),
-		"bt_ctf_trace_set_environment_field_string succeeds");
+	if (!mkdtemp(trace_path)) {
+		perror("# perror");
+		return;
+	}
 
-	/* Test bt_ctf_trace_get_environment_field_count */
-	ok(bt_ctf_trace_get_environment_field_count(NULL) < 0,
-		"bt_ctf_trace_get_environment_field_count handles a NULL trace correctly");
-	ok(bt_ctf_trace_get_environment_field_count(trace) == 5,
-		"bt_ctf_trace_get_environment_field_count returns a correct number of environment fields");
+	writer = bt_ctf_writer_create(trace_path);
+	clock = bt_ctf_clock_create("async_clock");
+	stream_class = bt_ctf_stream_class_create("async_stream");
+	event_class = bt_ctf_event_class_create("async_event");
+	uint_32_type = bt_ctf_field_type_integer_create(32);
+	if (!writer || !clock || !stream_class || !event_class ||
+		!uint_32_type) {
+		diag("Failed to create the asynchronous writer test trace");
+		ret = -1;
+		goto end;
+	}
+	ok(bt_ctf_writer_set_async(NULL, 4, flags) < 0,
+		"bt_ctf_writer_set_async handles NULL correctly");
+	ok(bt_ctf_writer_set_async(writer, 0, flags) < 0,
+		"bt_ctf_writer_set_async rejects an empty queue");
+	ok(!bt_ctf_writer_set_async(writer, 4, flags),
+		"Make a writer asynchronous (%s)", mode);
+	ret |= bt_ctf_writer_add_clock(writer, clock);
+	ret |= bt_ctf_stream_class_set_clock(stream_class, clock);
+	ret |= bt_ctf_event_class_add_field(event_class, uint_32_type, "seq");
+	ret |= bt_ctf_stream_class_add_event_class(stream_class, event_class);
+	if (ret) {
+		diag("Failed to set up the asynchronous writer test trace");
+		goto end;
+	}
+	stream = bt_ctf_writer_create_stream(writer, stream_class);
+	if (!stream) {
+		ret = -1;
+		goto end;
+	}
+	ok(bt_ctf_writer_set_async(writer, 4, flags) < 0,
+		"bt_ctf_writer_set_async fails once a stream has been created");
 
-	/* Test bt_ctf_trace_get_environment_field_name */
-	ok(bt_ctf_trace_get_environment_field_name(NULL, 0) == NULL,
-		"bt_ctf_trace_get_environment_field_name handles a NULL trace correctly");
-	ok(bt_ctf_trace_get_environment_field_name(trace, -1) == NULL,
-		"bt_ctf_trace_get_environment_field_name handles an invalid index correctly (negative)");
-	ok(bt_ctf_trace_get_environment_field_name(trace, 5) == NULL,
-		"bt_ctf_trace_get_environment_field_name handles an invalid index correctly (too large)");
-	ret_string = bt_ctf_trace_get_environment_field_name(trace, 0);
-	ok(ret_string && !strcmp(ret_string, "host"),
-		"bt_ctf_trace_get_environment_field_name returns a correct field name");
-	ret_string = bt_ctf_trace_get_environment_field_name(trace, 1);
-	ok(ret_string && !strcmp(ret_string, "test_env_int_obj"),
-		"bt_ctf_trace_get_environment_field_name returns a correct field name");
-	ret_string = bt_ctf_trace_get_environment_field_name(trace, 2);
-	ok(ret_string && !strcmp(ret_string, "test_env_str_obj"),
-		"bt_ctf_trace_get_environment_field_name returns a correct field name");
-	ret_string = bt_ctf_trace_get_environment_field_name(trace, 3);
-	ok(ret_string && !strcmp(ret_string, "test_env_int"),
-		"bt_ctf_trace_get_environment_field_name returns a correct field name");
-	ret_string = bt_ctf_trace_get_environment_field_name(trace, 4);
-	ok(ret_string && !strcmp(ret_string, "test_env_str"),
-		"bt_ctf_trace_get_environment_field_name returns a correct field name");
+	for (i = 0; i < ASYNC_TEST_LENGTH && !ret; i++) {
+		struct bt_ctf_event *event = bt_ctf_event_create(event_class);
 
-	/* Test bt_ctf_trace_get_environment_field_value */
-	ok(bt_ctf_trace_get_environment_field_value(NULL, 0) == NULL,
-		"bt_ctf_trace_get_environment_field_value handles a NULL trace correctly");
-	ok(bt_ctf_trace_get_environment_field_value(trace, -1) == NULL,
-		"bt_ctf_trace_get_environment_field_value handles an invalid index correctly (negative)");
-	ok(bt_ctf_trace_get_environment_field_value(trace, 5) == NULL,
-		"bt_ctf_trace_get_environment_field_value handles an invalid index correctly (too large)");
-	obj = bt_ctf_trace_get_environment_field_value(trace, 1);
-	ret = bt_object_integer_get(obj, &ret_int64_t);
-	ok(!ret && ret_int64_t == 23,
-		"bt_ctf_trace_get_environment_field_value succeeds in getting an integer value");
-	BT_OBJECT_PUT(obj);
+		if (!event) {
+			ret = -1;
+			break;
+		}
+		field = bt_ctf_event_get_payload(event, "seq");
+		ret |= bt_ctf_field_unsigned_integer_set_value(field, i);
+		bt_ctf_field_put(field);
+		ret |= bt_ctf_clock_set_time(clock, i);
+		ret |= bt_ctf_stream_append_event(stream, event);
+		bt_ctf_event_put(event);
+		if ((i + 1) % ASYNC_TEST_FLUSH_EVERY == 0) {
+			ret |= bt_ctf_stream_flush(stream);
+		}
+	}
+	ret |= bt_ctf_stream_flush(stream);
+	ok(ret == 0, "Append and flush events through an asynchronous writer");
+	bt_ctf_writer_flush_metadata(writer);
+	ok(!bt_ctf_writer_wait(writer),
+		"Wait for the queued packets to be written");
+	ok(bt_ctf_writer_wait(NULL) < 0,
+		"bt_ctf_writer_wait handles NULL correctly");
+	ret |= bt_ctf_stream_get_discarded_events_count(stream, &discarded);
+	if (!(flags & BT_CTF_WRITER_ASYNC_DISCARD)) {
+		ok(discarded == 0, "No event is discarded by a blocking writer");
+	}
+	bt_ctf_stream_put(stream);
+	stream = NULL;
+	bt_ctf_writer_put(writer);
+	writer = NULL;
+
+	nr_events = count_trace_events(trace_path);
+	ok(nr_events >= 0 && nr_events + discarded == ASYNC_TEST_LENGTH,
+		"Every event is written or counted as discarded (%" PRId64
+		" written, %" PRIu64 " discarded)", nr_events, discarded);
+end:
+	ok(ret == 0, "Asynchronous writer test completes (%s)", mode);
+	bt_ctf_stream_put(stream);
+	bt_ctf_field_type_put(uint_32_type);
+	bt_ctf_event_class_put(event_class);
+	bt_ctf_stream_class_put(stream_class);
+	bt_ctf_clock_put(clock);
+	bt_ctf_writer_put(writer);
+	remove_trace_dir(trace_path);
+}
+
+static
+gchar *read_trace_metadata(const char *trace_path, gsize *len)
+{
+	gchar *metadata_path, *metadata = NULL;
+
+	metadata_path = g_build_filename(trace_path, "metadata", NULL);
+	if (!g_file_get_contents(metadata_path, &metadata, len, NULL)) {
+		metadata = NULL;
+	}
+	g_free(metadata_path);
+	return metadata;
+}
+
+/*
+ * Flush the metadata of a trace before and after adding an event class,
+ * and check that only the new declaration is appended to the file.
+ */
+void incremental_metadata_test(int packetized)
+{
+	char trace_path[] = "/tmp/ctfwriter_metadata_XXXXXX";
+	struct bt_ctf_writer *writer = NULL;
+	struct bt_ctf_clock *clock = NULL;
+	struct bt_ctf_stream_class *stream_class = NULL;
+	struct bt_ctf_event_class *event_classes[2] = { NULL, NULL };
+	struct bt_ctf_field_type *uint_32_type = NULL;
+	struct bt_ctf_stream *stream = NULL;
+	gchar *metadata[3] = { NULL, NULL, NULL };
+	gsize len[3] = { 0, 0, 0 };
+	int ret = 0, i;
+	const char *mode = packetized ? "packetized" : "text";
+
+	if (!mkdtemp(trace_path)) {
+		perror("# perror");
+		return;
+	}
+
+	writer = bt_ctf_writer_create(trace_path);
+	clock = bt_ctf_clock_create("metadata_clock");
+	stream_class = bt_ctf_stream_class_create("metadata_stream");
+	event_classes[0] = bt_ctf_event_class_create("first_event");
+	event_classes[1] = bt_ctf_event_class_create("second_event");
+	uint_32_type = bt_ctf_field_type_integer_create(32);
+	if (!writer || !clock || !stream_class || !event_classes[0] ||
+		!event_classes[1] || !uint_32_type) {
+		diag("Failed to create the incremental metadata test trace");
+		ret = -1;
+		goto end;
+	}
+	ret |= bt_ctf_writer_set_packetized_metadata(writer, packetized);
+	ret |= bt_ctf_writer_add_clock(writer, clock);
+	ret |= bt_ctf_stream_class_set_clock(stream_class, clock);
+	for (i = 0; i < 2; i++) {
+		ret |= bt_ctf_event_class_add_field(event_classes[i],
+			uint_32_type, "value");
+	}
+	ret |= bt_ctf_stream_class_add_event_class(stream_class,
+		event_classes[0]);
+	if (ret) {
+		diag("Failed to set up the incremental metadata test trace");
+		goto end;
+	}
+	stream = bt_ctf_writer_create_stream(writer, stream_class);
+	if (!stream) {
+		ret = -1;
+		goto end;
+	}
+
+	bt_ctf_writer_flush_metadata(writer);
+	metadata[0] = read_trace_metadata(trace_path, &len[0]);
+	ret |= bt_ctf_stream_class_add_event_class(stream_class,
+		event_classes[1]);
+	bt_ctf_writer_flush_metadata(writer);
+	metadata[1] = read_trace_metadata(trace_path, &len[1]);
+	ok(metadata[0] && metadata[1] && len[1] > len[0] &&
+		!memcmp(metadata[0], metadata[1], len[0]),
+		"Metadata flush appends the new declarations (%s)", mode);
+	bt_ctf_writer_flush_metadata(writer);
+	metadata[2] = read_trace_metadata(trace_path, &len[2]);
+	ok(metadata[2] && len[2] == len[1],
+		"Metadata flush without new declarations writes nothing (%s)",
+		mode);
+
+	for (i = 0; i < 2; i++) {
+		struct bt_ctf_event *event =
+			bt_ctf_event_create(event_classes[i]);
+		struct bt_ctf_field *field;
+
+		if (!event) {
+			ret = -1;
+			break;
+		}
+		field = bt_ctf_event_get_payload(event, "value");
+		ret |= bt_ctf_field_unsigned_integer_set_value(field, i);
+		bt_ctf_field_put(field);
+		ret |= bt_ctf_clock_set_time(clock, i);
+		ret |= bt_ctf_stream_append_event(stream, event);
+		bt_ctf_event_put(event);
+	}
+	ret |= bt_ctf_stream_flush(stream);
+	bt_ctf_stream_put(stream);
+	stream = NULL;
+	bt_ctf_writer_put(writer);
+	writer = NULL;
+
+	ok(count_trace_events(trace_path) == 2,
+		"Read back a trace whose metadata was appended (%s)", mode);
+end:
+	ok(ret == 0, "Incremental metadata test completes (%s)", mode);
+	for (i = 0; i < 3; i++) {
+		g_free(metadata[i]);
+	}
+	bt_ctf_stream_put(stream);
+	bt_ctf_field_type_put(uint_32_type);
+	bt_ctf_event_class_put(event_classes[0]);
+	bt_ctf_event_class_put(event_classes[1]);
+	bt_ctf_stream_class_put(stream_class);
+	bt_ctf_clock_put(clock);
+	bt_ctf_writer_put(writer);
+	remove_trace_dir(trace_path);
+}
+
+/*
+ * Write INDEX_TEST_PACKETS packets and check the stream's index file
+ * describes each of them.
+ */
+void packet_index_test(void)
+{
+	char trace_path[] = "/tmp/ctfwriter_index_XXXXXX";
+	struct bt_ctf_writer *writer = NULL;
+	struct bt_ctf_clock *clock = NULL;
+	struct bt_ctf_stream_class *stream_class = NULL;
+	struct bt_ctf_event_class *event_class = NULL;
+	struct bt_ctf_field_type *uint_32_type = NULL;
+	struct bt_ctf_stream *stream = NULL;
+	struct ctf_packet_index_file_hdr *header;
+	struct ctf_packet_index *entries;
+	gchar *index_path = NULL, *index = NULL;
+	gsize len = 0;
+	size_t nr_entries = 0;
+	int ret = 0, i, entries_ok = 1;
+
+	if (!mkdtemp(trace_path)) {
+		perror("# perror");
+		return;
+	}
+
+	writer = bt_ctf_writer_create(trace_path);
+	clock = bt_ctf_clock_create("index_clock");
+	stream_class = bt_ctf_stream_class_create("index_stream");
+	event_class = bt_ctf_event_class_create("index_event");
+	uint_32_type = bt_ctf_field_type_integer_create(32);
+	if (!writer || !clock || !stream_class || !event_class ||
+		!uint_32_type) {
+		diag("Failed to create the packet index test trace");
+		ret = -1;
+		goto end;
+	}
+	ret |= bt_ctf_writer_add_clock(writer, clock);
+	ret |= bt_ctf_stream_class_set_clock(stream_class, clock);
+	ret |= bt_ctf_event_class_add_field(event_class, uint_32_type, "seq");
+	ret |= bt_ctf_stream_class_add_event_class(stream_class, event_class);
+	if (ret) {
+		diag("Failed to set up the packet index test trace");
+		goto end;
+	}
+	stream = bt_ctf_writer_create_stream(writer, stream_class);
+	if (!stream) {
+		ret = -1;
+		goto end;
+	}
+
+	for (i = 0; i < INDEX_TEST_PACKETS * INDEX_TEST_PACKET_LENGTH &&
+			!ret; i++) {
+		struct bt_ctf_event *event = bt_ctf_event_create(event_class);
+		struct bt_ctf_field *field;
+
+		if (!event) {
+			ret = -1;
+			break;
+		}
+		field = bt_ctf_event_get_payload(event, "seq");
+		ret |= bt_ctf_field_unsigned_integer_set_value(field, i);
+		bt_ctf_field_put(field);
+		ret |= bt_ctf_clock_set_time(clock, i);
+		ret |= bt_ctf_stream_append_event(stream, event);
+		bt_ctf_event_put(event);
+		if ((i + 1) % INDEX_TEST_PACKET_LENGTH == 0) {
+			ret |= bt_ctf_stream_flush(stream);
+		}
+	}
+	bt_ctf_stream_put(stream);
+	stream = NULL;
+	bt_ctf_writer_put(writer);
+	writer = NULL;
+
+	index_path = g_build_filename(trace_path, "index",
+		"index_stream_0.idx", NULL);
+	ok(g_file_get_contents(index_path, &index, &len, NULL) &&
+		len >= sizeof(*header),
+		"A packet index file is written for each stream");
+	if (!index || len < sizeof(*header)) {
+		goto end;
+	}
+	header = (struct ctf_packet_index_file_hdr *) index;
+	ok(be32toh(header->magic) == CTF_INDEX_MAGIC &&
+		be32toh(header->index_major) == CTF_INDEX_MAJOR &&
+		be32toh(header->packet_index_len) ==
+		sizeof(struct ctf_packet_index),
+		"Packet index file header is valid");
+	nr_entries = (len - sizeof(*header)) / sizeof(*entries);
+	ok(nr_entries == INDEX_TEST_PACKETS,
+		"Packet index has an entry per packet");
+	entries = (struct ctf_packet_index *) (index + sizeof(*header));
+	for (i = 0; i < nr_entries; i++) {
+		uint64_t begin = i * INDEX_TEST_PACKET_LENGTH;
+
+		if (be64toh(entries[i].timestamp_begin) != begin ||
+			be64toh(entries[i].timestamp_end) !=
+			begin + INDEX_TEST_PACKET_LENGTH - 1 ||
+			be64toh(entries[i].content_size) >
+			be64toh(entries[i].packet_size) ||
+			(i && be64toh(entries[i].offset) !=
+			be64toh(entries[i - 1].offset) +
+			be64toh(entries[i - 1].packet_size) / CHAR_BIT)) {
+			entries_ok = 0;
+		}
+	}
+	ok(entries_ok, "Packet index entries match the packets written");
+	ok(count_trace_events(trace_path) ==
+		INDEX_TEST_PACKETS * INDEX_TEST_PACKET_LENGTH,
+		"Read back a trace through its packet index");
+end:
+	ok(ret == 0, "Packet index test completes");
+	g_free(index);
+	g_free(index_path);
+	bt_ctf_stream_put(stream);
+	bt_ctf_field_type_put(uint_32_type);
+	bt_ctf_event_class_put(event_class);
+	bt_ctf_stream_class_put(stream_class);
+	bt_ctf_clock_put(clock);
+	bt_ctf_writer_put(writer);
+	remove_trace_dir(trace_path);
+}
+
+/*
+ * Copy the events within [COPY_TEST_BEGIN, COPY_TEST_END] of a trace
+ * whose first and last packets straddle the range, and check the packet
+ * context each copied event is read with.
+ */
+void copy_range_test(void)
+{
+	char trace_path[] = "/tmp/ctfwriter_copy_XXXXXX";
+	char copy_path[] = "/tmp/ctfwriter_copy_out_XXXXXX";
+	struct bt_ctf_writer *writer = NULL;
+	struct bt_ctf_clock *clock = NULL;
+	struct bt_ctf_stream_class *stream_class = NULL;
+	struct bt_ctf_event_class *event_class = NULL;
+	struct bt_ctf_field_type *uint_32_type = NULL;
+	struct bt_ctf_stream *stream = NULL;
+	struct bt_context *ctx = NULL;
+	struct bt_ctf_iter *iter = NULL;
+	struct bt_ctf_event *event;
+	struct bt_format *fmt;
+	struct bt_trace_descriptor *td_write = NULL;
+	uint64_t discarded[COPY_TEST_PACKETS];
+	int64_t nr_events = 0;
+	int ret = 0, i, contexts_ok = 1;
+
+	if (!mkdtemp(trace_path)) {
+		perror("# perror");
+		return;
+	}
+	if (!mkdtemp(copy_path)) {
+		perror("# perror");
+		rmdir(trace_path);
+		return;
+	}
+
+	writer = bt_ctf_writer_create(trace_path);
+	clock = bt_ctf_clock_create("copy_clock");
+	stream_class = bt_ctf_stream_class_create("copy_stream");
+	event_class = bt_ctf_event_class_create("copy_event");
+	uint_32_type = bt_ctf_field_type_integer_create(32);
+	if (!writer || !clock || !stream_class || !event_class ||
+		!uint_32_type) {
+		diag("Failed to create the copy test trace");
+		ret = -1;
+		goto end;
+	}
+	ret |= bt_ctf_writer_add_clock(writer, clock);
+	ret |= bt_ctf_stream_class_set_clock(stream_class, clock);
+	ret |= bt_ctf_event_class_add_field(event_class, uint_32_type, "seq");
+	ret |= bt_ctf_stream_class_add_event_class(stream_class, event_class);
+	if (ret) {
+		diag("Failed to set up the copy test trace");
+		goto end;
+	}
+	stream = bt_ctf_writer_create_stream(writer, stream_class);
+	if (!stream) {
+		ret = -1;
+		goto end;
+	}
+
+	for (i = 0; i < COPY_TEST_PACKETS * COPY_TEST_PACKET_LENGTH &&
+			!ret; i++) {
+		struct bt_ctf_event *event = bt_ctf_event_create(event_class);
+		struct bt_ctf_field *field;
+
+		if (!event) {
+			ret = -1;
+			break;
+		}
+		field = bt_ctf_event_get_payload(event, "seq");
+		ret |= bt_ctf_field_unsigned_integer_set_value(field, i);
+		bt_ctf_field_put(field);
+		ret |= bt_ctf_clock_set_time(clock, i);
+		ret |= bt_ctf_stream_append_event(stream, event);
+		bt_ctf_event_put(event);
+		if ((i + 1) % COPY_TEST_PACKET_LENGTH == 0) {
+			int packet = i / COPY_TEST_PACKET_LENGTH;
+
+			/* Give each packet its own events_discarded. */
+			bt_ctf_stream_append_discarded_events(stream, packet + 1);
+			ret |= bt_ctf_stream_get_discarded_events_count(stream,
+				&discarded[packet]);
+			ret |= bt_ctf_stream_flush(stream);
+		}
+	}
+	bt_ctf_stream_put(stream);
+	stream = NULL;
+	bt_ctf_writer_put(writer);
+	writer = NULL;
+	if (ret) {
+		goto end;
+	}
+
+	ctx = bt_context_create();
+	fmt = bt_lookup_format(g_quark_from_static_string("ctf"));
+	if (!ctx || !fmt || bt_context_add_trace(ctx, trace_path, "ctf",
+		NULL, NULL, NULL) < 0) {
+		ret = -1;
+		goto end;
+	}
+	td_write = fmt->open_trace(copy_path, O_RDWR, NULL, NULL);
+	if (!td_write) {
+		ret = -1;
+		goto end;
+	}
+	ret = ctf_copy_trace(td_write, g_ptr_array_index(ctx->tc->array, 0),
+		NULL, COPY_TEST_BEGIN, COPY_TEST_END);
+	fmt->close_trace(td_write);
+	bt_context_put(ctx);
+	ctx = NULL;
+	ok(ret == 0, "Copy the events of a time range of a trace");
+	if (ret) {
+		goto end;
+	}
+
+	ctx = bt_context_create();
+	if (!ctx || bt_context_add_trace(ctx, copy_path, "ctf", NULL, NULL,
+		NULL) < 0) {
+		ret = -1;
+		goto end;
+	}
+	iter = bt_ctf_iter_create(ctx, NULL, NULL);
+	if (!iter) {
+		ret = -1;
+		goto end;
+	}
+	while ((event = bt_ctf_iter_read_event(iter))) {
+		const struct bt_definition *scope;
+		uint64_t seq, packet, begin, end;
+
+		scope = bt_ctf_get_top_level_scope(event, BT_EVENT_FIELDS);
+		seq = bt_ctf_get_uint64(bt_ctf_get_field(event, scope, "seq"));
+		packet = seq / COPY_TEST_PACKET_LENGTH;
+		begin = MAX(packet * COPY_TEST_PACKET_LENGTH, COPY_TEST_BEGIN);
+		end = MIN(packet * COPY_TEST_PACKET_LENGTH +
+			COPY_TEST_PACKET_LENGTH - 1, COPY_TEST_END);
+		scope = bt_ctf_get_top_level_scope(event,
+			BT_STREAM_PACKET_CONTEXT);
+		if (seq != COPY_TEST_BEGIN + nr_events ||
+			bt_ctf_get_uint64(bt_ctf_get_field(event, scope,
+			"timestamp_begin")) != begin ||
+			bt_ctf_get_uint64(bt_ctf_get_field(event, scope,
+			"timestamp_end")) != end ||
+			bt_ctf_get_uint64(bt_ctf_get_field(event, scope,
+			"events_discarded")) != discarded[packet]) {
+			contexts_ok = 0;
+		}
+		nr_events++;
+		if (bt_iter_next(bt_ctf_get_iter(iter)) < 0) {
+			break;
+		}
+	}
+	ok(nr_events == COPY_TEST_END - COPY_TEST_BEGIN + 1,
+		"The copy holds the events of the time range");
+	ok(contexts_ok,
+		"Packets cut by the time range keep their own packet context");
+end:
+	ok(ret == 0, "Copy range test completes");
+	if (iter) {
+		bt_ctf_iter_destroy(iter);
+	}
+	if (ctx) {
+		bt_context_put(ctx);
+	}
+	bt_ctf_stream_put(stream);
+	bt_ctf_field_type_put(uint_32_type);
+	bt_ctf_event_class_put(event_class);
+	bt_ctf_stream_class_put(stream_class);
+	bt_ctf_clock_put(clock);
+	bt_ctf_writer_put(writer);
+	remove_trace_dir(copy_path);
+	remove_trace_dir(trace_path);
+}
+
+/*
+ * Write STATS_TEST_STREAMS streams, stream k having (k + 1) times more
+ * events and discarded events per packet than stream 0, and check the
+ * statistics of each stream.
+ */
+void stats_test(void)
+{
+	char trace_path[] = "/tmp/ctfwriter_stats_XXXXXX";
+	struct bt_ctf_writer *writer = NULL;
+	struct bt_ctf_clock *clock = NULL;
+	struct bt_ctf_stream_class *stream_class = NULL;
+	struct bt_ctf_event_class *event_class = NULL;
+	struct bt_ctf_field_type *uint_32_type = NULL;
+	struct bt_ctf_field_type *packet_context_type = NULL;
+	struct bt_ctf_stream *streams[STATS_TEST_STREAMS] = { NULL };
+	struct bt_context *ctx = NULL;
+	struct bt_ctf_stats *stats = NULL;
+	uint64_t time = 0;
+	int ret = 0, i, j, k, streams_ok = 1, cpus_ok = 1, index_ok = 1;
+
+	if (!mkdtemp(trace_path)) {
+		perror("# perror");
+		return;
+	}
+
+	writer = bt_ctf_writer_create(trace_path);
+	clock = bt_ctf_clock_create("stats_clock");
+	stream_class = bt_ctf_stream_class_create("stats_stream");
+	event_class = bt_ctf_event_class_create("stats_event");
+	uint_32_type = bt_ctf_field_type_integer_create(32);
+	if (!writer || !clock || !stream_class || !event_class ||
+		!uint_32_type) {
+		diag("Failed to create the statistics test trace");
+		ret = -1;
+		goto end;
+	}
+	packet_context_type =
+		bt_ctf_stream_class_get_packet_context_type(stream_class);
+	ret |= !packet_context_type;
+	ret |= bt_ctf_field_type_structure_add_field(packet_context_type,
+		uint_32_type, "cpu_id");
+	ret |= bt_ctf_writer_add_clock(writer, clock);
+	ret |= bt_ctf_stream_class_set_clock(stream_class, clock);
+	ret |= bt_ctf_event_class_add_field(event_class, uint_32_type, "seq");
+	ret |= bt_ctf_stream_class_add_event_class(stream_class, event_class);
+	if (ret) {
+		diag("Failed to set up the statistics test trace");
+		goto end;
+	}
+	for (k = 0; k < STATS_TEST_STREAMS; k++) {
+		streams[k] = bt_ctf_writer_create_stream(writer, stream_class);
+		if (!streams[k]) {
+			ret = -1;
+			goto end;
+		}
+	}
+
+	for (i = 0; i < STATS_TEST_PACKETS && !ret; i++) {
+		for (k = 0; k < STATS_TEST_STREAMS && !ret; k++) {
+			struct bt_ctf_field *packet_context, *cpu_id;
+
+			for (j = 0; j < (k + 1) * STATS_TEST_PACKET_LENGTH &&
+					!ret; j++) {
+				struct bt_ctf_event *event;
+				struct bt_ctf_field *field;
+
+				event = bt_ctf_event_create(event_class);
+				if (!event) {
+					ret = -1;
+					break;
+				}
+				field = bt_ctf_event_get_payload(event, "seq");
+				ret |= bt_ctf_field_unsigned_integer_set_value(
+					field, j);
+				bt_ctf_field_put(field);
+				ret |= bt_ctf_clock_set_time(clock, time++);
+				ret |= bt_ctf_stream_append_event(streams[k],
+					event);
+				bt_ctf_event_put(event);
+			}
+			bt_ctf_stream_append_discarded_events(streams[k],
+				k + 1);
+			/* The packet context is reset on each flush. */
+			packet_context = bt_ctf_stream_get_packet_context(
+				streams[k]);
+			cpu_id = bt_ctf_field_structure_get_field(
+				packet_context, "cpu_id");
+			ret |= bt_ctf_field_unsigned_integer_set_value(cpu_id,
+				STATS_TEST_CPU_ID + k);
+			bt_ctf_field_put(cpu_id);
+			bt_ctf_field_put(packet_context);
+			ret |= bt_ctf_stream_flush(streams[k]);
+		}
+	}
+	for (k = 0; k < STATS_TEST_STREAMS; k++) {
+		bt_ctf_stream_put(streams[k]);
+		streams[k] = NULL;
+	}
+	bt_ctf_writer_put(writer);
+	writer = NULL;
+	if (ret) {
+		goto end;
+	}
+
+	for (k = 0; k < STATS_TEST_STREAMS; k++) {
+		struct ctf_packet_index *entries = NULL;
+		gchar *name, *path, *index = NULL;
+		gsize len = 0;
+		size_t nr_entries = 0;
+
+		name = g_strdup_printf("stats_stream_%d.idx", k);
+		path = g_build_filename(trace_path, "index", name, NULL);
+		if (g_file_get_contents(path, &index, &len, NULL) &&
+			len >= sizeof(struct ctf_packet_index_file_hdr)) {
+			entries = (struct ctf_packet_index *) (index +
+				sizeof(struct ctf_packet_index_file_hdr));
+			nr_entries = (len -
+				sizeof(struct ctf_packet_index_file_hdr)) /
+				sizeof(*entries);
+		}
+		if (nr_entries != STATS_TEST_PACKETS) {
+			index_ok = 0;
+		}
+		for (i = 0; i < nr_entries; i++) {
+			if (be64toh(entries[i].stream_instance_id) !=
+				STATS_TEST_CPU_ID + k) {
+				index_ok = 0;
+			}
+		}
+		g_free(index);
+		g_free(path);
+		g_free(name);
+	}
+	ok(index_ok, "Packet index entries have the cpu_id of their packet");
+
+	ctx = bt_context_create();
+	if (!ctx || bt_context_add_trace(ctx, trace_path, "ctf", NULL, NULL,
+		NULL) < 0) {
+		ret = -1;
+		goto end;
+	}
+	stats = bt_ctf_stats_create(ctx, BT_CTF_STATS_EVENT_COUNTS, 0);
+	ok(stats && stats->nr_streams == STATS_TEST_STREAMS &&
+		stats->nr_packets == STATS_TEST_STREAMS * STATS_TEST_PACKETS,
+		"Compute the statistics of a trace");
+	if (!stats) {
+		ret = -1;
+		goto end;
+	}
+	for (i = 0; i < stats->nr_streams; i++) {
+		struct bt_ctf_stream_stats *sstats = &stats->streams[i];
+
+		k = sstats->cpu_id - STATS_TEST_CPU_ID;
+		if (k < 0 || k >= STATS_TEST_STREAMS) {
+			cpus_ok = 0;
+			continue;
+		}
+		if (sstats->nr_packets != STATS_TEST_PACKETS ||
+			sstats->events_discarded !=
+			(k + 1) * STATS_TEST_PACKETS ||
+			sstats->timestamp_begin >= sstats->timestamp_end) {
+			streams_ok = 0;
+		}
+	}
+	ok(cpus_ok, "Stream statistics have the cpu_id of the packet index");
+	ok(streams_ok && cpus_ok,
+		"Stream statistics count the packets and discarded events of each stream");
+	ok(stats->nr_event_classes == 1 &&
+		stats->event_classes[0].count == STATS_TEST_PACKETS *
+		STATS_TEST_PACKET_LENGTH * STATS_TEST_STREAMS *
+		(STATS_TEST_STREAMS + 1) / 2,
+		"Count the events of the event classes");
+end:
+	ok(ret == 0, "Statistics test completes");
+	bt_ctf_stats_destroy(stats);
+	if (ctx) {
+		bt_context_put(ctx);
+	}
+	for (k = 0; k < STATS_TEST_STREAMS; k++) {
+		bt_ctf_stream_put(streams[k]);
+	}
+	bt_ctf_field_type_put(packet_context_type);
+	bt_ctf_field_type_put(uint_32_type);
+	bt_ctf_event_class_put(event_class);
+	bt_ctf_stream_class_put(stream_class);
+	bt_ctf_clock_put(clock);
+	bt_ctf_writer_put(writer);
+	remove_trace_dir(trace_path);
+}
+
+/* Timestamp of the i-th event, jumping past a compact header's range */
+static
+uint64_t compact_test_timestamp(int i)
+{
+	uint64_t timestamp = (uint64_t) i * 1000;
+
+	if (i >= COMPACT_TEST_LENGTH / 2 + 10) {
+		timestamp += 1ULL << 30;
+	}
+	return timestamp;
+}
+
+/*
+ * Write COMPACT_TEST_LENGTH events to a stream using compact or default
+ * event headers, optionally compressed. Returns the size of the stream
+ * file, 0 on error.
+ */
+static
+off_t write_compact_test_trace(const char *trace_path, int compact,
+		int compressed)
+{
+	struct bt_ctf_writer *writer = NULL;
+	struct bt_ctf_clock *clock = NULL;
+	struct bt_ctf_stream_class *stream_class = NULL;
+	struct bt_ctf_event_class *event_class = NULL;
+	struct bt_ctf_field_type *uint_32_type = NULL;
+	struct bt_ctf_stream *stream = NULL;
+	gchar *stream_path = NULL;
+	struct stat st;
+	off_t size = 0;
+	int ret = 0, i;
+
+	writer = bt_ctf_writer_create(trace_path);
+	clock = bt_ctf_clock_create("compact_clock");
+	stream_class = bt_ctf_stream_class_create("compact_stream");
+	event_class = bt_ctf_event_class_create("compact_event");
+	uint_32_type = bt_ctf_field_type_integer_create(32);
+	if (!writer || !clock || !stream_class || !event_class ||
+		!uint_32_type) {
+		goto end;
+	}
+	ret |= bt_ctf_writer_add_clock(writer, clock);
+	ret |= bt_ctf_writer_set_compressed(writer, compressed);
+	ret |= bt_ctf_stream_class_set_compact_event_header(stream_class,
+		compact);
+	ret |= bt_ctf_stream_class_set_clock(stream_class, clock);
+	ret |= bt_ctf_event_class_add_field(event_class, uint_32_type, "seq");
+	ret |= bt_ctf_stream_class_add_event_class(stream_class, event_class);
+	if (ret) {
+		goto end;
+	}
+	stream = bt_ctf_writer_create_stream(writer, stream_class);
+	if (!stream) {
+		goto end;
+	}
+	ok(bt_ctf_stream_class_set_compact_event_header(stream_class,
+		!compact) < 0,
+		"The event header can't be changed once the stream class is frozen");
+
+	for (i = 0; i < COMPACT_TEST_LENGTH && !ret; i++) {
+		struct bt_ctf_event *event = bt_ctf_event_create(event_class);
+		struct bt_ctf_field *field;
+
+		if (!event) {
+			ret = -1;
+			break;
+		}
+		field = bt_ctf_event_get_payload(event, "seq");
+		ret |= bt_ctf_field_unsigned_integer_set_value(field, i);
+		bt_ctf_field_put(field);
+		ret |= bt_ctf_clock_set_time(clock, compact_test_timestamp(i));
+		ret |= bt_ctf_stream_append_event(stream, event);
+		bt_ctf_event_put(event);
+		if ((i + 1) % COMPACT_TEST_FLUSH_EVERY == 0) {
+			ret |= bt_ctf_stream_flush(stream);
+		}
+	}
+	ret |= bt_ctf_stream_flush(stream);
+	bt_ctf_stream_put(stream);
+	stream = NULL;
+	bt_ctf_writer_put(writer);
+	writer = NULL;
+
+	stream_path = g_build_filename(trace_path, "compact_stream_0", NULL);
+	if (!ret && !stat(stream_path, &st)) {
+		size = st.st_size;
+	}
+end:
+	g_free(stream_path);
+	bt_ctf_stream_put(stream);
+	bt_ctf_field_type_put(uint_32_type);
+	bt_ctf_event_class_put(event_class);
+	bt_ctf_stream_class_put(stream_class);
+	bt_ctf_clock_put(clock);
+	bt_ctf_writer_put(writer);
+	return size;
+}
+
+/*
+ * Write the same events with compact and default event headers, and
+ * check the compact trace is smaller and reads back the same timestamps.
+ */
+void compact_event_header_test(void)
+{
+	char compact_path[] = "/tmp/ctfwriter_compact_XXXXXX";
+	char default_path[] = "/tmp/ctfwriter_default_XXXXXX";
+	struct bt_context *ctx = NULL;
+	struct bt_ctf_iter *iter = NULL;
+	struct bt_ctf_event *event;
+	struct ctf_packet_index *entries;
+	gchar *index_path = NULL, *index = NULL;
+	gsize len = 0;
+	size_t nr_entries = 0, i;
+	off_t compact_size, default_size;
+	int64_t nr_events = 0;
+	int timestamps_match = 1, contexts_match = 1, entries_match = 1;
+
+	if (!mkdtemp(compact_path) || !mkdtemp(default_path)) {
+		perror("# perror");
+		return;
+	}
+
+	ok(bt_ctf_stream_class_set_compact_event_header(NULL, 1) < 0,
+		"bt_ctf_stream_class_set_compact_event_header handles NULL correctly");
+	compact_size = write_compact_test_trace(compact_path, 1, 0);
+	default_size = write_compact_test_trace(default_path, 0, 0);
+	ok(compact_size && default_size && compact_size < default_size,
+		"Compact event headers make the stream smaller (%jd bytes, %jd with default headers)",
+		(intmax_t) compact_size, (intmax_t) default_size);
+
+	ctx = bt_context_create();
+	if (!ctx || bt_context_add_trace(ctx, compact_path, "ctf", NULL, NULL,
+		NULL) < 0) {
+		goto end;
+	}
+	iter = bt_ctf_iter_create(ctx, NULL, NULL);
+	if (!iter) {
+		goto end;
+	}
+	while ((event = bt_ctf_iter_read_event(iter))) {
+		const struct bt_definition *scope;
+		uint64_t seq, first;
+
+		scope = bt_ctf_get_top_level_scope(event, BT_EVENT_FIELDS);
+		seq = bt_ctf_get_uint64(bt_ctf_get_field(event, scope, "seq"));
+		if (seq != nr_events ||
+			bt_ctf_get_cycles(event) !=
+			compact_test_timestamp(nr_events)) {
+			timestamps_match = 0;
+		}
+		/* First event of the packet */
+		first = seq - seq % COMPACT_TEST_FLUSH_EVERY;
+		scope = bt_ctf_get_top_level_scope(event,
+			BT_STREAM_PACKET_CONTEXT);
+		if (bt_ctf_get_uint64(bt_ctf_get_field(event, scope,
+			"timestamp_begin")) != compact_test_timestamp(first) ||
+			bt_ctf_get_uint64(bt_ctf_get_field(event, scope,
+			"timestamp_end")) != compact_test_timestamp(first +
+			COMPACT_TEST_FLUSH_EVERY - 1)) {
+			contexts_match = 0;
+		}
+		nr_events++;
+		if (bt_iter_next(bt_ctf_get_iter(iter)) < 0) {
+			break;
+		}
+	}
+
+	index_path = g_build_filename(compact_path, "index",
+		"compact_stream_0.idx", NULL);
+	if (g_file_get_contents(index_path, &index, &len, NULL) &&
+		len >= sizeof(struct ctf_packet_index_file_hdr)) {
+		entries = (struct ctf_packet_index *) (index +
+			sizeof(struct ctf_packet_index_file_hdr));
+		nr_entries = (len - sizeof(struct ctf_packet_index_file_hdr)) /
+			sizeof(*entries);
+	}
+	for (i = 0; i < nr_entries; i++) {
+		int first = i * COMPACT_TEST_FLUSH_EVERY;
+
+		if (be64toh(entries[i].timestamp_begin) !=
+			compact_test_timestamp(first) ||
+			be64toh(entries[i].timestamp_end) !=
+			compact_test_timestamp(first +
+			COMPACT_TEST_FLUSH_EVERY - 1)) {
+			entries_match = 0;
+		}
+	}
+end:
+	ok(nr_events == COMPACT_TEST_LENGTH && timestamps_match,
+		"Read back the timestamps of events with compact headers");
+	ok(nr_events == COMPACT_TEST_LENGTH && contexts_match,
+		"Packets of compact headers have the timestamps of their events");
+	ok(nr_entries == COMPACT_TEST_LENGTH / COMPACT_TEST_FLUSH_EVERY &&
+		entries_match,
+		"Packet index entries of compact headers have the timestamps of their events");
+	g_free(index);
+	g_free(index_path);
+	if (iter) {
+		bt_ctf_iter_destroy(iter);
+	}
+	if (ctx) {
+		bt_context_put(ctx);
+	}
+	remove_trace_dir(compact_path);
+	remove_trace_dir(default_path);
+}
+
+/*
+ * Write the compact header test trace with a compressed stream file, and
+ * check that it reads back and seeks as the uncompressed one.
+ */
+void compressed_stream_test(void)
+{
+	char compressed_path[] = "/tmp/ctfwriter_compressed_XXXXXX";
+	char plain_path[] = "/tmp/ctfwriter_plain_XXXXXX";
+	struct bt_context *ctx = NULL;
+	struct bt_ctf_iter *iter = NULL;
+	struct bt_iter_pos *pos = NULL;
+	struct bt_ctf_event *event;
+	const struct bt_definition *scope;
+	off_t compressed_size, plain_size;
+	int64_t nr_events = 0;
+	int64_t seek_seq = COMPACT_TEST_LENGTH * 3 / 4;
+	int events_match = 1;
+	int have_zstd = 0;
+
+	if (!mkdtemp(compressed_path) || !mkdtemp(plain_path)) {
+		perror("# perror");
+		return;
+	}
+
+	ok(bt_ctf_writer_set_compressed(NULL, 1) < 0,
+		"bt_ctf_writer_set_compressed handles NULL correctly");
+#ifdef BABELTRACE_HAVE_LIBZSTD
+	have_zstd = 1;
+#endif
+	skip_start(!have_zstd, 3, "Built without libzstd");
+	compressed_size = write_compact_test_trace(compressed_path, 1, 1);
+	plain_size = write_compact_test_trace(plain_path, 1, 0);
+	ok(compressed_size && plain_size && compressed_size < plain_size,
+		"Compressed stream file is smaller (%jd bytes, %jd uncompressed)",
+		(intmax_t) compressed_size, (intmax_t) plain_size);
+
+	ctx = bt_context_create();
+	if (!ctx || bt_context_add_trace(ctx, compressed_path, "ctf", NULL,
+		NULL, NULL) < 0) {
+		break;
+	}
+	iter = bt_ctf_iter_create(ctx, NULL, NULL);
+	if (!iter) {
+		break;
+	}
+	while ((event = bt_ctf_iter_read_event(iter))) {
+		scope = bt_ctf_get_top_level_scope(event, BT_EVENT_FIELDS);
+		if (bt_ctf_get_uint64(bt_ctf_get_field(event, scope, "seq")) !=
+			nr_events || bt_ctf_get_cycles(event) !=
+			compact_test_timestamp(nr_events)) {
+			events_match = 0;
+		}
+		nr_events++;
+		if (bt_iter_next(bt_ctf_get_iter(iter)) < 0) {
+			break;
+		}
+	}
+	ok(nr_events == COMPACT_TEST_LENGTH && events_match,
+		"Read back the events of a compressed stream");
+
+	event = NULL;
+	pos = bt_iter_create_time_pos(bt_ctf_get_iter(iter),
+		compact_test_timestamp(seek_seq));
+	if (pos && !bt_iter_set_pos(bt_ctf_get_iter(iter), pos)) {
+		event = bt_ctf_iter_read_event(iter);
+	}
+	if (event) {
+		scope = bt_ctf_get_top_level_scope(event, BT_EVENT_FIELDS);
+	}
+	ok(event && bt_ctf_get_uint64(bt_ctf_get_field(event, scope,
+		"seq")) == seek_seq,
+		"Seek to an event in the middle of a compressed stream");
+	skip_end();
+
+	if (pos) {
+		bt_iter_free_pos(pos);
+	}
+	if (iter) {
+		bt_ctf_iter_destroy(iter);
+	}
+	if (ctx) {
+		bt_context_put(ctx);
+	}
+	remove_trace_dir(compressed_path);
+	remove_trace_dir(plain_path);
+}
+
+/*
+ * Write LIMITS_TEST_STREAMS interleaved streams and merge them while
+ * allowing fewer open files and mapped bytes than a single stream needs,
+ * so that streams are parked and reopened all along.
+ */
+void stream_limits_test(void)
+{
+	char trace_path[] = "/tmp/ctfwriter_limits_XXXXXX";
+	struct bt_ctf_writer *writer = NULL;
+	struct bt_ctf_clock *clock = NULL;
+	struct bt_ctf_stream_class *stream_class = NULL;
+	struct bt_ctf_event_class *event_class = NULL;
+	struct bt_ctf_field_type *uint_32_type = NULL;
+	struct bt_ctf_stream *streams[LIMITS_TEST_STREAMS] = { NULL };
+	struct bt_context *ctx = NULL;
+	struct bt_ctf_iter *iter = NULL;
+	struct bt_ctf_event *event;
+	int64_t nr_events = 0;
+	int events_match = 1;
+	int ret = 0, i, j;
+
+	if (!mkdtemp(trace_path)) {
+		perror("# perror");
+		return;
+	}
+
+	writer = bt_ctf_writer_create(trace_path);
+	clock = bt_ctf_clock_create("limits_clock");
+	stream_class = bt_ctf_stream_class_create("limits_stream");
+	event_class = bt_ctf_event_class_create("limits_event");
+	uint_32_type = bt_ctf_field_type_integer_create(32);
+	if (!writer || !clock || !stream_class || !event_class ||
+		!uint_32_type) {
+		ret = -1;
+		goto end;
+	}
+	ret |= bt_ctf_writer_add_clock(writer, clock);
+	ret |= bt_ctf_stream_class_set_clock(stream_class, clock);
+	ret |= bt_ctf_event_class_add_field(event_class, uint_32_type, "seq");
+	ret |= bt_ctf_stream_class_add_event_class(stream_class, event_class);
+	for (j = 0; j < LIMITS_TEST_STREAMS && !ret; j++) {
+		streams[j] = bt_ctf_writer_create_stream(writer, stream_class);
+		if (!streams[j]) {
+			ret = -1;
+		}
+	}
+
+	/* Event "seq" of stream "seq % LIMITS_TEST_STREAMS" at time "seq" */
+	for (i = 0; i < LIMITS_TEST_LENGTH && !ret; i++) {
+		for (j = 0; j < LIMITS_TEST_STREAMS && !ret; j++) {
+			struct bt_ctf_event *new_event;
+			struct bt_ctf_field *field;
+			uint64_t seq = i * LIMITS_TEST_STREAMS + j;
+
+			new_event = bt_ctf_event_create(event_class);
+			if (!new_event) {
+				ret = -1;
+				break;
+			}
+			field = bt_ctf_event_get_payload(new_event, "seq");
+			ret |= bt_ctf_field_unsigned_integer_set_value(field,
+				seq);
+			bt_ctf_field_put(field);
+			ret |= bt_ctf_clock_set_time(clock, seq);
+			ret |= bt_ctf_stream_append_event(streams[j],
+				new_event);
+			bt_ctf_event_put(new_event);
+			if ((i + 1) % LIMITS_TEST_FLUSH_EVERY == 0) {
+				ret |= bt_ctf_stream_flush(streams[j]);
+			}
+		}
+	}
+	for (j = 0; j < LIMITS_TEST_STREAMS; j++) {
+		bt_ctf_stream_put(streams[j]);
+		streams[j] = NULL;
+	}
+	bt_ctf_writer_put(writer);
+	writer = NULL;
+	if (ret) {
+		goto end;
+	}
+
+	bt_ctf_set_stream_limits(2, 1);
+	ctx = bt_context_create();
+	if (!ctx || bt_context_add_trace(ctx, trace_path, "ctf", NULL, NULL,
+		NULL) < 0) {
+		goto end;
+	}
+	iter = bt_ctf_iter_create(ctx, NULL, NULL);
+	if (!iter) {
+		goto end;
+	}
+	while ((event = bt_ctf_iter_read_event(iter))) {
+		const struct bt_definition *scope;
+
+		scope = bt_ctf_get_top_level_scope(event, BT_EVENT_FIELDS);
+		if (bt_ctf_get_uint64(bt_ctf_get_field(event, scope, "seq")) !=
+			nr_events || bt_ctf_get_cycles(event) != nr_events) {
+			events_match = 0;
+		}
+		nr_events++;
+		if (bt_iter_next(bt_ctf_get_iter(iter)) < 0) {
+			break;
+		}
+	}
+end:
+	ok(!ret, "Write the resource limits test trace");
+	ok(nr_events == LIMITS_TEST_STREAMS * LIMITS_TEST_LENGTH,
+		"Read every event of streams parked to stay within resource limits");
+	ok(nr_events && events_match,
+		"Merge the events of parked and reopened streams in order");
+	if (iter) {
+		bt_ctf_iter_destroy(iter);
+	}
+	if (ctx) {
+		bt_context_put(ctx);
+	}
+	bt_ctf_set_stream_limits(0, 0);
+	for (j = 0; j < LIMITS_TEST_STREAMS; j++) {
+		bt_ctf_stream_put(streams[j]);
+	}
+	bt_ctf_field_type_put(uint_32_type);
+	bt_ctf_event_class_put(event_class);
+	bt_ctf_stream_class_put(stream_class);
+	bt_ctf_clock_put(clock);
+	bt_ctf_writer_put(writer);
+	remove_trace_dir(trace_path);
+}
+
+/*
+ * Seek to the last event of the compact header test trace, twice to go
+ * through the cached last event position.
+ */
+void seek_last_test(void)
+{
+	char trace_path[] = "/tmp/ctfwriter_seek_last_XXXXXX";
+	struct bt_context *ctx = NULL;
+	struct bt_ctf_iter *iter = NULL;
+	struct bt_iter_pos pos = { .type = BT_SEEK_LAST };
+	struct bt_ctf_event *event;
+	int64_t last_seq = COMPACT_TEST_LENGTH - 1;
+	int i, nr_found = 0;
+
+	if (!mkdtemp(trace_path)) {
+		perror("# perror");
+		return;
+	}
+	if (!write_compact_test_trace(trace_path, 1, 0)) {
+		goto end;
+	}
+	ctx = bt_context_create();
+	if (!ctx || bt_context_add_trace(ctx, trace_path, "ctf", NULL, NULL,
+		NULL) < 0) {
+		goto end;
+	}
+	iter = bt_ctf_iter_create(ctx, NULL, NULL);
+	if (!iter) {
+		goto end;
+	}
+	for (i = 0; i < 2; i++) {
+		const struct bt_definition *scope;
+
+		if (bt_iter_set_pos(bt_ctf_get_iter(iter), &pos)) {
+			break;
+		}
+		event = bt_ctf_iter_read_event(iter);
+		if (!event) {
+			break;
+		}
+		scope = bt_ctf_get_top_level_scope(event, BT_EVENT_FIELDS);
+		if (bt_ctf_get_uint64(bt_ctf_get_field(event, scope, "seq")) ==
+			last_seq && bt_ctf_get_cycles(event) ==
+			compact_test_timestamp(last_seq)) {
+			nr_found++;
+		}
+	}
+end:
+	ok(nr_found == 2, "Seek to the last event of a trace");
+	if (iter) {
+		bt_ctf_iter_destroy(iter);
+	}
+	if (ctx) {
+		bt_context_put(ctx);
+	}
+	remove_trace_dir(trace_path);
+}
+
+void trace_timestamps_test(void)
+{
+	char trace_path[] = "/tmp/ctfwriter_timestamps_XXXXXX";
+	struct bt_context *ctx = NULL;
+	int handle_id = -1;
+	uint64_t begin = compact_test_timestamp(0);
+	uint64_t end = compact_test_timestamp(COMPACT_TEST_LENGTH - 1);
+
+	if (!mkdtemp(trace_path)) {
+		perror("# perror");
+		return;
+	}
+	if (!write_compact_test_trace(trace_path, 0, 0)) {
+		goto end;
+	}
+	ctx = bt_context_create();
+	if (!ctx) {
+		goto end;
+	}
+	handle_id = bt_context_add_trace(ctx, trace_path, "ctf", NULL, NULL,
+		NULL);
+end:
+	ok(handle_id >= 0 &&
+		bt_trace_handle_get_timestamp_begin(ctx, handle_id,
+			BT_CLOCK_CYCLES) == begin &&
+		bt_trace_handle_get_timestamp_end(ctx, handle_id,
+			BT_CLOCK_CYCLES) == end,
+		"Trace handle timestamps span the packets of the trace");
+	ok(handle_id >= 0 &&
+		bt_context_get_timestamp_begin(ctx, BT_CLOCK_CYCLES) == begin &&
+		bt_context_get_timestamp_end(ctx, BT_CLOCK_CYCLES) == end &&
+		bt_context_get_timestamp_begin(ctx, BT_CLOCK_REAL) ==
+			bt_trace_handle_get_timestamp_begin(ctx, handle_id,
+				BT_CLOCK_REAL),
+		"Context timestamps span the packets of its traces");
+	ok(handle_id >= 0 && !bt_context_remove_trace(ctx, handle_id) &&
+		bt_context_get_timestamp_begin(ctx, BT_CLOCK_CYCLES) == -1ULL &&
+		bt_context_get_timestamp_end(ctx, BT_CLOCK_CYCLES) == 0,
+		"Context timestamps are updated when a trace is removed");
+	if (ctx) {
+		bt_context_put(ctx);
+	}
+	remove_trace_dir(trace_path);
+}
+
+/*
+ * Sum the counts of the event rate index of a trace over its whole
+ * range, optionally expecting the index to be loaded from its file.
+ */
+static
+int count_indexed_events(const char *trace_path, unsigned int nr_buckets,
+		uint64_t *total, int expect_saved)
+{
+	struct bt_context *ctx;
+	struct bt_ctf_iter *iter = NULL;
+	uint64_t counts[16];
+	uint64_t begin, end;
+	unsigned int i;
+	int ret = -1;
+
+	assert(nr_buckets <= 16);
+	ctx = bt_context_create();
+	if (!ctx || bt_context_add_trace(ctx, trace_path, "ctf", NULL, NULL,
+		NULL) < 0) {
+		goto end;
+	}
+	if (bt_ctf_event_rate_query(ctx, 0, 1, 1, counts) != -ENOENT) {
+		goto end;
+	}
+	/* A saved index is loaded even while an iterator exists. */
+	if (expect_saved) {
+		iter = bt_ctf_iter_create(ctx, NULL, NULL);
+		if (!iter) {
+			goto end;
+		}
+	}
+	if (bt_ctf_event_rate_index(ctx, 1000,
+		expect_saved ? 0 : BT_CTF_EVENT_RATE_SAVE)) {
+		goto end;
+	}
+	begin = bt_context_get_timestamp_begin(ctx, BT_CLOCK_REAL);
+	end = bt_context_get_timestamp_end(ctx, BT_CLOCK_REAL) + 1;
+	if (bt_ctf_event_rate_query(ctx, begin, end, nr_buckets, counts)) {
+		goto end;
+	}
+	*total = 0;
+	for (i = 0; i < nr_buckets; i++) {
+		*total += counts[i];
+	}
+	ret = 0;
+end:
+	if (iter) {
+		bt_ctf_iter_destroy(iter);
+	}
+	if (ctx) {
+		bt_context_put(ctx);
+	}
+	return ret;
+}
+
+void event_rate_test(void)
+{
+	char trace_path[] = "/tmp/ctfwriter_event_rate_XXXXXX";
+	uint64_t total = 0, saved_total = 0, coarse_total = 0;
+	int ret = -1;
+
+	if (!mkdtemp(trace_path)) {
+		perror("# perror");
+		return;
+	}
+	if (!write_compact_test_trace(trace_path, 0, 0)) {
+		goto end;
+	}
+	ret = count_indexed_events(trace_path, 16, &total, 0);
+	if (!ret) {
+		ret = count_indexed_events(trace_path, 16, &saved_total, 1);
+	}
+	if (!ret) {
+		ret = count_indexed_events(trace_path, 1, &coarse_total, 1);
+	}
+end:
+	ok(!ret && total == COMPACT_TEST_LENGTH,
+		"Event rate index counts every event of the trace");
+	ok(!ret && saved_total == total && coarse_total == total,
+		"Event rate index is loaded from its file at any resolution");
+	remove_trace_dir(trace_path);
+}
+
+void readahead_test(void)
+{
+	char trace_path[] = "/tmp/ctfwriter_readahead_XXXXXX";
+	int64_t nr_events = -1, nr_events_ahead = -1;
+
+	if (!mkdtemp(trace_path)) {
+		perror("# perror");
+		return;
+	}
+	if (write_compact_test_trace(trace_path, 0, 0)) {
+		bt_ctf_set_readahead(0);
+		nr_events = count_trace_events(trace_path);
+		/* Deeper than the number of packets of the stream */
+		bt_ctf_set_readahead(COMPACT_TEST_LENGTH);
+		nr_events_ahead = count_trace_events(trace_path);
+		bt_ctf_set_readahead(2);
+	}
+	ok(nr_events == COMPACT_TEST_LENGTH &&
+		nr_events_ahead == COMPACT_TEST_LENGTH,
+		"Read a trace with and without packets read ahead");
+	remove_trace_dir(trace_path);
+}
+
+void packet_io_test(void)
+{
+	char trace_path[] = "/tmp/ctfwriter_packet_io_XXXXXX";
+	enum bt_ctf_packet_io uring_io = BT_CTF_PACKET_IO_MMAP;
+	int64_t nr_events_read = -1, nr_events_uring = -1;
+
+	if (!mkdtemp(trace_path)) {
+		perror("# perror");
+		return;
+	}
+	if (write_compact_test_trace(trace_path, 0, 0)) {
+		bt_ctf_set_packet_io(BT_CTF_PACKET_IO_READ);
+		nr_events_read = count_trace_events(trace_path);
+		uring_io = bt_ctf_set_packet_io(BT_CTF_PACKET_IO_URING);
+		nr_events_uring = count_trace_events(trace_path);
+		bt_ctf_set_packet_io(BT_CTF_PACKET_IO_MMAP);
+	}
+	ok(nr_events_read == COMPACT_TEST_LENGTH,
+		"Read a trace with packets read in buffers");
+	ok((uring_io == BT_CTF_PACKET_IO_URING ||
+		uring_io == BT_CTF_PACKET_IO_READ) &&
+		nr_events_uring == COMPACT_TEST_LENGTH,
+		"Read a trace with io_uring, or its pread fallback");
+	remove_trace_dir(trace_path);
+}
+
+static
+void release_packet(const void *data, size_t len, void *priv)
+{
+	unsigned int *nr_released = priv;
+
+	g_free((void *) data);
+	(*nr_released)++;
+}
+
+/*
+ * Read the events of a packet stream up to the last packet pushed.
+ * Returns the number of events read, setting "more" if more events may
+ * come, or -1 if the events are not in order.
+ */
+static
+int64_t read_pushed_events(struct bt_ctf_iter *iter, int64_t first,
+		int *more)
+{
+	struct bt_ctf_event *event;
+	const struct bt_definition *scope;
+	int64_t nr_events = 0;
+	int flags;
+
+	while ((event = bt_ctf_iter_read_event_flags(iter, &flags))) {
+		scope = bt_ctf_get_top_level_scope(event, BT_EVENT_FIELDS);
+		if (bt_ctf_get_uint64(bt_ctf_get_field(event, scope, "seq")) !=
+			first + nr_events) {
+			return -1;
+		}
+		nr_events++;
+		if (bt_iter_next(bt_ctf_get_iter(iter)) < 0) {
+			return -1;
+		}
+	}
+	*more = !!(flags & BT_ITER_FLAG_RETRY);
+	return nr_events;
+}
+
+/*
+ * Push the packets of a trace to a packet stream in two steps, one packet
+ * per buffer and then all the remaining packets in a single buffer, and
+ * read them as they are pushed.
+ */
+void packet_stream_test(void)
+{
+	char trace_path[] = "/tmp/ctfwriter_packet_stream_XXXXXX";
+	struct bt_ctf_packet_stream *packet_stream = NULL;
+	struct bt_mmap_stream_list mmap_list;
+	struct bt_context *ctx = NULL;
+	struct bt_ctf_iter *iter = NULL;
+	struct ctf_packet_index *entries;
+	gchar *path = NULL, *index = NULL, *data = NULL;
+	FILE *metadata_fp = NULL;
+	gsize index_len = 0, len = 0;
+	size_t nr_packets, half, i;
+	off_t half_offset;
+	unsigned int nr_released = 0;
+	int64_t nr_first = -1, nr_last = -1;
+	int ret = 0, more_first = 0, more_last = 1;
+
+	if (!mkdtemp(trace_path)) {
+		perror("# perror");
+		return;
+	}
+	if (!write_compact_test_trace(trace_path, 0, 0)) {
+		ret = -1;
+		goto end;
+	}
+	path = g_build_filename(trace_path, "compact_stream_0", NULL);
+	if (!g_file_get_contents(path, &data, &len, NULL)) {
+		ret = -1;
+		goto end;
+	}
+	g_free(path);
+	path = g_build_filename(trace_path, "index", "compact_stream_0.idx",
+		NULL);
+	if (!g_file_get_contents(path, &index, &index_len, NULL) ||
+		index_len <= sizeof(struct ctf_packet_index_file_hdr)) {
+		ret = -1;
+		goto end;
+	}
+	entries = (struct ctf_packet_index *) (index +
+		sizeof(struct ctf_packet_index_file_hdr));
+	nr_packets = (index_len - sizeof(struct ctf_packet_index_file_hdr)) /
+		sizeof(*entries);
+	half = nr_packets / 2;
+	half_offset = be64toh(entries[half].offset);
+	g_free(path);
+	path = g_build_filename(trace_path, "metadata", NULL);
+	metadata_fp = fopen(path, "r");
+	if (!metadata_fp) {
+		ret = -1;
+		goto end;
+	}
+
+	/* Buffers which are not mapped files, released with g_free(). */
+	packet_stream = bt_ctf_packet_stream_create();
+	for (i = 0; i < half && !ret; i++) {
+		off_t offset = be64toh(entries[i].offset);
+		size_t size = be64toh(entries[i].packet_size) / CHAR_BIT;
+
+		ret = bt_ctf_packet_stream_push(packet_stream,
+			g_memdup(data + offset, size), size, release_packet,
+			&nr_released);
+	}
+	if (ret) {
+		goto end;
+	}
+	BT_INIT_LIST_HEAD(&mmap_list.head);
+	bt_list_add(&bt_ctf_packet_stream_mmap_stream(packet_stream)->list,
+		&mmap_list.head);
+	ctx = bt_context_create();
+	if (!ctx || bt_context_add_trace(ctx, NULL, "ctf", NULL, &mmap_list,
+		metadata_fp) < 0) {
+		ret = -1;
+		goto end;
+	}
+	iter = bt_ctf_iter_create(ctx, NULL, NULL);
+	if (!iter) {
+		ret = -1;
+		goto end;
+	}
+
+	nr_first = read_pushed_events(iter, 0, &more_first);
+	ok(nr_first == half * COMPACT_TEST_FLUSH_EVERY && more_first &&
+		nr_released == half,
+		"Read the packets pushed so far, then wait for more");
+
+	ret = bt_ctf_packet_stream_push(packet_stream,
+		g_memdup(data + half_offset, len - half_offset),
+		len - half_offset, release_packet, &nr_released);
+	bt_ctf_packet_stream_close(packet_stream);
+	if (!ret) {
+		/* Retry the stream waiting for packets. */
+		bt_iter_next(bt_ctf_get_iter(iter));
+		nr_last = read_pushed_events(iter, nr_first, &more_last);
+	}
+	ok(nr_first + nr_last == COMPACT_TEST_LENGTH && !more_last &&
+		nr_released == half + 1,
+		"Read the packets pushed while reading, up to the end of the stream");
+	ok(bt_ctf_packet_stream_push(packet_stream, data, len, NULL,
+		NULL) == -EINVAL, "Packets can't be pushed to a closed stream");
+end:
+	ok(ret == 0, "Packet stream test completes");
+	if (iter) {
+		bt_ctf_iter_destroy(iter);
+	}
+	if (ctx) {
+		bt_context_put(ctx);
+	}
+	bt_ctf_packet_stream_destroy(packet_stream);
+	if (metadata_fp) {
+		fclose(metadata_fp);
+	}
+	g_free(data);
+	g_free(index);
+	g_free(path);
+	remove_trace_dir(trace_path);
+}
+
+/*
+ * Write INDEX_TEST_PACKETS packets of "common" events, one of which also
+ * holds FILTER_TEST_RARE_LENGTH "rare" events. Returns 0 on success.
+ */
+static
+int write_filter_test_trace(const char *trace_path)
+{
+	struct bt_ctf_writer *writer = NULL;
+	struct bt_ctf_clock *clock = NULL;
+	struct bt_ctf_stream_class *stream_class = NULL;
+	struct bt_ctf_event_class *common_class = NULL, *rare_class = NULL;
+	struct bt_ctf_field_type *uint_32_type = NULL;
+	struct bt_ctf_stream *stream = NULL;
+	uint64_t timestamp = 0;
+	int ret = -1, i, j;
+
+	writer = bt_ctf_writer_create(trace_path);
+	clock = bt_ctf_clock_create("filter_clock");
+	stream_class = bt_ctf_stream_class_create("filter_stream");
+	common_class = bt_ctf_event_class_create("common");
+	rare_class = bt_ctf_event_class_create("rare");
+	uint_32_type = bt_ctf_field_type_integer_create(32);
+	if (!writer || !clock || !stream_class || !common_class ||
+		!rare_class || !uint_32_type) {
+		goto end;
+	}
+	ret = bt_ctf_writer_add_clock(writer, clock);
+	ret |= bt_ctf_stream_class_set_clock(stream_class, clock);
+	ret |= bt_ctf_event_class_add_field(common_class, uint_32_type, "seq");
+	ret |= bt_ctf_event_class_add_field(rare_class, uint_32_type, "seq");
+	ret |= bt_ctf_stream_class_add_event_class(stream_class, common_class);
+	ret |= bt_ctf_stream_class_add_event_class(stream_class, rare_class);
+	if (ret) {
+		goto end;
+	}
+	stream = bt_ctf_writer_create_stream(writer, stream_class);
+	if (!stream) {
+		ret = -1;
+		goto end;
+	}
+
+	for (i = 0; i < INDEX_TEST_PACKETS && !ret; i++) {
+		for (j = 0; j < INDEX_TEST_PACKET_LENGTH && !ret; j++) {
+			struct bt_ctf_event *event;
+			struct bt_ctf_field *field;
+			int rare = i == FILTER_TEST_RARE_PACKET &&
+				j < FILTER_TEST_RARE_LENGTH;
+
+			event = bt_ctf_event_create(rare ? rare_class :
+				common_class);
+			if (!event) {
+				ret = -1;
+				break;
+			}
+			field = bt_ctf_event_get_payload(event, "seq");
+			ret |= bt_ctf_field_unsigned_integer_set_value(field, j);
+			bt_ctf_field_put(field);
+			ret |= bt_ctf_clock_set_time(clock, timestamp++);
+			ret |= bt_ctf_stream_append_event(stream, event);
+			bt_ctf_event_put(event);
+		}
+		ret |= bt_ctf_stream_flush(stream);
+	}
+end:
+	bt_ctf_stream_put(stream);
+	bt_ctf_field_type_put(uint_32_type);
+	bt_ctf_event_class_put(rare_class);
+	bt_ctf_event_class_put(common_class);
+	bt_ctf_stream_class_put(stream_class);
+	bt_ctf_clock_put(clock);
+	bt_ctf_writer_put(writer);
+	return ret;
+}
+
+/*
+ * Count the events read by an iterator from its beginning, -1 if one is
+ * not named "name" (NULL to accept any).
+ */
+static
+int64_t count_filtered_events(struct bt_ctf_iter *iter, const char *name)
+{
+	struct bt_ctf_event *event;
+	int64_t count = 0;
+
+	while ((event = bt_ctf_iter_read_event(iter))) {
+		if (name && strcmp(bt_ctf_event_name(event), name)) {
+			return -1;
+		}
+		count++;
+		if (bt_iter_next(bt_ctf_get_iter(iter)) < 0) {
+			return -1;
+		}
+	}
+	return count;
+}
+
+/*
+ * Overwrite the packets of the filter test trace which hold no "rare"
+ * event, except the first one which is read when the iterator is
+ * created. Reading them afterwards fails. Returns 0 on success.
+ */
+static
+int corrupt_filter_test_trace(const char *trace_path)
+{
+	struct ctf_packet_index *entries;
+	gchar *path = NULL, *index = NULL, *garbage = NULL;
+	gsize index_len = 0;
+	size_t nr_packets, i;
+	int fd = -1, ret = -1;
+
+	path = g_build_filename(trace_path, "index", "filter_stream_0.idx",
+		NULL);
+	if (!g_file_get_contents(path, &index, &index_len, NULL) ||
+		index_len <= sizeof(struct ctf_packet_index_file_hdr)) {
+		goto end;
+	}
+	entries = (struct ctf_packet_index *) (index +
+		sizeof(struct ctf_packet_index_file_hdr));
+	nr_packets = (index_len - sizeof(struct ctf_packet_index_file_hdr)) /
+		sizeof(*entries);
+	if (nr_packets != INDEX_TEST_PACKETS) {
+		goto end;
+	}
+	g_free(path);
+	path = g_build_filename(trace_path, "filter_stream_0", NULL);
+	fd = open(path, O_WRONLY);
+	if (fd < 0) {
+		goto end;
+	}
+	for (i = 1; i < nr_packets; i++) {
+		off_t offset = be64toh(entries[i].offset);
+		size_t size = be64toh(entries[i].packet_size) / CHAR_BIT;
+
+		if (i == FILTER_TEST_RARE_PACKET) {
+			continue;
+		}
+		garbage = g_realloc(garbage, size);
+		memset(garbage, 0xff, size);
+		if (pwrite(fd, garbage, size, offset) != size) {
+			goto end;
+		}
+	}
+	ret = 0;
+end:
+	if (fd >= 0) {
+		close(fd);
+	}
+	g_free(garbage);
+	g_free(index);
+	g_free(path);
+	return ret;
+}
+
+void event_filter_test(void)
+{
+	char trace_path[] = "/tmp/ctfwriter_filter_XXXXXX";
+	const char *rare = "rare";
+	struct bt_context *ctx = NULL;
+	struct bt_ctf_iter *iter = NULL;
+	int64_t nr_rare = -1, nr_all = -1, nr_loaded = -1;
+	int64_t nr_corrupted = INDEX_TEST_PACKETS * INDEX_TEST_PACKET_LENGTH;
+	gchar *ids_path = NULL;
+	struct stat st;
+
+	if (!mkdtemp(trace_path)) {
+		perror("# perror");
+		return;
+	}
+	if (write_filter_test_trace(trace_path)) {
+		goto end;
+	}
+	ctx = bt_context_create();
+	if (!ctx || bt_context_add_trace(ctx, trace_path, "ctf", NULL, NULL,
+		NULL) < 0 ||
+		bt_ctf_event_id_index(ctx, BT_CTF_EVENT_ID_INDEX_SAVE)) {
+		goto end;
+	}
+	iter = bt_ctf_iter_create(ctx, NULL, NULL);
+	if (!iter || bt_ctf_iter_set_event_filter(iter, &rare, 1)) {
+		goto end;
+	}
+	nr_rare = count_filtered_events(iter, rare);
+	if (bt_ctf_iter_set_event_filter(iter, NULL, 0)) {
+		goto end;
+	}
+	nr_all = count_filtered_events(iter, NULL);
+	bt_ctf_iter_destroy(iter);
+	iter = NULL;
+	bt_context_put(ctx);
+	ctx = NULL;
+
+	/*
+	 * The saved index is loaded, even while an iterator exists. Packets
+	 * without "rare" events are made unreadable: the filter must skip
+	 * them without mapping them.
+	 */
+	if (corrupt_filter_test_trace(trace_path)) {
+		goto end;
+	}
+	ctx = bt_context_create();
+	if (!ctx || bt_context_add_trace(ctx, trace_path, "ctf", NULL, NULL,
+		NULL) < 0) {
+		goto end;
+	}
+	iter = bt_ctf_iter_create(ctx, NULL, NULL);
+	if (!iter || bt_ctf_event_id_index(ctx, 0) ||
+		bt_ctf_iter_set_event_filter(iter, &rare, 1)) {
+		goto end;
+	}
+	nr_loaded = count_filtered_events(iter, rare);
+	if (bt_ctf_iter_set_event_filter(iter, NULL, 0)) {
+		goto end;
+	}
+	nr_corrupted = count_filtered_events(iter, NULL);
+end:
+	ids_path = g_build_filename(trace_path, "index",
+		"filter_stream_0.ids", NULL);
+	ok(!stat(ids_path, &st) && S_ISREG(st.st_mode),
+		"Event id index is saved next to the packet index");
+	ok(nr_rare == FILTER_TEST_RARE_LENGTH,
+		"Event filter reads only the requested events");
+	ok(nr_all == INDEX_TEST_PACKETS * INDEX_TEST_PACKET_LENGTH,
+		"Removing the event filter reads all the events again");
+	ok(nr_loaded == FILTER_TEST_RARE_LENGTH,
+		"Event filter skips the packets without its events unmapped");
+	ok(nr_corrupted != INDEX_TEST_PACKETS * INDEX_TEST_PACKET_LENGTH,
+		"Packets skipped by the event filter are unreadable");
+	g_free(ids_path);
+	if (iter) {
+		bt_ctf_iter_destroy(iter);
+	}
+	if (ctx) {
+		bt_context_put(ctx);
+	}
+	remove_trace_dir(trace_path);
+}
+
+void event_snapshot_test(void)
+{
+	char trace_path[] = "/tmp/ctfwriter_snapshot_XXXXXX";
+	const struct bt_ctf_event_snapshot *snapshots[COMPACT_TEST_LENGTH];
+	struct bt_ctf_snapshot_arena *arena = NULL;
+	struct bt_context *ctx = NULL;
+	struct bt_ctf_iter *iter = NULL;
+	struct bt_ctf_event *event;
+	int nr_snapshots = 0, snapshots_match = 1;
+	int i;
+
+	if (!mkdtemp(trace_path)) {
+		perror("# perror");
+		return;
+	}
+	if (!write_compact_test_trace(trace_path, 1, 0)) {
+		goto end;
+	}
+	ctx = bt_context_create();
+	if (!ctx || bt_context_add_trace(ctx, trace_path, "ctf", NULL, NULL,
+		NULL) < 0) {
+		goto end;
+	}
+	iter = bt_ctf_iter_create(ctx, NULL, NULL);
+	arena = bt_ctf_snapshot_arena_create();
+	if (!iter || !arena) {
+		goto end;
+	}
+	while ((event = bt_ctf_iter_read_event(iter)) &&
+		nr_snapshots < COMPACT_TEST_LENGTH) {
+		snapshots[nr_snapshots] = bt_ctf_event_snapshot_create(arena,
+			event);
+		if (!snapshots[nr_snapshots]) {
+			break;
+		}
+		nr_snapshots++;
+		if (bt_iter_next(bt_ctf_get_iter(iter)) < 0) {
+			break;
+		}
+	}
+	bt_ctf_iter_destroy(iter);
+	iter = NULL;
+
+	/* The snapshots outlive the iterator. */
+	for (i = 0; i < nr_snapshots; i++) {
+		const struct bt_ctf_snapshot_field *seq;
+
+		seq = bt_ctf_event_snapshot_get_field(snapshots[i], "seq");
+		if (!seq || seq->type != CTF_TYPE_INTEGER ||
+			seq->u._unsigned != i ||
+			bt_ctf_event_snapshot_get_field_index(snapshots[i],
+				BT_EVENT_FIELDS, 0) != seq ||
+			bt_ctf_event_snapshot_get_cycles(snapshots[i]) !=
+				compact_test_timestamp(i) ||
+			strcmp(bt_ctf_event_snapshot_name(snapshots[i]),
+				"compact_event")) {
+			snapshots_match = 0;
+		}
+	}
+end:
+	ok(nr_snapshots == COMPACT_TEST_LENGTH && snapshots_match,
+		"Event snapshots keep the fields of all the events of a trace");
+	ok(!bt_ctf_event_snapshot_get_field(nr_snapshots ? snapshots[0] : NULL,
+		"no_such_field"),
+		"bt_ctf_event_snapshot_get_field returns NULL for an unknown field");
+	bt_ctf_snapshot_arena_reset(arena);
+	ok(arena && !bt_ctf_snapshot_arena_get_size(arena),
+		"Resetting a snapshot arena frees its snapshots");
+	bt_ctf_snapshot_arena_destroy(arena);
+	if (iter) {
+		bt_ctf_iter_destroy(iter);
+	}
+	if (ctx) {
+		bt_context_put(ctx);
+	}
+	remove_trace_dir(trace_path);
+}
+
+struct iterator_reader {
+	pthread_t thread;
+	struct bt_ctf_iter *iter;
+	int64_t first_seq;
+	int64_t nr_events;
+	int events_match;
+};
+
+static
+void *iterator_read(void *data)
+{
+	struct iterator_reader *reader = data;
+	struct bt_iter *iter = bt_ctf_get_iter(reader->iter);
+	struct bt_iter_pos *pos;
+	struct bt_ctf_event *event;
+
+	pos = bt_iter_create_time_pos(iter,
+		compact_test_timestamp(reader->first_seq));
+	if (!pos || bt_iter_set_pos(iter, pos)) {
+		reader->events_match = 0;
+		goto end;
+	}
+	while ((event = bt_ctf_iter_read_event(reader->iter))) {
+		const struct bt_definition *scope;
+		int64_t seq = reader->first_seq + reader->nr_events;
+
+		scope = bt_ctf_get_top_level_scope(event, BT_EVENT_FIELDS);
+		if (bt_ctf_get_uint64(bt_ctf_get_field(event, scope, "seq")) !=
+			seq || bt_ctf_get_cycles(event) !=
+			compact_test_timestamp(seq)) {
+			reader->events_match = 0;
+		}
+		reader->nr_events++;
+		if (bt_iter_next(iter) < 0) {
+			break;
+		}
+	}
+end:
+	if (pos) {
+		bt_iter_free_pos(pos);
+	}
+	return NULL;
+}
+
+/*
+ * Create ITERATORS_TEST_COUNT iterators on the same context, each one
+ * starting further in the trace, and read them all at once from
+ * different threads.
+ */
+void multiple_iterators_test(void)
+{
+	char trace_path[] = "/tmp/ctfwriter_iterators_XXXXXX";
+	struct iterator_reader readers[ITERATORS_TEST_COUNT] = { { 0 } };
+	struct bt_context *ctx = NULL;
+	int created = 0, started = 0, all_match = 1;
+	int i;
+
+	if (!mkdtemp(trace_path)) {
+		perror("# perror");
+		return;
+	}
+	if (!write_compact_test_trace(trace_path, 0, 0)) {
+		goto end;
+	}
+	ctx = bt_context_create();
+	if (!ctx || bt_context_add_trace(ctx, trace_path, "ctf", NULL, NULL,
+		NULL) < 0) {
+		goto end;
+	}
+	for (i = 0; i < ITERATORS_TEST_COUNT; i++) {
+		readers[i].iter = bt_ctf_iter_create(ctx, NULL, NULL);
+		if (!readers[i].iter) {
+			break;
+		}
+		readers[i].first_seq = i * COMPACT_TEST_LENGTH /
+			ITERATORS_TEST_COUNT;
+		readers[i].events_match = 1;
+		created++;
+	}
+	ok(created == ITERATORS_TEST_COUNT,
+		"Create %d iterators on the same context", ITERATORS_TEST_COUNT);
+
+	for (i = 0; i < created; i++) {
+		if (pthread_create(&readers[i].thread, NULL, iterator_read,
+			&readers[i])) {
+			break;
+		}
+		started++;
+	}
+	for (i = 0; i < started; i++) {
+		pthread_join(readers[i].thread, NULL);
+		if (!readers[i].events_match || readers[i].nr_events !=
+			COMPACT_TEST_LENGTH - readers[i].first_seq) {
+			all_match = 0;
+		}
+	}
+end:
+	ok(started == ITERATORS_TEST_COUNT && all_match,
+		"Read the same trace concurrently with one iterator per thread");
+	for (i = 0; i < ITERATORS_TEST_COUNT; i++) {
+		if (readers[i].iter) {
+			bt_ctf_iter_destroy(readers[i].iter);
+		}
+	}
+	if (ctx) {
+		bt_context_put(ctx);
+	}
+	remove_trace_dir(trace_path);
+}
+
+/* Value of element "i" of the integer array test fields of "len" bits */
+static
+uint64_t int_array_test_value(unsigned int len, uint64_t i)
+{
+	uint64_t value = 0x0123456789ABCDEFULL * (i + 1) + len;
+
+	return len == 64 ? value : value & ((1ULL << len) - 1);
+}
+
+/*
+ * Check the elements of an integer array or sequence field, both as
+ * contiguous values and through their definitions.
+ */
+static
+int int_array_test_check(const struct bt_ctf_event *event,
+		const struct bt_definition *field, unsigned int len,
+		uint64_t nr_elems)
+{
+	struct bt_definition const * const *list;
+	unsigned int count;
+	const void *values;
+	uint64_t nr_values = 0, i, value;
+	size_t elem_len = 0;
+
+	values = bt_ctf_get_int_array(field, &nr_values, &elem_len);
+	if (!values || nr_values != nr_elems || elem_len != len) {
+		return 0;
+	}
+	if (bt_ctf_get_field_list(event, field, &list, &count) ||
+		count != nr_elems) {
+		return 0;
+	}
+	for (i = 0; i < nr_elems; i++) {
+		switch (len) {
+		case 8:
+			value = ((const uint8_t *) values)[i];
+			break;
+		case 16:
+			value = ((const uint16_t *) values)[i];
+			break;
+		case 32:
+			value = ((const uint32_t *) values)[i];
+			break;
+		default:
+			value = ((const uint64_t *) values)[i];
+			break;
+		}
+		if (value != int_array_test_value(len, i) ||
+			bt_ctf_get_uint64(list[i]) != value) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*
+ * Write byte-aligned integer arrays of every width in both byte orders,
+ * and a sequence, and read them back as contiguous values.
+ */
+void int_array_test(void)
+{
+	static const unsigned int lens[] = { 8, 16, 32, 64 };
+	static const enum bt_ctf_byte_order byte_orders[] = {
+		BT_CTF_BYTE_ORDER_LITTLE_ENDIAN,
+		BT_CTF_BYTE_ORDER_BIG_ENDIAN,
+	};
+	char trace_path[] = "/tmp/ctfwriter_int_array_XXXXXX";
+	struct bt_ctf_writer *writer = NULL;
+	struct bt_ctf_clock *clock = NULL;
+	struct bt_ctf_stream_class *stream_class = NULL;
+	struct bt_ctf_event_class *event_class = NULL;
+	struct bt_ctf_field_type *elem_type, *array_type, *length_type = NULL;
+	struct bt_ctf_stream *stream = NULL;
+	struct bt_ctf_event *event = NULL;
+	struct bt_ctf_field *array, *elem, *length = NULL;
+	struct bt_context *ctx = NULL;
+	struct bt_ctf_iter *iter = NULL;
+	const struct bt_ctf_event *read_event;
+	const struct bt_definition *scope;
+	char name[32];
+	int ret = 0, arrays_ok = 1, sequence_ok = 0;
+	unsigned int l, b, i;
+
+	if (!mkdtemp(trace_path)) {
+		perror("# perror");
+		return;
+	}
+	writer = bt_ctf_writer_create(trace_path);
+	clock = bt_ctf_clock_create("int_array_clock");
+	stream_class = bt_ctf_stream_class_create("int_array_stream");
+	event_class = bt_ctf_event_class_create("int_array_event");
+	length_type = bt_ctf_field_type_integer_create(8);
+	if (!writer || !clock || !stream_class || !event_class ||
+		!length_type) {
+		ret = -1;
+		goto end;
+	}
+	ret |= bt_ctf_writer_add_clock(writer, clock);
+	ret |= bt_ctf_stream_class_set_clock(stream_class, clock);
+	for (l = 0; l < sizeof(lens) / sizeof(lens[0]); l++) {
+		for (b = 0; b < 2; b++) {
+			elem_type = bt_ctf_field_type_integer_create(lens[l]);
+			ret |= bt_ctf_field_type_set_alignment(elem_type, 8);
+			ret |= bt_ctf_field_type_set_byte_order(elem_type,
+				byte_orders[b]);
+			array_type = bt_ctf_field_type_array_create(elem_type,
+				INT_ARRAY_TEST_LENGTH);
+			snprintf(name, sizeof(name), "array_%u_%s", lens[l],
+				b ? "be" : "le");
+			ret |= bt_ctf_event_class_add_field(event_class,
+				array_type, name);
+			bt_ctf_field_type_put(array_type);
+			bt_ctf_field_type_put(elem_type);
+		}
+	}
+	ret |= bt_ctf_event_class_add_field(event_class, length_type,
+		"seq_len");
+	elem_type = bt_ctf_field_type_integer_create(32);
+	ret |= bt_ctf_field_type_set_alignment(elem_type, 8);
+	ret |= bt_ctf_field_type_set_byte_order(elem_type,
+		BT_CTF_BYTE_ORDER_BIG_ENDIAN);
+	array_type = bt_ctf_field_type_sequence_create(elem_type, "seq_len");
+	ret |= bt_ctf_event_class_add_field(event_class, array_type, "seq");
+	bt_ctf_field_type_put(array_type);
+	bt_ctf_field_type_put(elem_type);
+	ret |= bt_ctf_stream_class_add_event_class(stream_class, event_class);
+	if (ret) {
+		goto end;
+	}
+	stream = bt_ctf_writer_create_stream(writer, stream_class);
+	event = bt_ctf_event_create(event_class);
+	if (!stream || !event) {
+		ret = -1;
+		goto end;
+	}
+	for (l = 0; l < sizeof(lens) / sizeof(lens[0]); l++) {
+		for (b = 0; b < 2; b++) {
+			snprintf(name, sizeof(name), "array_%u_%s", lens[l],
+				b ? "be" : "le");
+			array = bt_ctf_event_get_payload(event, name);
+			for (i = 0; i < INT_ARRAY_TEST_LENGTH; i++) {
+				elem = bt_ctf_field_array_get_field(array, i);
+				ret |= bt_ctf_field_unsigned_integer_set_value(
+					elem, int_array_test_value(lens[l], i));
+				bt_ctf_field_put(elem);
+			}
+			bt_ctf_field_put(array);
+		}
+	}
+	length = bt_ctf_event_get_payload(event, "seq_len");
+	ret |= bt_ctf_field_unsigned_integer_set_value(length,
+		INT_ARRAY_TEST_LENGTH - 2);
+	array = bt_ctf_event_get_payload(event, "seq");
+	ret |= bt_ctf_field_sequence_set_length(array, length);
+	for (i = 0; i < INT_ARRAY_TEST_LENGTH - 2; i++) {
+		elem = bt_ctf_field_sequence_get_field(array, i);
+		ret |= bt_ctf_field_unsigned_integer_set_value(elem,
+			int_array_test_value(32, i));
+		bt_ctf_field_put(elem);
+	}
+	bt_ctf_field_put(array);
+	ret |= bt_ctf_clock_set_time(clock, 1);
+	ret |= bt_ctf_stream_append_event(stream, event);
+	ret |= bt_ctf_stream_flush(stream);
+	bt_ctf_stream_put(stream);
+	stream = NULL;
+	bt_ctf_writer_put(writer);
+	writer = NULL;
+	if (ret) {
+		goto end;
+	}
+
+	ctx = bt_context_create();
+	if (!ctx || bt_context_add_trace(ctx, trace_path, "ctf", NULL, NULL,
+		NULL) < 0) {
+		ret = -1;
+		goto end;
+	}
+	iter = bt_ctf_iter_create(ctx, NULL, NULL);
+	read_event = iter ? bt_ctf_iter_read_event(iter) : NULL;
+	if (!read_event) {
+		ret = -1;
+		goto end;
+	}
+	scope = bt_ctf_get_top_level_scope(read_event, BT_EVENT_FIELDS);
+	for (l = 0; l < sizeof(lens) / sizeof(lens[0]); l++) {
+		for (b = 0; b < 2; b++) {
+			snprintf(name, sizeof(name), "array_%u_%s", lens[l],
+				b ? "be" : "le");
+			if (!int_array_test_check(read_event,
+				bt_ctf_get_field(read_event, scope, name),
+				lens[l], INT_ARRAY_TEST_LENGTH)) {
+				diag("Integer array \"%s\" does not match", name);
+				arrays_ok = 0;
+			}
+		}
+	}
+	sequence_ok = int_array_test_check(read_event,
+		bt_ctf_get_field(read_event, scope, "seq"), 32,
+		INT_ARRAY_TEST_LENGTH - 2);
+end:
+	ok(ret == 0 && arrays_ok,
+		"Read back integer arrays of 8 to 64 bits in both byte orders as contiguous values");
+	ok(ret == 0 && sequence_ok,
+		"Read back an integer sequence as contiguous values");
+	if (iter) {
+		bt_ctf_iter_destroy(iter);
+	}
+	if (ctx) {
+		bt_context_put(ctx);
+	}
+	bt_ctf_field_put(length);
+	bt_ctf_event_put(event);
+	bt_ctf_stream_put(stream);
+	bt_ctf_field_type_put(length_type);
+	bt_ctf_event_class_put(event_class);
+	bt_ctf_stream_class_put(stream_class);
+	bt_ctf_clock_put(clock);
+	bt_ctf_writer_put(writer);
+	remove_trace_dir(trace_path);
+}
+
+static const struct {
+	const char *name;
+	unsigned int len;
+	unsigned int alignment;
+	int signedness;
+	enum bt_ctf_byte_order byte_order;
+} int_store_test_fields[] = {
+	{ "u8", 8, 8, 0, BT_CTF_BYTE_ORDER_NATIVE },
+	{ "u3", 3, 1, 0, BT_CTF_BYTE_ORDER_NATIVE },
+	{ "u13_le", 13, 1, 0, BT_CTF_BYTE_ORDER_LITTLE_ENDIAN },
+	{ "u16_be", 16, 8, 0, BT_CTF_BYTE_ORDER_BIG_ENDIAN },
+	{ "u5_be", 5, 1, 0, BT_CTF_BYTE_ORDER_BIG_ENDIAN },
+	{ "u32", 32, 8, 0, BT_CTF_BYTE_ORDER_NATIVE },
+	{ "u64_be", 64, 8, 0, BT_CTF_BYTE_ORDER_BIG_ENDIAN },
+	{ "s32", 32, 8, 1, BT_CTF_BYTE_ORDER_NATIVE },
+	{ "u64", 64, 8, 0, BT_CTF_BYTE_ORDER_NATIVE },
+};
+
+/* Value of field f of the i-th event, sign-extended if signed */
+static
+uint64_t int_store_test_value(unsigned int f, unsigned int i)
+{
+	unsigned int len = int_store_test_fields[f].len;
+	uint64_t value = 0x9e3779b97f4a7c15ULL * (i + 1) + f;
+
+	if (len == 64) {
+		return value;
+	}
+	value &= (1ULL << len) - 1;
+	if (int_store_test_fields[f].signedness &&
+		(value & (1ULL << (len - 1)))) {
+		value |= ~((1ULL << len) - 1);
+	}
+	return value;
+}
+
+/*
+ * Write events whose payload mixes aligned and unaligned integers of
+ * both byte orders, stored through the serialization program of the
+ * payload structure, and read them back.
+ */
+void int_store_test(void)
+{
+	char trace_path[] = "/tmp/ctfwriter_int_store_XXXXXX";
+	const unsigned int nr_fields = sizeof(int_store_test_fields) /
+		sizeof(int_store_test_fields[0]);
+	struct bt_ctf_writer *writer = NULL;
+	struct bt_ctf_clock *clock = NULL;
+	struct bt_ctf_stream_class *stream_class = NULL;
+	struct bt_ctf_event_class *event_class = NULL;
+	struct bt_ctf_field_type *type;
+	struct bt_ctf_stream *stream = NULL;
+	struct bt_context *ctx = NULL;
+	struct bt_ctf_iter *iter = NULL;
+	const struct bt_ctf_event *read_event;
+	int ret = 0, values_ok = 1;
+	unsigned int f, i, nr_events = 0;
+
+	if (!mkdtemp(trace_path)) {
+		perror("# perror");
+		return;
+	}
+	writer = bt_ctf_writer_create(trace_path);
+	clock = bt_ctf_clock_create("int_store_clock");
+	stream_class = bt_ctf_stream_class_create("int_store_stream");
+	event_class = bt_ctf_event_class_create("int_store_event");
+	if (!writer || !clock || !stream_class || !event_class) {
+		ret = -1;
+		goto end;
+	}
+	ret |= bt_ctf_writer_add_clock(writer, clock);
+	ret |= bt_ctf_stream_class_set_clock(stream_class, clock);
+	for (f = 0; f < nr_fields; f++) {
+		type = bt_ctf_field_type_integer_create(
+			int_store_test_fields[f].len);
+		ret |= bt_ctf_field_type_integer_set_signed(type,
+			int_store_test_fields[f].signedness);
+		ret |= bt_ctf_field_type_set_alignment(type,
+			int_store_test_fields[f].alignment);
+		ret |= bt_ctf_field_type_set_byte_order(type,
+			int_store_test_fields[f].byte_order);
+		ret |= bt_ctf_event_class_add_field(event_class, type,
+			int_store_test_fields[f].name);
+		bt_ctf_field_type_put(type);
+	}
+	ret |= bt_ctf_stream_class_add_event_class(stream_class, event_class);
+	if (ret) {
+		goto end;
+	}
+	stream = bt_ctf_writer_create_stream(writer, stream_class);
+	if (!stream) {
+		ret = -1;
+		goto end;
+	}
+	for (i = 0; i < INT_STORE_TEST_LENGTH && !ret; i++) {
+		struct bt_ctf_event *event = bt_ctf_event_create(event_class);
+
+		if (!event) {
+			ret = -1;
+			break;
+		}
+		for (f = 0; f < nr_fields; f++) {
+			struct bt_ctf_field *field;
+			uint64_t value = int_store_test_value(f, i);
+
+			field = bt_ctf_event_get_payload(event,
+				int_store_test_fields[f].name);
+			if (int_store_test_fields[f].signedness) {
+				ret |= bt_ctf_field_signed_integer_set_value(
+					field, (int64_t) value);
+			} else {
+				ret |= bt_ctf_field_unsigned_integer_set_value(
+					field, value);
+			}
+			bt_ctf_field_put(field);
+		}
+		ret |= bt_ctf_clock_set_time(clock, i);
+		ret |= bt_ctf_stream_append_event(stream, event);
+		bt_ctf_event_put(event);
+	}
+	ret |= bt_ctf_stream_flush(stream);
+	bt_ctf_stream_put(stream);
+	stream = NULL;
+	bt_ctf_writer_put(writer);
+	writer = NULL;
+	if (ret) {
+		goto end;
+	}
+
+	ctx = bt_context_create();
+	if (!ctx || bt_context_add_trace(ctx, trace_path, "ctf", NULL, NULL,
+		NULL) < 0) {
+		ret = -1;
+		goto end;
+	}
+	iter = bt_ctf_iter_create(ctx, NULL, NULL);
+	if (!iter) {
+		ret = -1;
+		goto end;
+	}
+	while ((read_event = bt_ctf_iter_read_event(iter))) {
+		const struct bt_definition *scope;
+
+		scope = bt_ctf_get_top_level_scope(read_event, BT_EVENT_FIELDS);
+		for (f = 0; f < nr_fields; f++) {
+			const struct bt_definition *field;
+			uint64_t value;
+
+			field = bt_ctf_get_field(read_event, scope,
+				int_store_test_fields[f].name);
+			if (int_store_test_fields[f].signedness) {
+				value = (uint64_t) bt_ctf_get_int64(field);
+			} else {
+				value = bt_ctf_get_uint64(field);
+			}
+			if (value != int_store_test_value(f, nr_events)) {
+				diag("Integer \"%s\" of event %u does not match",
+					int_store_test_fields[f].name,
+					nr_events);
+				values_ok = 0;
+			}
+		}
+		nr_events++;
+		if (bt_iter_next(bt_ctf_get_iter(iter)) < 0) {
+			break;
+		}
+	}
+end:
+	ok(ret == 0 && nr_events == INT_STORE_TEST_LENGTH && values_ok,
+		"Read back aligned and unaligned integers of both byte orders");
+	if (iter) {
+		bt_ctf_iter_destroy(iter);
+	}
+	if (ctx) {
+		bt_context_put(ctx);
+	}
+	bt_ctf_stream_put(stream);
+	bt_ctf_event_class_put(event_class);
+	bt_ctf_stream_class_put(stream_class);
+	bt_ctf_clock_put(clock);
+	bt_ctf_writer_put(writer);
+	remove_trace_dir(trace_path);
+}
+
+int main(int argc, char **argv)
+{
+	char trace_path[] = "/tmp/ctfwriter_XXXXXX";
+	char metadata_path[sizeof(trace_path) + 9];
+	const char *clock_name = "test_clock";
+	const char *clock_description = "This is a test clock";
+	const char *returned_clock_name;
+	const char *returned_clock_description;
+	const uint64_t frequency = 1123456789;
+	const uint64_t offset_s = 1351530929945824323;
+	const uint64_t offset = 1234567;
+	const uint64_t precision = 10;
+	const int is_absolute = 0xFF;
+	char *metadata_string;
+	struct bt_ctf_writer *writer;
+	struct utsname name;
+	char hostname[BABELTRACE_HOST_NAME_MAX];
+	struct bt_ctf_clock *clock, *ret_clock;
+	struct bt_ctf_stream_class *stream_class, *ret_stream_class;
+	struct bt_ctf_stream *stream1;
+	const char *ret_string;
+	const unsigned char *ret_uuid;
+	unsigned char tmp_uuid[16] = { 0 };
+	struct bt_ctf_field_type *packet_context_type,
+		*packet_context_field_type,
+		*packet_header_type,
+		*packet_header_field_type,
+		*integer_type,
+		*stream_event_context_type,
+		*ret_field_type,
+		*event_header_field_type;
+	struct bt_ctf_field *packet_header, *packet_header_field;
+	struct bt_ctf_trace *trace;
+	int ret;
+	int64_t ret_int64_t;
+	struct bt_object *obj;
+
+	if (argc < 3) {
+		printf("Usage: tests-ctf-writer path_to_ctf_parser_test path_to_babeltrace\n");
+		return -1;
+	}
+
+	plan_no_plan();
+
+	if (!mkdtemp(trace_path)) {
+		perror("# perror");
+	}
+
+	strcpy(metadata_path, trace_path);
+	strcat(metadata_path + sizeof(trace_path) - 1, "/metadata");
+
+	writer = bt_ctf_writer_create(trace_path);
+	ok(writer, "bt_ctf_create succeeds in creating trace with path");
+
+	ok(!bt_ctf_writer_get_trace(NULL),
+		"bt_ctf_writer_get_trace correctly handles NULL");
+	trace = bt_ctf_writer_get_trace(writer);
+	ok(trace,
+		"bt_ctf_writer_get_trace returns a bt_ctf_trace object");
+	ok(bt_ctf_trace_set_byte_order(trace, BT_CTF_BYTE_ORDER_BIG_ENDIAN) == 0,
+		"Set a trace's byte order to big endian");
+	ok(bt_ctf_trace_get_byte_order(trace) == BT_CTF_BYTE_ORDER_BIG_ENDIAN,
+		"bt_ctf_trace_get_byte_order returns a correct endianness");
+
+	/* Add environment context to the trace */
+	ret = gethostname(hostname, sizeof(hostname));
+	if (ret < 0) {
+		return ret;
+	}
+	ok(bt_ctf_writer_add_environment_field(writer, "host", hostname) == 0,
+		"Add host (%s) environment field to writer instance",
+		hostname);
+	ok(bt_ctf_writer_add_environment_field(NULL, "test_field",
+		"test_value"),
+		"bt_ctf_writer_add_environment_field error with NULL writer");
+	ok(bt_ctf_writer_add_environment_field(writer, NULL,
+		"test_value"),
+		"bt_ctf_writer_add_environment_field error with NULL field name");
+	ok(bt_ctf_writer_add_environment_field(writer, "test_field",
+		NULL),
+		"bt_ctf_writer_add_environment_field error with NULL field value");
+
+	/* Test bt_ctf_trace_set_environment_field with an integer object */
+	obj = bt_object_integer_create_init(23);
+	assert(obj);
+	ok(bt_ctf_trace_set_environment_field(NULL, "test_env_int_obj", obj),
+		"bt_ctf_trace_set_environment_field handles a NULL trace correctly");
+	ok(bt_ctf_trace_set_environment_field(trace, NULL, obj),
+		"bt_ctf_trace_set_environment_field handles a NULL name correctly");
+	ok(bt_ctf_trace_set_environment_field(trace, "test_env_int_obj", NULL),
+		"bt_ctf_trace_set_environment_field handles a NULL value correctly");
+	ok(!bt_ctf_trace_set_environment_field(trace, "test_env_int_obj", obj),
+		"bt_ctf_trace_set_environment_field succeeds in adding an integer object");
+	BT_OBJECT_PUT(obj);
+
+	/* Test bt_ctf_trace_set_environment_field with a string object */
+	obj = bt_object_string_create_init("the value");
+	assert(obj);
+	ok(!bt_ctf_trace_set_environment_field(trace, "test_env_str_obj", obj),
+		"bt_ctf_trace_set_environment_field succeeds in adding a string object");
+	BT_OBJECT_PUT(obj);
+
+	/* Test bt_ctf_trace_set_environment_field_integer */
+	ok(bt_ctf_trace_set_environment_field_integer(NULL, "test_env_int",
+		-194875),
+		"bt_ctf_trace_set_environment_field_integer handles a NULL trace correctly");
+	ok(bt_ctf_trace_set_environment_field_integer(trace, NULL, -194875),
+		"bt_ctf_trace_set_environment_field_integer handles a NULL name correctly");
+	ok(!bt_ctf_trace_set_environment_field_integer(trace, "test_env_int",
+		-164973),
+		"bt_ctf_trace_set_environment_field_integer succeeds");
+
+	/* Test bt_ctf_trace_set_environment_field_string */
+	ok(bt_ctf_trace_set_environment_field_string(NULL, "test_env_str",
+		"yeah"),
+		"bt_ctf_trace_set_environment_field_string handles a NULL trace correctly");
+	ok(bt_ctf_trace_set_environment_field_string(trace, NULL, "yeah"),
+		"bt_ctf_trace_set_environment_field_string handles a NULL name correctly");
+	ok(bt_ctf_trace_set_environment_field_string(trace, "test_env_str",
+		NULL),
+		"bt_ctf_trace_set_environment_field_string handles a NULL value correctly");
+	ok(!bt_ctf_trace_set_environment_field_string(trace, "test_env_str",
+		"oh yeah"),
+		"bt_ctf_trace_set_environment_field_string succeeds");
+
+	/* Test bt_ctf_trace_get_environment_field_count */
+	ok(bt_ctf_trace_get_environment_field_count(NULL) < 0,
+		"bt_ctf_trace_get_environment_field_count handles a NULL trace correctly");
+	ok(bt_ctf_trace_get_environment_field_count(trace) == 5,
+		"bt_ctf_trace_get_environment_field_count returns a correct number of environment fields");
+
+	/* Test bt_ctf_trace_get_environment_field_name */
+	ok(bt_ctf_trace_get_environment_field_name(NULL, 0) == NULL,
+		"bt_ctf_trace_get_environment_field_name handles a NULL trace correctly");
+	ok(bt_ctf_trace_get_environment_field_name(trace, -1) == NULL,
+		"bt_ctf_trace_get_environment_field_name handles an invalid index correctly (negative)");
+	ok(bt_ctf_trace_get_environment_field_name(trace, 5) == NULL,
+		"bt_ctf_trace_get_environment_field_name handles an invalid index correctly (too large)");
+	ret_string = bt_ctf_trace_get_environment_field_name(trace, 0);
+	ok(ret_string && !strcmp(ret_string, "host"),
+		"bt_ctf_trace_get_environment_field_name returns a correct field name");
+	ret_string = bt_ctf_trace_get_environment_field_name(trace, 1);
+	ok(ret_string && !strcmp(ret_string, "test_env_int_obj"),
+		"bt_ctf_trace_get_environment_field_name returns a correct field name");
+	ret_string = bt_ctf_trace_get_environment_field_name(trace, 2);
+	ok(ret_string && !strcmp(ret_string, "test_env_str_obj"),
+		"bt_ctf_trace_get_environment_field_name returns a correct field name");
+	ret_string = bt_ctf_trace_get_environment_field_name(trace, 3);
+	ok(ret_string && !strcmp(ret_string, "test_env_int"),
+		"bt_ctf_trace_get_environment_field_name returns a correct field name");
+	ret_string = bt_ctf_trace_get_environment_field_name(trace, 4);
+	ok(ret_string && !strcmp(ret_string, "test_env_str"),
+		"bt_ctf_trace_get_environment_field_name returns a correct field name");
+
+	/* Test bt_ctf_trace_get_environment_field_value */
+	ok(bt_ctf_trace_get_environment_field_value(NULL, 0) == NULL,
+		"bt_ctf_trace_get_environment_field_value handles a NULL trace correctly");
+	ok(bt_ctf_trace_get_environment_field_value(trace, -1) == NULL,
+		"bt_ctf_trace_get_environment_field_value handles an invalid index correctly (negative)");
+	ok(bt_ctf_trace_get_environment_field_value(trace, 5) == NULL,
+		"bt_ctf_trace_get_environment_field_value handles an invalid index correctly (too large)");
+	obj = bt_ctf_trace_get_environment_field_value(trace, 1);
+	ret = bt_object_integer_get(obj, &ret_int64_t);
+	ok(!ret && ret_int64_t == 23,
+		"bt_ctf_trace_get_environment_field_value succeeds in getting an integer value");
+	BT_OBJECT_PUT(obj);
 	obj = bt_ctf_trace_get_environment_field_value(trace, 2);
 	ret = bt_object_string_get(obj, &ret_string);
 	ok(!ret && ret_string && !strcmp(ret_string, "the value"),
@@ -2822,6 +5524,22 @@ int main(int argc, char **argv)
 		"bt_ctf_stream_class_get_clock returns a correct clock");
 	bt_ctf_clock_put(ret_clock);
 
+	ok(bt_ctf_stream_class_get_packet_size(NULL) < 0,
+		"bt_ctf_stream_class_get_packet_size handles NULL correctly");
+	ok(bt_ctf_stream_class_get_packet_size(stream_class) == 0,
+		"bt_ctf_stream_class_get_packet_size returns 0 when the packet size was not set");
+	ok(bt_ctf_stream_class_set_packet_size(NULL, getpagesize()) < 0,
+		"bt_ctf_stream_class_set_packet_size handles NULL correctly");
+	ok(bt_ctf_stream_class_set_packet_size(stream_class,
+		getpagesize() + 1) < 0,
+		"bt_ctf_stream_class_set_packet_size rejects a size which is not a multiple of the page size");
+	ok(bt_ctf_stream_class_set_packet_size(stream_class,
+		2 * getpagesize()) == 0,
+		"Set a stream class' packet size");
+	ok(bt_ctf_stream_class_get_packet_size(stream_class) ==
+		2 * getpagesize(),
+		"bt_ctf_stream_class_get_packet_size returns the correct packet size");
+
 	/* Test the event fields and event types APIs */
 	type_field_tests();
 
@@ -3042,6 +5760,51 @@ int main(int argc, char **argv)
 
 	test_empty_stream(writer);
 
+	concurrent_append_test();
+
+	async_writer_test(0);
+
+	async_writer_test(BT_CTF_WRITER_ASYNC_DISCARD |
+		BT_CTF_WRITER_ASYNC_WRITEBACK);
+
+	incremental_metadata_test(0);
+
+	incremental_metadata_test(1);
+
+	packet_index_test();
+
+	copy_range_test();
+
+	stats_test();
+
+	compact_event_header_test();
+
+	compressed_stream_test();
+
+	stream_limits_test();
+
+	multiple_iterators_test();
+
+	seek_last_test();
+
+	event_snapshot_test();
+
+	trace_timestamps_test();
+
+	event_rate_test();
+
+	event_filter_test();
+
+	readahead_test();
+
+	packet_io_test();
+
+	packet_stream_test();
+
+	int_array_test();
+
+	int_store_test();
+
 	metadata_string = bt_ctf_writer_get_metadata_string(writer);
 	ok(metadata_string, "Get metadata string");
 
@@ -3070,20 +5833,6 @@ int main(int argc, char **argv)
 	bt_ctf_stream_class_put(stream_class);
 
 	/* Remove all trace files and delete temporary trace directory */
-	DIR *trace_dir = opendir(trace_path);
-	if (!trace_dir) {
-		perror("# opendir");
-		return -1;
-	}
-
-	struct dirent *entry;
-	while ((entry = readdir(trace_dir))) {
-		if (entry->d_type == DT_REG) {
-			unlinkat(dirfd(trace_dir), entry->d_name, 0);
-		}
-	}
-
-	rmdir(trace_path);
-	closedir(trace_dir);
+	remove_trace_dir(trace_path);
 	return 0;
 }
@@ -47,6 +47,7 @@ int bt_array_rw(struct bt_stream_pos *pos, struct bt_definition *definition)
 	uint64_t i;
 	int ret;
 
+	bt_array_update_elems(array_definition);
 	/* No need to align, because the first field will align itself. */
 	for (i = 0; i < array_declaration->len; i++) {
 		struct bt_definition *field =
@@ -122,6 +123,8 @@ struct bt_definition *
 	assert(!ret);
 	array->string = NULL;
 	array->elems = NULL;
+	array->values = NULL;
+	array->elems_stale = 0;
 
 	if (array_declaration->elem->id == CTF_TYPE_INTEGER) {
 		struct declaration_integer *integer_declaration =
@@ -132,6 +135,12 @@ struct bt_definition *
 
 			array->string = g_string_new("");
 		}
+		if (bt_int_declaration_is_bulk(integer_declaration)) {
+			array->values = g_array_sized_new(FALSE, TRUE,
+					integer_declaration->len / CHAR_BIT,
+					array_declaration->len);
+			g_array_set_size(array->values, array_declaration->len);
+		}
 	}
 
 	array->elems = g_ptr_array_sized_new(array_declaration->len);
@@ -164,6 +173,10 @@ error:
 		field->declaration->definition_free(field);
 	}
 	(void) g_ptr_array_free(array->elems, TRUE);
+	if (array->values)
+		(void) g_array_free(array->values, TRUE);
+	if (array->string)
+		(void) g_string_free(array->string, TRUE);
 	bt_free_definition_scope(array->p.scope);
 	bt_declaration_unref(array->p.declaration);
 	g_free(array);
@@ -179,6 +192,8 @@ void _array_definition_free(struct bt_definition *definition)
 
 	if (array->string)
 		(void) g_string_free(array->string, TRUE);
+	if (array->values)
+		(void) g_array_free(array->values, TRUE);
 	if (array->elems) {
 		for (i = 0; i < array->elems->len; i++) {
 			struct bt_definition *field;
@@ -206,9 +221,23 @@ struct bt_definition *bt_array_index(struct definition_array *array, uint64_t i)
 		return NULL;
 	if (i >= array->elems->len)
 		return NULL;
+	bt_array_update_elems(array);
 	return g_ptr_array_index(array->elems, i);
 }
 
+void bt_array_update_elems(struct definition_array *array)
+{
+	struct declaration_integer *integer_declaration;
+
+	if (!array->elems_stale)
+		return;
+	integer_declaration = container_of(array->declaration->elem,
+			struct declaration_integer, p);
+	bt_int_values_to_definitions(integer_declaration, array->values,
+			array->elems, array->declaration->len);
+	array->elems_stale = 0;
+}
+
 int bt_get_array_len(const struct bt_definition *field)
 {
 	struct definition_array *array_definition;
@@ -246,3 +275,41 @@ GString *bt_get_char_array(const struct bt_definition *field)
 	fprintf(stderr, "[warning] Extracting string\n");
 	return NULL;
 }
+
+const void *bt_get_int_array_values(const struct bt_definition *field,
+		uint64_t *len, size_t *elem_len)
+{
+	struct bt_declaration *elem;
+	GArray *values;
+
+	switch (field->declaration->id) {
+	case CTF_TYPE_ARRAY:
+	{
+		struct definition_array *array_definition =
+			container_of(field, struct definition_array, p);
+
+		values = array_definition->values;
+		elem = array_definition->declaration->elem;
+		if (values)
+			*len = array_definition->declaration->len;
+		break;
+	}
+	case CTF_TYPE_SEQUENCE:
+	{
+		struct definition_sequence *sequence_definition =
+			container_of(field, struct definition_sequence, p);
+
+		values = sequence_definition->values;
+		elem = sequence_definition->declaration->elem;
+		if (values)
+			*len = bt_sequence_len(sequence_definition);
+		break;
+	}
+	default:
+		return NULL;
+	}
+	if (!values)
+		return NULL;
+	*elem_len = container_of(elem, struct declaration_integer, p)->len;
+	return values->data;
+}
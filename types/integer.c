@@ -201,3 +201,83 @@ int64_t bt_get_signed_int(const struct bt_definition *field)
 		g_quark_to_string(field->name));
 	return (int64_t)integer_definition->value._unsigned;
 }
+
+int bt_int_declaration_is_bulk(const struct declaration_integer *integer_declaration)
+{
+	size_t alignment = integer_declaration->p.alignment;
+
+	switch (integer_declaration->len) {
+	case 8:
+	case 16:
+	case 32:
+	case 64:
+		break;
+	default:
+		return 0;
+	}
+	/*
+	 * Elements must start on a byte boundary, and the element
+	 * length must be a multiple of the alignment so that no padding
+	 * is inserted between consecutive elements.
+	 */
+	if (!alignment || (alignment % CHAR_BIT)
+			|| (integer_declaration->len % alignment))
+		return 0;
+	return 1;
+}
+
+void bt_int_values_to_definitions(const struct declaration_integer *integer_declaration,
+		const GArray *values, GPtrArray *elems, uint64_t len)
+{
+	uint64_t i;
+
+	for (i = 0; i < len; i++) {
+		struct definition_integer *integer =
+			container_of(g_ptr_array_index(elems, i),
+				struct definition_integer, p);
+
+		if (!integer_declaration->signedness) {
+			switch (integer_declaration->len) {
+			case 8:
+				integer->value._unsigned =
+					g_array_index(values, uint8_t, i);
+				break;
+			case 16:
+				integer->value._unsigned =
+					g_array_index(values, uint16_t, i);
+				break;
+			case 32:
+				integer->value._unsigned =
+					g_array_index(values, uint32_t, i);
+				break;
+			case 64:
+				integer->value._unsigned =
+					g_array_index(values, uint64_t, i);
+				break;
+			default:
+				assert(0);
+			}
+		} else {
+			switch (integer_declaration->len) {
+			case 8:
+				integer->value._signed =
+					g_array_index(values, int8_t, i);
+				break;
+			case 16:
+				integer->value._signed =
+					g_array_index(values, int16_t, i);
+				break;
+			case 32:
+				integer->value._signed =
+					g_array_index(values, int32_t, i);
+				break;
+			case 64:
+				integer->value._signed =
+					g_array_index(values, int64_t, i);
+				break;
+			default:
+				assert(0);
+			}
+		}
+	}
+}
@@ -39,16 +39,14 @@ struct bt_definition *_sequence_definition_new(struct bt_declaration *declaratio
 static
 void _sequence_definition_free(struct bt_definition *definition);
 
-int bt_sequence_rw(struct bt_stream_pos *pos, struct bt_definition *definition)
+static
+void sequence_grow_elems(struct definition_sequence *sequence_definition,
+		uint64_t len)
 {
-	struct definition_sequence *sequence_definition =
-		container_of(definition, struct definition_sequence, p);
 	const struct declaration_sequence *sequence_declaration =
 		sequence_definition->declaration;
-	uint64_t len, oldlen, i;
-	int ret;
+	uint64_t oldlen, i;
 
-	len = sequence_definition->length->value._unsigned;
 	/*
 	 * Yes, large sequences could be _painfully slow_ to parse due
 	 * to memory allocation for each event read. At least, never
@@ -58,8 +56,9 @@ int bt_sequence_rw(struct bt_stream_pos *pos, struct bt_definition *definition)
 	 * value for that.
 	 */
 	oldlen = sequence_definition->elems->len;
-	if (oldlen < len)
-		g_ptr_array_set_size(sequence_definition->elems, len);
+	if (oldlen >= len)
+		return;
+	g_ptr_array_set_size(sequence_definition->elems, len);
 
 	for (i = oldlen; i < len; i++) {
 		struct bt_definition **field;
@@ -76,6 +75,18 @@ int bt_sequence_rw(struct bt_stream_pos *pos, struct bt_definition *definition)
 					  sequence_definition->p.scope,
 					  name, i, NULL);
 	}
+}
+
+int bt_sequence_rw(struct bt_stream_pos *pos, struct bt_definition *definition)
+{
+	struct definition_sequence *sequence_definition =
+		container_of(definition, struct definition_sequence, p);
+	uint64_t len, i;
+	int ret;
+
+	len = sequence_definition->length->value._unsigned;
+	bt_sequence_update_elems(sequence_definition);
+	sequence_grow_elems(sequence_definition, len);
 	for (i = 0; i < len; i++) {
 		struct bt_definition **field;
 
@@ -170,6 +181,8 @@ struct bt_definition *_sequence_definition_new(struct bt_declaration *declaratio
 
 	sequence->string = NULL;
 	sequence->elems = NULL;
+	sequence->values = NULL;
+	sequence->elems_stale = 0;
 
 	if (sequence_declaration->elem->id == CTF_TYPE_INTEGER) {
 		struct declaration_integer *integer_declaration =
@@ -185,6 +198,10 @@ struct bt_definition *_sequence_definition_new(struct bt_declaration *declaratio
 				return &sequence->p;
 			}
 		}
+		if (bt_int_declaration_is_bulk(integer_declaration)) {
+			sequence->values = g_array_new(FALSE, TRUE,
+					integer_declaration->len / CHAR_BIT);
+		}
 	}
 
 	sequence->elems = g_ptr_array_new();
@@ -207,6 +224,8 @@ void _sequence_definition_free(struct bt_definition *definition)
 
 	if (sequence->string)
 		(void) g_string_free(sequence->string, TRUE);
+	if (sequence->values)
+		(void) g_array_free(sequence->values, TRUE);
 	if (sequence->elems) {
 		for (i = 0; i < sequence->elems->len; i++) {
 			struct bt_definition *field;
@@ -233,6 +252,23 @@ struct bt_definition *bt_sequence_index(struct definition_sequence *sequence, ui
 		return NULL;
 	if (i >= sequence->length->value._unsigned)
 		return NULL;
+	bt_sequence_update_elems(sequence);
 	assert(i < sequence->elems->len);
 	return g_ptr_array_index(sequence->elems, i);
 }
+
+void bt_sequence_update_elems(struct definition_sequence *sequence)
+{
+	struct declaration_integer *integer_declaration;
+	uint64_t len;
+
+	if (!sequence->elems_stale)
+		return;
+	len = bt_sequence_len(sequence);
+	sequence_grow_elems(sequence, len);
+	integer_declaration = container_of(sequence->declaration->elem,
+			struct declaration_integer, p);
+	bt_int_values_to_definitions(integer_declaration, sequence->values,
+			sequence->elems, len);
+	sequence->elems_stale = 0;
+}